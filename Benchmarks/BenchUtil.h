@@ -0,0 +1,72 @@
+//***************************************************************************************
+// BenchUtil.h
+//
+// Helpers shared by the benchmarks: a millisecond clock, best-of-N timing, seeded
+// random numbers and a counter of the failed checks against the brute-force references.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+namespace Bench
+{
+	inline double NowMs()
+	{
+		using Clock = std::chrono::steady_clock;
+		return std::chrono::duration<double, std::milli>(Clock::now().time_since_epoch()).count();
+	}
+
+	// Best time of repeat runs of fn, in milliseconds.
+	template<typename Func>
+	double BestMs(int repeat, Func&& fn)
+	{
+		double best = 1e30;
+		for (int i = 0; i < repeat; ++i)
+		{
+			double start = NowMs();
+			fn();
+			double ms = NowMs() - start;
+			best = ms < best ? ms : best;
+		}
+		return best;
+	}
+
+	class Random
+	{
+	public:
+		explicit Random(uint32_t seed) : mEngine(seed) {}
+
+		float Uniform(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(mEngine); }
+		uint32_t Below(uint32_t n) { return std::uniform_int_distribution<uint32_t>(0, n - 1)(mEngine); }
+
+	private:
+		std::mt19937 mEngine;
+	};
+
+	inline int& FailureCount()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline void Check(bool ok, const char* what)
+	{
+		if (!ok)
+		{
+			if (FailureCount()++ < 10)
+				printf("FAILED: %s\n", what);
+		}
+	}
+
+	// Exit code of the benchmark: non-zero if any check failed.
+	inline int Result()
+	{
+		if (FailureCount() > 0)
+			printf("%d checks failed\n", FailureCount());
+		return FailureCount() > 0 ? 1 : 0;
+	}
+}
@@ -0,0 +1,181 @@
+//***************************************************************************************
+// CameraBatchBench.cpp
+//
+// Moves 1 to 4096 cameras with random walk, strafe, pitch and yaw amounts for 200
+// frames, through CameraBatch and through a scalar port of Camera, one camera at a time.
+//   -Checks that the views of the two are identical, bit for bit, and that the
+//    projections follow the XMMatrixPerspectiveFovLH layout.
+//   -Prints the time of a moving frame for both, and of CameraBatch::Update alone.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "CameraBatch.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	struct Vec
+	{
+		float x, y, z;
+	};
+
+	Vec Add(Vec a, Vec b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vec Scale(Vec a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float Dot(Vec a, Vec b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vec Cross(Vec a, Vec b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	Vec Normalize(Vec a)
+	{
+		float length = std::sqrt(Dot(a, a));
+		return { a.x / length, a.y / length, a.z / length };
+	}
+
+	// Camera's operations, in the same order, without DirectXMath.
+	struct ScalarCamera
+	{
+		Vec Position = { 0.0f, 0.0f, 0.0f };
+		Vec Right = { 1.0f, 0.0f, 0.0f };
+		Vec Up = { 0.0f, 1.0f, 0.0f };
+		Vec Look = { 0.0f, 0.0f, 1.0f };
+		float View[16];
+
+		void Walk(float d) { Position = Add(Scale(Look, d), Position); }
+		void Strafe(float d) { Position = Add(Scale(Right, d), Position); }
+
+		void Pitch(float angle)
+		{
+			// Rotation about the right vector (XMMatrixRotationAxis).
+			Vec k = Normalize(Right);
+			float s = std::sin(angle);
+			float c = std::cos(angle);
+			auto rotate = [&](Vec v)
+			{
+				Vec kv = Cross(k, v);
+				float kd = Dot(k, v) * (1.0f - c);
+				return Vec{ v.x * c + kv.x * s + k.x * kd, v.y * c + kv.y * s + k.y * kd, v.z * c + kv.z * s + k.z * kd };
+			};
+			Up = rotate(Up);
+			Look = rotate(Look);
+		}
+
+		void RotateY(float angle)
+		{
+			float s = std::sin(angle);
+			float c = std::cos(angle);
+			auto rotate = [&](Vec v) { return Vec{ v.x * c + v.z * s, v.y, -v.x * s + v.z * c }; };
+			Right = rotate(Right);
+			Up = rotate(Up);
+			Look = rotate(Look);
+		}
+
+		void UpdateViewMatrix()
+		{
+			Look = Normalize(Look);
+			Up = Normalize(Cross(Look, Right));
+			Right = Cross(Up, Look);
+
+			float view[16] = {
+				Right.x, Up.x, Look.x, 0.0f,
+				Right.y, Up.y, Look.y, 0.0f,
+				Right.z, Up.z, Look.z, 0.0f,
+				-Dot(Position, Right), -Dot(Position, Up), -Dot(Position, Look), 1.0f };
+			for (int i = 0; i < 16; ++i)
+				View[i] = view[i];
+		}
+	};
+}
+
+int main()
+{
+	const int frames = 200;
+
+	for (uint32_t count : { 1u, 5u, 1023u, 1024u, 4096u })
+	{
+		Bench::Random random(count);
+		CameraBatch batch;
+		std::vector<ScalarCamera> cameras(count);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float position[3] = { random.Uniform(-50.0f, 50.0f), random.Uniform(-50.0f, 50.0f), random.Uniform(-50.0f, 50.0f) };
+			float target[3] = { random.Uniform(-1.0f, 1.0f), random.Uniform(-1.0f, 1.0f), random.Uniform(-1.0f, 1.0f) };
+			float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+			batch.Add();
+			batch.LookAt(i, position, target, worldUp);
+			batch.SetLens(i, 0.25f * 3.1415926535f + 0.001f * i, 16.0f / 9.0f, 0.1f + 0.001f * i, 1000.0f);
+
+			ScalarCamera& camera = cameras[i];
+			camera.Position = { position[0], position[1], position[2] };
+			camera.Look = Normalize(Vec{ target[0] - position[0], target[1] - position[1], target[2] - position[2] });
+			camera.Right = Normalize(Cross(Vec{ 0.0f, 1.0f, 0.0f }, camera.Look));
+			camera.Up = Cross(camera.Look, camera.Right);
+			camera.UpdateViewMatrix();
+		}
+		batch.Update();
+
+		// Some cameras stand still on some axes, as in a real frame.
+		std::vector<float> walk(count), strafe(count), pitch(count), yaw(count);
+		double scalarMs = 0.0;
+		double batchMs = 0.0;
+		double updateMs = 0.0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				walk[i] = i % 3 ? random.Uniform(-0.1f, 0.1f) : 0.0f;
+				strafe[i] = random.Uniform(-0.1f, 0.1f);
+				pitch[i] = i % 5 ? random.Uniform(-0.02f, 0.02f) : 0.0f;
+				yaw[i] = random.Uniform(-0.02f, 0.02f);
+			}
+
+			double start = Bench::NowMs();
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				ScalarCamera& camera = cameras[i];
+				if (walk[i] != 0.0f)
+					camera.Walk(walk[i]);
+				if (strafe[i] != 0.0f)
+					camera.Strafe(strafe[i]);
+				if (pitch[i] != 0.0f)
+					camera.Pitch(pitch[i]);
+				if (yaw[i] != 0.0f)
+					camera.RotateY(yaw[i]);
+				if (walk[i] != 0.0f || strafe[i] != 0.0f || pitch[i] != 0.0f || yaw[i] != 0.0f)
+					camera.UpdateViewMatrix();
+			}
+			double middle = Bench::NowMs();
+			batch.Walk(walk.data());
+			batch.Strafe(strafe.data());
+			batch.Pitch(pitch.data());
+			batch.RotateY(yaw.data());
+			batch.Update();
+			double end = Bench::NowMs();
+
+			scalarMs += middle - start;
+			batchMs += end - middle;
+			updateMs += batch.GetStats().UpdateMs;
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const float* view = batch.View(i);
+			bool same = true;
+			for (int k = 0; k < 16; ++k)
+				same = same && view[k] == cameras[i].View[k];
+			Bench::Check(same, "view differs from Camera's");
+
+			float fovY = 0.25f * 3.1415926535f + 0.001f * i;
+			float nearZ = 0.1f + 0.001f * i;
+			float height = std::cos(0.5f * fovY) / std::sin(0.5f * fovY);
+			float range = 1000.0f / (1000.0f - nearZ);
+			const float* proj = batch.Proj(i);
+			Bench::Check(proj[0] == height / (16.0f / 9.0f) && proj[5] == height && proj[10] == range &&
+				proj[11] == 1.0f && proj[14] == -range * nearZ && proj[15] == 0.0f, "projection layout");
+		}
+
+		printf("%5u cameras: %.4f ms per frame batched (Update %.4f ms), %.4f ms one camera at a time\n",
+			count, batchMs / frames, updateMs / frames, scalarMs / frames);
+	}
+
+	return Bench::Result();
+}
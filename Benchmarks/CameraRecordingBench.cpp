@@ -0,0 +1,485 @@
+//***************************************************************************************
+// CameraRecordingBench.cpp
+//
+// CameraRecording and CameraPath without the application.
+//   -Records a synthetic session the way CameraApp does (keys already held when the
+//    recording starts, two input samples per frame as with the late latch), saves and
+//    loads it, and checks that every field comes back: exactly, except event times,
+//    which are stored relative to their sample as floats.
+//   -Truncated files, files of another version, garbage and inconsistent counts are
+//    rejected and leave the recording empty.
+//   -Replaying the samples through a fresh InputSystem with the same bindings gives the
+//    action values of the live session: exactly from the recording in memory, to float
+//    precision from the file.
+//   -A CameraPath baked at 30 and 60 fps passes through its keys at the key times, with
+//    the camera looking at the key targets, and its speed is continuous across keys.
+//   -Times saving and loading a long session.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "CameraPath.h"
+#include "CameraRecording.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	enum Action : uint32_t
+	{
+		ActionWalk,
+		ActionStrafe,
+		ActionYaw,
+		ActionPitch,
+		ActionZoom,
+		ActionToggle,
+		ActionCount
+	};
+
+	void Bind(InputSystem& input)
+	{
+		input.BindKey(ActionWalk, 'W', 10.0f);
+		input.BindKey(ActionWalk, 'S', -10.0f);
+		input.BindKey(ActionStrafe, 'D', 10.0f);
+		input.BindMouseAxis(ActionYaw, MouseAxis::X, InputSystem::MouseLeft, 0.0043633f);
+		input.BindMouseAxis(ActionPitch, MouseAxis::Y, InputSystem::MouseLeft, 0.0043633f);
+		input.BindMouseAxis(ActionZoom, MouseAxis::X, InputSystem::MouseRight, 0.03f);
+		input.BindWheel(ActionZoom, -1.0f);
+		input.BindKey(ActionToggle, 'F');
+	}
+
+	struct ActionValues
+	{
+		float Values[ActionCount];
+		uint32_t Pressed;
+		uint32_t Down;
+	};
+
+	ActionValues Read(const InputSystem& input)
+	{
+		ActionValues values = {};
+		for (uint32_t action = 0; action < ActionCount; ++action)
+		{
+			values.Values[action] = input.Value(action);
+			values.Pressed |= input.Pressed(action) ? 1u << action : 0u;
+			values.Down |= input.Down(action) ? 1u << action : 0u;
+		}
+		return values;
+	}
+
+	bool Equal(const ActionValues& a, const ActionValues& b, float tolerance)
+	{
+		for (uint32_t action = 0; action < ActionCount; ++action)
+		{
+			if (std::fabs(a.Values[action] - b.Values[action]) > tolerance * std::max<float>(1.0f, std::fabs(a.Values[action])))
+				return false;
+		}
+		return a.Pressed == b.Pressed && a.Down == b.Down;
+	}
+
+	// Keys in bursts, a 1000 Hz mouse with buttons, wheel ticks, focus loss.
+	std::vector<InputEvent> MakeEvents(double seconds, uint32_t seed)
+	{
+		Bench::Random random(seed);
+		std::vector<InputEvent> events;
+
+		auto push = [&](InputEventType type, uint32_t code, int32_t x, int32_t y, double time)
+		{
+			InputEvent e;
+			e.Type = type;
+			e.Code = code;
+			e.X = x;
+			e.Y = y;
+			e.Time = time;
+			events.push_back(e);
+		};
+
+		int32_t x = 0;
+		int32_t y = 0;
+		for (double t = 0.0005; t < seconds; t += 0.001)
+		{
+			x += (int32_t)random.Below(7) - 3;
+			y += (int32_t)random.Below(5) - 2;
+			push(InputEventType::MouseMove, 0, x, y, t);
+		}
+
+		const uint32_t keys[] = { 'W', 'S', 'D', 'F', 'Q' };
+		for (uint32_t key : keys)
+		{
+			for (double t = random.Uniform(0.0f, 0.3f); t < seconds; t += random.Uniform(0.1f, 0.7f))
+			{
+				double held = random.Uniform(0.01f, 0.5f);
+				push(InputEventType::KeyDown, key, 0, 0, t);
+				for (double repeat = t + 0.25; repeat < t + held; repeat += 0.033)
+					push(InputEventType::KeyDown, key, 0, 0, repeat);
+				push(InputEventType::KeyUp, key, 0, 0, t + held);
+				t += held;
+			}
+		}
+
+		for (uint32_t button : { InputSystem::MouseLeft, InputSystem::MouseRight })
+		{
+			for (double t = random.Uniform(0.0f, 0.5f); t < seconds; t += random.Uniform(0.2f, 1.0f))
+			{
+				double held = random.Uniform(0.05f, 0.8f);
+				push(InputEventType::ButtonDown, button, x, y, t);
+				push(InputEventType::ButtonUp, button, x, y, t + held);
+				t += held;
+			}
+		}
+
+		for (double t = random.Uniform(0.0f, 1.0f); t < seconds; t += random.Uniform(0.05f, 1.0f))
+			push(InputEventType::MouseWheel, 0, (int32_t)random.Below(241) - 120, 0, t);
+
+		push(InputEventType::ReleaseAll, 0, 0, 0, 0.6 * seconds);
+
+		std::stable_sort(events.begin(), events.end(),
+			[](const InputEvent& a, const InputEvent& b) { return a.Time < b.Time; });
+		return events;
+	}
+
+	CameraState MakeCamera(Bench::Random& random)
+	{
+		CameraState camera;
+		for (int i = 0; i < 3; ++i)
+		{
+			camera.Position[i] = random.Uniform(-100.0f, 100.0f);
+			camera.Look[i] = random.Uniform(-1.0f, 1.0f);
+			camera.Up[i] = random.Uniform(-1.0f, 1.0f);
+		}
+		camera.FovY = random.Uniform(0.5f, 1.5f);
+		camera.Aspect = random.Uniform(1.0f, 2.0f);
+		return camera;
+	}
+
+	struct Session
+	{
+		CameraRecording Recording;
+
+		// Action values after every sample, in order.
+		std::vector<ActionValues> Values;
+	};
+
+	// The live input runs for a second before the recording starts, so keys and buttons
+	// can already be held; their state goes into the first sample.
+	Session Record(const std::vector<InputEvent>& events, double seconds, double frameTime)
+	{
+		Bench::Random random(7);
+		Session session;
+
+		InputSystem input;
+		Bind(input);
+
+		size_t next = 0;
+		auto sample = [&](double time)
+		{
+			for (; next < events.size() && events[next].Time <= time; ++next)
+				input.Push(events[next]);
+			input.Update(time);
+		};
+
+		double time = 0.0;
+		for (; time < 1.0; time += frameTime)
+			sample(time);
+
+		std::vector<InputEvent> startEvents = input.HeldStateEvents();
+		session.Recording.SetFlags(1);
+
+		for (; time < seconds; time += frameTime)
+		{
+			session.Recording.BeginFrame((float)frameTime);
+
+			// The frame's sample and the late latch a few ms later.
+			for (double at : { time, time + 0.001 * random.Uniform(2.0f, 12.0f) })
+			{
+				sample(at);
+				startEvents.insert(startEvents.end(), input.ProcessedEvents().begin(), input.ProcessedEvents().end());
+				session.Recording.AddSample(at, startEvents);
+				startEvents.clear();
+				session.Values.push_back(Read(input));
+			}
+
+			session.Recording.EndFrame(MakeCamera(random));
+		}
+
+		return session;
+	}
+
+	// Action values after every sample of a replay through a fresh input system.
+	std::vector<ActionValues> Replay(const CameraRecording& recording)
+	{
+		InputSystem input;
+		Bind(input);
+
+		std::vector<ActionValues> values;
+		for (uint32_t f = 0; f < recording.FrameCount(); ++f)
+		{
+			const CameraRecording::Frame& frame = recording.GetFrame(f);
+			for (uint32_t s = frame.FirstSample; s < frame.FirstSample + frame.SampleCount; ++s)
+			{
+				recording.PushSample(s, input);
+				input.Update(recording.GetSample(s).Time);
+				values.push_back(Read(input));
+			}
+		}
+		return values;
+	}
+
+	bool SameCamera(const CameraState& a, const CameraState& b)
+	{
+		return memcmp(a.Position, b.Position, sizeof(a.Position)) == 0 && memcmp(a.Look, b.Look, sizeof(a.Look)) == 0 &&
+			memcmp(a.Up, b.Up, sizeof(a.Up)) == 0 && a.FovY == b.FovY && a.Aspect == b.Aspect && a.NearZ == b.NearZ &&
+			a.FarZ == b.FarZ;
+	}
+
+	void CompareRecordings(const CameraRecording& saved, const CameraRecording& loaded)
+	{
+		bool same = saved.Flags() == loaded.Flags() && saved.FrameCount() == loaded.FrameCount();
+		uint32_t sampleCount = 0;
+		for (uint32_t f = 0; same && f < saved.FrameCount(); ++f)
+		{
+			const CameraRecording::Frame& a = saved.GetFrame(f);
+			const CameraRecording::Frame& b = loaded.GetFrame(f);
+			same = a.DeltaTime == b.DeltaTime && a.FirstSample == b.FirstSample && a.SampleCount == b.SampleCount &&
+				SameCamera(a.Camera, b.Camera);
+			sampleCount = a.FirstSample + a.SampleCount;
+		}
+		Bench::Check(same, "frames round-trip");
+
+		for (uint32_t s = 0; same && s < sampleCount; ++s)
+		{
+			const CameraRecording::Sample& a = saved.GetSample(s);
+			const CameraRecording::Sample& b = loaded.GetSample(s);
+			same = a.Time == b.Time && a.FirstEvent == b.FirstEvent && a.EventCount == b.EventCount;
+
+			for (uint32_t i = a.FirstEvent; same && i < a.FirstEvent + a.EventCount; ++i)
+			{
+				const InputEvent& ea = saved.GetEvent(i);
+				const InputEvent& eb = loaded.GetEvent(i);
+				same = ea.Type == eb.Type && ea.Code == eb.Code && ea.X == eb.X && ea.Y == eb.Y &&
+					eb.Time == a.Time + (float)(ea.Time - a.Time);
+			}
+		}
+		Bench::Check(same, "samples and events round-trip");
+	}
+
+	std::vector<uint8_t> ReadFile(const fs::path& path)
+	{
+		std::ifstream fin(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const fs::path& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+		fout.write((const char*)data.data(), data.size());
+	}
+
+	std::wstring Wide(const fs::path& path)
+	{
+		std::string s = path.string();
+		return std::wstring(s.begin(), s.end());
+	}
+
+	// Loading the file fails and leaves the recording empty.
+	void CheckRejected(const fs::path& path, const std::vector<uint8_t>& data, const char* what)
+	{
+		WriteFile(path, data);
+
+		CameraRecording recording;
+		recording.AddCameraFrame(0.1f, CameraState());
+		Bench::Check(!recording.Load(Wide(path)) && recording.FrameCount() == 0, what);
+	}
+
+	void CheckRecording(const fs::path& directory)
+	{
+		const double seconds = 20.0;
+		const std::vector<InputEvent> events = MakeEvents(seconds, 1);
+		Session session = Record(events, seconds, 1.0 / 60.0);
+
+		Bench::Check(session.Recording.GetSample(0).EventCount > 0 && session.Recording.GetEvent(0).Type == InputEventType::MouseMove,
+			"first sample starts with the held state");
+
+		// Replay from memory.
+		std::vector<ActionValues> replayed = Replay(session.Recording);
+		bool exact = replayed.size() == session.Values.size();
+		for (size_t i = 0; exact && i < replayed.size(); ++i)
+			exact = Equal(replayed[i], session.Values[i], 0.0f);
+		Bench::Check(exact, "replay from memory gives the live action values");
+
+		fs::path path = directory / "Session.crec";
+		Bench::Check(session.Recording.Save(Wide(path)), "save");
+
+		CameraRecording loaded;
+		Bench::Check(loaded.Load(Wide(path)), "load");
+		CompareRecordings(session.Recording, loaded);
+
+		// Saving what was loaded gives the same bytes.
+		fs::path resaved = directory / "Resaved.crec";
+		loaded.Save(Wide(resaved));
+		std::vector<uint8_t> data = ReadFile(path);
+		Bench::Check(data == ReadFile(resaved), "save of a loaded recording is identical");
+
+		replayed = Replay(loaded);
+		bool close = replayed.size() == session.Values.size();
+		for (size_t i = 0; close && i < replayed.size(); ++i)
+			close = Equal(replayed[i], session.Values[i], 1e-5f);
+		Bench::Check(close, "replay from the file gives the live action values");
+
+		std::vector<ActionValues> again = Replay(loaded);
+		exact = again.size() == replayed.size();
+		for (size_t i = 0; exact && i < again.size(); ++i)
+			exact = Equal(again[i], replayed[i], 0.0f);
+		Bench::Check(exact, "replays are identical");
+
+		// Invalid files.
+		fs::path bad = directory / "Bad.crec";
+		CheckRejected(bad, std::vector<uint8_t>(data.begin(), data.end() - 1), "truncated by one byte");
+		CheckRejected(bad, std::vector<uint8_t>(data.begin(), data.begin() + data.size() / 2), "truncated by half");
+		CheckRejected(bad, std::vector<uint8_t>(data.begin(), data.begin() + 10), "truncated header");
+		CheckRejected(bad, std::vector<uint8_t>(), "empty file");
+
+		std::vector<uint8_t> garbage(data.size());
+		Bench::Random random(3);
+		for (uint8_t& b : garbage)
+			b = (uint8_t)random.Below(256);
+		CheckRejected(bad, garbage, "garbage");
+
+		std::vector<uint8_t> other = data;
+		other[4] = CameraRecording::Version - 1;
+		CheckRejected(bad, other, "other version");
+
+		// The sample count of the first frame no longer matches the number of samples.
+		other = data;
+		other[24 + 4]++;
+		CheckRejected(bad, other, "inconsistent sample counts");
+
+		// An event type that does not exist.
+		other = data;
+		other[data.size() - 17] = 0xff;
+		CheckRejected(bad, other, "unknown event type");
+
+		CameraRecording missing;
+		Bench::Check(!missing.Load(Wide(directory / "Missing.crec")), "missing file");
+
+		// A long session: one hour at 60 fps, the events repeated.
+		CameraRecording hour;
+		for (int i = 0; i < 180; ++i)
+		{
+			for (uint32_t f = 0; f < session.Recording.FrameCount(); ++f)
+			{
+				const CameraRecording::Frame& frame = session.Recording.GetFrame(f);
+				hour.BeginFrame(frame.DeltaTime);
+				for (uint32_t s = frame.FirstSample; s < frame.FirstSample + frame.SampleCount; ++s)
+				{
+					const CameraRecording::Sample& sample = session.Recording.GetSample(s);
+					std::vector<InputEvent> sampleEvents;
+					for (uint32_t e = sample.FirstEvent; e < sample.FirstEvent + sample.EventCount; ++e)
+						sampleEvents.push_back(session.Recording.GetEvent(e));
+					hour.AddSample(sample.Time, sampleEvents);
+				}
+				hour.EndFrame(frame.Camera);
+			}
+		}
+
+		fs::path hourPath = directory / "Hour.crec";
+		double saveMs = Bench::BestMs(3, [&] { hour.Save(Wide(hourPath)); });
+		CameraRecording hourLoaded;
+		double loadMs = Bench::BestMs(3, [&] { hourLoaded.Load(Wide(hourPath)); });
+		Bench::Check(hourLoaded.FrameCount() == hour.FrameCount(), "long session round-trip");
+
+		printf("%u frames of %.0f s in %.1f KB; one hour (%u frames, %.1f MB): save %.1f ms, load %.1f ms\n",
+			session.Recording.FrameCount(), seconds - 1.0, data.size() / 1024.0, hour.FrameCount(),
+			fs::file_size(hourPath) / (1024.0 * 1024.0), saveMs, loadMs);
+	}
+
+	void CheckPath()
+	{
+		const float times[] = { 0.0f, 0.7f, 1.9f, 3.1f, 3.5f };
+		const float positions[][3] = { { 0, 5, -20 }, { 10, 6, -10 }, { 15, 4, 5 }, { 0, 8, 20 }, { -5, 8, 22 } };
+		const float targets[][3] = { { 0, 0, 0 }, { 2, 1, 0 }, { 0, 0, 3 }, { -4, 2, 0 }, { -6, 2, 0 } };
+
+		CameraPath path;
+		for (int k = 0; k < 5; ++k)
+			path.AddKey(times[k], positions[k], targets[k]);
+		path.SetLens(0.8f, 1.5f, 0.5f, 500.0f);
+
+		for (float fps : { 30.0f, 60.0f })
+		{
+			CameraRecording recording;
+			path.Bake(fps, recording);
+
+			Bench::Check(recording.FrameCount() == (uint32_t)std::lround(path.Duration() * fps) + 1, "baked frame count");
+
+			bool throughKeys = true;
+			for (int k = 0; k < 5 && throughKeys; ++k)
+			{
+				uint32_t f = (uint32_t)std::lround(times[k] * fps);
+				if (f >= recording.FrameCount())
+				{
+					throughKeys = false;
+					break;
+				}
+
+				const CameraState& camera = recording.GetFrame(f).Camera;
+				float look[3];
+				float lookLength = 0.0f;
+				for (int i = 0; i < 3; ++i)
+				{
+					throughKeys = throughKeys && std::fabs(camera.Position[i] - positions[k][i]) < 1e-3f;
+					look[i] = targets[k][i] - positions[k][i];
+					lookLength += look[i] * look[i];
+				}
+				lookLength = std::sqrt(lookLength);
+				for (int i = 0; i < 3; ++i)
+					throughKeys = throughKeys && std::fabs(camera.Look[i] - look[i] / lookLength) < 1e-4f;
+
+				throughKeys = throughKeys && camera.FovY == 0.8f && camera.Aspect == 1.5f && std::fabs(camera.Up[1]) > 0.0f;
+			}
+			Bench::Check(throughKeys, "baked path passes through the keys");
+
+			for (uint32_t f = 0; f < recording.FrameCount(); ++f)
+				Bench::Check(recording.GetFrame(f).DeltaTime == 1.0f / fps, "baked delta time");
+		}
+
+		// Velocity on both sides of the inner keys.
+		bool continuous = true;
+		for (int k = 1; k < 4; ++k)
+		{
+			const float h = 1e-3f;
+			CameraState before = path.Sample(times[k] - h);
+			CameraState at = path.Sample(times[k]);
+			CameraState after = path.Sample(times[k] + h);
+			for (int i = 0; i < 3; ++i)
+			{
+				float left = (at.Position[i] - before.Position[i]) / h;
+				float right = (after.Position[i] - at.Position[i]) / h;
+				continuous = continuous && std::fabs(left - right) < 0.05f * std::max<float>(1.0f, std::fabs(left));
+			}
+		}
+		Bench::Check(continuous, "speed continuous across keys");
+
+		// Clamped outside the path.
+		Bench::Check(path.Sample(-1.0f).Position[0] == positions[0][0] && path.Sample(10.0f).Position[2] == positions[4][2],
+			"clamped outside the keys");
+	}
+}
+
+int main()
+{
+	fs::path directory = fs::temp_directory_path() / "CameraRecordingBench";
+	fs::remove_all(directory);
+	fs::create_directories(directory);
+
+	CheckRecording(directory);
+	CheckPath();
+
+	fs::remove_all(directory);
+
+	return Bench::Result();
+}
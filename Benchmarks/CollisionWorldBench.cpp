@@ -0,0 +1,147 @@
+//***************************************************************************************
+// CollisionWorldBench.cpp
+//
+// 5000 box movers random-walking for 60 frames among 10k and 1M static boxes, at the
+// same density, plus the box of the app stopping at and sliding along a column.
+//   -Checks where the app's box stops and slides, and that none of the checked movers
+//    that started outside every static ends up inside one (against all of them).
+//   -Prints the time of a frame of moves, timed as a whole, and the time per move.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "CollisionWorld.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const float MoverExtents[3] = { 0.5f, 1.0f, 0.5f };
+
+	bool Overlap(const float a[3], const float extentsA[3], const float b[3], const float extentsB[3])
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (std::fabs(a[i] - b[i]) >= extentsA[i] + extentsB[i])
+				return false;
+		}
+		return true;
+	}
+
+	bool InsideStatic(const std::vector<float>& statics, const float center[3])
+	{
+		for (size_t k = 0; k < statics.size(); k += 6)
+		{
+			if (Overlap(center, MoverExtents, &statics[k], &statics[k + 3]))
+				return true;
+		}
+		return false;
+	}
+
+	void CheckRoom()
+	{
+		// The floor of the app: four walls and a column.
+		CollisionWorld world(4.0f);
+		const float walls[4][6] = {
+			{ 10.4f, 1.0f, 0.0f, 0.5f, 2.0f, 16.0f },
+			{ -10.4f, 1.0f, 0.0f, 0.5f, 2.0f, 16.0f },
+			{ 0.0f, 1.0f, 15.4f, 11.0f, 2.0f, 0.5f },
+			{ 0.0f, 1.0f, -15.4f, 11.0f, 2.0f, 0.5f } };
+		for (const float* wall : walls)
+			world.AddStatic(wall, wall + 3);
+
+		const float column[6] = { 5.0f, 1.5f, 0.0f, 0.5f, 1.5f, 0.5f };
+		world.AddStatic(column, column + 3);
+
+		const float start[3] = { 0.0f, 1.0f, 0.0f };
+		const float extents[3] = { 1.0f, 1.0f, 1.0f };
+		uint32_t box = world.AddMover(start, extents);
+
+		// Against the column, then along its face, then past it into the corner.
+		float position[3];
+		const float toColumn[3] = { 20.0f, 0.0f, 0.0f };
+		Bench::Check(world.Move(box, toColumn), "no hit against the column");
+		world.GetPosition(box, position);
+		Bench::Check(std::fabs(position[0] - 3.5f) < 0.01f, "box not stopped at the column");
+
+		const float alongColumn[3] = { 1.0f, 0.0f, 3.0f };
+		world.Move(box, alongColumn);
+		world.GetPosition(box, position);
+		Bench::Check(position[2] > 2.9f && position[0] < 3.5f, "box not sliding along the column");
+
+		const float toCorner[3] = { 20.0f, 0.0f, 30.0f };
+		world.Move(box, toCorner);
+		world.GetPosition(box, position);
+		Bench::Check(position[0] > 8.8f && position[0] < 8.91f && position[2] > 13.8f && position[2] < 13.91f,
+			"box not stopped in the corner");
+	}
+}
+
+int main()
+{
+	CheckRoom();
+
+	const uint32_t moverCount = 5000;
+	const uint32_t checkedMovers = 500;
+	const int frames = 60;
+
+	for (uint32_t staticCount : { 10000u, 1000000u })
+	{
+		Bench::Random random(1);
+		float side = 400.0f * std::sqrt(staticCount / 10000.0f);
+
+		CollisionWorld world(4.0f);
+		std::vector<float> statics;
+		for (uint32_t i = 0; i < staticCount; ++i)
+		{
+			float box[6] = { random.Uniform(0.0f, side), 1.0f, random.Uniform(0.0f, side),
+				random.Uniform(0.3f, 1.3f), 1.0f, random.Uniform(0.3f, 1.3f) };
+			world.AddStatic(box, box + 3);
+			statics.insert(statics.end(), box, box + 6);
+		}
+
+		std::vector<uint32_t> movers;
+		std::vector<bool> startedInside(checkedMovers);
+		for (uint32_t i = 0; i < moverCount; ++i)
+		{
+			float center[3] = { random.Uniform(0.0f, 400.0f), 1.0f, random.Uniform(0.0f, 400.0f) };
+			movers.push_back(world.AddMover(center, MoverExtents));
+			if (i < checkedMovers)
+				startedInside[i] = InsideStatic(statics, center);
+		}
+
+		world.ResetStats();
+		std::vector<float> steps(2 * moverCount);
+		double totalMs = 0.0;
+		double bestMs = 1e30;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			for (float& step : steps)
+				step = random.Uniform(-0.2f, 0.2f);
+
+			double start = Bench::NowMs();
+			for (uint32_t i = 0; i < moverCount; ++i)
+			{
+				const float displacement[3] = { steps[2 * i], 0.0f, steps[2 * i + 1] };
+				world.Move(movers[i], displacement);
+			}
+			double ms = Bench::NowMs() - start;
+			totalMs += ms;
+			bestMs = std::min<double>(bestMs, ms);
+		}
+
+		for (uint32_t i = 0; i < checkedMovers; ++i)
+		{
+			float center[3];
+			world.GetPosition(movers[i], center);
+			Bench::Check(startedInside[i] || !InsideStatic(statics, center), "mover ended inside a static");
+		}
+
+		const CollisionWorld::Stats& stats = world.GetStats();
+		printf("%7u statics, %u movers: %.2f ms per frame (best %.2f), %.2f us per move, %.1f candidates per move\n",
+			staticCount, moverCount, totalMs / frames, bestMs, 1000.0 * totalMs / stats.Moves,
+			(double)stats.CandidatesTested / stats.Moves);
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// CubeCullBench.cpp
+//
+// A cube camera (an environment probe) moving over 22, 1k and 100k random boxes on a
+// floor, with far planes of 20, 100 and 1000, culled three ways: CullCube, the six face
+// frustums in one CullFrustums traversal, and the six faces one at a time.
+//   -Checks on every 50th frame that no face lists an item twice, that every face list
+//    is within that of the plane test (CullCube is exact where the planes are
+//    conservative), and that an item with a sample point (corners, edge and face
+//    centers, center) inside a face is listed for it.
+//   -Prints the time of a frame for each of the three.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "BoundsBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const float NearZ = 0.1f;
+
+	// Cube map order: +x, -x, +y, -y, +z, -z.
+	const float FaceForward[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const float FaceUp[6][3] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 } };
+
+	BoundsBvh::Frustum FaceFrustum(const float eye[3], int face, float farZ)
+	{
+		const float* forward = FaceForward[face];
+		const float* up = FaceUp[face];
+		const float right[3] = {
+			up[1] * forward[2] - up[2] * forward[1],
+			up[2] * forward[0] - up[0] * forward[2],
+			up[0] * forward[1] - up[1] * forward[0] };
+
+		auto plane = [&](const float normal[3], float offset, float* out)
+		{
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int i = 0; i < 3; ++i)
+				out[i] = normal[i] / length;
+			out[3] = -(out[0] * eye[0] + out[1] * eye[1] + out[2] * eye[2]) + offset;
+		};
+
+		// 90 degrees both ways: the side planes are at 45 degrees from the axis.
+		float left[3], rightPlane[3], bottom[3], top[3], back[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			left[i] = forward[i] + right[i];
+			rightPlane[i] = forward[i] - right[i];
+			bottom[i] = forward[i] + up[i];
+			top[i] = forward[i] - up[i];
+			back[i] = -forward[i];
+		}
+
+		BoundsBvh::Frustum frustum;
+		plane(left, 0.0f, frustum.Planes[0]);
+		plane(rightPlane, 0.0f, frustum.Planes[1]);
+		plane(bottom, 0.0f, frustum.Planes[2]);
+		plane(top, 0.0f, frustum.Planes[3]);
+		plane(forward, -NearZ, frustum.Planes[4]);
+		plane(back, farZ, frustum.Planes[5]);
+		return frustum;
+	}
+
+	bool InFace(const float point[3], const float center[3], int face, float farZ)
+	{
+		int axis = face / 2;
+		float depth = (face & 1 ? -1.0f : 1.0f) * (point[axis] - center[axis]);
+		return depth >= NearZ && depth <= farZ &&
+			std::fabs(point[(axis + 1) % 3] - center[(axis + 1) % 3]) <= depth &&
+			std::fabs(point[(axis + 2) % 3] - center[(axis + 2) % 3]) <= depth;
+	}
+
+	void CheckFaces(const std::vector<float>& centers, const std::vector<float>& extents, const float center[3], float farZ,
+		const std::vector<uint32_t>* cube, const std::vector<uint32_t>* planes)
+	{
+		for (int face = 0; face < 6; ++face)
+		{
+			std::vector<uint32_t> listed = cube[face];
+			std::sort(listed.begin(), listed.end());
+			Bench::Check(std::adjacent_find(listed.begin(), listed.end()) == listed.end(), "item listed twice for a face");
+
+			std::vector<uint32_t> planeListed = planes[face];
+			std::sort(planeListed.begin(), planeListed.end());
+			Bench::Check(std::includes(planeListed.begin(), planeListed.end(), listed.begin(), listed.end()),
+				"item listed that the face planes cull");
+
+			for (uint32_t item = 0; item < centers.size() / 3; ++item)
+			{
+				if (std::binary_search(listed.begin(), listed.end(), item))
+					continue;
+
+				for (int sample = 0; sample < 27; ++sample)
+				{
+					float point[3];
+					for (int k = 0, s = sample; k < 3; ++k, s /= 3)
+						point[k] = centers[3 * item + k] + (float)(s % 3 - 1) * extents[3 * item + k];
+
+					if (InFace(point, center, face, farZ))
+					{
+						Bench::Check(false, "item inside a face is missing");
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	for (uint32_t count : { 22u, 1000u, 100000u })
+	{
+		Bench::Random random(count);
+		float span = 4.0f * std::sqrt((float)count);
+
+		BoundsBvh bvh;
+		std::vector<float> centers;
+		std::vector<float> extents;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float center[3] = { random.Uniform(0.0f, span), random.Uniform(0.0f, 3.0f), random.Uniform(0.0f, span) };
+			float extent[3] = { random.Uniform(0.5f, 1.5f), random.Uniform(0.5f, 1.5f), random.Uniform(0.5f, 1.5f) };
+			bvh.Add(center, extent);
+			centers.insert(centers.end(), center, center + 3);
+			extents.insert(extents.end(), extent, extent + 3);
+		}
+		bvh.Build();
+
+		for (float farZ : { 20.0f, 100.0f, 1000.0f })
+		{
+			const int frames = count > 10000 ? 200 : 3000;
+			std::vector<uint32_t> cube[6];
+			std::vector<uint32_t> shared[6];
+			std::vector<uint32_t> separate[6];
+			double ms[3] = {};
+
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				float center[3] = { span * (0.3f + 0.004f * ((frame * 37) % 100)), 1.5f, span * (0.3f + 0.004f * ((frame * 61) % 100)) };
+
+				BoundsBvh::Frustum faces[6];
+				for (int face = 0; face < 6; ++face)
+					faces[face] = FaceFrustum(center, face, farZ);
+
+				// Each way goes first in turn, so none always finds the nodes in the cache.
+				for (int pass = 0; pass < 3; ++pass)
+				{
+					int way = (pass + frame) % 3;
+					double start = Bench::NowMs();
+					if (way == 0)
+					{
+						bvh.CullCube(center, NearZ, farZ, cube);
+					}
+					else if (way == 1)
+					{
+						bvh.CullFrustums(faces, 6, shared);
+					}
+					else
+					{
+						for (int face = 0; face < 6; ++face)
+							bvh.CullFrustums(&faces[face], 1, &separate[face]);
+					}
+					ms[way] += Bench::NowMs() - start;
+				}
+
+				if (frame % 50 == 0)
+					CheckFaces(centers, extents, center, farZ, cube, shared);
+			}
+
+			size_t listed = 0;
+			size_t planeListed = 0;
+			for (int face = 0; face < 6; ++face)
+			{
+				listed += cube[face].size();
+				planeListed += shared[face].size();
+			}
+
+			printf("%6u boxes, far %4.0f: CullCube %7.2f us, six frustums shared %7.2f us, one at a time %7.2f us; %zu vs %zu listed\n",
+				count, farZ, 1000.0 * ms[0] / frames, 1000.0 * ms[1] / frames, 1000.0 * ms[2] / frames, listed, planeListed);
+		}
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,164 @@
+//***************************************************************************************
+// FrustumCullBench.cpp
+//
+// One, two and four turning cameras side by side over 22, 1k and 100k random boxes on
+// a floor, culled by BoundsBvh::CullFrustums all in one traversal, and one frustum at a
+// time with a traversal each.
+//   -Checks every list, shared and separate, against a brute-force plane test of every
+//    box, on every 50th frame.
+//   -Prints the time of a frame of culls for both.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "BoundsBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Planes facing inside, from the eye, the yaw about +y, the lens and the depth range.
+	BoundsBvh::Frustum MakeFrustum(const float eye[3], float yaw, float fovY, float aspect, float nearZ, float farZ)
+	{
+		const float forward[3] = { std::sin(yaw), 0.0f, std::cos(yaw) };
+		const float up[3] = { 0.0f, 1.0f, 0.0f };
+		const float right[3] = { forward[2], 0.0f, -forward[0] };
+		float tanY = std::tan(0.5f * fovY);
+		float tanX = tanY * aspect;
+
+		auto plane = [&](const float normal[3], float offset, float* out)
+		{
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int i = 0; i < 3; ++i)
+				out[i] = normal[i] / length;
+			out[3] = -(out[0] * eye[0] + out[1] * eye[1] + out[2] * eye[2]) + offset;
+		};
+
+		float left[3], rightPlane[3], bottom[3], top[3], back[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			left[i] = forward[i] * tanX + right[i];
+			rightPlane[i] = forward[i] * tanX - right[i];
+			bottom[i] = forward[i] * tanY + up[i];
+			top[i] = forward[i] * tanY - up[i];
+			back[i] = -forward[i];
+		}
+
+		BoundsBvh::Frustum frustum;
+		plane(left, 0.0f, frustum.Planes[0]);
+		plane(rightPlane, 0.0f, frustum.Planes[1]);
+		plane(bottom, 0.0f, frustum.Planes[2]);
+		plane(top, 0.0f, frustum.Planes[3]);
+		plane(forward, -nearZ, frustum.Planes[4]);
+		plane(back, farZ, frustum.Planes[5]);
+		return frustum;
+	}
+
+	std::vector<uint32_t> BruteForceCull(const std::vector<float>& centers, const std::vector<float>& extents,
+		const BoundsBvh::Frustum& frustum)
+	{
+		std::vector<uint32_t> visible;
+		for (size_t item = 0; item < centers.size() / 3; ++item)
+		{
+			const float* c = &centers[3 * item];
+			const float* e = &extents[3 * item];
+
+			bool outside = false;
+			for (const float* p : frustum.Planes)
+			{
+				float distance = p[0] * c[0] + p[1] * c[1] + p[2] * c[2] + p[3];
+				float radius = std::fabs(p[0]) * e[0] + std::fabs(p[1]) * e[1] + std::fabs(p[2]) * e[2];
+				outside = outside || distance < -radius;
+			}
+
+			if (!outside)
+				visible.push_back((uint32_t)item);
+		}
+		return visible;
+	}
+
+	bool SameItems(std::vector<uint32_t> a, const std::vector<uint32_t>& sorted)
+	{
+		std::sort(a.begin(), a.end());
+		return a == sorted;
+	}
+}
+
+int main()
+{
+	for (uint32_t count : { 22u, 1000u, 100000u })
+	{
+		Bench::Random random(count);
+		float span = 4.0f * std::sqrt((float)count);
+
+		BoundsBvh bvh;
+		std::vector<float> centers;
+		std::vector<float> extents;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float center[3] = { random.Uniform(0.0f, span), random.Uniform(0.0f, 3.0f), random.Uniform(0.0f, span) };
+			float extent[3] = { random.Uniform(0.5f, 1.5f), random.Uniform(0.5f, 1.5f), random.Uniform(0.5f, 1.5f) };
+			bvh.Add(center, extent);
+			centers.insert(centers.end(), center, center + 3);
+			extents.insert(extents.end(), extent, extent + 3);
+		}
+		bvh.Build();
+
+		for (uint32_t viewCount : { 1u, 2u, 4u })
+		{
+			const int frames = count > 10000 ? 200 : 5000;
+			std::vector<uint32_t> shared[4];
+			std::vector<uint32_t> separate[4];
+			double sharedMs = 0.0;
+			double separateMs = 0.0;
+
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				// Cameras a little apart, turning together and looking 0.3 rad apart: their
+				// frustums overlap, as in a split screen.
+				BoundsBvh::Frustum frustums[4];
+				for (uint32_t v = 0; v < viewCount; ++v)
+				{
+					float eye[3] = { 0.5f * span + 1.5f * v, 2.0f, 0.5f * span };
+					frustums[v] = MakeFrustum(eye, 0.01f * frame + 0.3f * v, 0.785f, v == 0 ? 1.7f : 0.85f, 1.0f,
+						std::min<float>(1000.0f, span));
+				}
+
+				// Alternately first, so neither finds the nodes already in the cache every frame.
+				for (int pass = 0; pass < 2; ++pass)
+				{
+					double start = Bench::NowMs();
+					if ((pass == 0) == (frame % 2 == 0))
+					{
+						bvh.CullFrustums(frustums, viewCount, shared);
+						sharedMs += Bench::NowMs() - start;
+					}
+					else
+					{
+						for (uint32_t v = 0; v < viewCount; ++v)
+							bvh.CullFrustums(&frustums[v], 1, &separate[v]);
+						separateMs += Bench::NowMs() - start;
+					}
+				}
+
+				if (frame % 50 == 0)
+				{
+					for (uint32_t v = 0; v < viewCount; ++v)
+					{
+						std::vector<uint32_t> expected = BruteForceCull(centers, extents, frustums[v]);
+						Bench::Check(SameItems(shared[v], expected), "shared cull differs from brute force");
+						Bench::Check(SameItems(separate[v], expected), "separate cull differs from brute force");
+					}
+				}
+			}
+
+			if (viewCount == 1)
+				printf("%6u boxes, 1 view:  %7.2f us per frame\n", count, 1000.0 * sharedMs / frames);
+			else
+				printf("%6u boxes, %u views: %7.2f us per frame shared, %7.2f us one frustum at a time\n", count, viewCount,
+					1000.0 * sharedMs / frames, 1000.0 * separateMs / frames);
+		}
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,322 @@
+//***************************************************************************************
+// InputSystemBench.cpp
+//
+// InputSystem driven with synthetic event streams.
+//   -Checks the time a key is held across updates, that auto-repeat neither restarts
+//    the hold nor presses again, mouse axes bound to combinations of buttons, release
+//    of keys and buttons on focus loss, and fractional wheel steps.
+//   -A 1000 Hz mouse turning the camera at 60 fps: applying the summed deltas once per
+//    frame, as CameraApp does, against turning the camera and rebuilding its view for
+//    every message, as the old OnMouseMove did. Checks that both end at the same
+//    orientation and times the two.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "InputSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	enum Action : uint32_t
+	{
+		ActionWalk,
+		ActionYaw,
+		ActionPitch,
+		ActionPan,
+		ActionZoom,
+		ActionCount
+	};
+
+	const uint32_t KeyWalk = 'W';
+	const uint32_t KeyBack = 'S';
+
+	bool Near(double a, double b, double tolerance = 1e-5)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+
+	struct Vec
+	{
+		float x, y, z;
+	};
+
+	float Dot(Vec a, Vec b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vec Cross(Vec a, Vec b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	Vec Normalize(Vec a)
+	{
+		float length = std::sqrt(Dot(a, a));
+		return { a.x / length, a.y / length, a.z / length };
+	}
+
+	// The orientation part of Camera, without DirectXMath.
+	struct ScalarCamera
+	{
+		Vec Right = { 1.0f, 0.0f, 0.0f };
+		Vec Up = { 0.0f, 1.0f, 0.0f };
+		Vec Look = { 0.0f, 0.0f, 1.0f };
+
+		void Pitch(float angle)
+		{
+			Vec k = Normalize(Right);
+			float s = std::sin(angle);
+			float c = std::cos(angle);
+			auto rotate = [&](Vec v)
+			{
+				Vec kv = Cross(k, v);
+				float kd = Dot(k, v) * (1.0f - c);
+				return Vec{ v.x * c + kv.x * s + k.x * kd, v.y * c + kv.y * s + k.y * kd, v.z * c + kv.z * s + k.z * kd };
+			};
+			Up = rotate(Up);
+			Look = rotate(Look);
+		}
+
+		void RotateY(float angle)
+		{
+			float s = std::sin(angle);
+			float c = std::cos(angle);
+			auto rotate = [&](Vec v) { return Vec{ v.x * c + v.z * s, v.y, -v.x * s + v.z * c }; };
+			Right = rotate(Right);
+			Up = rotate(Up);
+			Look = rotate(Look);
+		}
+
+		void UpdateViewMatrix()
+		{
+			Look = Normalize(Look);
+			Up = Normalize(Cross(Look, Right));
+			Right = Cross(Up, Look);
+		}
+	};
+
+	void CheckKeyHold()
+	{
+		InputSystem input;
+		input.BindKey(ActionWalk, KeyWalk, 10.0f);
+		input.BindKey(ActionWalk, KeyBack, -10.0f);
+
+		// Held from 5 ms to 40 ms, across three 1/60 s frames, with auto-repeat.
+		const double frame = 1.0 / 60.0;
+		input.Update(0.0);
+		input.PushKey(KeyWalk, true, 0.005);
+		input.PushKey(KeyWalk, true, 0.010);
+		input.Update(frame);
+		Bench::Check(Near(input.Value(ActionWalk), 10.0 * (frame - 0.005)) && input.Pressed(ActionWalk) &&
+			input.Down(ActionWalk), "hold, first frame");
+
+		input.PushKey(KeyWalk, true, 0.020);
+		input.PushKey(KeyWalk, true, 0.030);
+		input.Update(2.0 * frame);
+		Bench::Check(Near(input.Value(ActionWalk), 10.0 * frame) && !input.Pressed(ActionWalk) && input.Down(ActionWalk),
+			"hold, auto-repeat neither restarts nor presses again");
+
+		input.PushKey(KeyWalk, false, 0.040);
+		input.Update(3.0 * frame);
+		Bench::Check(Near(input.Value(ActionWalk), 10.0 * (0.040 - 2.0 * frame)) && !input.Down(ActionWalk),
+			"hold, last frame");
+
+		// A tap inside one frame, and both keys of the action held.
+		input.PushKey(KeyWalk, true, 0.055);
+		input.PushKey(KeyWalk, false, 0.060);
+		input.PushKey(KeyBack, true, 0.058);
+		input.Update(4.0 * frame);
+		Bench::Check(Near(input.Value(ActionWalk), 10.0 * 0.005 - 10.0 * (4.0 * frame - 0.058)) && input.Pressed(ActionWalk) &&
+			input.Down(ActionWalk), "tap and opposite key in one frame");
+
+		// Unbound keys are ignored; an up without a down counts nothing.
+		input.PushKey('Q', true, 0.07);
+		input.PushKey(KeyBack, false, 4.0 * frame);
+		input.PushKey(KeyWalk, false, 0.075);
+		input.Update(5.0 * frame);
+		Bench::Check(input.Value(ActionWalk) == 0.0f && !input.Pressed(ActionWalk) && !input.Down(ActionWalk),
+			"unbound key and stray up");
+
+		// Before the first update, the interval starts at the first event.
+		InputSystem fresh;
+		fresh.BindKey(ActionWalk, KeyWalk);
+		fresh.PushKey(KeyWalk, true, 100.0);
+		fresh.Update(100.25);
+		Bench::Check(Near(fresh.Value(ActionWalk), 0.25), "first update");
+	}
+
+	void CheckMouseAxes()
+	{
+		InputSystem input;
+		input.BindMouseAxis(ActionYaw, MouseAxis::X, InputSystem::MouseLeft, 1.0f);
+		input.BindMouseAxis(ActionPan, MouseAxis::X, 0, 1.0f);
+		input.BindMouseAxis(ActionZoom, MouseAxis::Y, InputSystem::MouseRight, 2.0f);
+		input.BindMouseAxis(ActionPitch, MouseAxis::Y, InputSystem::MouseLeft | InputSystem::MouseRight, 1.0f);
+
+		// The first position only sets where the next move is measured from.
+		input.PushMouseMove(100, 100, 0.001);
+		input.PushMouseMove(103, 101, 0.002);
+		input.PushButton(InputSystem::MouseLeft, true, 110, 110, 0.003);
+		input.PushMouseMove(115, 112, 0.004);
+		input.PushButton(InputSystem::MouseRight, true, 115, 112, 0.005);
+		input.PushMouseMove(120, 120, 0.006);
+		input.PushButton(InputSystem::MouseLeft, false, 120, 120, 0.007);
+		input.PushMouseMove(121, 110, 0.008);
+		input.Update(0.01);
+
+		Bench::Check(input.Value(ActionPan) == 3.0f + 5.0f + 5.0f + 1.0f, "axis with no buttons required");
+		Bench::Check(input.Value(ActionYaw) == 5.0f + 5.0f, "axis with the left button");
+		Bench::Check(input.Value(ActionZoom) == 2.0f * (8.0f - 10.0f), "axis with the right button");
+		Bench::Check(input.Value(ActionPitch) == 8.0f, "axis with both buttons");
+		Bench::Check(input.GetStats().MouseMoves == 5 && input.GetStats().EventCount == 8, "stats");
+
+		// Deltas do not carry over; the right button is still held.
+		input.PushMouseMove(111, 100, 0.012);
+		input.Update(0.02);
+		Bench::Check(input.Value(ActionPan) == -10.0f && input.Value(ActionYaw) == 0.0f && input.Value(ActionZoom) == -20.0f,
+			"second update");
+	}
+
+	void CheckReleaseAll()
+	{
+		InputSystem input;
+		input.BindKey(ActionWalk, KeyWalk);
+		input.BindMouseAxis(ActionYaw, MouseAxis::X, InputSystem::MouseLeft, 1.0f);
+
+		input.Update(0.0);
+		input.PushKey(KeyWalk, true, 0.01);
+		input.PushButton(InputSystem::MouseLeft, true, 0, 0, 0.01);
+		input.PushMouseMove(4, 0, 0.02);
+		input.PushReleaseAll(0.03);
+		input.PushMouseMove(10, 0, 0.04);
+		input.Update(0.05);
+		Bench::Check(Near(input.Value(ActionWalk), 0.02) && !input.Down(ActionWalk) && input.Value(ActionYaw) == 4.0f,
+			"release all stops holds and buttons");
+
+		// The key up that arrives after focus comes back changes nothing.
+		input.PushKey(KeyWalk, false, 0.06);
+		input.PushMouseMove(20, 0, 0.07);
+		input.Update(0.08);
+		Bench::Check(input.Value(ActionWalk) == 0.0f && input.Value(ActionYaw) == 0.0f && input.HeldStateEvents().size() == 1,
+			"after release all");
+	}
+
+	void CheckWheel()
+	{
+		InputSystem input;
+		input.BindWheel(ActionZoom, -2.0f);
+
+		input.PushWheel(1.0f, 0.001);
+		input.PushWheel(-3.0f, 0.002);
+		input.Update(0.01);
+		Bench::Check(input.Value(ActionZoom) == 4.0f, "whole wheel steps");
+
+		// A high-resolution wheel: ten tenths of a step make one step.
+		for (int i = 0; i < 10; ++i)
+			input.PushWheel(0.1f, 0.011 + 0.0001 * i);
+		input.Update(0.02);
+		Bench::Check(input.Value(ActionZoom) == -2.0f, "tenths of a step add up");
+
+		input.PushWheel(0.25f, 0.021);
+		input.PushWheel(1.0f / InputSystem::WheelUnitsPerStep, 0.022);
+		input.Update(0.03);
+		Bench::Check(Near(input.Value(ActionZoom), -2.0 * (0.25 + 1.0 / InputSystem::WheelUnitsPerStep)),
+			"smallest wheel unit is kept");
+	}
+
+	// Cursor positions of a mouse at 1000 Hz with the left button held: a slow sweep with
+	// jitter.
+	std::vector<InputEvent> MakeMouseStream(double seconds, uint32_t seed)
+	{
+		Bench::Random random(seed);
+		std::vector<InputEvent> events;
+
+		InputEvent e;
+		e.Type = InputEventType::ButtonDown;
+		e.Code = InputSystem::MouseLeft;
+		events.push_back(e);
+
+		int32_t x = 0;
+		int32_t y = 0;
+		for (double t = 0.001; t < seconds; t += 0.001)
+		{
+			x += (int32_t)random.Below(5) - 1;
+			y += (int32_t)random.Below(5) - 2;
+
+			e.Type = InputEventType::MouseMove;
+			e.X = x;
+			e.Y = y;
+			e.Time = t;
+			events.push_back(e);
+		}
+		return events;
+	}
+
+	void CompareCoalescing()
+	{
+		const float radiansPerPixel = 0.25f * 3.14159265f / 180.0f;
+		const double frame = 1.0 / 60.0;
+		const std::vector<InputEvent> events = MakeMouseStream(10.0, 1);
+
+		// One turn per message.
+		ScalarCamera perMessage;
+		double perMessageMs = Bench::BestMs(5, [&] {
+			perMessage = ScalarCamera();
+			int32_t lastX = 0;
+			int32_t lastY = 0;
+			for (const InputEvent& e : events)
+			{
+				if (e.Type == InputEventType::MouseMove)
+				{
+					perMessage.Pitch(radiansPerPixel * (float)(e.Y - lastY));
+					perMessage.RotateY(radiansPerPixel * (float)(e.X - lastX));
+					perMessage.UpdateViewMatrix();
+				}
+				lastX = e.X;
+				lastY = e.Y;
+			}
+		});
+
+		// Events queued as they arrive, one turn per frame.
+		ScalarCamera coalesced;
+		uint32_t frames = 0;
+		uint32_t maxMoves = 0;
+		double coalescedMs = Bench::BestMs(5, [&] {
+			coalesced = ScalarCamera();
+			InputSystem input;
+			input.BindMouseAxis(ActionPitch, MouseAxis::Y, InputSystem::MouseLeft, radiansPerPixel);
+			input.BindMouseAxis(ActionYaw, MouseAxis::X, InputSystem::MouseLeft, radiansPerPixel);
+
+			frames = 0;
+			size_t next = 0;
+			for (double time = frame; next < events.size(); time += frame)
+			{
+				for (; next < events.size() && events[next].Time <= time; ++next)
+					input.Push(events[next]);
+				input.Update(time);
+				coalesced.Pitch(input.Value(ActionPitch));
+				coalesced.RotateY(input.Value(ActionYaw));
+				coalesced.UpdateViewMatrix();
+
+				maxMoves = std::max<uint32_t>(maxMoves, input.GetStats().MouseMoves);
+				++frames;
+			}
+		});
+
+		// Pitch and yaw do not commute, so the orders differ by second-order terms only.
+		auto angle = [](Vec a, Vec b) { Vec c = Cross(a, b); return std::asin(std::sqrt(Dot(c, c))); };
+		float lookAngle = angle(perMessage.Look, coalesced.Look);
+		float upAngle = angle(perMessage.Up, coalesced.Up);
+		Bench::Check(lookAngle < 1e-4f && upAngle < 1e-4f, "coalesced and per-message orientation");
+
+		printf("%u frames, up to %u mouse moves each: per message %.2f us per frame, coalesced %.2f us per frame; "
+			"orientations differ by %.5f rad (look), %.5f rad (up)\n",
+			frames, maxMoves, 1000.0 * perMessageMs / frames, 1000.0 * coalescedMs / frames, lookAngle, upAngle);
+	}
+}
+
+int main()
+{
+	CheckKeyHold();
+	CheckMouseAxes();
+	CheckReleaseAll();
+	CheckWheel();
+	CompareCoalescing();
+
+	return Bench::Result();
+}
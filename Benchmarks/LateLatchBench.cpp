@@ -0,0 +1,215 @@
+//***************************************************************************************
+// LateLatchBench.cpp
+//
+// The input path of CameraApp on a simulated clock: a 1000 Hz mouse turning the camera,
+// a movement key held in bursts and a toggle key, sampled by InputSystem at the start of
+// every frame and, with the late latch, again right before the submit.
+//   -The frame loop mirrors CameraApp: the latch only re-samples camera motion; keys
+//    pressed in its interval are kept as a mask and carried out by the next Update.
+//   -Checks that with and without the latch the camera receives all of the mouse motion
+//    and key hold time exactly once, and that every toggle press is carried out once, in
+//    the same frame either way.
+//   -Prints the time from the input sample to the submit and from each mouse event to
+//    the submit of the first frame that shows it, without and with the latch. Recording
+//    takes a random time on the simulated clock; the latch takes its measured time.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "InputSystem.h"
+#include "LatencyStats.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	enum Action : uint32_t
+	{
+		ActionYaw,
+		ActionWalk,
+		ActionToggle,
+		ActionCount
+	};
+
+	const uint32_t KeyWalk = 'W';
+	const uint32_t KeyToggle = 'F';
+
+	uint32_t PressedActions(const InputSystem& input)
+	{
+		uint32_t pressed = 0;
+		for (uint32_t action = 0; action < ActionCount; ++action)
+		{
+			if (input.Pressed(action))
+				pressed |= 1u << action;
+		}
+		return pressed;
+	}
+
+	struct Trace
+	{
+		std::vector<InputEvent> Events;
+		int64_t TotalDeltaX = 0;
+		double TotalHeldSeconds = 0.0;
+		uint32_t TogglePresses = 0;
+	};
+
+	Trace MakeTrace(double seconds, uint32_t seed)
+	{
+		Bench::Random random(seed);
+		Trace trace;
+
+		auto push = [&](InputEventType type, uint32_t code, int32_t x, double time)
+		{
+			InputEvent e;
+			e.Type = type;
+			e.Code = code;
+			e.X = x;
+			e.Time = time;
+			trace.Events.push_back(e);
+		};
+
+		int32_t cursor = 0;
+		push(InputEventType::MouseMove, 0, cursor, 0.0);
+		for (double t = 0.001; t < seconds; t += 0.001)
+		{
+			int32_t dx = (int32_t)random.Below(7) - 3;
+			cursor += dx;
+			trace.TotalDeltaX += dx;
+			push(InputEventType::MouseMove, 0, cursor, t);
+		}
+
+		for (double t = random.Uniform(0.0f, 0.5f); t < seconds - 1.0; t += random.Uniform(0.2f, 0.8f))
+		{
+			double held = random.Uniform(0.05f, 0.6f);
+			push(InputEventType::KeyDown, KeyWalk, 0, t);
+			push(InputEventType::KeyUp, KeyWalk, 0, t + held);
+			trace.TotalHeldSeconds += held;
+			t += held;
+		}
+
+		for (double t = random.Uniform(0.0f, 0.3f); t < seconds - 1.0; t += random.Uniform(0.1f, 0.4f))
+		{
+			push(InputEventType::KeyDown, KeyToggle, 0, t);
+			push(InputEventType::KeyUp, KeyToggle, 0, t + 0.03);
+			trace.TogglePresses++;
+		}
+
+		std::stable_sort(trace.Events.begin(), trace.Events.end(),
+			[](const InputEvent& a, const InputEvent& b) { return a.Time < b.Time; });
+		return trace;
+	}
+
+	struct Result
+	{
+		int64_t Yaw = 0;
+		double WalkSeconds = 0.0;
+		std::vector<uint32_t> ToggleFrames;
+		LatencyStats SampleToSubmit;
+		LatencyStats EventToSubmit;
+		LatencyStats LatchCost;
+	};
+
+	// Frames start every period; recording takes workMin to workMax ms after the sample.
+	Result Run(const Trace& trace, bool latch, double period, float workMin, float workMax, uint32_t seed)
+	{
+		InputSystem input;
+		input.BindMouseAxis(ActionYaw, MouseAxis::X, 0, 1.0f);
+		input.BindKey(ActionWalk, KeyWalk);
+		input.BindKey(ActionToggle, KeyToggle);
+
+		Bench::Random random(seed);
+		Result result;
+
+		size_t next = 0;
+		size_t firstUnshown = 0;
+		uint32_t latchedActions = 0;
+
+		// Events up to time go into the queue, then are consumed; returns the motion.
+		auto sample = [&](double time)
+		{
+			for (; next < trace.Events.size() && trace.Events[next].Time <= time; ++next)
+				input.Push(trace.Events[next]);
+			input.Update(time);
+			result.Yaw += (int64_t)input.Value(ActionYaw);
+			result.WalkSeconds += input.Value(ActionWalk);
+		};
+
+		double end = trace.Events.back().Time + 0.1;
+		for (uint32_t frame = 0; frame * period < end; ++frame)
+		{
+			// Update: the actions pressed since the previous sample, latch included.
+			double sampleTime = frame * period;
+			sample(sampleTime);
+			uint32_t pressed = PressedActions(input) | latchedActions;
+			latchedActions = 0;
+			if (pressed & (1u << ActionToggle))
+				result.ToggleFrames.push_back(frame);
+
+			// The latch delays the submit by its own (real) cost.
+			double lastSample = sampleTime;
+			double submitTime = sampleTime + 0.001 * random.Uniform(workMin, workMax);
+			if (latch)
+			{
+				double start = Bench::NowMs();
+				sample(submitTime);
+				latchedActions |= PressedActions(input);
+				double latchMs = Bench::NowMs() - start;
+				result.LatchCost.Add(latchMs);
+
+				lastSample = submitTime;
+				submitTime += 0.001 * latchMs;
+			}
+
+			result.SampleToSubmit.Add(1000.0 * (submitTime - lastSample));
+
+			// Mouse moves shown for the first time by this frame.
+			for (; firstUnshown < next; ++firstUnshown)
+			{
+				if (trace.Events[firstUnshown].Type == InputEventType::MouseMove)
+					result.EventToSubmit.Add(1000.0 * (submitTime - trace.Events[firstUnshown].Time));
+			}
+		}
+
+		return result;
+	}
+}
+
+int main()
+{
+	struct Config
+	{
+		const char* Name;
+		double Period;
+		float WorkMin;
+		float WorkMax;
+	};
+
+	const Config configs[] = {
+		{ "60 Hz, 4-14 ms of work", 1.0 / 60.0, 4.0f, 14.0f },
+		{ "144 Hz, 2-6 ms of work", 1.0 / 144.0, 2.0f, 6.0f },
+	};
+
+	const Trace trace = MakeTrace(20.0, 1);
+
+	for (const Config& config : configs)
+	{
+		Result before = Run(trace, false, config.Period, config.WorkMin, config.WorkMax, 2);
+		Result after = Run(trace, true, config.Period, config.WorkMin, config.WorkMax, 2);
+
+		for (const Result* result : { &before, &after })
+		{
+			Bench::Check(result->Yaw == trace.TotalDeltaX, "mouse motion lost or counted twice");
+			Bench::Check(std::abs(result->WalkSeconds - trace.TotalHeldSeconds) < 1e-3, "key hold time lost or counted twice");
+			Bench::Check(result->ToggleFrames.size() == trace.TogglePresses, "toggle press lost or carried out twice");
+		}
+		Bench::Check(before.ToggleFrames == after.ToggleFrames, "the latch moved a toggle to another frame");
+
+		printf("%s\n", config.Name);
+		printf("  without latch: input sample to submit %.2f ms average (%.2f max), mouse event to submit %.2f ms average\n",
+			before.SampleToSubmit.GetStats().AverageMs, before.SampleToSubmit.GetStats().MaxMs, before.EventToSubmit.GetStats().AverageMs);
+		printf("  with latch:    input sample to submit %.2f us average (%.2f max), mouse event to submit %.2f ms average\n",
+			1000.0 * after.SampleToSubmit.GetStats().AverageMs, 1000.0 * after.SampleToSubmit.GetStats().MaxMs, after.EventToSubmit.GetStats().AverageMs);
+	}
+
+	return Bench::Result();
+}
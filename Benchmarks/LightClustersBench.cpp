@@ -0,0 +1,118 @@
+//***************************************************************************************
+// LightClustersBench.cpp
+//
+// Bins random point and spot lights (30% spots) spread through the view frustum of a
+// 16:9 camera with a 45 degree vertical field of view.
+//   -Checks that every light in a cluster's list passes the scalar test against that
+//    cluster, and that random points inside the frustum find every light that reaches
+//    them in the list of their cluster.
+//   -Prints the time of Assign and the lights per occupied cluster.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "LightClusters.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	std::vector<ClusterLight> RandomLights(Bench::Random& random, uint32_t count)
+	{
+		std::vector<ClusterLight> lights(count);
+		for (ClusterLight& light : lights)
+		{
+			light.Position[0] = random.Uniform(-30.0f, 30.0f);
+			light.Position[1] = random.Uniform(-15.0f, 15.0f);
+			light.Position[2] = random.Uniform(-5.0f, 75.0f);
+			light.Range = random.Uniform(0.5f, 4.5f);
+
+			if (random.Uniform(0.0f, 1.0f) < 0.3f)
+			{
+				float d[3] = { random.Uniform(-1.0f, 1.0f), random.Uniform(-1.0f, 1.0f), random.Uniform(-1.0f, 1.0f) };
+				float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + 1e-6f;
+				for (int j = 0; j < 3; ++j)
+					light.Direction[j] = d[j] / length;
+				light.IsSpot = true;
+				light.CosAngle = LightClusters::SpotCosAngle(random.Uniform(4.0f, 64.0f));
+			}
+		}
+		return lights;
+	}
+
+	// Assign only tests the clusters under a light's screen and depth bounds, so its lists
+	// are a subset of what the cluster boxes alone would give.
+	void CheckAgainstClusterTest(const LightClusters& clusters, const std::vector<ClusterLight>& lights)
+	{
+		for (uint32_t c = 0; c < clusters.ClusterCount(); ++c)
+		{
+			const ClusterRange& range = clusters.Ranges()[c];
+			const uint32_t* first = clusters.LightIndices().data() + range.Offset;
+			for (uint32_t k = 0; k < range.Count; ++k)
+			{
+				Bench::Check(first[k] < lights.size() && clusters.Intersects(lights[first[k]], c), "listed light does not touch the cluster");
+				Bench::Check(k == 0 || first[k - 1] < first[k], "cluster list not sorted");
+			}
+		}
+	}
+
+	void CheckPointSamples(Bench::Random& random, const LightClusters& clusters, const std::vector<ClusterLight>& lights)
+	{
+		const ClusterGridDesc& grid = clusters.Grid();
+		for (int s = 0; s < 20000; ++s)
+		{
+			// A point inside the frustum, through its normalized device coordinates.
+			float nx = random.Uniform(-1.0f, 1.0f);
+			float ny = random.Uniform(-1.0f, 1.0f);
+			float z = grid.NearZ * std::pow(80.0f / grid.NearZ, random.Uniform(0.0f, 1.0f));
+			float p[3] = { nx * z / grid.ProjScaleX, ny * z / grid.ProjScaleY, z };
+
+			uint32_t tx = std::min<uint32_t>((uint32_t)((nx + 1.0f) * 0.5f * grid.CountX), grid.CountX - 1);
+			uint32_t ty = std::min<uint32_t>((uint32_t)((1.0f - ny) * 0.5f * grid.CountY), grid.CountY - 1);
+			const ClusterRange& range = clusters.Ranges()[clusters.ClusterIndex(tx, ty, clusters.Slice(z))];
+			const uint32_t* first = clusters.LightIndices().data() + range.Offset;
+
+			for (uint32_t i = 0; i < (uint32_t)lights.size(); ++i)
+			{
+				const ClusterLight& light = lights[i];
+				float d[3] = { p[0] - light.Position[0], p[1] - light.Position[1], p[2] - light.Position[2] };
+				float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+				if (distance > light.Range)
+					continue;
+				if (light.IsSpot && distance > 0.0f &&
+					(d[0] * light.Direction[0] + d[1] * light.Direction[1] + d[2] * light.Direction[2]) / distance < light.CosAngle)
+					continue;
+
+				Bench::Check(std::binary_search(first, first + range.Count, i), "light reaching a point missing from its cluster");
+			}
+		}
+	}
+}
+
+int main()
+{
+	const float fovY = 0.785398f;
+	ClusterGridDesc grid;
+	grid.ProjScaleY = 1.0f / std::tan(0.5f * fovY);
+	grid.ProjScaleX = grid.ProjScaleY * 9.0f / 16.0f;
+
+	LightClusters clusters;
+	clusters.SetGrid(grid);
+
+	Bench::Random random(11);
+	for (uint32_t count : { 1000u, 3000u, 10000u })
+	{
+		std::vector<ClusterLight> lights = RandomLights(random, count);
+
+		double ms = Bench::BestMs(20, [&]() { clusters.Assign(lights.data(), count); });
+		CheckAgainstClusterTest(clusters, lights);
+		CheckPointSamples(random, clusters, lights);
+
+		const LightClusters::Stats& stats = clusters.GetStats();
+		printf("%5u lights: assign %6.3f ms; %6u indices, %4u occupied clusters, %.1f lights per occupied cluster (max %u)\n",
+			count, ms, stats.IndexCount, stats.OccupiedClusters, (double)stats.IndexCount / std::max<uint32_t>(stats.OccupiedClusters, 1),
+			stats.MaxLightsPerCluster);
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,214 @@
+//***************************************************************************************
+// RayPacketBench.cpp
+//
+// Coherent rays from a camera through a 632 x 632 grid against 22, 1k and 100k random
+// boxes, each an instance of a cube or an octahedron mesh, in a BoundsBvh.
+//   -Traces the rays four at a time in packets, and one at a time (a packet with one
+//    active lane), on the boxes and exactly on the triangles with MeshRayTest.
+//   -Checks both against a brute-force trace over all the items on a subset of rays.
+//   -Prints the rays per second of each.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "BoundsBvh.h"
+#include "MeshRayTest.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const float NoHit = 1e6f;
+
+	struct Vertex
+	{
+		float Position[3];
+		float Normal[3];
+		float TexC[2];
+	};
+
+	struct Ray
+	{
+		float Origin[3];
+		float Direction[3];
+	};
+
+	// A unit cube (12 triangles) followed by an octahedron (8), in one vertex and index list.
+	void BuildMeshes(std::vector<Vertex>& vertices, std::vector<uint16_t>& indices, uint32_t& octStart, int32_t& octBase)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			Vertex v = {};
+			for (int k = 0; k < 3; ++k)
+				v.Position[k] = i & (1 << k) ? 0.5f : -0.5f;
+			vertices.push_back(v);
+		}
+
+		const uint16_t faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+		for (const uint16_t* f : faces)
+			indices.insert(indices.end(), { f[0], f[1], f[2], f[0], f[2], f[3] });
+
+		octStart = (uint32_t)indices.size();
+		octBase = (int32_t)vertices.size();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (float sign : { 0.5f, -0.5f })
+			{
+				Vertex v = {};
+				v.Position[axis] = sign;
+				vertices.push_back(v);
+			}
+		}
+
+		const uint16_t triangles[8][3] = { { 0, 2, 4 }, { 2, 1, 4 }, { 1, 3, 4 }, { 3, 0, 4 }, { 2, 0, 5 }, { 1, 2, 5 }, { 3, 1, 5 }, { 0, 3, 5 } };
+		for (const uint16_t* t : triangles)
+			indices.insert(indices.end(), { t[0], t[1], t[2] });
+	}
+
+	float BruteForceTrace(const std::vector<float>& worlds, MeshRayTest* mesh, const Ray& ray)
+	{
+		float best = NoHit;
+		for (size_t item = 0; item < worlds.size() / 16; ++item)
+		{
+			const float* world = &worlds[16 * item];
+			float enter = 0.0f;
+			float exit = best;
+			for (int k = 0; k < 3; ++k)
+			{
+				float mn = world[12 + k] - 0.5f * world[5 * k];
+				float mx = world[12 + k] + 0.5f * world[5 * k];
+				float inv = 1.0f / ray.Direction[k];
+				float a = (mn - ray.Origin[k]) * inv;
+				float b = (mx - ray.Origin[k]) * inv;
+				enter = std::max<float>(enter, std::min<float>(a, b));
+				exit = std::min<float>(exit, std::max<float>(a, b));
+			}
+			if (enter > exit)
+				continue;
+
+			float distance = enter;
+			uint32_t triangle;
+			if (mesh != nullptr && !mesh->Intersect((uint32_t)item, ray.Origin, ray.Direction, enter, best, distance, triangle))
+				continue;
+
+			best = distance;
+		}
+		return best;
+	}
+
+	void SetLane(BoundsBvh::RayPacket& packet, int lane, const Ray& ray, float maxDistance)
+	{
+		packet.OriginX[lane] = ray.Origin[0];
+		packet.OriginY[lane] = ray.Origin[1];
+		packet.OriginZ[lane] = ray.Origin[2];
+		packet.DirectionX[lane] = ray.Direction[0];
+		packet.DirectionY[lane] = ray.Direction[1];
+		packet.DirectionZ[lane] = ray.Direction[2];
+		packet.MaxDistance[lane] = maxDistance;
+	}
+
+	float HitDistance(const BoundsBvh::RayHit& hit)
+	{
+		return hit.Item == BoundsBvh::NoItem ? NoHit : hit.Distance;
+	}
+}
+
+int main()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint16_t> indices;
+	uint32_t octStart;
+	int32_t octBase;
+	BuildMeshes(vertices, indices, octStart, octBase);
+
+	for (uint32_t count : { 22u, 1000u, 100000u })
+	{
+		Bench::Random random(count);
+		float span = 4.0f * std::cbrt((float)count);
+
+		BoundsBvh bvh;
+		MeshRayTest mesh;
+		uint32_t cube = mesh.AddMesh(vertices.data(), sizeof(Vertex), indices.data(), 36, 0, 0);
+		uint32_t octahedron = mesh.AddMesh(vertices.data(), sizeof(Vertex), indices.data(), 24, octStart, octBase);
+
+		// Scaled and translated instances; the box of an item is that of its mesh.
+		std::vector<float> worlds(16 * (size_t)count, 0.0f);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float* world = &worlds[16 * (size_t)i];
+			float center[3];
+			float extents[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				world[5 * k] = random.Uniform(0.5f, 2.5f);
+				world[12 + k] = random.Uniform(0.0f, span);
+				center[k] = world[12 + k];
+				extents[k] = 0.5f * world[5 * k];
+			}
+			world[15] = 1.0f;
+
+			bvh.Add(center, extents);
+			mesh.SetItem(i, i % 2 ? octahedron : cube, world);
+		}
+		bvh.Build();
+
+		const uint32_t grid = 632;
+		std::vector<Ray> rays(grid * grid);
+		for (uint32_t r = 0; r < rays.size(); ++r)
+		{
+			Ray& ray = rays[r];
+			ray.Origin[0] = -5.0f;
+			ray.Origin[1] = 0.5f * span;
+			ray.Origin[2] = 0.5f * span;
+
+			float direction[3] = { 1.0f, (float)(r % grid) / grid - 0.5f, (float)(r / grid) / grid - 0.5f };
+			float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+			for (int k = 0; k < 3; ++k)
+				ray.Direction[k] = direction[k] / length;
+		}
+
+		for (MeshRayTest* test : { (MeshRayTest*)nullptr, &mesh })
+		{
+			std::vector<BoundsBvh::RayHit> packetHits(rays.size());
+			double packetMs = Bench::BestMs(2, [&]()
+			{
+				for (size_t r = 0; r < rays.size(); r += 4)
+				{
+					BoundsBvh::RayPacket packet;
+					for (int lane = 0; lane < 4; ++lane)
+						SetLane(packet, lane, rays[r + lane], NoHit);
+					bvh.RayCast(packet, &packetHits[r], test);
+				}
+			});
+
+			std::vector<BoundsBvh::RayHit> singleHits(rays.size());
+			double singleMs = Bench::BestMs(2, [&]()
+			{
+				for (size_t r = 0; r < rays.size(); ++r)
+				{
+					BoundsBvh::RayPacket packet;
+					for (int lane = 0; lane < 4; ++lane)
+						SetLane(packet, lane, rays[r], lane == 0 ? NoHit : 0.0f);
+
+					BoundsBvh::RayHit hits[4];
+					bvh.RayCast(packet, hits, test);
+					singleHits[r] = hits[0];
+				}
+			});
+
+			size_t step = count > 10000 ? 401 : 17;
+			for (size_t r = 0; r < rays.size(); r += step)
+			{
+				float expected = BruteForceTrace(worlds, test, rays[r]);
+				float tolerance = 1e-3f * std::max<float>(1.0f, expected);
+				Bench::Check(std::fabs(HitDistance(packetHits[r]) - expected) <= tolerance, "packet hit differs from brute force");
+				Bench::Check(std::fabs(HitDistance(singleHits[r]) - expected) <= tolerance, "single ray hit differs from brute force");
+			}
+
+			printf("%6u items, %s: %.2f M rays/s in packets, %.2f M rays/s one at a time\n", count,
+				test ? "triangles" : "boxes    ", rays.size() / packetMs / 1000.0, rays.size() / singleMs / 1000.0);
+		}
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,160 @@
+//***************************************************************************************
+// RenderGraphBench.cpp
+//
+// Builds and compiles random frame graphs every "frame", as CameraApp does, without a
+// device (RenderGraph's default size estimate).
+//   -Every pass creates a full-screen transient and reads one or two earlier ones; some
+//    are never read and must be culled. The last pass writes the imported back buffer.
+//   -Checks the culling against a reachability walk from the last pass, that every pass
+//    runs after the passes it reads from, and that transients sharing heap memory have
+//    disjoint lifetimes.
+//   -Prints the time to build and compile a graph and the memory saved by aliasing.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "RenderGraph.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace
+{
+	struct GraphShape
+	{
+		// Transients each pass reads (indices of the passes that created them).
+		std::vector<std::vector<uint32_t>> Reads;
+	};
+
+	GraphShape RandomShape(Bench::Random& random, uint32_t passCount)
+	{
+		GraphShape shape;
+		shape.Reads.resize(passCount);
+		for (uint32_t p = 1; p < passCount; ++p)
+		{
+			// Mostly recent producers, so lifetimes are short and memory can be shared.
+			uint32_t readCount = 1 + random.Below(2);
+			for (uint32_t r = 0; r < readCount; ++r)
+			{
+				uint32_t window = std::min<uint32_t>(p, 6);
+				uint32_t producer = p - 1 - random.Below(window);
+				if (std::find(shape.Reads[p].begin(), shape.Reads[p].end(), producer) == shape.Reads[p].end())
+					shape.Reads[p].push_back(producer);
+			}
+		}
+		return shape;
+	}
+
+	void BuildGraph(RenderGraph& graph, const GraphShape& shape, std::vector<RGHandle>& created)
+	{
+		uint32_t passCount = (uint32_t)shape.Reads.size();
+		created.assign(passCount, RGInvalidHandle);
+
+		graph.Reset();
+		RGHandle backBuffer = graph.ImportTexture("BackBuffer", RGState::Present, RGState::Present);
+
+		RGTextureDesc desc;
+		desc.Width = 1920;
+		desc.Height = 1080;
+		for (uint32_t p = 0; p < passCount; ++p)
+		{
+			graph.AddPass("Pass" + std::to_string(p),
+				[&](RenderGraph::PassBuilder& builder)
+				{
+					for (uint32_t producer : shape.Reads[p])
+						builder.Read(created[producer], RGState::ShaderResource);
+					if (p + 1 < passCount)
+						created[p] = builder.Create("Target" + std::to_string(p), desc);
+					else
+						builder.Write(backBuffer, RGState::RenderTarget);
+				},
+				[]() {});
+		}
+	}
+
+	void CheckGraph(const RenderGraph& graph, const GraphShape& shape)
+	{
+		uint32_t passCount = (uint32_t)shape.Reads.size();
+
+		// Brute force: the passes the last one depends on, directly or not.
+		std::vector<bool> live(passCount, false);
+		live[passCount - 1] = true;
+		for (uint32_t p = passCount; p-- > 0;)
+		{
+			if (live[p])
+			{
+				for (uint32_t producer : shape.Reads[p])
+					live[producer] = true;
+			}
+		}
+
+		std::map<std::string, uint32_t> position;
+		std::vector<std::string> order = graph.ExecutionOrder();
+		for (uint32_t i = 0; i < (uint32_t)order.size(); ++i)
+			position[order[i]] = i;
+
+		uint32_t liveCount = (uint32_t)std::count(live.begin(), live.end(), true);
+		Bench::Check(order.size() == liveCount, "culled passes differ from the reachability walk");
+		for (uint32_t p = 0; p < passCount; ++p)
+		{
+			std::string name = "Pass" + std::to_string(p);
+			Bench::Check(live[p] == (position.count(name) != 0), "pass culled (or kept) wrongly");
+			if (!live[p])
+				continue;
+			for (uint32_t producer : shape.Reads[p])
+				Bench::Check(position["Pass" + std::to_string(producer)] < position[name], "pass runs before its input");
+		}
+
+		// Transients sharing heap memory must not be alive at the same time.
+		const std::vector<RenderGraph::ResourceInfo>& resources = graph.Resources();
+		for (size_t a = 0; a < resources.size(); ++a)
+		{
+			const RenderGraph::ResourceInfo& ra = resources[a];
+			if (ra.Imported || !ra.Used)
+				continue;
+			for (size_t b = a + 1; b < resources.size(); ++b)
+			{
+				const RenderGraph::ResourceInfo& rb = resources[b];
+				if (rb.Imported || !rb.Used)
+					continue;
+				bool memoryOverlaps = ra.HeapOffset < rb.HeapOffset + rb.Size && rb.HeapOffset < ra.HeapOffset + ra.Size;
+				bool lifetimesOverlap = ra.FirstPass <= rb.LastPass && rb.FirstPass <= ra.LastPass;
+				Bench::Check(!(memoryOverlaps && lifetimesOverlap), "aliased transients are alive together");
+			}
+		}
+	}
+}
+
+int main()
+{
+	Bench::Random random(7);
+
+	for (uint32_t passCount : { 8u, 32u, 128u, 512u })
+	{
+		// Correctness on a few shapes, timing on the last one.
+		RenderGraph graph;
+		std::vector<RGHandle> created;
+		GraphShape shape;
+		for (int i = 0; i < 20; ++i)
+		{
+			shape = RandomShape(random, passCount);
+			BuildGraph(graph, shape, created);
+			graph.Compile();
+			CheckGraph(graph, shape);
+		}
+
+		int repeat = 2000 / passCount + 20;
+		double ms = Bench::BestMs(repeat, [&]()
+		{
+			BuildGraph(graph, shape, created);
+			graph.Compile();
+		});
+
+		const RenderGraphStats& stats = graph.Stats();
+		printf("%4u passes: build + compile %8.1f us; %3u culled, %3u transients, %7.1f MB -> %6.1f MB (%4.1f%% saved by aliasing)\n",
+			passCount, 1000.0 * ms, stats.CulledPassCount, stats.TransientCount,
+			stats.TransientBytes / 1048576.0, stats.TransientHeapBytes / 1048576.0,
+			100.0 * stats.SavedBytes() / std::max<uint64_t>(stats.TransientBytes, 1));
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,143 @@
+//***************************************************************************************
+// ResolutionScalerBench.cpp
+//
+// ResolutionScaler in a closed loop with a synthetic frame: the time of a frame is the
+// larger of a fixed CPU time and a GPU time that goes with the pixel count (the square
+// of the scale), plus noise, with the scale taking effect three frames late as with the
+// frames in flight.
+//   -Loads: light, heavy, a step up and down with spikes, CPU bound, and a slow sine
+//    with spikes. Checks where the scale settles, how many changes it takes and how
+//    many frames go over the budget once it has settled.
+//   -With a CameraRecording file as argument, also replays its delta times (open loop).
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "CameraRecording.h"
+#include "ResolutionScaler.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Result
+	{
+		double OverBudget = 0.0;
+		double AverageScale = 0.0;
+		uint32_t Changes = 0;
+		float FinalScale = 0.0f;
+		uint64_t SpikesIgnored = 0;
+	};
+
+	// gpuMs[i] is the GPU time of frame i at full resolution.
+	Result Run(const std::vector<double>& gpuMs, double cpuMs, uint32_t seed, bool spikes)
+	{
+		const uint32_t lag = 3;
+		const uint32_t settleFrames = 200;
+
+		ResolutionScaler scaler;
+		std::mt19937 engine(seed);
+		std::normal_distribution<double> noise(0.0, 0.4);
+
+		std::vector<float> inFlight(lag, scaler.Scale());
+		uint64_t over = 0;
+		double scaleSum = 0.0;
+		for (size_t i = 0; i < gpuMs.size(); ++i)
+		{
+			float scale = inFlight[i % lag];
+			double frameMs = std::max<double>(cpuMs, gpuMs[i] * scale * scale) + noise(engine);
+			if (spikes && i % 97 == 0)
+				frameMs *= 3.0;
+
+			if (i >= settleFrames && frameMs > scaler.Desc().BudgetMs)
+				++over;
+			scaleSum += scale;
+
+			inFlight[i % lag] = scaler.Update(frameMs);
+		}
+
+		const ResolutionScaler::Stats& stats = scaler.GetStats();
+		Result result;
+		result.OverBudget = (double)over / (gpuMs.size() - settleFrames);
+		result.AverageScale = scaleSum / gpuMs.size();
+		result.Changes = stats.Decreases + stats.Increases;
+		result.FinalScale = scaler.Scale();
+		result.SpikesIgnored = stats.SpikesIgnored;
+		return result;
+	}
+
+	void Print(const char* name, const Result& result)
+	{
+		printf("%-10s %5.1f%% over budget, average scale %.3f, final %.3f, %2u changes, %llu spikes ignored\n", name,
+			100.0 * result.OverBudget, result.AverageScale, result.FinalScale, result.Changes,
+			(unsigned long long)result.SpikesIgnored);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// Fits the budget at full resolution: no change at all.
+	std::vector<double> light(3000, 10.0);
+	Result result = Run(light, 3.0, 1, false);
+	Print("light", result);
+	Bench::Check(result.FinalScale == 1.0f && result.Changes == 0, "light load changed the scale");
+
+	// 25 ms at full resolution: the middle of the band is at about 0.76.
+	std::vector<double> heavy(3000, 25.0);
+	result = Run(heavy, 3.0, 2, false);
+	Print("heavy", result);
+	Bench::Check(result.FinalScale > 0.65f && result.FinalScale < 0.85f, "heavy load settled out of the band");
+	Bench::Check(result.OverBudget < 0.05 && result.Changes < 10, "heavy load keeps going over the budget");
+
+	// 10 ms, then 30 ms, then 12 ms, with a spike every 97 frames.
+	std::vector<double> step;
+	for (int i = 0; i < 6000; ++i)
+		step.push_back(i < 1000 ? 10.0 : i < 3000 ? 30.0 : 12.0);
+	result = Run(step, 3.0, 3, true);
+	Print("step", result);
+	Bench::Check(result.FinalScale == 1.0f && result.Changes < 20, "step load did not come back to full resolution");
+
+	// The CPU alone is over the budget: the scale cannot help, it ends at the minimum.
+	result = Run(light, 20.0, 4, false);
+	Print("cpu bound", result);
+	Bench::Check(result.FinalScale == ResolutionScalerDesc().MinScale, "CPU bound load not at the minimum scale");
+
+	// 10 to 26 ms over about 50 s, with spikes.
+	std::vector<double> sine;
+	for (int i = 0; i < 10000; ++i)
+		sine.push_back(18.0 + 8.0 * std::sin(i * 0.002));
+	result = Run(sine, 3.0, 5, true);
+	Print("sine", result);
+	Bench::Check(result.OverBudget < 0.1, "sine load keeps going over the budget");
+
+	// Degenerate descriptions are clamped to a usable scale and size.
+	ResolutionScalerDesc zero;
+	zero.MinScale = 0.0f;
+	zero.MaxScale = 0.0f;
+	ResolutionScaler clamped(zero);
+	for (int i = 0; i < 100; ++i)
+		clamped.Update(100.0);
+	uint32_t width, height;
+	clamped.ScaledSize(1, 1, width, height);
+	Bench::Check(clamped.Scale() > 0.0f && width == 1 && height == 1, "degenerate description not clamped");
+
+	if (argc > 1)
+	{
+		std::string name = argv[1];
+		CameraRecording recording;
+		if (recording.Load(std::wstring(name.begin(), name.end())))
+		{
+			ResolutionScaler scaler;
+			for (uint32_t i = 0; i < recording.FrameCount(); ++i)
+				scaler.Update(1000.0 * recording.GetFrame(i).DeltaTime);
+			printf("%s: %s\n", name.c_str(), scaler.Report().c_str());
+		}
+		else
+		{
+			Bench::Check(false, "recording cannot be loaded");
+		}
+	}
+
+	return Bench::Result();
+}
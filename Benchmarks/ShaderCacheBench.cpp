@@ -0,0 +1,231 @@
+//***************************************************************************************
+// ShaderCacheBench.cpp
+//
+// ShaderCache over a small shader tree in a temporary directory, with a stub compiler
+// that counts its calls and returns bytes derived from its arguments.
+//   -A miss compiles and writes the blob; a second Load, in the same cache or in a new
+//    one over the same directory, maps it without compiling.
+//   -The key changes with an included file (LightingUtil.hlsl, which includes the main
+//    file back), a file included through a relative path from another include, a
+//    define, the entry point, the target and the flags; it does not change with a file
+//    of the same name in another directory.
+//   -Truncated files and files written for another key are rejected and rewritten, and
+//    no temporary files are left behind.
+//   -Times cold and warm key computation and loads that hit.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "Hash.h"
+#include "ShaderCache.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	uint32_t gCompileCount = 0;
+
+	std::vector<uint8_t> StubCompile(
+		const std::wstring& filename,
+		const std::vector<ShaderDefine>& defines,
+		const std::string& entrypoint,
+		const std::string& target,
+		uint32_t flags)
+	{
+		++gCompileCount;
+
+		std::string text = std::string(filename.begin(), filename.end()) + "|" + entrypoint + "|" + target +
+			"|" + std::to_string(flags);
+		for (const ShaderDefine& d : defines)
+			text += "|" + d.Name + "=" + d.Value;
+
+		// Long enough to be mapped from more than one page.
+		std::vector<uint8_t> bytecode;
+		for (int i = 0; i < 500; ++i)
+			bytecode.insert(bytecode.end(), text.begin(), text.end());
+		return bytecode;
+	}
+
+	void WriteText(const fs::path& path, const std::string& text)
+	{
+		std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+		fout << text;
+	}
+
+	std::wstring Wide(const fs::path& path)
+	{
+		std::string s = path.string();
+		return std::wstring(s.begin(), s.end());
+	}
+
+	bool Equal(const ShaderBytecode& bytecode, const std::vector<uint8_t>& expected)
+	{
+		return bytecode.Size() == expected.size() &&
+			std::equal(expected.begin(), expected.end(), (const uint8_t*)bytecode.Data());
+	}
+
+	fs::path CacheFile(const fs::path& cacheDir, uint64_t key)
+	{
+		return cacheDir / (Hasher::ToHex(key) + ".cso");
+	}
+
+	size_t CountTemporaryFiles(const fs::path& cacheDir)
+	{
+		size_t count = 0;
+		for (const auto& entry : fs::directory_iterator(cacheDir))
+			count += entry.path().extension() == ".tmp";
+		return count;
+	}
+}
+
+int main()
+{
+	fs::path root = fs::temp_directory_path() / "ShaderCacheBench";
+	fs::remove_all(root);
+	fs::create_directories(root / "Shaders" / "Sub");
+
+	fs::path shaders = root / "Shaders";
+	fs::path cacheDir = root / "Cache";
+
+	WriteText(shaders / "Default.hlsl",
+		"#include \"LightingUtil.hlsl\"\n"
+		"  #  include <Sub/Common.hlsl>\n"
+		"float4 PS() : SV_Target { return 1; }\n"
+		"float4 VS() : SV_Position { return 0; }\n");
+	WriteText(shaders / "LightingUtil.hlsl", "#define MaxLights 16\n#include \"Default.hlsl\"\n");
+	WriteText(shaders / "Sub" / "Common.hlsl", "#include \"Inner.hlsl\"\n");
+	WriteText(shaders / "Sub" / "Inner.hlsl", "float Inner;\n");
+	WriteText(shaders / "Inner.hlsl", "float NotIncluded;\n");
+
+	std::wstring source = Wide(shaders / "Default.hlsl");
+	std::vector<ShaderDefine> defines = { { "ALPHA_TEST", "1" }, { "FOG", "1" } };
+
+	const char includes[] = "#include \"a.hlsl\"\n\t# include<b.hlsl>\n// #include \"c.hlsl\"\n#includes \"d\"\n#include \"e";
+	Bench::Check(ShaderCache::ParseIncludes(includes, sizeof(includes) - 1) == std::vector<std::string>({ "a.hlsl", "b.hlsl" }),
+		"ParseIncludes");
+
+	// Miss, then hit in the same cache and in a new one.
+	std::vector<uint8_t> expected = StubCompile(source, defines, "PS", "ps_5_0", 0);
+	gCompileCount = 0;
+	uint64_t key = 0;
+	{
+		ShaderCache cache(Wide(cacheDir), StubCompile);
+		key = cache.ComputeKey(source, defines, "PS", "ps_5_0");
+
+		auto first = cache.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == 1 && cache.GetStats().Misses == 1 && Equal(*first, expected), "first load compiles");
+		Bench::Check(fs::file_size(CacheFile(cacheDir, key)) > expected.size(), "first load writes the cache file");
+
+		auto second = cache.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == 1 && cache.GetStats().Hits == 1 && Equal(*second, expected), "second load hits");
+	}
+	{
+		ShaderCache cache(Wide(cacheDir), StubCompile);
+		auto bytecode = cache.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == 1 && cache.GetStats().Hits == 1 && Equal(*bytecode, expected), "new cache hits");
+	}
+
+	// What the key depends on.
+	{
+		ShaderCache cache(Wide(cacheDir), StubCompile);
+		Bench::Check(cache.ComputeKey(source, defines, "PS", "ps_5_0") == key, "key is stable");
+		Bench::Check(cache.ComputeKey(source, { { "ALPHA_TEST", "1" } }, "PS", "ps_5_0") != key, "key changes with a define");
+		Bench::Check(cache.ComputeKey(source, { { "ALPHA_TEST", "0" }, { "FOG", "1" } }, "PS", "ps_5_0") != key,
+			"key changes with a define value");
+		Bench::Check(cache.ComputeKey(source, defines, "VS", "ps_5_0") != key, "key changes with the entry point");
+		Bench::Check(cache.ComputeKey(source, defines, "PS", "ps_5_1") != key, "key changes with the target");
+
+		ShaderCache debugCache(Wide(cacheDir), StubCompile, 1);
+		Bench::Check(debugCache.ComputeKey(source, defines, "PS", "ps_5_0") != key, "key changes with the flags");
+		ShaderCache newCompiler(Wide(cacheDir), StubCompile, 0, "10.1");
+		Bench::Check(newCompiler.ComputeKey(source, defines, "PS", "ps_5_0") != key, "key changes with the compiler version");
+
+		WriteText(shaders / "Inner.hlsl", "float NotIncluded2;\n");
+		cache.ClearSourceHashes();
+		Bench::Check(cache.ComputeKey(source, defines, "PS", "ps_5_0") == key, "key ignores a file outside the include tree");
+
+		WriteText(shaders / "Sub" / "Inner.hlsl", "float Inner2;\n");
+		Bench::Check(cache.ComputeKey(source, defines, "PS", "ps_5_0") == key, "source hashes are kept until cleared");
+		cache.ClearSourceHashes();
+		uint64_t innerKey = cache.ComputeKey(source, defines, "PS", "ps_5_0");
+		Bench::Check(innerKey != key, "key changes with a nested relative include");
+
+		WriteText(shaders / "LightingUtil.hlsl", "#define MaxLights 32\n#include \"Default.hlsl\"\n");
+		cache.ClearSourceHashes();
+		uint64_t lightingKey = cache.ComputeKey(source, defines, "PS", "ps_5_0");
+		Bench::Check(lightingKey != key && lightingKey != innerKey, "key changes with LightingUtil.hlsl");
+
+		uint32_t compiles = gCompileCount;
+		auto bytecode = cache.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == compiles + 1 && Equal(*bytecode, expected), "edited include recompiles");
+
+		WriteText(shaders / "Sub" / "Inner.hlsl", "float Inner;\n");
+		WriteText(shaders / "LightingUtil.hlsl", "#define MaxLights 16\n#include \"Default.hlsl\"\n");
+		cache.ClearSourceHashes();
+		Bench::Check(cache.ComputeKey(source, defines, "PS", "ps_5_0") == key, "restored sources give the old key");
+	}
+
+	// Invalid cache files are misses and get rewritten.
+	{
+		fs::path file = CacheFile(cacheDir, key);
+		fs::resize_file(file, fs::file_size(file) / 2);
+
+		uint32_t compiles = gCompileCount;
+		ShaderCache cache(Wide(cacheDir), StubCompile);
+		auto bytecode = cache.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == compiles + 1 && cache.GetStats().Rejected == 1 && Equal(*bytecode, expected),
+			"truncated file is rejected");
+
+		fs::resize_file(file, 10);
+		ShaderCache cache2(Wide(cacheDir), StubCompile);
+		cache2.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == compiles + 2 && cache2.GetStats().Rejected == 1, "file shorter than the header is rejected");
+
+		ShaderCache cache3(Wide(cacheDir), StubCompile);
+		bytecode = cache3.Load(source, defines, "PS", "ps_5_0");
+		Bench::Check(gCompileCount == compiles + 2 && cache3.GetStats().Hits == 1 && Equal(*bytecode, expected),
+			"rejected file is rewritten");
+
+		// A complete file under the name of another key.
+		uint64_t vsKey = cache3.ComputeKey(source, defines, "VS", "vs_5_0");
+		fs::copy_file(file, CacheFile(cacheDir, vsKey), fs::copy_options::overwrite_existing);
+		bytecode = cache3.Load(source, defines, "VS", "vs_5_0");
+		Bench::Check(gCompileCount == compiles + 3 && cache3.GetStats().Rejected == 1 &&
+			Equal(*bytecode, StubCompile(source, defines, "VS", "vs_5_0", 0)), "file of another key is rejected");
+
+		Bench::Check(CountTemporaryFiles(cacheDir) == 0, "no temporary files left");
+	}
+
+	// Timings.
+	{
+		ShaderCache cache(Wide(cacheDir), StubCompile);
+		const int loads = 1000;
+
+		double coldMs = Bench::BestMs(5, [&] {
+			for (int i = 0; i < loads; ++i)
+			{
+				cache.ClearSourceHashes();
+				cache.ComputeKey(source, defines, "PS", "ps_5_0");
+			}
+		});
+		double warmMs = Bench::BestMs(5, [&] {
+			for (int i = 0; i < loads; ++i)
+				cache.ComputeKey(source, defines, "PS", "ps_5_0");
+		});
+		double hitMs = Bench::BestMs(5, [&] {
+			for (int i = 0; i < loads; ++i)
+				cache.Load(source, defines, "PS", "ps_5_0");
+		});
+
+		printf("key with sources hashed %.2f us, with source hashes kept %.2f us, load that hits %.2f us\n",
+			1000.0 * coldMs / loads, 1000.0 * warmMs / loads, 1000.0 * hitMs / loads);
+		printf("%s\n", cache.Report().c_str());
+	}
+
+	fs::remove_all(root);
+
+	return Bench::Result();
+}
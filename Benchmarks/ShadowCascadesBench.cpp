@@ -0,0 +1,160 @@
+//***************************************************************************************
+// ShadowCascadesBench.cpp
+//
+// Fits four cascades to a walking camera and culls random box casters (one in fifty
+// dynamic) spread over a 400 x 400 area.
+//   -Checks that the corners of every cascade's slice of the camera frustum fall inside
+//    its projection, that no caster whose projected box touches a cascade is missing
+//    from its list, and that a cascade is not re-rendered while the camera stands
+//    still, or moves less than a shadow map texel, unless it holds a dynamic caster.
+//   -Prints the fitting and culling times reported by ShadowCascades.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	struct Box
+	{
+		float Center[3];
+		float Extents[3];
+	};
+
+	void Transform(const float m[4][4], const float p[3], float out[3])
+	{
+		for (int j = 0; j < 3; ++j)
+			out[j] = p[0] * m[0][j] + p[1] * m[1][j] + p[2] * m[2][j] + m[3][j];
+	}
+
+	void CheckCorners(const ShadowCascades& cascades, const ShadowCamera& camera)
+	{
+		float tanY = std::tan(0.5f * camera.FovY);
+		for (uint32_t i = 0; i < cascades.CascadeCount(); ++i)
+		{
+			const ShadowCascade& cascade = cascades.Cascade(i);
+			for (float z : { cascade.SplitNear, cascade.SplitFar })
+			{
+				for (int corner = 0; corner < 4; ++corner)
+				{
+					float x = (corner & 1 ? 1.0f : -1.0f) * z * tanY * camera.Aspect;
+					float y = (corner & 2 ? 1.0f : -1.0f) * z * tanY;
+
+					float p[3];
+					for (int j = 0; j < 3; ++j)
+						p[j] = camera.Position[j] + x * camera.Right[j] + y * camera.Up[j] + z * camera.Look[j];
+
+					float clip[3];
+					Transform(cascade.ViewProj, p, clip);
+					Bench::Check(std::fabs(clip[0]) <= 1.0001f && std::fabs(clip[1]) <= 1.0001f &&
+						clip[2] >= -1e-4f && clip[2] <= 1.0001f, "frustum corner outside its cascade");
+				}
+			}
+		}
+	}
+
+	void CheckCulling(const ShadowCascades& cascades, const std::vector<Box>& boxes)
+	{
+		for (uint32_t i = 0; i < cascades.CascadeCount(); ++i)
+		{
+			const ShadowCascade& cascade = cascades.Cascade(i);
+			std::vector<bool> listed(boxes.size(), false);
+			for (uint32_t id : cascade.Casters)
+				listed[id] = true;
+
+			for (size_t b = 0; b < boxes.size(); ++b)
+			{
+				// Clip-space bounds of the eight corners; anything in front of the far
+				// plane counts, since the shadow pass flattens nearer casters.
+				float mn[3] = { 1e30f, 1e30f, 1e30f };
+				float mx[3] = { -1e30f, -1e30f, -1e30f };
+				for (int k = 0; k < 8; ++k)
+				{
+					float p[3];
+					for (int j = 0; j < 3; ++j)
+						p[j] = boxes[b].Center[j] + (k & (1 << j) ? 1.0f : -1.0f) * boxes[b].Extents[j];
+					float clip[3];
+					Transform(cascade.ViewProj, p, clip);
+					for (int j = 0; j < 3; ++j)
+					{
+						mn[j] = std::min<float>(mn[j], clip[j]);
+						mx[j] = std::max<float>(mx[j], clip[j]);
+					}
+				}
+
+				bool touches = mx[0] >= -1.0f && mn[0] <= 1.0f && mx[1] >= -1.0f && mn[1] <= 1.0f && mn[2] <= 1.0f;
+				Bench::Check(!touches || listed[b], "caster touching a cascade is missing");
+			}
+		}
+	}
+
+	uint32_t RenderedWithoutDynamic(const ShadowCascades& cascades)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < cascades.CascadeCount(); ++i)
+		{
+			if (cascades.Cascade(i).NeedsRender && !cascades.Cascade(i).HasDynamicCasters)
+				++count;
+		}
+		return count;
+	}
+}
+
+int main()
+{
+	const float lightDirection[3] = { 0.57735f, -0.57735f, 0.57735f };
+
+	Bench::Random random(5);
+	for (uint32_t count : { 1000u, 10000u, 100000u })
+	{
+		ShadowCascades cascades;
+		cascades.SetDesc(ShadowCascadeDesc());
+
+		std::vector<Box> boxes(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Box& box = boxes[i];
+			box.Center[0] = random.Uniform(-200.0f, 200.0f);
+			box.Center[1] = random.Uniform(0.0f, 10.0f);
+			box.Center[2] = random.Uniform(-200.0f, 200.0f);
+			for (int j = 0; j < 3; ++j)
+				box.Extents[j] = random.Uniform(0.5f, 3.5f);
+			cascades.AddCaster(box.Center, box.Extents, i % 50 != 0);
+		}
+
+		ShadowCamera camera;
+		camera.Position[1] = 2.0f;
+		camera.Aspect = 16.0f / 9.0f;
+
+		cascades.Update(camera, lightDirection);
+		CheckCorners(cascades, camera);
+		CheckCulling(cascades, boxes);
+
+		cascades.Update(camera, lightDirection);
+		Bench::Check(RenderedWithoutDynamic(cascades) == 0, "cascade re-rendered with a still camera");
+		camera.Position[0] += 0.001f;
+		cascades.Update(camera, lightDirection);
+		Bench::Check(RenderedWithoutDynamic(cascades) == 0, "cascade re-rendered after a sub-texel move");
+
+		// Walking camera: every frame moves it by more than a texel.
+		double fitMs = 1e30;
+		double cullMs = 1e30;
+		for (int frame = 0; frame < 60; ++frame)
+		{
+			camera.Position[0] += 0.3f;
+			cascades.Update(camera, lightDirection);
+			fitMs = std::min<double>(fitMs, cascades.GetStats().FitMs);
+			cullMs = std::min<double>(cullMs, cascades.GetStats().CullMs);
+		}
+		CheckCorners(cascades, camera);
+		CheckCulling(cascades, boxes);
+
+		printf("%6u casters: fit %.4f ms, cull %.4f ms; %u casters in the four cascades\n",
+			count, fitMs, cullMs, cascades.GetStats().VisibleCasters);
+	}
+
+	return Bench::Result();
+}
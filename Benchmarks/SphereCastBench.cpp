@@ -0,0 +1,147 @@
+//***************************************************************************************
+// SphereCastBench.cpp
+//
+// Sphere casts of the spring arm's length and radius (15 and 0.85) against 22, 1k and
+// 100k random boxes in a BoundsBvh.
+//   -Checks every cast against a brute-force cast over all the boxes, with the same
+//    rules: boxes grown by the radius, those overlapping the sphere at the origin left
+//    out. Hit or miss, distance and item must be the same.
+//   -Prints the build time and the casts per second.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "BoundsBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const float CastLength = 15.0f;
+	const float CastRadius = 0.85f;
+
+	struct Cast
+	{
+		float Origin[3];
+		float Direction[3];
+	};
+
+	bool BruteForceCast(const std::vector<float>& centers, const std::vector<float>& extents, const Cast& cast,
+		BoundsBvh::Hit& hit)
+	{
+		bool found = false;
+		float best = CastLength;
+		for (size_t item = 0; item < centers.size() / 3; ++item)
+		{
+			float tNear = -1e30f;
+			float tFar = 1e30f;
+			for (int i = 0; i < 3; ++i)
+			{
+				float d = cast.Direction[i];
+				float inv = std::fabs(d) > 1e-20f ? 1.0f / d : std::copysign(1e20f, d);
+				float t1 = (centers[3 * item + i] - extents[3 * item + i] - CastRadius - cast.Origin[i]) * inv;
+				float t2 = (centers[3 * item + i] + extents[3 * item + i] + CastRadius - cast.Origin[i]) * inv;
+				tNear = std::max<float>(tNear, std::min<float>(t1, t2));
+				tFar = std::min<float>(tFar, std::max<float>(t1, t2));
+			}
+
+			if (tNear < 0.0f || tNear > tFar || tNear >= best)
+				continue;
+
+			best = tNear;
+			hit.Distance = tNear;
+			hit.Item = (uint32_t)item;
+			found = true;
+		}
+		return found;
+	}
+
+	std::vector<Cast> RandomCasts(Bench::Random& random, uint32_t count, float world)
+	{
+		std::vector<Cast> casts(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Cast& cast = casts[i];
+			for (int k = 0; k < 3; ++k)
+			{
+				cast.Origin[k] = random.Uniform(-world, world);
+				cast.Direction[k] = random.Uniform(-1.0f, 1.0f);
+			}
+
+			// Some casts along the axes, where the slabs divide by zero.
+			if (i % 7 == 0)
+				cast.Direction[0] = 0.0f;
+			if (i % 11 == 0)
+			{
+				cast.Direction[0] = 1.0f;
+				cast.Direction[1] = 0.0f;
+				cast.Direction[2] = 0.0f;
+			}
+
+			float length = std::sqrt(cast.Direction[0] * cast.Direction[0] + cast.Direction[1] * cast.Direction[1] +
+				cast.Direction[2] * cast.Direction[2]);
+			for (int k = 0; k < 3; ++k)
+				cast.Direction[k] /= length;
+		}
+		return casts;
+	}
+}
+
+int main()
+{
+	for (uint32_t count : { 22u, 1000u, 100000u })
+	{
+		Bench::Random random(count);
+
+		// About the same density of boxes at every count.
+		float world = 4.0f * std::cbrt((float)count);
+
+		BoundsBvh bvh;
+		std::vector<float> centers;
+		std::vector<float> extents;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float center[3];
+			float extent[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				center[k] = random.Uniform(-world, world);
+				extent[k] = 0.2f + random.Uniform(0.0f, 1.0f);
+			}
+
+			bvh.Add(center, extent);
+			centers.insert(centers.end(), center, center + 3);
+			extents.insert(extents.end(), extent, extent + 3);
+		}
+		bvh.Build();
+		double buildMs = bvh.GetStats().BuildMs;
+
+		std::vector<Cast> checks = RandomCasts(random, count >= 100000 ? 2000 : 20000, world);
+		for (const Cast& cast : checks)
+		{
+			BoundsBvh::Hit hit;
+			BoundsBvh::Hit expected;
+			bool found = bvh.SphereCast(cast.Origin, cast.Direction, CastLength, CastRadius, hit);
+			bool expectedFound = BruteForceCast(centers, extents, cast, expected);
+
+			Bench::Check(found == expectedFound, "hit or miss differs from the brute-force cast");
+			if (found && expectedFound)
+				Bench::Check(hit.Distance == expected.Distance && hit.Item == expected.Item, "hit differs from the brute-force cast");
+		}
+
+		std::vector<Cast> casts = RandomCasts(random, 200000, world);
+		uint32_t hits = 0;
+		double ms = Bench::BestMs(3, [&]()
+		{
+			hits = 0;
+			BoundsBvh::Hit hit;
+			for (const Cast& cast : casts)
+				hits += bvh.SphereCast(cast.Origin, cast.Direction, CastLength, CastRadius, hit) ? 1 : 0;
+		});
+
+		printf("%6u boxes: build %.3f ms, %.3f us per cast (%.0fk casts/s), %.0f%% hit\n",
+			count, buildMs, 1000.0 * ms / casts.size(), casts.size() / ms, 100.0 * hits / casts.size());
+	}
+
+	return Bench::Result();
+}
@@ -0,0 +1,119 @@
+//***************************************************************************************
+// TlsfBench.cpp
+//
+// Synthetic allocation traces through TlsfAllocator, shaped like the heaps of
+// GpuHeapAllocator: many small buffers (256-byte aligned), textures (64 KB aligned,
+// some 4 MB) and frees in random order, with the heap about three quarters full.
+//   -Checks that live allocations never overlap, respect their alignment and add up to
+//    the reported used size, and that everything merges back into one block at the end.
+//   -Prints operations per second and the fragmentation at the end of each trace
+//    (1 - largest free block / free size).
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "TlsfAllocator.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	struct Request
+	{
+		uint64_t Size;
+		uint64_t Alignment;
+	};
+
+	Request RandomRequest(Bench::Random& random, float textureShare)
+	{
+		if (random.Uniform(0.0f, 1.0f) >= textureShare)
+			return { 256 + (uint64_t)random.Below(64 * 1024), 256 };
+
+		// Textures: mostly a few hundred KB, now and then a big (MSAA-sized) one.
+		if (random.Below(16) == 0)
+			return { (4ull << 20) + random.Below(8u << 20), 4ull << 20 };
+		return { (64ull << 10) + random.Below(2u << 20), 64ull << 10 };
+	}
+
+	void CheckLive(const TlsfAllocator& allocator, const std::vector<TlsfAllocator::Allocation>& live)
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+		uint64_t used = 0;
+		for (const TlsfAllocator::Allocation& a : live)
+		{
+			ranges.push_back({ a.Offset, a.Size });
+			used += a.Size;
+		}
+		std::sort(ranges.begin(), ranges.end());
+
+		bool disjoint = true;
+		for (size_t i = 1; i < ranges.size(); ++i)
+			disjoint = disjoint && ranges[i - 1].first + ranges[i - 1].second <= ranges[i].first;
+		Bench::Check(disjoint, "live allocations overlap");
+		Bench::Check(used == allocator.UsedSize(), "used size does not match the live allocations");
+	}
+
+	void RunTrace(const char* name, uint64_t capacity, float textureShare, int operations, uint32_t seed)
+	{
+		Bench::Random random(seed);
+		TlsfAllocator allocator(capacity);
+		std::vector<TlsfAllocator::Allocation> live;
+		uint32_t failed = 0;
+
+		double start = Bench::NowMs();
+		double checkMs = 0.0;
+		for (int i = 0; i < operations; ++i)
+		{
+			// Allocations and frees in random order, with the heap kept around three quarters full.
+			if (live.empty() || (allocator.UsedSize() < capacity / 4 * 3 && random.Below(5) < 3))
+			{
+				Request request = RandomRequest(random, textureShare);
+				TlsfAllocator::Allocation a = allocator.Allocate(request.Size, request.Alignment);
+				if (!a.IsValid())
+				{
+					++failed;
+					continue;
+				}
+				Bench::Check(a.Offset % request.Alignment == 0, "misaligned allocation");
+				Bench::Check(a.Offset + request.Size <= capacity && a.Size >= request.Size, "allocation out of range");
+				live.push_back(a);
+			}
+			else
+			{
+				size_t index = random.Below((uint32_t)live.size());
+				allocator.Free(live[index]);
+				live[index] = live.back();
+				live.pop_back();
+			}
+
+			if (i % 20000 == 0)
+			{
+				double checkStart = Bench::NowMs();
+				CheckLive(allocator, live);
+				checkMs += Bench::NowMs() - checkStart;
+			}
+		}
+		double ms = Bench::NowMs() - start - checkMs;
+
+		TlsfAllocator::Stats stats = allocator.GetStats();
+		uint64_t freeSize = stats.Capacity - stats.UsedSize;
+		double fragmentation = freeSize > 0 ? 1.0 - (double)stats.LargestFreeBlock / freeSize : 0.0;
+
+		printf("%-9s %7d ops in %7.2f ms (%5.1f M ops/s); %6zu live, %4.1f%% used, %5u free blocks, fragmentation %4.1f%%, %u failed\n",
+			name, operations, ms, operations / ms / 1000.0, live.size(), 100.0 * stats.UsedSize / capacity,
+			stats.FreeBlockCount, 100.0 * fragmentation, failed);
+
+		for (const TlsfAllocator::Allocation& a : live)
+			allocator.Free(a);
+		stats = allocator.GetStats();
+		Bench::Check(stats.FreeBlockCount == 1 && stats.LargestFreeBlock == capacity, "free blocks not merged back");
+	}
+}
+
+int main()
+{
+	RunTrace("buffers", 64ull << 20, 0.0f, 2000000, 1);
+	RunTrace("textures", 256ull << 20, 1.0f, 500000, 2);
+	RunTrace("mixed", 256ull << 20, 0.2f, 2000000, 3);
+
+	return Bench::Result();
+}
@@ -137,6 +137,8 @@ void Camera::SetLens(float fovY, float aspect, float zn, float zf)
 	// Calcola matrice di proiezione e la salva.
 	XMMATRIX P = XMMatrixPerspectiveFovLH(mFovY, mAspect, mNearZ, mFarZ);
 	XMStoreFloat4x4(&mProj, P);
+
+	++mVersion;
 }
 
 void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp)
@@ -187,6 +189,116 @@ XMFLOAT4X4 Camera::GetProj4x4f()const
 	return mProj;
 }
 
+bool Camera::NeedsUpdate(DerivedData data)const
+{
+	// Una nuova versione invalida tutto ci che era stato ricavato dalla precedente.
+	if (mDerivedVersion != mVersion)
+	{
+		mDerivedVersion = mVersion;
+		mDerivedValid = 0;
+	}
+
+	bool needsUpdate = (mDerivedValid & data) == 0;
+	mDerivedValid |= data;
+	return needsUpdate;
+}
+
+XMMATRIX Camera::GetViewProj()const
+{
+	if (NeedsUpdate(DerivedViewProj))
+		XMStoreFloat4x4(&mViewProj, XMMatrixMultiply(GetView(), GetProj()));
+
+	return XMLoadFloat4x4(&mViewProj);
+}
+
+XMMATRIX Camera::GetInvView()const
+{
+	if (NeedsUpdate(DerivedInvView))
+		XMStoreFloat4x4(&mInvView, MathHelper::InverseRigid(GetView()));
+
+	return XMLoadFloat4x4(&mInvView);
+}
+
+XMMATRIX Camera::GetInvProj()const
+{
+	if (NeedsUpdate(DerivedInvProj))
+		XMStoreFloat4x4(&mInvProj, MathHelper::InversePerspective(GetProj()));
+
+	return XMLoadFloat4x4(&mInvProj);
+}
+
+XMMATRIX Camera::GetInvViewProj()const
+{
+	// (V * P)^-1 = P^-1 * V^-1
+	if (NeedsUpdate(DerivedInvViewProj))
+		XMStoreFloat4x4(&mInvViewProj, XMMatrixMultiply(GetInvProj(), GetInvView()));
+
+	return XMLoadFloat4x4(&mInvViewProj);
+}
+
+const XMFLOAT4* Camera::GetFrustumPlanes()const
+{
+	if (NeedsUpdate(DerivedPlanes))
+	{
+		// Piani estratti dalle colonne della view-projection (Gribb-Hartmann): un punto
+		//  dentro se -w <= x <= w, -w <= y <= w e 0 <= z <= w in clip space.
+		XMMATRIX T = XMMatrixTranspose(GetViewProj());
+		XMVECTOR c0 = T.r[0];
+		XMVECTOR c1 = T.r[1];
+		XMVECTOR c2 = T.r[2];
+		XMVECTOR c3 = T.r[3];
+
+		const XMVECTOR planes[6] =
+		{
+			XMVectorAdd(c3, c0),      // left
+			XMVectorSubtract(c3, c0), // right
+			XMVectorAdd(c3, c1),      // bottom
+			XMVectorSubtract(c3, c1), // top
+			c2,                       // near
+			XMVectorSubtract(c3, c2)  // far
+		};
+
+		for (int i = 0; i < 6; ++i)
+			XMStoreFloat4(&mFrustumPlanes[i], XMPlaneNormalize(planes[i]));
+	}
+
+	return mFrustumPlanes;
+}
+
+const XMFLOAT3* Camera::GetFrustumCorners()const
+{
+	if (NeedsUpdate(DerivedCorners))
+	{
+		// Direttamente dalla base della camera e dalle dimensioni delle finestre near e far.
+		XMVECTOR P = XMLoadFloat3(&mPosition);
+		XMVECTOR R = XMLoadFloat3(&mRight);
+		XMVECTOR U = XMLoadFloat3(&mUp);
+		XMVECTOR L = XMLoadFloat3(&mLook);
+
+		const float depth[2] = { mNearZ, mFarZ };
+		const float halfHeight[2] = { 0.5f * mNearWindowHeight, 0.5f * mFarWindowHeight };
+
+		for (int i = 0; i < 8; ++i)
+		{
+			int plane = (i >> 2) & 1;
+			float x = (i & 1 ? 1.0f : -1.0f) * mAspect * halfHeight[plane];
+			float y = (i & 2 ? 1.0f : -1.0f) * halfHeight[plane];
+
+			XMVECTOR corner = XMVectorMultiplyAdd(XMVectorReplicate(depth[plane]), L, P);
+			corner = XMVectorMultiplyAdd(XMVectorReplicate(x), R, corner);
+			corner = XMVectorMultiplyAdd(XMVectorReplicate(y), U, corner);
+			XMStoreFloat3(&mFrustumCorners[i], corner);
+		}
+	}
+
+	return mFrustumCorners;
+}
+
+std::uint64_t Camera::GetVersion()const
+{
+	return mVersion;
+}
+
 void Camera::Strafe(float d)
 {
 	// mPosition += d*mRight
@@ -241,7 +353,6 @@ void Camera::UpdateViewMatrix()
 		XMVECTOR R = XMLoadFloat3(&mRight);
 		XMVECTOR U = XMLoadFloat3(&mUp);
 		XMVECTOR L = XMLoadFloat3(&mLook);
-		XMVECTOR P = XMLoadFloat3(&mPosition);
 
 		// Riortogonalizza e normalizza gli assi del sistema della camera.
 		// Necessario perch i piccoli errori di precisione che si hanno
@@ -254,37 +365,49 @@ void Camera::UpdateViewMatrix()
 		// il prodotto vettoriale.
 		R = XMVector3Cross(U, L);
 
-		// Riempe gli elementi della matrice view.
-		float x = -XMVectorGetX(XMVector3Dot(P, R));
-		float y = -XMVectorGetX(XMVector3Dot(P, U));
-		float z = -XMVectorGetX(XMVector3Dot(P, L));
-
 		XMStoreFloat3(&mRight, R);
 		XMStoreFloat3(&mUp, U);
 		XMStoreFloat3(&mLook, L);
 
-		mView(0, 0) = mRight.x;
-		mView(1, 0) = mRight.y;
-		mView(2, 0) = mRight.z;
-		mView(3, 0) = x;
+		StoreViewMatrix();
+
+		mViewDirty = false;
+	}
+}
+
+void Camera::StoreViewMatrix()
+{
+	XMVECTOR R = XMLoadFloat3(&mRight);
+	XMVECTOR U = XMLoadFloat3(&mUp);
+	XMVECTOR L = XMLoadFloat3(&mLook);
+	XMVECTOR P = XMLoadFloat3(&mPosition);
 
-		mView(0, 1) = mUp.x;
-		mView(1, 1) = mUp.y;
-		mView(2, 1) = mUp.z;
-		mView(3, 1) = y;
+	// Riempe gli elementi della matrice view.
+	float x = -XMVectorGetX(XMVector3Dot(P, R));
+	float y = -XMVectorGetX(XMVector3Dot(P, U));
+	float z = -XMVectorGetX(XMVector3Dot(P, L));
 
-		mView(0, 2) = mLook.x;
-		mView(1, 2) = mLook.y;
-		mView(2, 2) = mLook.z;
-		mView(3, 2) = z;
+	mView(0, 0) = mRight.x;
+	mView(1, 0) = mRight.y;
+	mView(2, 0) = mRight.z;
+	mView(3, 0) = x;
 
-		mView(0, 3) = 0.0f;
-		mView(1, 3) = 0.0f;
-		mView(2, 3) = 0.0f;
-		mView(3, 3) = 1.0f;
+	mView(0, 1) = mUp.x;
+	mView(1, 1) = mUp.y;
+	mView(2, 1) = mUp.z;
+	mView(3, 1) = y;
 
-		mViewDirty = false;
-	}
+	mView(0, 2) = mLook.x;
+	mView(1, 2) = mLook.y;
+	mView(2, 2) = mLook.z;
+	mView(3, 2) = z;
+
+	mView(0, 3) = 0.0f;
+	mView(1, 3) = 0.0f;
+	mView(2, 3) = 0.0f;
+	mView(3, 3) = 1.0f;
+
+	++mVersion;
 }
 
 void ThirdPersonCamera::LookAt(const DirectX::XMFLOAT3& pos, const DirectX::XMFLOAT3& target, const DirectX::XMFLOAT3& up)
@@ -378,6 +501,27 @@ float ThirdPersonCamera::GetRadius()
 	return mRadius;
 }
 
+void ThirdPersonCamera::SetArmLength(float length)
+{
+	// Solo se la distanza della camera cambia davvero: altrimenti la view verrebbe
+	// ricostruita ad ogni frame anche a camera ferma.
+	if (std::min<float>(length, mRadius) != std::min<float>(mArmLength, mRadius))
+		mViewDirty = true;
+
+	mArmLength = length;
+}
+
+float ThirdPersonCamera::GetArmLength()const
+{
+	return mArmLength;
+}
+
+XMFLOAT3 ThirdPersonCamera::GetArmDirection3f()const
+{
+	// Stessa conversione da coordinate sferiche di UpdateViewMatrix, con raggio unitario.
+	return { cosf(mPhi) * sinf(mTheta), sinf(mPhi), cosf(mPhi) * cosf(mTheta) };
+}
+
 void ThirdPersonCamera::UpdateViewMatrix()
 {
 	if (mViewDirty)
@@ -388,19 +532,102 @@ void ThirdPersonCamera::UpdateViewMatrix()
 		//float z = mRadius * sinf(mPhi) * sinf(mTheta);
 		//float y = mRadius * cosf(mPhi);
 
-		// Converte da coordinate sferiche a coordinate cartesiane.
-		float x = mRadius * cosf(mPhi) * sinf(mTheta);
-		float z = mRadius * cosf(mPhi) * cosf(mTheta);
-		float y = mRadius * sinf(mPhi);
+		// Converte da coordinate sferiche a coordinate cartesiane. Il braccio pu essere
+		// accorciato dalle collisioni.
+		float radius = std::min<float>(mRadius, mArmLength);
+		float x = radius * cosf(mPhi) * sinf(mTheta);
+		float z = radius * cosf(mPhi) * cosf(mTheta);
+		float y = radius * sinf(mPhi);
 
 		mPosition = { mTarget.x + x, mTarget.y + y, mTarget.z + z };
 
-		XMStoreFloat4x4(&mView, XMMatrixLookAtLH(XMLoadFloat3(&mPosition), XMLoadFloat3(&mTarget), g_XMIdentityR1));
+		// La base si ricava direttamente dagli angoli, senza passare da XMMatrixLookAtLH:
+		// look va dalla camera al target, right  orizzontale (mPhi < 90 quindi
+		// cos(mPhi) > 0) e up = look x right  gi unitario.
+		float cosPhi = cosf(mPhi);
+		float sinPhi = sinf(mPhi);
+		float cosTheta = cosf(mTheta);
+		float sinTheta = sinf(mTheta);
+
+		mLook = { -cosPhi * sinTheta, -sinPhi, -cosPhi * cosTheta };
+		mRight = { -cosTheta, 0.0f, sinTheta };
+		XMStoreFloat3(&mUp, XMVector3Cross(XMLoadFloat3(&mLook), XMLoadFloat3(&mRight)));
 
-		XMStoreFloat3(&mRight, XMVector3Normalize({ mView._11, mView._21, mView._31 }));
-		XMStoreFloat3(&mLook, XMVector3Normalize({ mView._13, mView._23, mView._33 }));
-		XMStoreFloat3(&mUp, XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&mLook), XMLoadFloat3(&mRight))));
+		StoreViewMatrix();
 
 		mViewDirty = false;
 	}
 }
+
+CubeCamera::CubeCamera()
+{
+	SetLens(0.1f, 1000.0f);
+	SetPosition(mPosition);
+}
+
+void CubeCamera::SetPosition(const XMFLOAT3& position)
+{
+	// Direzioni di vista e vettori up delle facce, nell'ordine delle slice di una cube map.
+	static const XMFLOAT3 looks[FaceCount] =
+	{
+		XMFLOAT3(+1.0f, 0.0f, 0.0f),
+		XMFLOAT3(-1.0f, 0.0f, 0.0f),
+		XMFLOAT3(0.0f, +1.0f, 0.0f),
+		XMFLOAT3(0.0f, -1.0f, 0.0f),
+		XMFLOAT3(0.0f, 0.0f, +1.0f),
+		XMFLOAT3(0.0f, 0.0f, -1.0f)
+	};
+	static const XMFLOAT3 ups[FaceCount] =
+	{
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 0.0f, -1.0f),
+		XMFLOAT3(0.0f, 0.0f, +1.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f)
+	};
+
+	mPosition = position;
+	for (UINT i = 0; i < FaceCount; ++i)
+	{
+		XMFLOAT3 target(position.x + looks[i].x, position.y + looks[i].y, position.z + looks[i].z);
+		mFaces[i].LookAt(position, target, ups[i]);
+		mFaces[i].UpdateViewMatrix();
+	}
+
+	++mVersion;
+}
+
+XMFLOAT3 CubeCamera::GetPosition3f()const
+{
+	return mPosition;
+}
+
+void CubeCamera::SetLens(float zn, float zf)
+{
+	// 90 per lato: le sei facce coprono tutte le direzioni senza sovrapporsi.
+	for (Camera& face : mFaces)
+		face.SetLens(0.5f * XM_PI, 1.0f, zn, zf);
+
+	++mVersion;
+}
+
+float CubeCamera::GetNearZ()const
+{
+	return mFaces[0].GetNearZ();
+}
+
+float CubeCamera::GetFarZ()const
+{
+	return mFaces[0].GetFarZ();
+}
+
+const Camera& CubeCamera::GetFace(UINT face)const
+{
+	return mFaces[face];
+}
+
+std::uint64_t CubeCamera::GetVersion()const
+{
+	return mVersion;
+}
@@ -61,6 +61,25 @@ public:
 	DirectX::XMFLOAT4X4 GetView4x4f()const;
 	DirectX::XMFLOAT4X4 GetProj4x4f()const;
 
+	// Matrices derived from View/Proj, computed on the first request after a change.
+	// The inverses are analytic: the view is a rigid transform, the projection a perspective.
+	DirectX::XMMATRIX GetViewProj()const;
+	DirectX::XMMATRIX GetInvView()const;
+	DirectX::XMMATRIX GetInvProj()const;
+	DirectX::XMMATRIX GetInvViewProj()const;
+
+	// World space frustum planes (a, b, c, d), normalized, normals pointing inside, in
+	// the order left, right, bottom, top, near, far.
+	const DirectX::XMFLOAT4* GetFrustumPlanes()const;
+
+	// World space frustum corners: bit 0 of the index selects right, bit 1 top and
+	// bit 2 the far plane.
+	const DirectX::XMFLOAT3* GetFrustumCorners()const;
+
+	// Incremented every time the view or the projection changes, so that whatever is
+	// derived from the camera can be cached against it.
+	std::uint64_t GetVersion()const;
+
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
 	virtual void Walk(float d);
@@ -74,6 +93,9 @@ public:
 
 protected:
 
+	// Builds mView from position and (orthonormal) basis and starts a new version.
+	void StoreViewMatrix();
+
 	// Camera coordinate system with coordinates relative to world space.
 	DirectX::XMFLOAT3 mPosition = { 0.0f, 0.0f, 0.0f };
 	DirectX::XMFLOAT3 mRight = { 1.0f, 0.0f, 0.0f };
@@ -93,6 +115,33 @@ protected:
 	// Cache View/Proj matrices.
 	DirectX::XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 mProj = MathHelper::Identity4x4();
+
+	std::uint64_t mVersion = 1;
+
+private:
+
+	enum DerivedData : std::uint32_t
+	{
+		DerivedViewProj = 1 << 0,
+		DerivedInvView = 1 << 1,
+		DerivedInvProj = 1 << 2,
+		DerivedInvViewProj = 1 << 3,
+		DerivedPlanes = 1 << 4,
+		DerivedCorners = 1 << 5
+	};
+
+	// True if data has not been computed yet for the current version; the caller
+	// computes it right away, so it is marked as valid.
+	bool NeedsUpdate(DerivedData data)const;
+
+	mutable std::uint64_t mDerivedVersion = 0;
+	mutable std::uint32_t mDerivedValid = 0;
+	mutable DirectX::XMFLOAT4X4 mViewProj = MathHelper::Identity4x4();
+	mutable DirectX::XMFLOAT4X4 mInvView = MathHelper::Identity4x4();
+	mutable DirectX::XMFLOAT4X4 mInvProj = MathHelper::Identity4x4();
+	mutable DirectX::XMFLOAT4X4 mInvViewProj = MathHelper::Identity4x4();
+	mutable DirectX::XMFLOAT4 mFrustumPlanes[6];
+	mutable DirectX::XMFLOAT3 mFrustumCorners[8];
 };
 
 
@@ -121,14 +170,53 @@ public:
 	float GetRadius();
 	void AddToRadius(float d);
 
+	// Spring arm: the eye is placed at min(radius, arm length) from the target, so that
+	// collisions can pull it in without changing the radius chosen by the user.
+	void SetArmLength(float length);
+	float GetArmLength()const;
+
+	// Unit vector from the target toward the eye.
+	DirectX::XMFLOAT3 GetArmDirection3f()const;
+
 	// Building the View matrix works differently from the base class.
 	void UpdateViewMatrix();
 
 private:
 	float mRadius;
+	float mArmLength = FLT_MAX;
 	float mPhi = 0.25f * DirectX::XM_PI;
 	float mTheta = DirectX::XM_PI;
 	DirectX::XMFLOAT3 mTarget;
 };
 
+// Six cameras with a 90 degree field of view and a square aspect ratio sharing one
+// position, one per face of a cube map: face i looks along +x, -x, +y, -y, +z, -z with
+// the up vector of slice i of a TextureCube.
+class CubeCamera
+{
+public:
+
+	CubeCamera();
+
+	void SetPosition(const DirectX::XMFLOAT3& position);
+	DirectX::XMFLOAT3 GetPosition3f()const;
+
+	void SetLens(float zn, float zf);
+	float GetNearZ()const;
+	float GetFarZ()const;
+
+	// The camera of a face, with its view ready to be used.
+	const Camera& GetFace(UINT face)const;
+
+	// Incremented every time the position or the lens changes.
+	std::uint64_t GetVersion()const;
+
+	static const UINT FaceCount = 6;
+
+private:
+	Camera mFaces[FaceCount];
+	DirectX::XMFLOAT3 mPosition = { 0.0f, 0.0f, 0.0f };
+	std::uint64_t mVersion = 1;
+};
+
 #endif // CAMERA_H
\ No newline at end of file
@@ -6,6 +6,27 @@
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
 #include "Common/GeometryGenerator.h"
+#include "Common/UploadRing.h"
+#include "Common/BufferPool.h"
+#include "Common/DescriptorAllocator.h"
+#include "Common/RenderGraphExecutor.h"
+#include "Common/PipelineStateCache.h"
+#include "Common/ShaderCache.h"
+#include "Common/ShaderPermutations.h"
+#include "Common/LightClusters.h"
+#include "Common/ShadowCascades.h"
+#include "Common/ShadowMapArray.h"
+#include "Common/LatencyStats.h"
+#include "Common/FixedTimestep.h"
+#include "Common/CameraRecording.h"
+#include "Common/CameraPath.h"
+#include "Common/BoundsBvh.h"
+#include "Common/CollisionWorld.h"
+#include "Common/MeshRayTest.h"
+#include "Common/CubeRenderTarget.h"
+#include "Common/Hash.h"
+#include "Common/ResolutionScaler.h"
+#include <chrono>
 #include "Camera.h"
 #include "FrameResource.h"
 
@@ -18,6 +39,23 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Capacity of the per-frame clustered lighting buffers.
+const UINT gMaxClusteredLights = 16384;
+const UINT gMaxClusterLightIndices = 1 << 19;
+
+// Frequenza della simulazione (movimento di camera e box), indipendente dal frame rate.
+const double gSimulationRate = 60.0;
+
+// File della sessione registrata con R e riprodotta con T/Y (nella cartella di lavoro).
+const wchar_t* gRecordingFile = L"CameraRecording.crec";
+
+// Velocit (1/s) con cui il braccio della camera in terza persona torna alla lunghezza
+// voluta dopo una collisione.
+const float gSpringArmReturnRate = 4.0f;
+
+// Lato in pixel delle facce della sonda d'ambiente.
+const UINT gProbeResolution = 256;
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -51,8 +89,137 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Bounding box of the submesh in local space.
+	BoundingBox Bounds;
+
+	// Id of the item among the shadow casters.
+	uint32_t ShadowCasterId = 0;
+
+	// Items moved by the fixed-step simulation: World is interpolated every frame
+	// between the previous and the latest simulated transform.
+	XMFLOAT4X4 PrevSimWorld = MathHelper::Identity4x4();
+	XMFLOAT4X4 SimWorld = MathHelper::Identity4x4();
+};
+
+// Stato registrabile della camera: posizione, base e proiezione.
+static CameraState GetCameraState(const Camera& camera)
+{
+	XMFLOAT3 position = camera.GetPosition3f();
+	XMFLOAT3 look = camera.GetLook3f();
+	XMFLOAT3 up = camera.GetUp3f();
+
+	CameraState state;
+	state.Position[0] = position.x;
+	state.Position[1] = position.y;
+	state.Position[2] = position.z;
+	state.Look[0] = look.x;
+	state.Look[1] = look.y;
+	state.Look[2] = look.z;
+	state.Up[0] = up.x;
+	state.Up[1] = up.y;
+	state.Up[2] = up.z;
+	state.FovY = camera.GetFovY();
+	state.Aspect = camera.GetAspect();
+	state.NearZ = camera.GetNearZ();
+	state.FarZ = camera.GetFarZ();
+	return state;
+}
+
+// Azioni della action map dell'input: pi tasti o assi del mouse possono alimentare
+// la stessa azione.
+enum CameraAction : uint32_t
+{
+	ActionWalk,
+	ActionStrafe,
+	ActionPitch,
+	ActionYaw,
+	ActionZoom,
+	ActionFirstPersonCamera,
+	ActionThirdPersonCamera,
+	ActionFogOn,
+	ActionFogOff,
+	ActionClusteredLightsOn,
+	ActionClusteredLightsOff,
+	ActionShadowsOn,
+	ActionShadowsOff,
+	ActionDepthPrepassOn,
+	ActionDepthPrepassOff,
+	ActionLateLatchOn,
+	ActionLateLatchOff,
+	ActionRecord,
+	ActionReplayInput,
+	ActionReplayCamera,
+	ActionFlythrough,
+	ActionSpringArmOn,
+	ActionSpringArmOff,
+	ActionNextViewLayout,
+	ActionDynamicResolutionOn,
+	ActionDynamicResolutionOff
 };
 
+// Azioni premute nell'intervallo dell'ultimo Update dell'input, un bit per azione.
+static uint32_t PressedActions(const InputSystem& input)
+{
+	uint32_t pressed = 0;
+	for (uint32_t action = 0; action <= ActionDynamicResolutionOff; ++action)
+	{
+		if (input.Pressed(action))
+			pressed |= 1u << action;
+	}
+	return pressed;
+}
+
+static bool HasAction(uint32_t actions, CameraAction action)
+{
+	return (actions >> action) & 1u;
+}
+
+// Origine della camera e dell'input che la muove.
+enum class PlaybackMode
+{
+	Live,	// input dell'utente
+	Input,	// input registrato, con i delta time registrati
+	Camera	// stati della camera registrati (o di un percorso), senza simulazione
+};
+
+// Disposizione delle viste nel back buffer.
+enum class ViewLayout
+{
+	Single,				// solo la camera attiva
+	SplitScreen,		// camera attiva a sinistra, l'altra a destra
+	PictureInPicture	// l'altra camera in un riquadro in alto a destra
+};
+
+const UINT gMaxViews = 2;
+
+// Una vista del frame: camera, regione del back buffer e pass CB, con gli oggetti che
+// la camera vede ordinati dal pi vicino. Gli object CB sono gli stessi per tutte.
+struct RenderView
+{
+	const Camera* Cam = nullptr;
+	D3D12_VIEWPORT Viewport = {};
+	D3D12_RECT ScissorRect = {};
+	UINT PassCBIndex = 0;
+	UINT ShaderKey = 0;
+	std::vector<RenderItem*> Ritems;
+
+	// Faccia della sonda d'ambiente: niente depth pre-pass e niente riflessi.
+	bool Capture = false;
+};
+
+// Matrici della camera nelle costanti di un pass.
+static void StoreCameraMatrices(PassConstants& passCB, const Camera& camera)
+{
+	XMStoreFloat4x4(&passCB.View, XMMatrixTranspose(camera.GetView()));
+	XMStoreFloat4x4(&passCB.InvView, XMMatrixTranspose(camera.GetInvView()));
+	XMStoreFloat4x4(&passCB.Proj, XMMatrixTranspose(camera.GetProj()));
+	XMStoreFloat4x4(&passCB.InvProj, XMMatrixTranspose(camera.GetInvProj()));
+	XMStoreFloat4x4(&passCB.ViewProj, XMMatrixTranspose(camera.GetViewProj()));
+	XMStoreFloat4x4(&passCB.InvViewProj, XMMatrixTranspose(camera.GetInvViewProj()));
+	passCB.EyePosW = camera.GetPosition3f();
+}
+
 class CameraApp : public D3DApp
 {
 public:
@@ -70,14 +237,45 @@ private:
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
-	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
-	void OnKeyboardInput(const GameTimer& gt);
+	void BuildInputBindings(InputSystem& input);
+	void ApplyInput();
+	const InputSystem* SampleInput();
+	void TurnCamera(const InputSystem& input);
+	void ResetSimulation();
+	void BeginPlaybackFrame(const GameTimer& gt);
+	void EndPlaybackFrame();
+	void StartPlayback(CameraAction command);
+	void StopPlayback();
+	bool PlaybackSampleLeft()const;
+	void SimulateStep(uint32_t remainingSteps);
+	void InterpolateSimState(float alpha);
+	void PlaceCameras(const XMFLOAT3& position);
+	void UpdateSpringArm(float deltaTime);
+	void LatchCamera();
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
+	void WriteObjectCB(const RenderItem* ri);
 	void UpdateMaterialCBs(const GameTimer& gt);
 	//void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void StorePassCamera(const Camera* camera);
+	void UpdateSecondaryPassCBs();
+	void UpdateLightingCB();
+	void UpdateClusteredLights(const GameTimer& gt);
+	void UpdateShadowCascades(const GameTimer& gt);
+	void UpdateResolutionScale(const GameTimer& gt);
+	void UpdateViews();
+	void CullViews();
+	void UpdateEnvironmentProbe();
+	void BindLightingResources(ID3D12GraphicsCommandList* cmdList);
+	void SortViewRitems(RenderView& view);
+	void RefitSceneBvh();
+
+	const Camera* ActiveCamera()const;
+	const Camera* InactiveCamera()const;
+	float ViewAspect()const;
+	void SetCameraLenses();
 
 	void LoadTextures();
 	void BuildRootSignature();
@@ -88,9 +286,25 @@ private:
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
-
-	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
+	void BuildClusteredLights();
+	void BuildLighting();
+	void BuildShadowCasters();
+	void BuildCollisionBvh();
+	void BuildCollisionWorld();
+	void BuildSceneBvh();
+	void BuildEnvironmentProbe();
+	void Pick(int x, int y);
+	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const RenderView& view);
+	void DrawShadowCasters(ID3D12GraphicsCommandList* cmdList, const std::vector<uint32_t>& casters);
+	void DrawDepthPrepass(ID3D12GraphicsCommandList* cmdList, const RenderView& view);
+	void DrawDepthOnly(ID3D12GraphicsCommandList* cmdList, const RenderItem* ri);
+
+	PipelineStateCache::Handle RequestOpaqueVariant(UINT shaderKey, bool depthEqual);
+	ID3D12PipelineState* OpaqueVariant(UINT shaderKey, bool depthPrepass);
+	bool UsesDepthPrepass(UINT shaderKey)const;
+	UINT ShaderKeyFor(const RenderItem* ri, const RenderView& view)const;
+
+	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
 
 private:
 
@@ -102,13 +316,82 @@ private:
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
+	// Shader-visible CBV/SRV/UAV heap (persistent region + per-frame ring) and the
+	// CPU-only heap in which the views are created before being copied there.
+	std::unique_ptr<GpuDescriptorHeap> mSrvHeap;
+	std::unique_ptr<StagingDescriptorHeap> mSrvStagingHeap;
+
+	// Staging memory shared by all buffer and texture uploads.
+	std::unique_ptr<UploadRing> mUploadRing;
+
+	// GPU objects waiting for the frame that last used them to retire.
+	DeferredReleaseQueue mDeferredReleases;
+
+	// Vertex and index buffers of all the geometries, sub-allocated from one resource.
+	std::unique_ptr<BufferPool> mGeometryBuffers;
+
+	// Where the textures are placed in the allocator heaps.
+	std::vector<GpuAllocation> mTextureAllocations;
+
+	// The frame is described as a graph of passes, rebuilt every frame; the executor
+	// owns the transient render targets the passes create.
+	RenderGraph mRenderGraph;
+	std::unique_ptr<RenderGraphExecutor> mGraphExecutor;
+
+	// Keep system memory copies of the geometry (MeshGeometry::VertexBufferCPU/IndexBufferCPU).
+	// Only CPU-side features such as picking need them.
+	bool mKeepGeometryCpuCopies = true;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
-	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
-	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	// Bytecode letto dalla cache degli shader (o appena compilato).
+	std::unique_ptr<ShaderCache> mShaderCache;
+	std::unordered_map<std::string, std::shared_ptr<const ShaderBytecode>> mShaders;
+	// PSO e root signature salvati su disco tra un'esecuzione e l'altra; i PSO vengono
+	// creati in background e mPSOs ne conserva gli handle.
+	std::unique_ptr<PipelineStateCache> mPsoCache;
+	std::unordered_map<std::string, PipelineStateCache::Handle> mPSOs;
+
+	// Varianti di Default.hlsl scelte da una chiave di permutazione: il pass fissa
+	// luci e nebbia, il materiale aggiunge le sue feature (es. ALPHA_TEST) e gli oggetti
+	// lontani usano una variante pi economica. Ogni chiave ha il suo PSO.
+	std::unique_ptr<ShaderPermutations> mDefaultShaders;
+	UINT mDirLightsField = 0;
+	UINT mAlphaTestField = 0;
+	UINT mFogField = 0;
+	UINT mClusteredLightsField = 0;
+	UINT mShadowsField = 0;
+	UINT mReflectionsField = 0;
+	UINT mPassShaderKey = 0;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC mOpaquePsoDesc;
+	std::unordered_map<UINT, PipelineStateCache::Handle> mVariantPSOs;
+	// Le stesse varianti con depth test EQUAL, per quando la profondit viene dal pre-pass.
+	std::unordered_map<UINT, PipelineStateCache::Handle> mDepthEqualVariantPSOs;
+
+	// Depth pre-pass: gli oggetti opachi scrivono prima solo la profondit, poi il pass
+	// principale la confronta con EQUAL e il pixel shader gira una volta per pixel visibile.
+	bool mDepthPrepassEnabled = true;
+
+	// Oltre questa distanza dalla camera gli oggetti sono illuminati solo dalla luce principale.
+	float mReducedLightingDistance = 20.0f;
+	bool mFogEnabled = false;
+
+	// Luci puntiformi e spot della scena in world space (prima le puntiformi, poi le spot
+	// da mClusteredSpotLightStart). Ogni frame vengono portate in view space e assegnate
+	// ai cluster del frustum: il pixel shader valuta solo quelle del proprio cluster.
+	std::vector<Light> mClusteredLights;
+	UINT mClusteredSpotLightStart = 0;
+	std::vector<ClusterLight> mViewSpaceLights;
+	LightClusters mLightClusters;
+	bool mClusteredLightsEnabled = true;
+
+	// Ombre della luce principale: una slice della shadow map per cascata. Le cascate
+	// la cui proiezione e i cui caster non sono cambiati non vengono ridisegnate.
+	ShadowCascades mShadowCascades;
+	std::unique_ptr<ShadowMapArray> mShadowMap;
+	std::vector<RenderItem*> mShadowCasterRitems;
+	bool mShadowsEnabled = true;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
@@ -122,12 +405,122 @@ private:
 
 	PassConstants mMainPassCB;
 
+	// Camera (e sua versione) da cui sono state ricavate le matrici di mMainPassCB.
+	const Camera* mPassCamera = nullptr;
+	std::uint64_t mPassCameraVersion = 0;
+
+	// Luci e ambiente, separati dai dati della camera: ogni modifica incrementa la versione
+	// e ogni frame resource ricarica il proprio LightingCB solo se  rimasto indietro.
+	LightingConstants mLighting;
+	UINT64 mLightingVersion = 1;
+
 	//Camera mCamera;
 	std::unique_ptr<FirstPersonCamera> mFpsCam;
 	std::unique_ptr<ThirdPersonCamera> mTpsCam;
 	BOOL mUseFpsCamera;
 
-	POINT mLastMousePos;
+	// Simulazione a passo fisso: la posizione di camera/target (e della box) avanza di un
+	// passo alla volta; a video va l'interpolazione tra gli ultimi due stati simulati.
+	// L'orientamento segue il mouse ad ogni frame, fuori dalla simulazione.
+	FixedTimestep mFixedStep{ 1.0 / gSimulationRate };
+	XMFLOAT3 mPrevSimPosition = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT3 mSimPosition = { 0.0f, 0.0f, 0.0f };
+	float mPendingWalk = 0.0f;
+	float mPendingStrafe = 0.0f;
+	std::vector<RenderItem*> mSimulatedRitems;
+
+	// Bounds degli oggetti fermi, per le collisioni del braccio della camera in terza
+	// persona: la camera viene avvicinata al target se un oggetto si trova in mezzo.
+	BoundsBvh mCollisionBvh;
+	bool mSpringArmEnabled = true;
+
+	// Oggetti fermi e pareti attorno al pavimento per il movimento della box, che scivola
+	// lungo ci che incontra invece di attraversarlo.
+	CollisionWorld mCollisionWorld;
+	uint32_t mPlayerBody = 0;
+
+	// Bounds di tutti gli oggetti opachi, numerati come in mSceneRitems: una sola visita
+	// per il culling di tutte le viste, e il picking con il tasto centrale (raggio dalla
+	// camera attraverso il pixel, poi esattamente contro i triangoli degli oggetti).
+	BoundsBvh mSceneBvh;
+	MeshRayTest mPickMeshes;
+	std::vector<RenderItem*> mSceneRitems;
+
+	// Viste del frame (M cambia disposizione) e, per ciascuna, gli oggetti di mSceneBvh
+	// nel suo frustum.
+	ViewLayout mViewLayout = ViewLayout::Single;
+	std::vector<RenderView> mViews;
+	std::vector<uint32_t> mVisibleItems[gMaxViews];
+
+	// Sonda d'ambiente al centro della sfera riflettente: cube map vista da sei camere con
+	// la stessa posizione. Una sola visita di mSceneBvh assegna ad ogni oggetto la maschera
+	// delle facce che tocca e riempie le liste di tutte le facce; una faccia viene
+	// ridisegnata solo se cambia ci che vede (oggetti, oggetti mossi, luci, nebbia).
+	CubeCamera mProbeCam;
+	std::unique_ptr<CubeRenderTarget> mEnvironmentProbe;
+	RenderItem* mProbeRItem = nullptr;
+	RenderView mProbeViews[CubeCamera::FaceCount];
+	std::vector<uint32_t> mProbeItems[CubeCamera::FaceCount];
+	std::uint64_t mProbeSignatures[CubeCamera::FaceCount] = {};
+	bool mProbeFaceNeedsRender[CubeCamera::FaceCount] = {};
+	std::uint64_t mProbeFacesRendered = 0;
+	std::uint64_t mProbeFacesSkipped = 0;
+
+	// Risoluzione dinamica: le viste vengono disegnate in SceneColor, grande quanto il back
+	// buffer, su una regione ridotta secondo il tempo dei frame, poi portate sul back buffer
+	// con un filtro bilineare. La texture non cambia con la scala, quindi non va ricreata.
+	// H attiva il controllo, J lo disattiva (scala 1).
+	ResolutionScaler mResolutionScaler;
+	bool mDynamicResolutionEnabled = true;
+	UINT mRenderWidth = 0;
+	UINT mRenderHeight = 0;
+
+	// Registrazione (R) e riproduzione della sessione. La registrazione parte dallo stato
+	// iniziale della simulazione e salva, per ogni frame, delta time, eventi consumati ad ogni
+	// campionamento e camera usata. La riproduzione dell'input (T) li passa a mReplayInput,
+	// con gli stessi binding, al posto dell'input dell'utente; quella della camera (Y, o U per
+	// il percorso predefinito) imposta direttamente mPlaybackCam frame per frame.
+	CameraRecording mRecording;
+	bool mRecordingActive = false;
+	std::vector<InputEvent> mRecordingStartEvents;
+	PlaybackMode mPlayback = PlaybackMode::Live;
+	uint32_t mPlaybackFrame = 0;
+	uint32_t mPlaybackSamplesUsed = 0;
+	InputSystem mReplayInput;
+	Camera mPlaybackCam;
+
+	// Tasto di registrazione/riproduzione premuto: eseguito all'inizio del frame seguente,
+	// prima del primo campionamento.
+	bool mPlaybackCommandPending = false;
+	CameraAction mPlaybackCommand = ActionRecord;
+
+	// Istante dell'input applicato alla camera (dell'utente o registrato), nel campionamento
+	// di Update e nell'ultimo.
+	double mFrameInputTime = 0.0;
+	double mCameraInputTime = 0.0;
+
+	// Durata dei frame riprodotti, da una submit alla successiva.
+	LatencyStats mPlaybackFrameTimes;
+	LatencyStats::Clock::time_point mPlaybackFrameEnd;
+
+	// Late latch: a command list gi registrata, subito prima di ExecuteCommandLists, la
+	// camera viene aggiornata con l'input pi recente e le sue matrici sovrascrivono quelle
+	// del pass CB del frame. Il tempo per cui un tasto  rimasto premuto viene dai timestamp
+	// degli eventi, quindi il movimento si divide tra i due campionamenti senza perdite.
+	bool mLateLatchEnabled = true;
+
+	// Tasti premuti prima del campionamento del latch (dell'utente e dell'input che muove
+	// la camera): il latch ricampiona solo il movimento, le azioni sono eseguite nel
+	// prossimo Update.
+	uint32_t mLatchedActions = 0;
+	uint32_t mLatchedCameraActions = 0;
+
+	// Istanti in cui l'input  stato campionato (in Update e nel latch) e latenza da
+	// ciascuno di essi alla submit del frame.
+	LatencyStats::Clock::time_point mInputSampleTime;
+	LatencyStats::Clock::time_point mLatchSampleTime;
+	LatencyStats mInputLatency;
+	LatencyStats mLatchedInputLatency;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -162,13 +555,57 @@ CameraApp::~CameraApp()
 {
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
+
+	// Salva nella pipeline library i PSO creati in questa esecuzione.
+	if (mPsoCache != nullptr)
+	{
+		mPsoCache->Save();
+		mPsoCache->LogStats();
+	}
+
+	// Assegnazione delle luci ai cluster dell'ultimo frame.
+	::OutputDebugStringA((mLightClusters.Report() + "\n").c_str());
+	::OutputDebugStringA((mShadowCascades.Report() + "\n").c_str());
+	::OutputDebugStringA((mInput.Report() + "\n").c_str());
+	::OutputDebugStringA((mFixedStep.Report() + "\n").c_str());
+	::OutputDebugStringA((mCollisionBvh.Report() + "\n").c_str());
+	::OutputDebugStringA((mCollisionWorld.Report() + "\n").c_str());
+	::OutputDebugStringA((mSceneBvh.Report() + "\n").c_str());
+	::OutputDebugStringA((mPickMeshes.Report() + "\n").c_str());
+	::OutputDebugStringA((mResolutionScaler.Report() + "\n").c_str());
+	std::string probe = "Environment probe: " + std::to_string(mProbeFacesRendered) + " faces rendered, " +
+		std::to_string(mProbeFacesSkipped) + " unchanged\n";
+	::OutputDebugStringA(probe.c_str());
+
+	// Latenza input -> submit, campionando l'input in Update e nel late latch.
+	::OutputDebugStringA((mInputLatency.Report("Input to submit (sampled in Update)") + "\n").c_str());
+	::OutputDebugStringA((mLatchedInputLatency.Report("Input to submit (late latched)") + "\n").c_str());
+
+	// Anche la shadow map  una placed resource.
+	mShadowMap.reset();
+	mEnvironmentProbe.reset();
+
+	// Le texture sono placed resource: vanno rilasciate prima di restituire il loro spazio.
+	for (auto& tex : mTextures)
+		mStateTracker.Unregister(tex.second->Resource.Get());
+	mTextures.clear();
+	for (auto& allocation : mTextureAllocations)
+		mGpuHeapAllocator->Free(allocation);
 }
 
 bool CameraApp::Initialize()
 {
+	auto startupBegin = std::chrono::high_resolution_clock::now();
+
 	if (!D3DApp::Initialize())
 		return false;
 
+	mPsoCache = std::make_unique<PipelineStateCache>(md3dDevice.Get(), L"PipelineCache");
+
+	// La chiave della cache comprende anche i flag e la versione del compilatore.
+	mShaderCache = std::make_unique<ShaderCache>(L"ShaderCache", d3dUtil::CompileShaderBytecode,
+		d3dUtil::ShaderCompileFlags(), std::to_string(D3D_COMPILER_VERSION));
+
 	// Reset the command list to prep for initialization commands.
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
@@ -176,26 +613,59 @@ bool CameraApp::Initialize()
 	// so we have to query this information.
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	mFpsCam = std::make_unique<FirstPersonCamera>();
-	mTpsCam = std::make_unique<ThirdPersonCamera>();
+	// Un unico buffer di upload, mappato una volta sola, da cui vengono sub-allocati
+	// i dati intermedi di tutti i vertex/index buffer e di tutte le texture.
+	mUploadRing = std::make_unique<UploadRing>(md3dDevice.Get(), mFence.Get(), 32 * 1024 * 1024, &mDeferredReleases);
 
-	// Alza un po' la camera ed imposta le propriet del frustum.
-	mFpsCam->SetPosition(0.0f, 2.0f, 0.0f);
-	mFpsCam->SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	// Limiti di memoria per categoria di risorsa: superarli causa un'eccezione (E_OUTOFMEMORY).
+	mGpuHeapAllocator->SetBudget(GpuHeapCategory::Buffer, 128 * 1024 * 1024);
+	mGpuHeapAllocator->SetBudget(GpuHeapCategory::Texture, 256 * 1024 * 1024);
+	mGpuHeapAllocator->SetBudget(GpuHeapCategory::RenderTarget, 256 * 1024 * 1024);
 
-	// Imposta le propriet del sistema della camera e del frustum.
-	mTpsCam->LookAt(XMFLOAT3{ 0.0f, 2.0f, -15.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
-	mTpsCam->SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	// Un'unica risorsa da cui vengono sub-allocati vertex ed index buffer di tutte le geometrie.
+	mGeometryBuffers = std::make_unique<BufferPool>(*mGpuHeapAllocator, 4 * 1024 * 1024);
+	mStateTracker.Register(mGeometryBuffers->Resource(), D3D12_RESOURCE_STATE_GENERIC_READ);
 
-	LoadTextures();
+	BuildInputBindings(mInput);
+	BuildInputBindings(mReplayInput);
+
+	// I PSO vengono richiesti per primi: i worker della cache li creano (o li caricano
+	// dalla pipeline library) mentre vengono caricate texture e geometrie.
 	BuildRootSignature();
-	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
+	BuildPSOs();
+
+	LoadTextures();
+	BuildDescriptorHeaps();
+
+	ShadowCascadeDesc shadowDesc;
+	mShadowCascades.SetDesc(shadowDesc);
+	mShadowMap = std::make_unique<ShadowMapArray>(md3dDevice.Get(), *mGpuHeapAllocator, mStateTracker,
+		*mSrvHeap, shadowDesc.Resolution, shadowDesc.CascadeCount);
+
+	// Le render target transitorie del grafo vengono create nell'heap dell'executor;
+	// le dimensioni per l'aliasing le fornisce il device.
+	mGraphExecutor = std::make_unique<RenderGraphExecutor>(md3dDevice.Get(), mStateTracker, mDeferredReleases, *mSrvHeap);
+	mRenderGraph.SetSizeQuery(mGraphExecutor->SizeQuery());
+
 	BuildShapeGeometry();
 	BuildMaterials();
 	BuildRenderItems();
+	BuildCollisionBvh();
+	BuildCollisionWorld();
+	BuildSceneBvh();
+	BuildEnvironmentProbe();
+
+	ResetSimulation();
+
+	BuildShadowCasters();
+	BuildClusteredLights();
+	BuildLighting();
 	BuildFrameResources();
-	BuildPSOs();
+
+	// Le ultime transizioni degli upload (verso GENERIC_READ/PIXEL_SHADER_RESOURCE)
+	// sono ancora in sospeso nel tracker.
+	mStateTracker.FlushBarriers(mCommandList.Get());
 
 	// Execute the initialization commands.
 	ThrowIfFailed(mCommandList->Close());
@@ -205,6 +675,28 @@ bool CameraApp::Initialize()
 	// Wait until initialization is complete.
 	FlushCommandQueue();
 
+	LogMemoryUsage(L"after initialization, staging still referenced");
+
+	// I dati intermedi di inizializzazione non servono pi: restituisce lo spazio al ring
+	// e rilascia le eventuali risorse di upload dedicate.
+	mUploadRing->FinishFrame(mCurrentFence);
+	mUploadRing->ReleaseCompleted(mFence->GetCompletedValue());
+	mDeferredReleases.FinishFrame(mCurrentFence);
+	mDeferredReleases.ReleaseCompleted(mFence->GetCompletedValue());
+	mSrvHeap->FinishFrame(mCurrentFence);
+	mSrvHeap->ReleaseCompleted(mFence->GetCompletedValue());
+
+	LogMemoryUsage(L"after initialization, staging released");
+
+	// Tempo di avvio e statistiche della cache (i PSO ancora in creazione risultano pending).
+	double startupMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupBegin).count();
+	std::wstring startup = L"Startup: " + std::to_wstring(startupMs) + L" ms\n";
+	::OutputDebugString(startup.c_str());
+	mPsoCache->LogStats();
+	::OutputDebugStringA((mShaderCache->Report() + "\n").c_str());
+	std::string variants = "Default.hlsl: " + std::to_string(mDefaultShaders->VariantCount()) + " shader variants\n";
+	::OutputDebugStringA(variants.c_str());
+
 	return true;
 }
 
@@ -212,15 +704,26 @@ void CameraApp::OnResize()
 {
 	D3DApp::OnResize();
 
-	if (mFpsCam != nullptr)
-		mFpsCam->SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-	if (mTpsCam != nullptr)
-		mTpsCam->SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	mResolutionScaler.ScaledSize(mClientWidth, mClientHeight, mRenderWidth, mRenderHeight);
+	SetCameraLenses();
 }
 
 void CameraApp::Update(const GameTimer& gt)
 {
-	OnKeyboardInput(gt);
+	BeginPlaybackFrame(gt);
+
+	mInputSampleTime = LatencyStats::Clock::now();
+	ApplyInput();
+	mFrameInputTime = mCameraInputTime;
+
+	// Passi della simulazione maturati dal frame precedente (anche nessuno), poi lo stato
+	// mostrato in questo frame. Riproducendo l'input il tempo trascorso  quello registrato.
+	float deltaTime = mPlayback == PlaybackMode::Input ? mRecording.GetFrame(mPlaybackFrame).DeltaTime : gt.DeltaTime();
+	uint32_t steps = mFixedStep.Advance(deltaTime);
+	for (uint32_t i = 0; i < steps; ++i)
+		SimulateStep(steps - i);
+	InterpolateSimState(mFixedStep.Alpha());
+	UpdateSpringArm(deltaTime);
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -236,11 +739,22 @@ void CameraApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	mUploadRing->ReleaseCompleted(mFence->GetCompletedValue());
+	mDeferredReleases.ReleaseCompleted(mFence->GetCompletedValue());
+	mSrvHeap->ReleaseCompleted(mFence->GetCompletedValue());
+
+	UpdateResolutionScale(gt);
+	UpdateViews();
 	AnimateMaterials(gt);
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	//UpdateMaterialBuffer(gt);
+	UpdateClusteredLights(gt);
+	UpdateShadowCascades(gt);
 	UpdateMainPassCB(gt);
+	UpdateLightingCB();
+	CullViews();
+	UpdateEnvironmentProbe();
 }
 
 void CameraApp::Draw(const GameTimer& gt)
@@ -253,50 +767,250 @@ void CameraApp::Draw(const GameTimer& gt)
 
 	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 	// Reusing the command list reuses memory.
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
+	// Attesa esplicita: al primo frame il PSO potrebbe essere ancora in creazione.
+	ID3D12PipelineState* opaquePso = mPsoCache->Wait(mPSOs["opaque"]);
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), opaquePso));
 
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvHeap->Heap() };
+	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	// Clear the back buffer and depth buffer.
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
 
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	// Il frame  descritto da un grafo di pass che dichiarano cosa leggono e cosa scrivono:
+	// ordine dei pass, barriere e memoria delle render target transitorie sono ricavati
+	// dal grafo. Back buffer e depth buffer appartengono a D3DApp e vengono importati.
+	mRenderGraph.Reset();
+	RGHandle backBuffer = mRenderGraph.ImportTexture("BackBuffer", RGState::Present, RGState::Present);
+	RGHandle depthBuffer = mRenderGraph.ImportTexture("DepthBuffer", RGState::DepthWrite, RGState::DepthWrite);
+	RGHandle shadowMap = mRenderGraph.ImportTexture("ShadowMap", RGState::ShaderResource, RGState::ShaderResource);
+	RGHandle environmentProbe = mRenderGraph.ImportTexture("EnvironmentProbe", RGState::ShaderResource, RGState::ShaderResource);
+	RGHandle probeDepth = mRenderGraph.ImportTexture("ProbeDepth", RGState::DepthWrite, RGState::DepthWrite);
+
+	// Solo le cascate da aggiornare: le altre tengono la profondit dei frame precedenti.
+	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+	for (UINT i = 0; mShadowsEnabled && i < mShadowCascades.CascadeCount(); ++i)
+	{
+		if (!mShadowCascades.Cascade(i).NeedsRender)
+			continue;
+
+		mRenderGraph.AddPass("ShadowCascade" + std::to_string(i),
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.Write(shadowMap, RGState::DepthWrite);
+			},
+			[this, i, passCBByteSize]()
+			{
+				D3D12_VIEWPORT viewport = mShadowMap->Viewport();
+				D3D12_RECT scissorRect = mShadowMap->ScissorRect();
+				mCommandList->RSSetViewports(1, &viewport);
+				mCommandList->RSSetScissorRects(1, &scissorRect);
+
+				// Nessuna render target: solo profondit.
+				D3D12_CPU_DESCRIPTOR_HANDLE dsv = mShadowMap->Dsv(i);
+				mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+				mCommandList->OMSetRenderTargets(0, nullptr, false, &dsv);
+
+				mCommandList->SetPipelineState(mPsoCache->Wait(mPSOs["shadow"]));
+
+				// Il pass CB 1 + i contiene la view-projection della cascata.
+				auto passCB = mCurrFrameResource->PassCB->Resource();
+				mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + (1 + i) * passCBByteSize);
+
+				DrawShadowCasters(mCommandList.Get(), mShadowCascades.Cascade(i).Casters);
+			});
+	}
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	// Solo le facce della sonda il cui contenuto  cambiato: le altre tengono la cattura
+	// precedente.
+	if (std::find(std::begin(mProbeFaceNeedsRender), std::end(mProbeFaceNeedsRender), true) != std::end(mProbeFaceNeedsRender))
+	{
+		mRenderGraph.AddPass("ProbeCapture",
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.Write(environmentProbe, RGState::RenderTarget);
+				builder.Write(probeDepth, RGState::DepthWrite);
+				if (mShadowsEnabled)
+					builder.Read(shadowMap, RGState::ShaderResource);
+			},
+			[this, passCBByteSize]()
+			{
+				D3D12_VIEWPORT viewport = mEnvironmentProbe->Viewport();
+				D3D12_RECT scissorRect = mEnvironmentProbe->ScissorRect();
+				mCommandList->RSSetViewports(1, &viewport);
+				mCommandList->RSSetScissorRects(1, &scissorRect);
+
+				BindLightingResources(mCommandList.Get());
+
+				auto passCB = mCurrFrameResource->PassCB->Resource();
+				D3D12_CPU_DESCRIPTOR_HANDLE dsv = mEnvironmentProbe->Dsv();
+				for (UINT f = 0; f < CubeCamera::FaceCount; ++f)
+				{
+					if (!mProbeFaceNeedsRender[f])
+						continue;
+
+					// Le facce sono disegnate una dopo l'altra con lo stesso depth buffer.
+					D3D12_CPU_DESCRIPTOR_HANDLE rtv = mEnvironmentProbe->Rtv(f);
+					mCommandList->ClearRenderTargetView(rtv, Colors::LightSteelBlue, 0, nullptr);
+					mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+					mCommandList->OMSetRenderTargets(1, &rtv, true, &dsv);
+
+					const RenderView& view = mProbeViews[f];
+					mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + view.PassCBIndex * passCBByteSize);
+					DrawRenderItems(mCommandList.Get(), view);
+				}
+			});
+	}
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	if (mDepthPrepassEnabled)
+	{
+		mRenderGraph.AddPass("DepthPrepass",
+			[&](RenderGraph::PassBuilder& builder)
+			{
+				builder.Write(depthBuffer, RGState::DepthWrite);
+			},
+			[this, depthBuffer, passCBByteSize]()
+			{
+				D3D12_CPU_DESCRIPTOR_HANDLE dsv = mGraphExecutor->Dsv(depthBuffer);
+				mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+				mCommandList->OMSetRenderTargets(0, nullptr, false, &dsv);
+
+				mCommandList->SetPipelineState(mPsoCache->Wait(mPSOs["depthPrepass"]));
+
+				auto passCB = mCurrFrameResource->PassCB->Resource();
+				for (size_t v = 0; v < mViews.size(); ++v)
+				{
+					const RenderView& view = mViews[v];
+					mCommandList->RSSetViewports(1, &view.Viewport);
+					mCommandList->RSSetScissorRects(1, &view.ScissorRect);
+
+					// Il riquadro del picture-in-picture copre la vista disegnata prima.
+					if (v > 0)
+						mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 1, &view.ScissorRect);
+
+					mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + view.PassCBIndex * passCBByteSize);
+					DrawDepthPrepass(mCommandList.Get(), view);
+				}
+			});
+	}
 
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	//mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+	// Le viste vengono disegnate in SceneColor, sulla regione ridotta scelta da
+	// mResolutionScaler; il depth buffer di D3DApp viene usato sulla stessa regione.
+	RGTextureDesc sceneColorDesc;
+	sceneColorDesc.Width = (uint32_t)mClientWidth;
+	sceneColorDesc.Height = (uint32_t)mClientHeight;
+	sceneColorDesc.Format = (uint32_t)mBackBufferFormat;
+	XMStoreFloat4((XMFLOAT4*)sceneColorDesc.ClearColor, Colors::LightSteelBlue);
+
+	RGHandle sceneColor = RGInvalidHandle;
+	mRenderGraph.AddPass("Opaque",
+		[&](RenderGraph::PassBuilder& builder)
+		{
+			sceneColor = builder.Create("SceneColor", sceneColorDesc);
+			builder.Write(depthBuffer, RGState::DepthWrite);
+			if (mShadowsEnabled)
+				builder.Read(shadowMap, RGState::ShaderResource);
+			builder.Read(environmentProbe, RGState::ShaderResource);
+		},
+		[this, &sceneColor, depthBuffer, passCBByteSize]()
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE rtv = mGraphExecutor->Rtv(sceneColor);
+			D3D12_CPU_DESCRIPTOR_HANDLE dsv = mGraphExecutor->Dsv(depthBuffer);
+
+			// Clear the scene color and depth buffer.
+			// Con il pre-pass la profondit  gi quella finale e non va cancellata.
+			mCommandList->ClearRenderTargetView(rtv, Colors::LightSteelBlue, 0, nullptr);
+			if (!mDepthPrepassEnabled)
+				mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+
+			// Specify the buffers we are going to render to.
+			mCommandList->OMSetRenderTargets(1, &rtv, true, &dsv);
+
+			BindLightingResources(mCommandList.Get());
+
+			// Una vista dopo l'altra, ciascuna con la sua regione, il suo pass CB e i suoi
+			// oggetti; gli object CB sono condivisi. I pass delle ombre hanno lasciato
+			// viewport e scissor della shadow map.
+			auto passCB = mCurrFrameResource->PassCB->Resource();
+			for (size_t v = 0; v < mViews.size(); ++v)
+			{
+				const RenderView& view = mViews[v];
+				mCommandList->RSSetViewports(1, &view.Viewport);
+				mCommandList->RSSetScissorRects(1, &view.ScissorRect);
+
+				// Il riquadro del picture-in-picture copre la vista disegnata prima.
+				if (v > 0)
+				{
+					mCommandList->ClearRenderTargetView(rtv, Colors::LightSteelBlue, 1, &view.ScissorRect);
+					if (!mDepthPrepassEnabled)
+						mCommandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 1, &view.ScissorRect);
+				}
+
+				mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + view.PassCBIndex * passCBByteSize);
+				DrawRenderItems(mCommandList.Get(), view);
+			}
+		});
+
+	// Un triangolo che copre il back buffer campiona la regione disegnata di SceneColor,
+	// la cui dimensione arriva dal pass CB 0.
+	mRenderGraph.AddPass("Upscale",
+		[&](RenderGraph::PassBuilder& builder)
+		{
+			builder.Read(sceneColor, RGState::ShaderResource);
+			builder.Write(backBuffer, RGState::RenderTarget);
+		},
+		[this, sceneColor, backBuffer]()
+		{
+			mCommandList->RSSetViewports(1, &mScreenViewport);
+			mCommandList->RSSetScissorRects(1, &mScissorRect);
 
-	// Bind all the materials used in this scene.  For structured buffers, we can bypass the heap and 
-	// set as a root descriptor.
-	//auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-	//mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+			D3D12_CPU_DESCRIPTOR_HANDLE rtv = mGraphExecutor->Rtv(backBuffer);
+			mCommandList->OMSetRenderTargets(1, &rtv, true, nullptr);
 
-	// Bind all the textures used in this scene.  Observe
-	// that we only have to specify the first descriptor in the table.  
-	// The root signature knows how many descriptors are expected in the table.
-	//mCommandList->SetGraphicsRootDescriptorTable(3, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+			mCommandList->SetPipelineState(mPsoCache->Wait(mPSOs["upscale"]));
+			mCommandList->SetGraphicsRootDescriptorTable(0, mGraphExecutor->Srv(sceneColor));
+			mCommandList->SetGraphicsRootConstantBufferView(2, mCurrFrameResource->PassCB->Resource()->GetGPUVirtualAddress());
 
-	DrawRenderItems(mCommandList.Get(), mOpaqueRitems);
+			mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			mCommandList->DrawInstanced(3, 1, 0, 0);
+		});
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	mRenderGraph.Compile();
+
+	// Le risorse transitorie vanno create (o riprese dal frame precedente) prima di
+	// associare quelle importate, che possono occuparne gli slot.
+	mGraphExecutor->Prepare(mRenderGraph);
+	mGraphExecutor->BindImported(backBuffer, CurrentBackBuffer(), CurrentBackBufferView());
+	mGraphExecutor->BindImported(depthBuffer, mDepthStencilBuffer.Get(), {}, DepthStencilView());
+	mGraphExecutor->BindImported(shadowMap, mShadowMap->Resource());
+	mGraphExecutor->BindImported(environmentProbe, mEnvironmentProbe->Resource());
+	mGraphExecutor->BindImported(probeDepth, mEnvironmentProbe->DepthResource(), {}, mEnvironmentProbe->Dsv());
+
+	// Le transizioni (compresa quella finale verso PRESENT) passano dal tracker.
+	mGraphExecutor->Execute(mRenderGraph, mCommandList.Get());
 
 	// Done recording commands.
 	ThrowIfFailed(mCommandList->Close());
 
+	// La GPU non ha ancora letto nulla di questo frame: la camera pu essere ricampionata
+	// fino all'ultimo istante. Riproducendo l'input il latch c' se c'era nella registrazione;
+	// gli stati della camera registrati non hanno nulla da ricampionare.
+	bool latch = false;
+	if (mPlayback == PlaybackMode::Live)
+		latch = mLateLatchEnabled;
+	else if (mPlayback == PlaybackMode::Input)
+		latch = PlaybackSampleLeft();
+
+	if (latch)
+		LatchCamera();
+
+	LatencyStats::Clock::time_point submitTime = LatencyStats::Clock::now();
+	mInputLatency.Add(mInputSampleTime, submitTime);
+	if (latch)
+		mLatchedInputLatency.Add(mLatchSampleTime, submitTime);
+
 	// Add the command list to the queue for execution.
 	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
@@ -312,14 +1026,22 @@ void CameraApp::Draw(const GameTimer& gt)
 	// Because we are on the GPU timeline, the new fence point won't be 
 	// set until the GPU finishes processing all the commands prior to this Signal().
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+
+	// Eventuali upload registrati in questo frame vengono recuperati al raggiungimento del fence.
+	mUploadRing->FinishFrame(mCurrentFence);
+	mDeferredReleases.FinishFrame(mCurrentFence);
+	mSrvHeap->FinishFrame(mCurrentFence);
+
+	EndPlaybackFrame();
 }
 
 void CameraApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
-	mLastMousePos.x = x;
-	mLastMousePos.y = y;
-
+	// Il trascinamento continua anche fuori dalla finestra.
 	SetCapture(mhMainWnd);
+
+	if ((btnState & MK_MBUTTON) != 0)
+		Pick(x, y);
 }
 
 void CameraApp::OnMouseUp(WPARAM btnState, int x, int y)
@@ -327,275 +1049,1099 @@ void CameraApp::OnMouseUp(WPARAM btnState, int x, int y)
 	ReleaseCapture();
 }
 
-void CameraApp::OnMouseMove(WPARAM btnState, int x, int y)
+void CameraApp::BuildInputBindings(InputSystem& input)
 {
-	if ((btnState & MK_LBUTTON) != 0)
-	{
-		// Ogni pixel corrisponde ad 1/4 di grado.
-		float dx = XMConvertToRadians(0.25f * static_cast<float>(x - mLastMousePos.x));
-		float dy = XMConvertToRadians(0.25f * static_cast<float>(y - mLastMousePos.y));
+	// Velocit in unit al secondo: il valore dell'azione  la distanza percorsa nel frame.
+	input.BindKey(ActionWalk, 'W', 10.0f);
+	input.BindKey(ActionWalk, 'S', -10.0f);
+	input.BindKey(ActionStrafe, 'D', 10.0f);
+	input.BindKey(ActionStrafe, 'A', -10.0f);
+
+	// Con il tasto sinistro ogni pixel corrisponde ad 1/4 di grado.
+	input.BindMouseAxis(ActionPitch, MouseAxis::Y, InputSystem::MouseLeft, XMConvertToRadians(0.25f));
+	input.BindMouseAxis(ActionYaw, MouseAxis::X, InputSystem::MouseLeft, XMConvertToRadians(0.25f));
+
+	// Con il destro ogni pixel corrisponde a 0.03 unit nello spazio World; la rotella
+	// avvicina la camera di un'unit per scatto.
+	input.BindMouseAxis(ActionZoom, MouseAxis::X, InputSystem::MouseRight, 0.03f);
+	input.BindMouseAxis(ActionZoom, MouseAxis::Y, InputSystem::MouseRight, -0.03f);
+	input.BindWheel(ActionZoom, -1.0f);
+
+	input.BindKey(ActionFirstPersonCamera, '1');
+	input.BindKey(ActionThirdPersonCamera, '3');
+
+	input.BindKey(ActionFogOn, 'F');
+	input.BindKey(ActionFogOff, 'G');
+	input.BindKey(ActionClusteredLightsOn, 'L');
+	input.BindKey(ActionClusteredLightsOff, 'K');
+	input.BindKey(ActionShadowsOn, 'O');
+	input.BindKey(ActionShadowsOff, 'P');
+	input.BindKey(ActionDepthPrepassOn, 'Z');
+	input.BindKey(ActionDepthPrepassOff, 'X');
+	input.BindKey(ActionLateLatchOn, 'B');
+	input.BindKey(ActionLateLatchOff, 'N');
+
+	input.BindKey(ActionRecord, 'R');
+	input.BindKey(ActionReplayInput, 'T');
+	input.BindKey(ActionReplayCamera, 'Y');
+	input.BindKey(ActionFlythrough, 'U');
+
+	input.BindKey(ActionSpringArmOn, 'C');
+	input.BindKey(ActionSpringArmOff, 'V');
+
+	input.BindKey(ActionNextViewLayout, 'M');
+
+	input.BindKey(ActionDynamicResolutionOn, 'H');
+	input.BindKey(ActionDynamicResolutionOff, 'J');
+}
+
+void CameraApp::ApplyInput()
+{
+	const InputSystem* cameraInput = SampleInput();
 
-		if (mUseFpsCamera)
+	// Tasti premuti da questo campionamento o da quello del latch del frame precedente.
+	uint32_t pressed = PressedActions(mInput) | mLatchedActions;
+	uint32_t cameraPressed = (cameraInput ? PressedActions(*cameraInput) : 0) | mLatchedCameraActions;
+	mLatchedActions = 0;
+	mLatchedCameraActions = 0;
+
+	// R avvia/ferma la registrazione, T/Y/U una riproduzione; durante una riproduzione
+	// ciascuno di essi la interrompe.
+	for (CameraAction action : { ActionRecord, ActionReplayInput, ActionReplayCamera, ActionFlythrough })
+	{
+		if (HasAction(pressed, action))
 		{
-			mFpsCam->Pitch(dy);
-			mFpsCam->RotateY(dx);
+			mPlaybackCommandPending = true;
+			mPlaybackCommand = action;
 		}
+	}
+
+	// Nebbia: F la attiva, G la disattiva. Cambia la chiave del pass, quindi la variante.
+	if (HasAction(pressed, ActionFogOn))
+		mFogEnabled = true;
+
+	if (HasAction(pressed, ActionFogOff))
+		mFogEnabled = false;
+
+	// Luci assegnate ai cluster: L le attiva, K le disattiva.
+	if (HasAction(pressed, ActionClusteredLightsOn))
+		mClusteredLightsEnabled = true;
+
+	if (HasAction(pressed, ActionClusteredLightsOff))
+		mClusteredLightsEnabled = false;
+
+	// Ombre: O le attiva, P le disattiva.
+	if (HasAction(pressed, ActionShadowsOn))
+		mShadowsEnabled = true;
+
+	if (HasAction(pressed, ActionShadowsOff))
+		mShadowsEnabled = false;
+
+	// Depth pre-pass: Z lo attiva, X lo disattiva.
+	if (HasAction(pressed, ActionDepthPrepassOn))
+		mDepthPrepassEnabled = true;
+
+	if (HasAction(pressed, ActionDepthPrepassOff))
+		mDepthPrepassEnabled = false;
+
+	// Late latch della camera: B lo attiva, N lo disattiva.
+	if (HasAction(pressed, ActionLateLatchOn))
+		mLateLatchEnabled = true;
+
+	if (HasAction(pressed, ActionLateLatchOff))
+		mLateLatchEnabled = false;
+
+	// Collisioni del braccio della camera in terza persona: C le attiva, V le disattiva.
+	if (HasAction(pressed, ActionSpringArmOn))
+		mSpringArmEnabled = true;
+
+	if (HasAction(pressed, ActionSpringArmOff))
+		mSpringArmEnabled = false;
+
+	// Risoluzione dinamica: H la attiva, J la disattiva e torna alla risoluzione piena.
+	if (HasAction(pressed, ActionDynamicResolutionOn))
+		mDynamicResolutionEnabled = true;
+
+	if (HasAction(pressed, ActionDynamicResolutionOff))
+	{
+		mDynamicResolutionEnabled = false;
+		mResolutionScaler.Reset();
+	}
+
+	// M passa alla disposizione successiva: vista singola, schermo diviso, picture-in-picture.
+	if (HasAction(pressed, ActionNextViewLayout))
+	{
+		if (mViewLayout == ViewLayout::Single)
+			mViewLayout = ViewLayout::SplitScreen;
+		else if (mViewLayout == ViewLayout::SplitScreen)
+			mViewLayout = ViewLayout::PictureInPicture;
 		else
-		{
-			mTpsCam->Pitch(dy);
-			mTpsCam->RotateY(dx);
-		}
+			mViewLayout = ViewLayout::Single;
+
+		SetCameraLenses();
 	}
-	else if ((btnState & MK_RBUTTON) != 0)
+
+	const ShaderPermutationLayout& layout = mDefaultShaders->Layout();
+	mPassShaderKey = layout.Set(mPassShaderKey, mFogField, mFogEnabled ? 1 : 0);
+	mPassShaderKey = layout.Set(mPassShaderKey, mClusteredLightsField, mClusteredLightsEnabled ? 1 : 0);
+	mPassShaderKey = layout.Set(mPassShaderKey, mShadowsField, mShadowsEnabled ? 1 : 0);
+
+	if (cameraInput == nullptr)
+		return;
+
+	if (HasAction(cameraPressed, ActionFirstPersonCamera))
+		mUseFpsCamera = true;
+
+	if (HasAction(cameraPressed, ActionThirdPersonCamera))
+		mUseFpsCamera = false;
+
+	TurnCamera(*cameraInput);
+}
+
+const InputSystem* CameraApp::SampleInput()
+{
+	// Eventi accumulati dall'ultimo campionamento (frame precedente o late latch).
+	double time = InputSystem::Now();
+	mInput.Update(time);
+
+	// La camera segue l'input registrato al posto di quello dell'utente; le opzioni
+	// restano comandate dall'utente. Nessun input se la camera non  mossa dall'input.
+	mCameraInputTime = time;
+	if (mPlayback == PlaybackMode::Input)
 	{
-		// Ogni pixel corrisponde a 0.03 unit nello spazio World.
-		float dx = 0.03f * static_cast<float>(x - mLastMousePos.x);
-		float dy = 0.03f * static_cast<float>(y - mLastMousePos.y);
+		if (!PlaybackSampleLeft())
+			return nullptr;
+
+		const CameraRecording::Frame& frame = mRecording.GetFrame(mPlaybackFrame);
+		uint32_t sample = frame.FirstSample + mPlaybackSamplesUsed++;
+		mRecording.PushSample(sample, mReplayInput);
+		mCameraInputTime = mRecording.GetSample(sample).Time;
+		mReplayInput.Update(mCameraInputTime);
+		return &mReplayInput;
+	}
 
-		// Aggiorna raggio cos camera pu avvicinarsi o allontanarsi dal target.
-		mTpsCam->AddToRadius(dx - dy);
+	if (mPlayback == PlaybackMode::Camera)
+		return nullptr;
+
+	if (mRecordingActive)
+	{
+		// Il primo campionamento comprende lo stato dell'input all'avvio della registrazione.
+		mRecordingStartEvents.insert(mRecordingStartEvents.end(),
+			mInput.ProcessedEvents().begin(), mInput.ProcessedEvents().end());
+		mRecording.AddSample(time, mRecordingStartEvents);
+		mRecordingStartEvents.clear();
+	}
+
+	return &mInput;
+}
+
+void CameraApp::TurnCamera(const InputSystem& input)
+{
+	// Movimenti del mouse nell'intervallo, gi sommati: l'orientamento cambia una volta
+	// sola per campionamento e subito, senza aspettare la simulazione.
+	float pitch = input.Value(ActionPitch);
+	float yaw = input.Value(ActionYaw);
+	float zoom = input.Value(ActionZoom);
+
+	if (mUseFpsCamera)
+	{
+		if (pitch != 0.0f)
+			mFpsCam->Pitch(pitch);
+		if (yaw != 0.0f)
+			mFpsCam->RotateY(yaw);
+	}
+	else
+	{
+		if (pitch != 0.0f)
+			mTpsCam->Pitch(pitch);
+		if (yaw != 0.0f)
+			mTpsCam->RotateY(yaw);
+	}
+
+	// Aggiorna raggio cos camera pu avvicinarsi o allontanarsi dal target.
+	if (zoom != 0.0f)
+		mTpsCam->AddToRadius(zoom);
+
+	// Lo spostamento (tempo per cui i tasti sono rimasti premuti per la velocit) viene
+	// accumulato e consumato dai passi della simulazione.
+	mPendingWalk += input.Value(ActionWalk);
+	mPendingStrafe += input.Value(ActionStrafe);
+}
+
+void CameraApp::SimulateStep(uint32_t remainingSteps)
+{
+	// Lo stato corrente diventa il precedente.
+	mPrevSimPosition = mSimPosition;
+	for (RenderItem* ri : mSimulatedRitems)
+		ri->PrevSimWorld = ri->SimWorld;
+
+	// Lo spostamento accumulato  diviso tra i passi rimasti in questo frame.
+	float walk = mPendingWalk / remainingSteps;
+	float strafe = mPendingStrafe / remainingSteps;
+	mPendingWalk -= walk;
+	mPendingStrafe -= strafe;
+
+	// Il passo parte dallo stato simulato, non da quello interpolato mostrato a video.
+	PlaceCameras(mSimPosition);
+
+	XMFLOAT3 movedPos;
+	float height;
+
+	if (mUseFpsCamera)
+	{
+		if (walk != 0.0f)
+			mFpsCam->Walk(walk);
+		if (strafe != 0.0f)
+			mFpsCam->Strafe(strafe);
+
+		movedPos = mFpsCam->GetPosition3f();
+		height = 2.0f;
+	}
+	else
+	{
+		if (walk != 0.0f)
+			mTpsCam->Walk(walk);
+		if (strafe != 0.0f)
+			mTpsCam->Strafe(strafe);
+
+		movedPos = mTpsCam->GetTarget3f();
+		height = 1.0f;
+	}
+
+	// La box si sposta sul pavimento (solo in XZ) fermandosi contro gli oggetti e le pareti
+	// e scivolando lungo di essi; camera/target la seguono, alla propria altezza.
+	float displacement[3] = { movedPos.x - mSimPosition.x, 0.0f, movedPos.z - mSimPosition.z };
+	if (displacement[0] != 0.0f || displacement[2] != 0.0f)
+		mCollisionWorld.Move(mPlayerBody, displacement);
+
+	float boxCenter[3];
+	mCollisionWorld.GetPosition(mPlayerBody, boxCenter);
+	mSimPosition = { boxCenter[0], height, boxCenter[2] };
+
+	XMStoreFloat4x4(
+		&mBoxRItem->SimWorld,
+		XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(boxCenter[0], boxCenter[1], boxCenter[2]));
+}
+
+void CameraApp::InterpolateSimState(float alpha)
+{
+	XMFLOAT3 position;
+	XMStoreFloat3(&position, XMVectorLerp(XMLoadFloat3(&mPrevSimPosition), XMLoadFloat3(&mSimPosition), alpha));
+	PlaceCameras(position);
+
+	for (RenderItem* ri : mSimulatedRitems)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, MathHelper::InterpolateTransform(
+			XMLoadFloat4x4(&ri->PrevSimWorld), XMLoadFloat4x4(&ri->SimWorld), alpha));
+
+		// Oggetti fermi: niente upload.
+		if (memcmp(&world, &ri->World, sizeof(world)) != 0)
+		{
+			ri->World = world;
+			ri->NumFramesDirty = gNumFrameResources;
+		}
 	}
 
 	if (mUseFpsCamera)
 		mFpsCam->UpdateViewMatrix();
 	else
 		mTpsCam->UpdateViewMatrix();
+}
+
+void CameraApp::PlaceCameras(const XMFLOAT3& position)
+{
+	// Aggiorna, nella classe della camera, la posizione di camera/target a quella della box.
+	// Solo se  cambiata: altrimenti la view verrebbe ricostruita anche a camera ferma.
+	XMVECTOR p = XMLoadFloat3(&position);
+	if (!XMVector3Equal(mFpsCam->GetPosition(), p))
+		mFpsCam->SetPosition(position);
+	if (!XMVector3Equal(mTpsCam->GetTarget(), p))
+		mTpsCam->SetTarget3f(position);
+}
+
+void CameraApp::UpdateSpringArm(float deltaTime)
+{
+	// Con pi viste la camera in terza persona pu essere visibile anche se non  attiva.
+	if (mUseFpsCamera && mViewLayout == ViewLayout::Single)
+		return;
+
+	float radius = mTpsCam->GetRadius();
+	float arm = std::min<float>(mTpsCam->GetArmLength(), radius);
+
+	// Sfera che contiene il near plane: la camera si ferma prima che l'oggetto lo tagli.
+	float nearWidth = mTpsCam->GetNearWindowWidth();
+	float nearHeight = mTpsCam->GetNearWindowHeight();
+	float probeRadius = 0.5f * sqrtf(nearWidth * nearWidth + nearHeight * nearHeight);
+
+	// Dal target verso la posizione voluta della camera.
+	float desired = radius;
+	if (mSpringArmEnabled)
+	{
+		XMFLOAT3 target = mTpsCam->GetTarget3f();
+		XMFLOAT3 direction = mTpsCam->GetArmDirection3f();
+
+		BoundsBvh::Hit hit;
+		if (mCollisionBvh.SphereCast(&target.x, &direction.x, radius, probeRadius, hit))
+			desired = hit.Distance;
+	}
+
+	// Si accorcia subito (un oggetto non deve mai coprire il target) e si riallunga
+	// gradualmente, con un avvicinamento esponenziale indipendente dal frame rate.
+	if (desired < arm)
+		arm = desired;
+	else
+		arm += (desired - arm) * (1.0f - expf(-gSpringArmReturnRate * deltaTime));
+
+	if (desired - arm < 0.001f)
+		arm = desired;
+
+	mTpsCam->SetArmLength(arm);
+	mTpsCam->UpdateViewMatrix();
+}
+
+void CameraApp::LatchCamera()
+{
+	mLatchSampleTime = LatencyStats::Clock::now();
+
+	// Durante un trascinamento (capture attiva) la posizione del cursore  letta direttamente:
+	// il WM_MOUSEMOVE corrispondente arriver solo al prossimo giro del message loop, e la
+	// sua differenza da questa posizione sar nulla.
+	if (GetCapture() == mhMainWnd)
+	{
+		POINT cursor;
+		if (GetCursorPos(&cursor) && ScreenToClient(mhMainWnd, &cursor))
+			mInput.PushMouseMove(cursor.x, cursor.y, InputSystem::Now());
+	}
+
+	// Solo il movimento della camera: le azioni cambiano chiavi dei pass, viste e
+	// risoluzione, gi usate dalla command list, e vengono eseguite nel prossimo Update.
+	const InputSystem* cameraInput = SampleInput();
+	mLatchedActions |= PressedActions(mInput);
+	if (cameraInput != nullptr)
+	{
+		mLatchedCameraActions |= PressedActions(*cameraInput);
+		TurnCamera(*cameraInput);
+	}
+
+	// L'orientamento  quello appena campionato; la posizione  interpolata all'istante
+	// del campionamento, pi vicina allo stato simulato pi recente.
+	double sinceUpdate = mCameraInputTime - mFrameInputTime;
+	InterpolateSimState(mFixedStep.Alpha(sinceUpdate));
+
+	// Il braccio pu solo accorciarsi: il ritorno  gi avanzato in Update.
+	UpdateSpringArm(0.0f);
+
+	// Solo le camere vengono corrette: culling, ordinamento, cluster delle luci e cascate
+	// restano quelli calcolati in Update, uno spostamento di pochi millisecondi prima.
+	UpdateSecondaryPassCBs();
+
+	const Camera* camera = ActiveCamera();
+	if (camera == mPassCamera && camera->GetVersion() == mPassCameraVersion)
+		return;
+
+	StorePassCamera(camera);
+	mCurrFrameResource->PassCB->CopyData(0, 0, &mMainPassCB, offsetof(PassConstants, cbPerObjectPad1));
+
+	// Gli oggetti mossi dalla simulazione seguono la stessa interpolazione.
+	for (RenderItem* ri : mSimulatedRitems)
+		WriteObjectCB(ri);
+}
+
+void CameraApp::ResetSimulation()
+{
+	// Camere ricreate da zero, come all'avvio: registrazione e riproduzione partono dallo
+	// stesso stato.
+	mFpsCam = std::make_unique<FirstPersonCamera>();
+	mTpsCam = std::make_unique<ThirdPersonCamera>();
+
+	// Alza un po' la camera.
+	mFpsCam->SetPosition(0.0f, 2.0f, 0.0f);
+
+	// Imposta le propriet del sistema della camera.
+	mTpsCam->LookAt(XMFLOAT3{ 0.0f, 2.0f, -15.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+
+	// Il frustum dipende anche dalla disposizione delle viste.
+	SetCameraLenses();
+
+	mPassCamera = nullptr;
+	mFixedStep.Reset();
+	mPendingWalk = 0.0f;
+	mPendingStrafe = 0.0f;
+	mLatchedCameraActions = 0;
+
+	// Stato iniziale della simulazione: un passo senza movimento porta camera/target e box
+	// sul pavimento, e diventa anche lo stato precedente.
+	mSimPosition = mUseFpsCamera ? mFpsCam->GetPosition3f() : mTpsCam->GetTarget3f();
+	float boxCenter[3] = { mSimPosition.x, 1.0f, mSimPosition.z };
+	mCollisionWorld.SetPosition(mPlayerBody, boxCenter);
+	SimulateStep(1);
+	mPrevSimPosition = mSimPosition;
+	for (RenderItem* ri : mSimulatedRitems)
+		ri->PrevSimWorld = ri->SimWorld;
+}
+
+void CameraApp::BeginPlaybackFrame(const GameTimer& gt)
+{
+	if (mPlaybackCommandPending)
+	{
+		mPlaybackCommandPending = false;
+
+		if (mPlayback != PlaybackMode::Live)
+		{
+			StopPlayback();
+		}
+		else if (mPlaybackCommand == ActionRecord && mRecordingActive)
+		{
+			mRecordingActive = false;
+			if (!mRecording.Save(gRecordingFile))
+				::OutputDebugStringW((std::wstring(L"Cannot write ") + gRecordingFile + L"\n").c_str());
+		}
+		else if (mPlaybackCommand == ActionRecord)
+		{
+			// Tasti e pulsanti gi premuti e posizione del cursore entrano nel primo
+			// campionamento: la riproduzione parte da nessun tasto premuto.
+			mRecordingStartEvents = mInput.HeldStateEvents();
+			ResetSimulation();
+			mRecording.Clear();
+			mRecording.SetFlags(mUseFpsCamera ? 1u : 0u);
+			mRecordingActive = true;
+		}
+		else if (!mRecordingActive)
+		{
+			StartPlayback(mPlaybackCommand);
+		}
+	}
+
+	mPlaybackSamplesUsed = 0;
+
+	if (mRecordingActive)
+	{
+		mRecording.BeginFrame(gt.DeltaTime());
+	}
+	else if (mPlayback == PlaybackMode::Camera)
+	{
+		// La proiezione segue la finestra attuale, il resto  quello registrato.
+		const CameraState& state = mRecording.GetFrame(mPlaybackFrame).Camera;
+		XMFLOAT3 position(state.Position);
+		XMFLOAT3 target(state.Position[0] + state.Look[0], state.Position[1] + state.Look[1], state.Position[2] + state.Look[2]);
+		XMFLOAT3 up(state.Up);
+
+		mPlaybackCam.LookAt(position, target, up);
+		mPlaybackCam.SetLens(state.FovY, AspectRatio(), state.NearZ, state.FarZ);
+		mPlaybackCam.UpdateViewMatrix();
+	}
+}
+
+void CameraApp::EndPlaybackFrame()
+{
+	if (mRecordingActive)
+	{
+		mRecording.EndFrame(GetCameraState(*ActiveCamera()));
+		return;
+	}
+
+	if (mPlayback == PlaybackMode::Live)
+		return;
+
+	// Il primo intervallo comprenderebbe l'avvio della riproduzione.
+	LatencyStats::Clock::time_point frameEnd = LatencyStats::Clock::now();
+	if (mPlaybackFrame > 0)
+		mPlaybackFrameTimes.Add(mPlaybackFrameEnd, frameEnd);
+	mPlaybackFrameEnd = frameEnd;
+
+	if (++mPlaybackFrame == mRecording.FrameCount())
+		StopPlayback();
+}
+
+void CameraApp::StartPlayback(CameraAction command)
+{
+	if (command == ActionFlythrough)
+	{
+		// Giro della stanza guardando verso il centro, chiuso sul punto di partenza.
+		const float keys[][7] =
+		{
+			//  t      posizione               target
+			{  0.0f,   0.0f, 3.0f, -13.0f,     0.0f, 1.0f,  0.0f },
+			{  4.0f,   8.0f, 4.0f,  -6.0f,     0.0f, 1.0f,  2.0f },
+			{  8.0f,   7.0f, 6.0f,  10.0f,    -2.0f, 1.0f,  0.0f },
+			{ 12.0f,  -7.0f, 3.0f,  11.0f,     0.0f, 2.0f, -4.0f },
+			{ 16.0f,  -8.0f, 2.0f,  -8.0f,     4.0f, 1.0f,  4.0f },
+			{ 20.0f,   0.0f, 3.0f, -13.0f,     0.0f, 1.0f,  0.0f }
+		};
+
+		CameraPath path;
+		for (const float* key : keys)
+			path.AddKey(key[0], key + 1, key + 4);
+		path.SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+
+		mRecording.Clear();
+		path.Bake((float)gSimulationRate, mRecording);
+		mPlayback = PlaybackMode::Camera;
+	}
+	else
+	{
+		if (!mRecording.Load(gRecordingFile))
+		{
+			::OutputDebugStringW((std::wstring(L"Cannot read ") + gRecordingFile + L"\n").c_str());
+			return;
+		}
+		mPlayback = command == ActionReplayInput ? PlaybackMode::Input : PlaybackMode::Camera;
+	}
+
+	if (mRecording.FrameCount() == 0)
+	{
+		mPlayback = PlaybackMode::Live;
+		return;
+	}
+
+	// L'input registrato riparte dallo stato in cui  iniziata la registrazione, con un
+	// input system nuovo.
+	if (mPlayback == PlaybackMode::Input)
+	{
+		mUseFpsCamera = (mRecording.Flags() & 1u) != 0;
+		ResetSimulation();
+		mReplayInput = InputSystem();
+		BuildInputBindings(mReplayInput);
+	}
+
+	mPlaybackFrame = 0;
+	mPlaybackFrameTimes.Reset();
+	mPassCamera = nullptr;
+}
+
+void CameraApp::StopPlayback()
+{
+	if (mPlayback == PlaybackMode::Live)
+		return;
+
+	::OutputDebugStringA((std::to_string(mPlaybackFrame) + " frames played\n").c_str());
+	::OutputDebugStringA((mPlaybackFrameTimes.Report("Playback frame time") + "\n").c_str());
+
+	mPlayback = PlaybackMode::Live;
+	mPassCamera = nullptr;
+}
+
+bool CameraApp::PlaybackSampleLeft()const
+{
+	return mPlaybackSamplesUsed < mRecording.GetFrame(mPlaybackFrame).SampleCount;
+}
+
+void CameraApp::AnimateMaterials(const GameTimer& gt)
+{
+
+}
+
+void CameraApp::UpdateObjectCBs(const GameTimer& gt)
+{
+	for (auto& e : mAllRitems)
+	{
+		// Only update the cbuffer data if the constants have changed.  
+		// This needs to be tracked per frame resource.
+		if (e->NumFramesDirty > 0)
+		{
+			WriteObjectCB(e.get());
+
+			// Next FrameResource need to be updated too.
+			e->NumFramesDirty--;
+		}
+	}
+}
+
+void CameraApp::WriteObjectCB(const RenderItem* ri)
+{
+	XMMATRIX world = XMLoadFloat4x4(&ri->World);
+	XMMATRIX texTransform = XMLoadFloat4x4(&ri->TexTransform);
+
+	ObjectConstants objConstants;
+	XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+	XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+	//objConstants.MaterialIndex = e->Mat->MatCBIndex;
 
-	mLastMousePos.x = x;
-	mLastMousePos.y = y;
+	mCurrFrameResource->ObjectCB->CopyData(ri->ObjCBIndex, objConstants);
+}
+
+void CameraApp::UpdateMaterialCBs(const GameTimer& gt)
+{
+	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
+	for (auto& e : mMaterials)
+	{
+		// Only update the cbuffer data if the constants have changed.  If the cbuffer
+		// data changes, it needs to be updated for each FrameResource.
+		Material* mat = e.second.get();
+		if (mat->NumFramesDirty > 0)
+		{
+			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+
+			MaterialConstants matConstants;
+			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
+			matConstants.FresnelR0 = mat->FresnelR0;
+			matConstants.Roughness = mat->Roughness;
+			XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+
+			currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+
+			// Next FrameResource need to be updated too.
+			mat->NumFramesDirty--;
+		}
+	}
+}
+
+/*void CameraAndDynamicIndexingApp::UpdateMaterialBuffer(const GameTimer& gt)
+{
+	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
+	for (auto& e : mMaterials)
+	{
+		// Only update the cbuffer data if the constants have changed.  If the cbuffer
+		// data changes, it needs to be updated for each FrameResource.
+		Material* mat = e.second.get();
+		if (mat->NumFramesDirty > 0)
+		{
+			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+
+			MaterialData matData;
+			matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+			matData.FresnelR0 = mat->FresnelR0;
+			matData.Roughness = mat->Roughness;
+			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+
+			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
+
+			// Next FrameResource need to be updated too.
+			mat->NumFramesDirty--;
+		}
+	}
+}*/
+
+void CameraApp::UpdateMainPassCB(const GameTimer& gt)
+{
+	// Le matrici cambiano solo con la camera (o passando all'altra camera); le inverse
+	// le ricava la camera stessa, senza invertire 4x4 generiche.
+	const Camera* camera = ActiveCamera();
+	if (camera != mPassCamera || camera->GetVersion() != mPassCameraVersion)
+		StorePassCamera(camera);
+
+	// La regione di SceneColor in cui vengono disegnate le viste.
+	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mRenderWidth, (float)mRenderHeight);
+	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mRenderWidth, 1.0f / mRenderHeight);
+	mMainPassCB.NearZ = 1.0f;
+	mMainPassCB.FarZ = 1000.0f;
+	mMainPassCB.TotalTime = gt.TotalTime();
+	mMainPassCB.DeltaTime = gt.DeltaTime();
+
+	auto currPassCB = mCurrFrameResource->PassCB.get();
+	currPassCB->CopyData(0, mMainPassCB);
+
+	UpdateSecondaryPassCBs();
+}
+
+void CameraApp::StorePassCamera(const Camera* camera)
+{
+	StoreCameraMatrices(mMainPassCB, *camera);
+
+	mPassCamera = camera;
+	mPassCameraVersion = camera->GetVersion();
+}
+
+void CameraApp::UpdateSecondaryPassCBs()
+{
+	// Cluster delle luci e cascate seguono la camera attiva: le altre viste hanno solo le
+	// luci direzionali, senza ombre (anche la loro chiave dello shader le esclude).
+	for (size_t v = 1; v < mViews.size(); ++v)
+	{
+		PassConstants viewPassCB = mMainPassCB;
+		StoreCameraMatrices(viewPassCB, *mViews[v].Cam);
+		viewPassCB.CascadeCount = 0;
+		mCurrFrameResource->PassCB->CopyData(mViews[v].PassCBIndex, viewPassCB);
+	}
+}
+
+void CameraApp::UpdateResolutionScale(const GameTimer& gt)
+{
+	// Senza timestamp della GPU il tempo misurato  quello tra due frame della CPU: quando
+	// la GPU  in ritardo Update aspetta il fence, quindi il costo dei pixel vi compare.
+	if (mDynamicResolutionEnabled)
+		mResolutionScaler.Update(gt.DeltaTime() * 1000.0);
+
+	mResolutionScaler.ScaledSize(mClientWidth, mClientHeight, mRenderWidth, mRenderHeight);
+}
+
+void CameraApp::UpdateViews()
+{
+	// La prima vista  quella della camera attiva, con il pass CB 0; le altre usano i pass
+	// CB che seguono quelli delle cascate.
+	const ShaderPermutationLayout& layout = mDefaultShaders->Layout();
+	UINT secondaryKey = layout.Set(layout.Set(mPassShaderKey, mClusteredLightsField, 0), mShadowsField, 0);
+
+	// Le viste si dividono la regione di SceneColor disegnata in questo frame.
+	D3D12_VIEWPORT screen = mScreenViewport;
+	screen.Width = (float)mRenderWidth;
+	screen.Height = (float)mRenderHeight;
+
+	mViews.resize(mViewLayout == ViewLayout::Single ? 1 : 2);
+	for (UINT v = 0; v < (UINT)mViews.size(); ++v)
+	{
+		RenderView& view = mViews[v];
+		view.Cam = v == 0 ? ActiveCamera() : InactiveCamera();
+		view.PassCBIndex = v == 0 ? 0 : ShadowCascades::MaxCascades + v;
+		view.ShaderKey = v == 0 ? mPassShaderKey : secondaryKey;
+		view.Viewport = screen;
+	}
+
+	if (mViewLayout == ViewLayout::SplitScreen)
+	{
+		// Met sinistra e met destra: le camere hanno l'aspect ratio dimezzato.
+		float half = 0.5f * screen.Width;
+		mViews[0].Viewport.Width = half;
+		mViews[1].Viewport = mViews[0].Viewport;
+		mViews[1].Viewport.TopLeftX += half;
+	}
+	else if (mViewLayout == ViewLayout::PictureInPicture)
+	{
+		// Un quarto della finestra per lato (stesso aspect ratio), in alto a destra.
+		const float margin = 16.0f * mResolutionScaler.Scale();
+		D3D12_VIEWPORT& inset = mViews[1].Viewport;
+		inset.Width = 0.25f * screen.Width;
+		inset.Height = 0.25f * screen.Height;
+		inset.TopLeftX = screen.TopLeftX + screen.Width - inset.Width - margin;
+		inset.TopLeftY = screen.TopLeftY + margin;
+	}
+
+	for (RenderView& view : mViews)
+	{
+		view.ScissorRect.left = (LONG)view.Viewport.TopLeftX;
+		view.ScissorRect.top = (LONG)view.Viewport.TopLeftY;
+		view.ScissorRect.right = (LONG)(view.Viewport.TopLeftX + view.Viewport.Width);
+		view.ScissorRect.bottom = (LONG)(view.Viewport.TopLeftY + view.Viewport.Height);
+	}
+}
+
+void CameraApp::CullViews()
+{
+	RefitSceneBvh();
+
+	// Una sola visita della BVH per tutte le viste: ogni nodo viene provato insieme contro
+	// i frustum delle viste che ancora lo attraversano.
+	BoundsBvh::Frustum frustums[gMaxViews];
+	for (size_t v = 0; v < mViews.size(); ++v)
+	{
+		const XMFLOAT4* planes = mViews[v].Cam->GetFrustumPlanes();
+		for (int p = 0; p < 6; ++p)
+			std::copy(&planes[p].x, &planes[p].x + 4, frustums[v].Planes[p]);
+	}
+	mSceneBvh.CullFrustums(frustums, (uint32_t)mViews.size(), mVisibleItems);
+
+	for (size_t v = 0; v < mViews.size(); ++v)
+	{
+		RenderView& view = mViews[v];
+		view.Ritems.clear();
+		for (uint32_t item : mVisibleItems[v])
+			view.Ritems.push_back(mSceneRitems[item]);
+
+		SortViewRitems(view);
+	}
 }
 
-void CameraApp::OnKeyboardInput(const GameTimer& gt)
+void CameraApp::UpdateEnvironmentProbe()
 {
-	const float dt = gt.DeltaTime();
+	// Come le viste secondarie, le facce hanno solo le luci direzionali e niente ombre:
+	// cluster delle luci e cascate seguono la camera attiva.
+	const ShaderPermutationLayout& layout = mDefaultShaders->Layout();
+	UINT probeKey = layout.Set(layout.Set(mPassShaderKey, mClusteredLightsField, 0), mShadowsField, 0);
 
-	if (GetAsyncKeyState('1') & 0x8000)
-		mUseFpsCamera = true;
-
-	if (GetAsyncKeyState('3') & 0x8000)
-		mUseFpsCamera = false;
-
-	if (GetAsyncKeyState('W') & 0x8000)
-		if (mUseFpsCamera)
-			mFpsCam->Walk(10.0f * dt);
-		else
-			mTpsCam->Walk(10.0f * dt);
+	// Una sola visita per le sei facce; mSceneBvh  gi stata aggiornata da CullViews.
+	XMFLOAT3 position = mProbeCam.GetPosition3f();
+	mSceneBvh.CullCube(&position.x, mProbeCam.GetNearZ(), mProbeCam.GetFarZ(), mProbeItems);
 
-	if (GetAsyncKeyState('S') & 0x8000)
-		if (mUseFpsCamera)
-			mFpsCam->Walk(-10.0f * dt);
-		else
-			mTpsCam->Walk(-10.0f * dt);
+	for (UINT f = 0; f < CubeCamera::FaceCount; ++f)
+	{
+		RenderView& view = mProbeViews[f];
+		view.ShaderKey = probeKey;
+		view.Ritems.clear();
+
+		// Ci da cui dipende la faccia: chiave dello shader, luci, sonda e oggetti visti,
+		// quelli mossi dalla simulazione con la loro posizione. La sfera che contiene la
+		// sonda non compare nella cattura.
+		Hasher signature;
+		signature.Add(probeKey);
+		signature.Add(mLightingVersion);
+		signature.Add(mProbeCam.GetVersion());
+		for (uint32_t item : mProbeItems[f])
+		{
+			RenderItem* ri = mSceneRitems[item];
+			if (ri == mProbeRItem)
+				continue;
+
+			view.Ritems.push_back(ri);
+			signature.Add(item);
+			if (std::find(mSimulatedRitems.begin(), mSimulatedRitems.end(), ri) != mSimulatedRitems.end())
+				signature.Add(&ri->World, sizeof(ri->World));
+		}
 
-	if (GetAsyncKeyState('A') & 0x8000)
-		if (mUseFpsCamera)
-			mFpsCam->Strafe(-10.0f * dt);
-		else
-			mTpsCam->Strafe(-10.0f * dt);
+		mProbeFaceNeedsRender[f] = signature.Value() != mProbeSignatures[f];
+		if (!mProbeFaceNeedsRender[f])
+		{
+			mProbeFacesSkipped++;
+			continue;
+		}
 
-	if (GetAsyncKeyState('D') & 0x8000)
-		if (mUseFpsCamera)
-			mFpsCam->Strafe(10.0f * dt);
-		else
-			mTpsCam->Strafe(10.0f * dt);
+		mProbeSignatures[f] = signature.Value();
+		mProbeFacesRendered++;
+		SortViewRitems(view);
+
+		PassConstants facePassCB = mMainPassCB;
+		StoreCameraMatrices(facePassCB, *view.Cam);
+		facePassCB.RenderTargetSize = XMFLOAT2((float)gProbeResolution, (float)gProbeResolution);
+		facePassCB.InvRenderTargetSize = XMFLOAT2(1.0f / gProbeResolution, 1.0f / gProbeResolution);
+		facePassCB.NearZ = mProbeCam.GetNearZ();
+		facePassCB.FarZ = mProbeCam.GetFarZ();
+		facePassCB.CascadeCount = 0;
+		mCurrFrameResource->PassCB->CopyData(view.PassCBIndex, facePassCB);
+	}
+}
 
-	XMFLOAT3 adjustedPos;
+void CameraApp::BindLightingResources(ID3D12GraphicsCommandList* cmdList)
+{
+	auto lightingCB = mCurrFrameResource->LightingCB->Resource();
+	cmdList->SetGraphicsRootConstantBufferView(8, lightingCB->GetGPUVirtualAddress());
 
-	// Mantiene camera/target attaccato al pavimento.
-	if (mUseFpsCamera)
-		XMStoreFloat3(&adjustedPos,
-			XMVectorClamp(mFpsCam->GetPosition(),
-				XMVectorSet(-8.9f, 2.0f, -13.9f, 0.0f),
-				XMVectorSet(8.9f, 2.0f, 13.9f, 0.0f)));
-	else
-		XMStoreFloat3(&adjustedPos,
-			XMVectorClamp(mTpsCam->GetTarget(),
-				XMVectorSet(-8.9f, 1.0f, -13.9f, 0.0f),
-				XMVectorSet(8.9f, 1.0f, 13.9f, 0.0f)));
+	// Luci, range dei cluster e liste di indici (t1, t2, t3).
+	cmdList->SetGraphicsRootShaderResourceView(4, mCurrFrameResource->ClusteredLights->Resource()->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(5, mCurrFrameResource->ClusterRanges->Resource()->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(6, mCurrFrameResource->ClusterLightIndices->Resource()->GetGPUVirtualAddress());
 
-	// Aggiorna, nella classe della camera, la posizione di camera/target a quella della box.
-	mFpsCam->SetPosition(adjustedPos.x, adjustedPos.y, adjustedPos.z);
-	mTpsCam->SetTarget3f(adjustedPos);
+	// Shadow map di tutte le cascate (t4) e sonda d'ambiente (t5).
+	cmdList->SetGraphicsRootDescriptorTable(7, mShadowMap->Srv());
+	cmdList->SetGraphicsRootDescriptorTable(9, mEnvironmentProbe->Srv());
+}
 
-	// Aggiorna la posizione della box nel relativo RenderItem.
-	XMStoreFloat4x4(
-		&mBoxRItem->World,
-		XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(adjustedPos.x, 1.0f, adjustedPos.z));
-	mBoxRItem->NumFramesDirty = gNumFrameResources;
+void CameraApp::RefitSceneBvh()
+{
+	// Gli oggetti mossi dalla simulazione vengono portati dove sono disegnati.
+	for (uint32_t item = 0; item < (uint32_t)mSceneRitems.size(); ++item)
+	{
+		RenderItem* ri = mSceneRitems[item];
+		if (std::find(mSimulatedRitems.begin(), mSimulatedRitems.end(), ri) == mSimulatedRitems.end())
+			continue;
+
+		BoundingBox bounds;
+		ri->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+		mSceneBvh.SetBounds(item, &bounds.Center.x, &bounds.Extents.x);
+		mPickMeshes.SetWorld(item, &ri->World._11);
+	}
+	mSceneBvh.Refit();
+}
 
-	if (mUseFpsCamera)
-		mFpsCam->UpdateViewMatrix();
+const Camera* CameraApp::ActiveCamera()const
+{
+	if (mPlayback == PlaybackMode::Camera)
+		return &mPlaybackCam;
+	else if (mUseFpsCamera)
+		return mFpsCam.get();
 	else
-		mTpsCam->UpdateViewMatrix();
+		return mTpsCam.get();
 }
 
-void CameraApp::AnimateMaterials(const GameTimer& gt)
+const Camera* CameraApp::InactiveCamera()const
 {
-
+	// L'altra delle due camere; riproducendo gli stati registrati, quella selezionata.
+	bool fps = mPlayback == PlaybackMode::Camera ? mUseFpsCamera != FALSE : mUseFpsCamera == FALSE;
+	if (fps)
+		return mFpsCam.get();
+	else
+		return mTpsCam.get();
 }
 
-void CameraApp::UpdateObjectCBs(const GameTimer& gt)
+float CameraApp::ViewAspect()const
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for (auto& e : mAllRitems)
-	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+	// Nello schermo diviso ogni vista ha met della larghezza.
+	return mViewLayout == ViewLayout::SplitScreen ? 0.5f * AspectRatio() : AspectRatio();
+}
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			//objConstants.MaterialIndex = e->Mat->MatCBIndex;
+void CameraApp::SetCameraLenses()
+{
+	if (mFpsCam != nullptr)
+		mFpsCam->SetLens(0.25f * MathHelper::Pi, ViewAspect(), 1.0f, 1000.0f);
+	if (mTpsCam != nullptr)
+		mTpsCam->SetLens(0.25f * MathHelper::Pi, ViewAspect(), 1.0f, 1000.0f);
+}
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+void CameraApp::UpdateLightingCB()
+{
+	// Ogni frame resource ha la sua copia: va aggiornata finch non raggiunge la versione corrente.
+	if (mCurrFrameResource->LightingVersion == mLightingVersion)
+		return;
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
-	}
+	mCurrFrameResource->LightingCB->CopyData(0, mLighting);
+	mCurrFrameResource->LightingVersion = mLightingVersion;
 }
 
-void CameraApp::UpdateMaterialCBs(const GameTimer& gt)
+void CameraApp::UpdateClusteredLights(const GameTimer& gt)
 {
-	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
-	for (auto& e : mMaterials)
+	const Camera* camera = ActiveCamera();
+	XMMATRIX view = camera->GetView();
+	XMFLOAT4X4 proj = camera->GetProj4x4f();
+
+	// La griglia segue la proiezione della camera (i bounds dei cluster vengono
+	// ricalcolati solo quando cambia).
+	ClusterGridDesc grid;
+	grid.NearZ = camera->GetNearZ();
+	grid.FarZ = camera->GetFarZ();
+	grid.ProjScaleX = proj._11;
+	grid.ProjScaleY = proj._22;
+	grid.MaxLightIndices = gMaxClusterLightIndices;
+	mLightClusters.SetGrid(grid);
+
+	UINT lightCount = mClusteredLightsEnabled ? (UINT)mClusteredLights.size() : 0;
+	for (UINT i = 0; i < lightCount; ++i)
 	{
-		// Only update the cbuffer data if the constants have changed.  If the cbuffer
-		// data changes, it needs to be updated for each FrameResource.
-		Material* mat = e.second.get();
-		if (mat->NumFramesDirty > 0)
-		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+		const Light& light = mClusteredLights[i];
+		ClusterLight& viewLight = mViewSpaceLights[i];
+
+		XMStoreFloat3((XMFLOAT3*)viewLight.Position, XMVector3TransformCoord(XMLoadFloat3(&light.Position), view));
+		XMStoreFloat3((XMFLOAT3*)viewLight.Direction, XMVector3TransformNormal(XMLoadFloat3(&light.Direction), view));
+		viewLight.Range = light.FalloffEnd;
+		viewLight.IsSpot = i >= mClusteredSpotLightStart;
+		viewLight.CosAngle = viewLight.IsSpot ? LightClusters::SpotCosAngle(light.SpotPower) : -1.0f;
+	}
 
-			MaterialConstants matConstants;
-			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matConstants.FresnelR0 = mat->FresnelR0;
-			matConstants.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+	mLightClusters.Assign(mViewSpaceLights.data(), lightCount);
 
-			currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+	// Le luci restano in world space: il pixel shader lavora con PosW.
+	if (lightCount > 0)
+		mCurrFrameResource->ClusteredLights->CopyData(0, mClusteredLights.data(), lightCount);
 
-			// Next FrameResource need to be updated too.
-			mat->NumFramesDirty--;
-		}
-	}
+	const std::vector<ClusterRange>& ranges = mLightClusters.Ranges();
+	mCurrFrameResource->ClusterRanges->CopyData(0, ranges.data(), (UINT)ranges.size());
+
+	const std::vector<uint32_t>& indices = mLightClusters.LightIndices();
+	if (!indices.empty())
+		mCurrFrameResource->ClusterLightIndices->CopyData(0, indices.data(), (UINT)indices.size());
+
+	mMainPassCB.ClusterCount = { grid.CountX, grid.CountY, grid.CountZ };
+	mMainPassCB.ClusterDepthScale = mLightClusters.DepthScale();
+	mMainPassCB.ClusterDepthBias = mLightClusters.DepthBias();
+	// I tile dividono la viewport della prima vista, che parte dall'angolo in alto a sinistra.
+	const D3D12_VIEWPORT& viewport = mViews[0].Viewport;
+	mMainPassCB.ClusterTileScale = { (float)grid.CountX / viewport.Width, (float)grid.CountY / viewport.Height };
 }
 
-/*void CameraAndDynamicIndexingApp::UpdateMaterialBuffer(const GameTimer& gt)
+void CameraApp::UpdateShadowCascades(const GameTimer& gt)
 {
-	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
-	for (auto& e : mMaterials)
+	if (!mShadowsEnabled)
+		return;
+
+	// La box si muove con la camera:  l'unico caster dinamico.
+	BoundingBox boxBounds;
+	mBoxRItem->Bounds.Transform(boxBounds, XMLoadFloat4x4(&mBoxRItem->World));
+	mShadowCascades.SetCasterBounds(mBoxRItem->ShadowCasterId, &boxBounds.Center.x, &boxBounds.Extents.x);
+
+	const Camera* camera = ActiveCamera();
+	XMFLOAT3 position = camera->GetPosition3f();
+	XMFLOAT3 right = camera->GetRight3f();
+	XMFLOAT3 up = camera->GetUp3f();
+	XMFLOAT3 look = camera->GetLook3f();
+
+	ShadowCamera shadowCamera;
+	std::copy(&position.x, &position.x + 3, shadowCamera.Position);
+	std::copy(&right.x, &right.x + 3, shadowCamera.Right);
+	std::copy(&up.x, &up.x + 3, shadowCamera.Up);
+	std::copy(&look.x, &look.x + 3, shadowCamera.Look);
+	shadowCamera.NearZ = camera->GetNearZ();
+	shadowCamera.FarZ = camera->GetFarZ();
+	shadowCamera.FovY = camera->GetFovY();
+	shadowCamera.Aspect = camera->GetAspect();
+
+	// Direzione della luce principale.
+	const XMFLOAT3& lightDirection = mLighting.Lights[0].Direction;
+	mShadowCascades.Update(shadowCamera, &lightDirection.x);
+
+	UINT cascadeCount = mShadowCascades.CascadeCount();
+	float splits[ShadowCascades::MaxCascades] = {};
+	for (UINT i = 0; i < cascadeCount; ++i)
 	{
-		// Only update the cbuffer data if the constants have changed.  If the cbuffer
-		// data changes, it needs to be updated for each FrameResource.
-		Material* mat = e.second.get();
-		if (mat->NumFramesDirty > 0)
-		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+		const ShadowCascade& cascade = mShadowCascades.Cascade(i);
+		XMMATRIX viewProj = XMLoadFloat4x4((const XMFLOAT4X4*)cascade.ViewProj);
+		XMMATRIX shadowTransform = XMLoadFloat4x4((const XMFLOAT4X4*)cascade.ShadowTransform);
 
-			MaterialData matData;
-			matData.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matData.FresnelR0 = mat->FresnelR0;
-			matData.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-
-			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
+		// Il pass delle ombre usa solo la view-projection; il resto  quello del pass principale.
+		PassConstants shadowPassCB = mMainPassCB;
+		XMStoreFloat4x4(&shadowPassCB.ViewProj, XMMatrixTranspose(viewProj));
+		mCurrFrameResource->PassCB->CopyData(1 + i, shadowPassCB);
 
-			// Next FrameResource need to be updated too.
-			mat->NumFramesDirty--;
-		}
+		XMStoreFloat4x4(&mMainPassCB.ShadowTransform[i], XMMatrixTranspose(shadowTransform));
+		splits[i] = cascade.SplitFar;
 	}
-}*/
 
-void CameraApp::UpdateMainPassCB(const GameTimer& gt)
+	mMainPassCB.CascadeSplits = { splits[0], splits[1], splits[2], splits[3] };
+	mMainPassCB.CascadeCount = cascadeCount;
+	mMainPassCB.ShadowTexelSize = 1.0f / mShadowMap->Resolution();
+}
+
+void CameraApp::SortViewRitems(RenderView& view)
 {
-	XMMATRIX view, proj;
+	// Dal pi vicino al pi lontano lungo la direzione di vista: il depth test scarta
+	// prima i frammenti coperti, sia nel pre-pass sia senza.
+	XMVECTOR eye = view.Cam->GetPosition();
+	XMVECTOR look = view.Cam->GetLook();
 
-	if (mUseFpsCamera)
+	auto viewDepth = [eye, look](const RenderItem* ri)
 	{
-		view = mFpsCam->GetView();
-		proj = mFpsCam->GetProj();
-	}
-	else
-	{
-		view = mTpsCam->GetView();
-		proj = mTpsCam->GetProj();
-	}
-
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
-
-	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
-	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
-	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
-	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
-	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
-	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&ri->Bounds.Center), XMLoadFloat4x4(&ri->World));
+		return XMVectorGetX(XMVector3Dot(center - eye, look));
+	};
 
-	if (mUseFpsCamera)
-		mMainPassCB.EyePosW = mFpsCam->GetPosition3f();
-	else
-		mMainPassCB.EyePosW = mTpsCam->GetPosition3f();
+	std::vector<std::pair<float, RenderItem*>> keyed;
+	keyed.reserve(view.Ritems.size());
+	for (RenderItem* ri : view.Ritems)
+		keyed.emplace_back(viewDepth(ri), ri);
 
-	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
-	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
-	mMainPassCB.NearZ = 1.0f;
-	mMainPassCB.FarZ = 1000.0f;
-	mMainPassCB.TotalTime = gt.TotalTime();
-	mMainPassCB.DeltaTime = gt.DeltaTime();
-	mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
-	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[0].Strength = { 0.8f, 0.8f, 0.8f };
-	mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
-	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
-	mMainPassCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
+	std::sort(keyed.begin(), keyed.end(),
+		[](const std::pair<float, RenderItem*>& a, const std::pair<float, RenderItem*>& b) { return a.first < b.first; });
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	for (size_t i = 0; i < keyed.size(); ++i)
+		view.Ritems[i] = keyed[i].second;
 }
 
 void CameraApp::LoadTextures()
 {
-	auto bricksTex = std::make_unique<Texture>();
-	bricksTex->Name = "bricksTex";
-	bricksTex->Filename = L"../../Textures/bricks.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), bricksTex->Filename.c_str(),
-		bricksTex->Resource, bricksTex->UploadHeap));
-
-	auto stoneTex = std::make_unique<Texture>();
-	stoneTex->Name = "stoneTex";
-	stoneTex->Filename = L"../../Textures/stone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), stoneTex->Filename.c_str(),
-		stoneTex->Resource, stoneTex->UploadHeap));
-
-	auto tileTex = std::make_unique<Texture>();
-	tileTex->Name = "tileTex";
-	tileTex->Filename = L"../../Textures/tile.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), tileTex->Filename.c_str(),
-		tileTex->Resource, tileTex->UploadHeap));
-
-	auto crateTex = std::make_unique<Texture>();
-	crateTex->Name = "crateTex";
-	crateTex->Filename = L"../../Textures/WoodCrate01.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), crateTex->Filename.c_str(),
-		crateTex->Resource, crateTex->UploadHeap));
-
-	mTextures[bricksTex->Name] = std::move(bricksTex);
-	mTextures[stoneTex->Name] = std::move(stoneTex);
-	mTextures[tileTex->Name] = std::move(tileTex);
-	mTextures[crateTex->Name] = std::move(crateTex);
+	const std::array<std::pair<std::string, std::wstring>, 4> texFiles =
+	{{
+		{ "bricksTex", L"../../Textures/bricks.dds" },
+		{ "stoneTex", L"../../Textures/stone.dds" },
+		{ "tileTex", L"../../Textures/tile.dds" },
+		{ "crateTex", L"../../Textures/WoodCrate01.dds" }
+	}};
+
+	// Le texture vengono collocate negli heap dell'allocatore invece di essere
+	// committed resource con un heap implicito ciascuna.
+	auto createTexture = [this](const D3D12_RESOURCE_DESC& desc, ComPtr<ID3D12Resource>& texture)
+	{
+		GpuAllocation allocation;
+		texture = mGpuHeapAllocator->CreateResource(desc, D3D12_HEAP_TYPE_DEFAULT,
+			D3D12_RESOURCE_STATE_COMMON, nullptr, allocation);
+		mTextureAllocations.push_back(allocation);
+		return S_OK;
+	};
+
+	for (const auto& file : texFiles)
+	{
+		auto tex = std::make_unique<Texture>();
+		tex->Name = file.first;
+		tex->Filename = file.second;
+
+		// Crea la texture e ne carica i dati passando per il ring di upload
+		// (nessuna risorsa intermedia dedicata).
+		std::unique_ptr<uint8_t[]> ddsData;
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+		ThrowIfFailed(DirectX::LoadDDSTextureFromFile12(md3dDevice.Get(),
+			tex->Filename.c_str(), tex->Resource, ddsData, subresources, 0, nullptr, createTexture));
+
+		d3dUtil::UploadTexture(mCommandList.Get(), tex->Resource.Get(), subresources, *mUploadRing, mStateTracker);
+
+		mTextures[tex->Name] = std::move(tex);
+	}
 }
 
 void CameraApp::BuildRootSignature()
@@ -605,15 +2151,31 @@ void CameraApp::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE texTable;
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
-	// 4 root parameter.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	// Texture2DArray della shadow map (t4).
+	CD3DX12_DESCRIPTOR_RANGE shadowTable;
+	shadowTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 4);
+
+	// TextureCube della sonda d'ambiente (t5).
+	CD3DX12_DESCRIPTOR_RANGE probeTable;
+	probeTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 5);
+
+	// 10 root parameter.
+	CD3DX12_ROOT_PARAMETER slotRootParameter[10];
 
 	// 1 root descriptor table (per l'SRV alla texture, quindi visibilit sufficiente nel PS).
 	// 3 root descriptor (per i CBV ai 3 CB: per object, per pass e per il materiale).
+	// 3 root descriptor (per gli SRV ai structured buffer delle luci assegnate ai cluster).
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[1].InitAsConstantBufferView(0);
 	slotRootParameter[2].InitAsConstantBufferView(1);
 	slotRootParameter[3].InitAsConstantBufferView(2);
+	slotRootParameter[4].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[5].InitAsShaderResourceView(2, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[6].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[7].InitAsDescriptorTable(1, &shadowTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	// 1 root descriptor per il CBV di luci e ambiente, letto solo dal PS.
+	slotRootParameter[8].InitAsConstantBufferView(3, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[9].InitAsDescriptorTable(1, &probeTable, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	// 4 SRV delle 4 texture usate in questa demo a partire da slot 0 di space0
 	// (quindi da slot 0 a 4 visto come viene dichiarato per primo in HLSL)
@@ -635,92 +2197,99 @@ void CameraApp::BuildRootSignature()
 	auto staticSamplers = GetStaticSamplers();
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(10, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
-	// create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
-	ComPtr<ID3DBlob> serializedRootSig = nullptr;
-	ComPtr<ID3DBlob> errorBlob = nullptr;
-	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
-
-	if (errorBlob != nullptr)
-	{
-		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-	}
-	ThrowIfFailed(hr);
-
-	ThrowIfFailed(md3dDevice->CreateRootSignature(
-		0,
-		serializedRootSig->GetBufferPointer(),
-		serializedRootSig->GetBufferSize(),
-		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+	// La versione serializzata viene letta dalla cache su disco, se presente.
+	mRootSignature = mPsoCache->CreateRootSignature(rootSigDesc);
 }
 
 void CameraApp::BuildDescriptorHeaps()
 {
 	//
-	// Create the SRV heap.
+	// Create the SRV heaps.
 	// SRV di StructuredBuffer non serve visto che viene usato root descriptor.
+	// La regione persistente ospita gli SRV delle texture, il ring quelli che servono
+	// per un solo frame; le dimensioni lasciano spazio a migliaia di texture caricate
+	// a runtime senza dover ricreare l'heap.
 	//
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 4;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+	mSrvHeap = std::make_unique<GpuDescriptorHeap>(md3dDevice.Get(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4096, 1024);
+	mSrvStagingHeap = std::make_unique<StagingDescriptorHeap>(md3dDevice.Get(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 256);
 
 	//
 	// Fill out the heap with actual descriptors.
+	// Le SRV vengono create nell'heap di staging (solo CPU) e copiate nell'heap
+	// shader-visible tutte insieme con una sola CopyDescriptors.
 	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	auto bricksTex = mTextures["bricksTex"]->Resource;
-	auto stoneTex = mTextures["stoneTex"]->Resource;
-	auto tileTex = mTextures["tileTex"]->Resource;
-	auto crateTex = mTextures["crateTex"]->Resource;
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = bricksTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = bricksTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
+	std::vector<DescriptorHandle> staged;
+	for (auto& texPair : mTextures)
+	{
+		Texture* tex = texPair.second.get();
+		D3D12_RESOURCE_DESC texDesc = tex->Resource->GetDesc();
 
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = texDesc.Format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
 
-	srvDesc.Format = stoneTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = stoneTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(stoneTex.Get(), &srvDesc, hDescriptor);
+		DescriptorHandle stagingSrv = mSrvStagingHeap->Allocate();
+		md3dDevice->CreateShaderResourceView(tex->Resource.Get(), &srvDesc, stagingSrv.Cpu);
 
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+		DescriptorHandle srv = mSrvHeap->AllocatePersistent();
+		mSrvHeap->StageCopy(srv, 0, stagingSrv.Cpu, 1);
+		tex->SrvHeapIndex = srv.Index;
 
-	srvDesc.Format = tileTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = tileTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(tileTex.Get(), &srvDesc, hDescriptor);
+		staged.push_back(stagingSrv);
+	}
 
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+	mSrvHeap->FlushCopies();
 
-	srvDesc.Format = crateTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = crateTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(crateTex.Get(), &srvDesc, hDescriptor);
+	// Dopo la copia i descriptor di staging non servono pi.
+	for (auto& stagingSrv : staged)
+		mSrvStagingHeap->Free(stagingSrv);
 }
 
 void CameraApp::BuildShadersAndInputLayout()
 {
-	const D3D_SHADER_MACRO alphaTestDefines[] =
-	{
-		"ALPHA_TEST", "1",
-		NULL, NULL
-	};
-
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"../../Shaders\\Default.hlsl", nullptr, "VS", "vs_5_0");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"../../Shaders\\Default.hlsl", nullptr, "PS", "ps_5_0");
+	// Le manopole di Default.hlsl (e di LightingUtil.hlsl) diventano campi della chiave.
+	ShaderPermutationLayout layout;
+	mDirLightsField = layout.AddCount("NUM_DIR_LIGHTS", 3);
+	layout.AddCount("NUM_POINT_LIGHTS", 15);
+	layout.AddCount("NUM_SPOT_LIGHTS", 15);
+	mAlphaTestField = layout.AddFlag("ALPHA_TEST");
+	mFogField = layout.AddFlag("FOG");
+	mClusteredLightsField = layout.AddFlag("CLUSTERED_LIGHTS");
+	mShadowsField = layout.AddFlag("SHADOWS");
+	mReflectionsField = layout.AddFlag("REFLECTIONS");
+
+	// Compilati solo se sorgente, include, define, entry point o target sono cambiati
+	// dall'ultima esecuzione; altrimenti il bytecode viene mappato dalla cache.
+	mDefaultShaders = std::make_unique<ShaderPermutations>(*mShaderCache, L"../../Shaders\\Default.hlsl", layout);
+
+	// Il vertex shader non dipende da nessuna manopola: una sola variante per tutte le chiavi.
+	mDefaultShaders->SetKeyMask("VS", 0);
+	mDefaultShaders->SetKeyMask("VSShadow", 0);
+
+	mPassShaderKey = layout.Set(layout.Set(0, mDirLightsField, 3), mClusteredLightsField, 1);
+	mPassShaderKey = layout.Set(mPassShaderKey, mShadowsField, 1);
+	UINT reducedKey = layout.Set(mPassShaderKey, mDirLightsField, 1);
+	UINT fogBit = layout.Mask(mFogField);
+
+	// Le varianti usate dalla scena vengono costruite subito; le altre alla prima richiesta.
+	mDefaultShaders->Prebuild("PS", "ps_5_0", { mPassShaderKey, reducedKey, mPassShaderKey | fogBit, reducedKey | fogBit });
+
+	mShaders["standardVS"] = mDefaultShaders->Get("VS", "vs_5_0", mPassShaderKey);
+	mShaders["opaquePS"] = mDefaultShaders->Get("PS", "ps_5_0", mPassShaderKey);
+	mShaders["shadowVS"] = mDefaultShaders->Get("VSShadow", "vs_5_0", mPassShaderKey);
+
+	mShaders["upscaleVS"] = mShaderCache->Load(L"../../Shaders\\Upscale.hlsl", {}, "VS", "vs_5_0");
+	mShaders["upscalePS"] = mShaderCache->Load(L"../../Shaders\\Upscale.hlsl", {}, "PS", "ps_5_0");
 
 	mInputLayout =
 	{
@@ -775,6 +2344,12 @@ void CameraApp::BuildShapeGeometry()
 	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
 
+	// Bounding box in spazio locale, usati per la distanza dalla camera in DrawRenderItems.
+	BoundingBox::CreateFromPoints(boxSubmesh.Bounds, box.Vertices.size(), &box.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+	BoundingBox::CreateFromPoints(gridSubmesh.Bounds, grid.Vertices.size(), &grid.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+	BoundingBox::CreateFromPoints(sphereSubmesh.Bounds, sphere.Vertices.size(), &sphere.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+	BoundingBox::CreateFromPoints(cylinderSubmesh.Bounds, cylinder.Vertices.size(), &cylinder.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+
 	//
 	// Extract the vertex elements we are interested in and pack the
 	// vertices of all the meshes into one vertex buffer.
@@ -829,17 +2404,28 @@ void CameraApp::BuildShapeGeometry()
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "shapeGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	// Le copie in memoria di sistema servono solo se richieste (ad es. per il picking).
+	if (mKeepGeometryCpuCopies)
+	{
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	}
+
+	// Vertex ed index buffer sono intervalli della risorsa condivisa mGeometryBuffers.
+	BufferRange vbRange = d3dUtil::CreateDefaultBuffer(mCommandList.Get(),
+		vertices.data(), vbByteSize, *mGeometryBuffers, *mUploadRing, mStateTracker);
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	BufferRange ibRange = d3dUtil::CreateDefaultBuffer(mCommandList.Get(),
+		indices.data(), ibByteSize, *mGeometryBuffers, *mUploadRing, mStateTracker);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->VertexBufferGPU = vbRange.Resource;
+	geo->VertexBufferOffset = vbRange.Offset;
+	geo->IndexBufferGPU = ibRange.Resource;
+	geo->IndexBufferOffset = ibRange.Offset;
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -856,7 +2442,7 @@ void CameraApp::BuildShapeGeometry()
 
 void CameraApp::BuildPSOs()
 {
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& opaquePsoDesc = mOpaquePsoDesc;
 
 	//
 	// PSO for opaque objects.
@@ -866,13 +2452,13 @@ void CameraApp::BuildPSOs()
 	opaquePsoDesc.pRootSignature = mRootSignature.Get();
 	opaquePsoDesc.VS =
 	{
-		reinterpret_cast<BYTE*>(mShaders["standardVS"]->GetBufferPointer()),
-		mShaders["standardVS"]->GetBufferSize()
+		mShaders["standardVS"]->Data(),
+		mShaders["standardVS"]->Size()
 	};
 	opaquePsoDesc.PS =
 	{
-		reinterpret_cast<BYTE*>(mShaders["opaquePS"]->GetBufferPointer()),
-		mShaders["opaquePS"]->GetBufferSize()
+		mShaders["opaquePS"]->Data(),
+		mShaders["opaquePS"]->Size()
 	};
 	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
@@ -884,15 +2470,157 @@ void CameraApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	mPSOs["opaque"] = mPsoCache->RequestGraphicsPipeline(opaquePsoDesc);
+	mVariantPSOs[mPassShaderKey] = mPSOs["opaque"];
+
+	// Le altre varianti precompilate: i worker della cache creano i PSO in background.
+	const ShaderPermutationLayout& layout = mDefaultShaders->Layout();
+	UINT reducedKey = layout.Set(mPassShaderKey, mDirLightsField, 1);
+	UINT fogBit = layout.Mask(mFogField);
+	for (UINT key : { reducedKey, mPassShaderKey | fogBit, reducedKey | fogBit })
+		mVariantPSOs[key] = RequestOpaqueVariant(key, false);
+
+	//
+	// PSO per le shadow map: solo profondit, senza pixel shader n render target.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC shadowPsoDesc = opaquePsoDesc;
+	shadowPsoDesc.VS =
+	{
+		mShaders["shadowVS"]->Data(),
+		mShaders["shadowVS"]->Size()
+	};
+	shadowPsoDesc.PS = { nullptr, 0 };
+	shadowPsoDesc.RasterizerState.DepthBias = 100000;
+	shadowPsoDesc.RasterizerState.DepthBiasClamp = 0.0f;
+	shadowPsoDesc.RasterizerState.SlopeScaledDepthBias = 1.0f;
+	// I caster tra la luce e la cascata vengono schiacciati sul near plane invece di essere tagliati.
+	shadowPsoDesc.RasterizerState.DepthClipEnable = FALSE;
+	shadowPsoDesc.NumRenderTargets = 0;
+	shadowPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+	shadowPsoDesc.SampleDesc.Count = 1;
+	shadowPsoDesc.SampleDesc.Quality = 0;
+	shadowPsoDesc.DSVFormat = ShadowMapArray::DepthFormat;
+	mPSOs["shadow"] = mPsoCache->RequestGraphicsPipeline(shadowPsoDesc);
+
+	//
+	// PSO del depth pre-pass: stesso vertex shader di posizione, nessun pixel shader,
+	// stesso depth buffer (e campionamento) del pass principale.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC prepassPsoDesc = opaquePsoDesc;
+	prepassPsoDesc.VS = shadowPsoDesc.VS;
+	prepassPsoDesc.PS = { nullptr, 0 };
+	prepassPsoDesc.NumRenderTargets = 0;
+	prepassPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+	mPSOs["depthPrepass"] = mPsoCache->RequestGraphicsPipeline(prepassPsoDesc);
+
+	// Il pass principale dopo il pre-pass: EQUAL e nessuna scrittura della profondit.
+	mPSOs["opaqueDepthEqual"] = RequestOpaqueVariant(mPassShaderKey, true);
+	mDepthEqualVariantPSOs[mPassShaderKey] = mPSOs["opaqueDepthEqual"];
+	for (UINT key : { reducedKey, mPassShaderKey | fogBit, reducedKey | fogBit })
+		mDepthEqualVariantPSOs[key] = RequestOpaqueVariant(key, true);
+
+	//
+	// PSO dell'upscale sul back buffer: triangolo generato dal vertex shader, senza
+	// input layout n profondit.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC upscalePsoDesc = opaquePsoDesc;
+	upscalePsoDesc.InputLayout = { nullptr, 0 };
+	upscalePsoDesc.VS =
+	{
+		mShaders["upscaleVS"]->Data(),
+		mShaders["upscaleVS"]->Size()
+	};
+	upscalePsoDesc.PS =
+	{
+		mShaders["upscalePS"]->Data(),
+		mShaders["upscalePS"]->Size()
+	};
+	upscalePsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	upscalePsoDesc.DepthStencilState.DepthEnable = FALSE;
+	upscalePsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	upscalePsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+	mPSOs["upscale"] = mPsoCache->RequestGraphicsPipeline(upscalePsoDesc);
+}
+
+PipelineStateCache::Handle CameraApp::RequestOpaqueVariant(UINT shaderKey, bool depthEqual)
+{
+	auto vs = mDefaultShaders->Get("VS", "vs_5_0", shaderKey);
+	auto ps = mDefaultShaders->Get("PS", "ps_5_0", shaderKey);
+
+	// La cache copia la descrizione (bytecode compreso), quindi basta un temporaneo.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = mOpaquePsoDesc;
+	desc.VS = { vs->Data(), vs->Size() };
+	desc.PS = { ps->Data(), ps->Size() };
+	if (depthEqual)
+	{
+		desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+		desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	}
+	return mPsoCache->RequestGraphicsPipeline(desc);
+}
+
+ID3D12PipelineState* CameraApp::OpaqueVariant(UINT shaderKey, bool depthPrepass)
+{
+	bool depthEqual = depthPrepass && UsesDepthPrepass(shaderKey);
+	auto& variants = depthEqual ? mDepthEqualVariantPSOs : mVariantPSOs;
+
+	auto it = variants.find(shaderKey);
+	if (it == variants.end())
+		it = variants.emplace(shaderKey, RequestOpaqueVariant(shaderKey, depthEqual)).first;
+
+	// Finch il PSO della variante non  pronto si disegna con quello completo,
+	// senza bloccare il frame.
+	ID3D12PipelineState* pso = mPsoCache->TryGet(it->second);
+	return pso != nullptr ? pso : mPsoCache->Wait(mPSOs[depthEqual ? "opaqueDepthEqual" : "opaque"]);
+}
+
+bool CameraApp::UsesDepthPrepass(UINT shaderKey)const
+{
+	// Con l'alpha test la profondit dipende dal pixel shader: quegli oggetti non
+	// partecipano al pre-pass e vengono disegnati con il depth test normale.
+	const ShaderPermutationLayout& layout = mDefaultShaders->Layout();
+	return mDepthPrepassEnabled && layout.Get(shaderKey, mAlphaTestField) == 0;
+}
+
+UINT CameraApp::ShaderKeyFor(const RenderItem* ri, const RenderView& view)const
+{
+	const ShaderPermutationLayout& layout = mDefaultShaders->Layout();
+	UINT key = view.ShaderKey | ri->Mat->ShaderFeatures;
+
+	// La sonda non pu leggere la cube map in cui sta disegnando.
+	if (view.Capture)
+		key = layout.Set(key, mReflectionsField, 0);
+
+	// Distanza dalla camera del punto pi vicino e di quello pi lontano del bounding box.
+	BoundingBox bounds;
+	ri->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+
+	XMVECTOR eye = view.Cam->GetPosition();
+	XMVECTOR center = XMLoadFloat3(&bounds.Center);
+	XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+	XMVECTOR closest = XMVectorClamp(eye, center - extents, center + extents);
+	float nearest = XMVectorGetX(XMVector3Length(eye - closest));
+	float farthest = XMVectorGetX(XMVector3Length(XMVectorAbs(eye - center) + extents));
+
+	// Gli oggetti lontani ricevono solo la luce principale.
+	if (nearest > mReducedLightingDistance)
+		key = layout.Set(key, mDirLightsField, 1);
+
+	// Un oggetto che finisce prima dell'inizio della nebbia non ne ha bisogno.
+	if (farthest < mLighting.FogStart)
+		key = layout.Set(key, mFogField, 0);
+
+	return key;
 }
 
 void CameraApp::BuildFrameResources()
 {
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
-		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+		// Un pass per vista, uno per cascata e uno per faccia della sonda d'ambiente.
+		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), *mGpuHeapAllocator,
+			gMaxViews + ShadowCascades::MaxCascades + CubeCamera::FaceCount, (UINT)mAllRitems.size(), (UINT)mMaterials.size(),
+			mLightClusters.ClusterCount(), gMaxClusteredLights, gMaxClusterLightIndices));
 	}
 }
 
@@ -901,7 +2629,7 @@ void CameraApp::BuildMaterials()
 	auto bricks0 = std::make_unique<Material>();
 	bricks0->Name = "bricks0";
 	bricks0->MatCBIndex = 0;
-	bricks0->DiffuseSrvHeapIndex = 0;
+	bricks0->DiffuseSrvHeapIndex = mTextures["bricksTex"]->SrvHeapIndex;
 	bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	bricks0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
 	bricks0->Roughness = 0.1f;
@@ -909,7 +2637,7 @@ void CameraApp::BuildMaterials()
 	auto stone0 = std::make_unique<Material>();
 	stone0->Name = "stone0";
 	stone0->MatCBIndex = 1;
-	stone0->DiffuseSrvHeapIndex = 1;
+	stone0->DiffuseSrvHeapIndex = mTextures["stoneTex"]->SrvHeapIndex;
 	stone0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	stone0->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	stone0->Roughness = 0.3f;
@@ -917,7 +2645,7 @@ void CameraApp::BuildMaterials()
 	auto tile0 = std::make_unique<Material>();
 	tile0->Name = "tile0";
 	tile0->MatCBIndex = 2;
-	tile0->DiffuseSrvHeapIndex = 2;
+	tile0->DiffuseSrvHeapIndex = mTextures["tileTex"]->SrvHeapIndex;
 	tile0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	tile0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
 	tile0->Roughness = 0.3f;
@@ -925,15 +2653,26 @@ void CameraApp::BuildMaterials()
 	auto crate0 = std::make_unique<Material>();
 	crate0->Name = "crate0";
 	crate0->MatCBIndex = 3;
-	crate0->DiffuseSrvHeapIndex = 3;
+	crate0->DiffuseSrvHeapIndex = mTextures["crateTex"]->SrvHeapIndex;
 	crate0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	crate0->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	crate0->Roughness = 0.2f;
 
+	// Specchio: quasi tutta la luce viene dal riflesso della sonda d'ambiente.
+	auto mirror0 = std::make_unique<Material>();
+	mirror0->Name = "mirror0";
+	mirror0->MatCBIndex = 4;
+	mirror0->DiffuseSrvHeapIndex = mTextures["tileTex"]->SrvHeapIndex;
+	mirror0->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.1f, 1.0f);
+	mirror0->FresnelR0 = XMFLOAT3(0.98f, 0.97f, 0.95f);
+	mirror0->Roughness = 0.1f;
+	mirror0->ShaderFeatures = mDefaultShaders->Layout().Mask(mReflectionsField);
+
 	mMaterials["bricks0"] = std::move(bricks0);
 	mMaterials["stone0"] = std::move(stone0);
 	mMaterials["tile0"] = std::move(tile0);
 	mMaterials["crate0"] = std::move(crate0);
+	mMaterials["mirror0"] = std::move(mirror0);
 }
 
 void CameraApp::BuildRenderItems()
@@ -948,7 +2687,11 @@ void CameraApp::BuildRenderItems()
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Bounds = boxRitem->Geo->DrawArgs["box"].Bounds;
+	boxRitem->PrevSimWorld = boxRitem->World;
+	boxRitem->SimWorld = boxRitem->World;
 	mBoxRItem = boxRitem.get();
+	mSimulatedRitems.push_back(mBoxRItem);
 	mAllRitems.push_back(std::move(boxRitem));
 
 	auto gridRitem = std::make_unique<RenderItem>();
@@ -961,6 +2704,7 @@ void CameraApp::BuildRenderItems()
 	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	gridRitem->Bounds = gridRitem->Geo->DrawArgs["grid"].Bounds;
 	mAllRitems.push_back(std::move(gridRitem));
 
 	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
@@ -987,6 +2731,7 @@ void CameraApp::BuildRenderItems()
 		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		leftCylRitem->Bounds = leftCylRitem->Geo->DrawArgs["cylinder"].Bounds;
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
@@ -997,6 +2742,7 @@ void CameraApp::BuildRenderItems()
 		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		rightCylRitem->Bounds = rightCylRitem->Geo->DrawArgs["cylinder"].Bounds;
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -1007,6 +2753,7 @@ void CameraApp::BuildRenderItems()
 		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		leftSphereRitem->Bounds = leftSphereRitem->Geo->DrawArgs["sphere"].Bounds;
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -1017,6 +2764,7 @@ void CameraApp::BuildRenderItems()
 		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		rightSphereRitem->Bounds = rightSphereRitem->Geo->DrawArgs["sphere"].Bounds;
 
 		mAllRitems.push_back(std::move(leftCylRitem));
 		mAllRitems.push_back(std::move(rightCylRitem));
@@ -1024,12 +2772,257 @@ void CameraApp::BuildRenderItems()
 		mAllRitems.push_back(std::move(rightSphereRitem));
 	}
 
+	// Sfera riflettente appoggiata sul pavimento, con la sonda d'ambiente al centro.
+	auto mirrorRitem = std::make_unique<RenderItem>();
+	XMStoreFloat4x4(&mirrorRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f) * XMMatrixTranslation(0.0f, 1.5f, 6.0f));
+	mirrorRitem->TexTransform = MathHelper::Identity4x4();
+	mirrorRitem->ObjCBIndex = objCBIndex++;
+	mirrorRitem->Mat = mMaterials["mirror0"].get();
+	mirrorRitem->Geo = mGeometries["shapeGeo"].get();
+	mirrorRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	mirrorRitem->IndexCount = mirrorRitem->Geo->DrawArgs["sphere"].IndexCount;
+	mirrorRitem->StartIndexLocation = mirrorRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
+	mirrorRitem->BaseVertexLocation = mirrorRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	mirrorRitem->Bounds = mirrorRitem->Geo->DrawArgs["sphere"].Bounds;
+	mProbeRItem = mirrorRitem.get();
+	mAllRitems.push_back(std::move(mirrorRitem));
+
 	// All the render items are opaque.
 	for (auto& e : mAllRitems)
 		mOpaqueRitems.push_back(e.get());
 }
 
-void CameraApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void CameraApp::BuildClusteredLights()
+{
+	// Luci sparse sopra il pavimento: prima le puntiformi, poi le spot rivolte verso il basso.
+	const UINT pointLightCount = 768;
+	const UINT spotLightCount = 256;
+	assert(pointLightCount + spotLightCount <= gMaxClusteredLights);
+
+	mClusteredLights.clear();
+	for (UINT i = 0; i < pointLightCount + spotLightCount; ++i)
+	{
+		Light light;
+		light.Strength = { MathHelper::RandF(0.1f, 0.4f), MathHelper::RandF(0.1f, 0.4f), MathHelper::RandF(0.1f, 0.4f) };
+		light.Position = { MathHelper::RandF(-10.0f, 10.0f), MathHelper::RandF(0.5f, 3.0f), MathHelper::RandF(-15.0f, 15.0f) };
+		light.FalloffEnd = MathHelper::RandF(1.0f, 3.0f);
+
+		if (i >= pointLightCount)
+		{
+			light.Position.y += 3.0f;
+			light.FalloffEnd *= 2.0f;
+			light.Direction = { 0.0f, -1.0f, 0.0f };
+			light.SpotPower = MathHelper::RandF(8.0f, 64.0f);
+		}
+
+		light.FalloffStart = 0.2f * light.FalloffEnd;
+		mClusteredLights.push_back(light);
+	}
+
+	mClusteredSpotLightStart = pointLightCount;
+	mViewSpaceLights.resize(mClusteredLights.size());
+
+	// Il numero di cluster serve gi per dimensionare i buffer delle frame resource;
+	// la proiezione viene aggiornata ad ogni frame.
+	ClusterGridDesc grid;
+	grid.MaxLightIndices = gMaxClusterLightIndices;
+	mLightClusters.SetGrid(grid);
+}
+
+void CameraApp::BuildLighting()
+{
+	// Valori fissi della scena: finch nessuno li modifica, vengono caricati una volta
+	// per frame resource.
+	mLighting.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
+	mLighting.FogColor = { 0.690196097f, 0.768627524f, 0.870588303f, 1.0f };
+	mLighting.FogStart = 10.0f;
+	mLighting.FogRange = 40.0f;
+	mLighting.ClusterSpotLightStart = mClusteredSpotLightStart;
+	mLighting.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+	mLighting.Lights[0].Strength = { 0.8f, 0.8f, 0.8f };
+	mLighting.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
+	mLighting.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
+	mLighting.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
+	mLighting.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
+	++mLightingVersion;
+}
+
+void CameraApp::BuildShadowCasters()
+{
+	// Tutti gli oggetti opachi proiettano ombre. Solo la box si muove: gli altri sono
+	// statici e, finch restano fermi, le cascate che li contengono non vanno ridisegnate.
+	for (RenderItem* ri : mOpaqueRitems)
+	{
+		BoundingBox bounds;
+		ri->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+
+		ri->ShadowCasterId = mShadowCascades.AddCaster(&bounds.Center.x, &bounds.Extents.x, ri != mBoxRItem);
+		mShadowCasterRitems.push_back(ri);
+	}
+}
+
+void CameraApp::BuildCollisionBvh()
+{
+	// Solo gli oggetti fermi: quelli mossi dalla simulazione (la box) seguono il target,
+	// che  l'origine del braccio della camera.
+	mCollisionBvh.Clear();
+	for (RenderItem* ri : mOpaqueRitems)
+	{
+		if (std::find(mSimulatedRitems.begin(), mSimulatedRitems.end(), ri) != mSimulatedRitems.end())
+			continue;
+
+		BoundingBox bounds;
+		ri->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+		mCollisionBvh.Add(&bounds.Center.x, &bounds.Extents.x);
+	}
+	mCollisionBvh.Build();
+}
+
+void CameraApp::BuildCollisionWorld()
+{
+	mCollisionWorld.Clear();
+
+	// Il pavimento non  un ostacolo: ci si cammina sopra.
+	for (RenderItem* ri : mOpaqueRitems)
+	{
+		BoundingBox bounds;
+		ri->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+
+		if (ri == mBoxRItem)
+			mPlayerBody = mCollisionWorld.AddMover(&bounds.Center.x, &bounds.Extents.x);
+		else if (bounds.Center.y + bounds.Extents.y > 0.0f)
+			mCollisionWorld.AddStatic(&bounds.Center.x, &bounds.Extents.x);
+	}
+
+	// Pareti invisibili sui bordi del pavimento (20x30): la box resta sopra di esso.
+	const float walls[4][6] =
+	{
+		//   centro              semi-estensioni
+		{ -10.5f, 2.0f,   0.0f,   0.5f, 2.0f, 16.0f },
+		{  10.5f, 2.0f,   0.0f,   0.5f, 2.0f, 16.0f },
+		{   0.0f, 2.0f, -15.5f,  11.0f, 2.0f,  0.5f },
+		{   0.0f, 2.0f,  15.5f,  11.0f, 2.0f,  0.5f }
+	};
+	for (const float* wall : walls)
+		mCollisionWorld.AddStatic(wall, wall + 3);
+}
+
+void CameraApp::BuildSceneBvh()
+{
+	mSceneBvh.Clear();
+	mPickMeshes.Clear();
+	mSceneRitems.clear();
+
+	// Una mesh per submesh, individuata dal suo primo indice, condivisa dagli oggetti che
+	// la disegnano. Senza le copie in memoria di sistema resta il test sui bounds.
+	std::unordered_map<const std::uint16_t*, uint32_t> meshes;
+	for (RenderItem* ri : mOpaqueRitems)
+	{
+		BoundingBox bounds;
+		ri->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+		uint32_t item = mSceneBvh.Add(&bounds.Center.x, &bounds.Extents.x);
+		mSceneRitems.push_back(ri);
+
+		MeshGeometry* geo = ri->Geo;
+		if (geo->VertexBufferCPU == nullptr || geo->IndexBufferCPU == nullptr)
+			continue;
+
+		const std::uint16_t* indices = static_cast<const std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+		auto mesh = meshes.find(indices + ri->StartIndexLocation);
+		if (mesh == meshes.end())
+		{
+			uint32_t id = mPickMeshes.AddMesh(geo->VertexBufferCPU->GetBufferPointer(), geo->VertexByteStride,
+				indices, ri->IndexCount, ri->StartIndexLocation, ri->BaseVertexLocation);
+			mesh = meshes.emplace(indices + ri->StartIndexLocation, id).first;
+		}
+		mPickMeshes.SetItem(item, mesh->second, &ri->World._11);
+	}
+	mSceneBvh.Build();
+}
+
+void CameraApp::BuildEnvironmentProbe()
+{
+	// Stessi formati di back buffer e depth buffer: le facce si disegnano con i PSO del
+	// pass principale.
+	mEnvironmentProbe = std::make_unique<CubeRenderTarget>(md3dDevice.Get(), *mGpuHeapAllocator, mStateTracker,
+		*mSrvHeap, gProbeResolution, mBackBufferFormat, mDepthStencilFormat, Colors::LightSteelBlue);
+
+	// La sonda sta al centro della sfera; il near plane  dentro la sfera, che non viene
+	// disegnata nella cattura.
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&mProbeRItem->Bounds.Center), XMLoadFloat4x4(&mProbeRItem->World)));
+	mProbeCam.SetPosition(center);
+	mProbeCam.SetLens(1.0f, 100.0f);
+
+	for (UINT f = 0; f < CubeCamera::FaceCount; ++f)
+	{
+		RenderView& view = mProbeViews[f];
+		view.Cam = &mProbeCam.GetFace(f);
+		view.Viewport = mEnvironmentProbe->Viewport();
+		view.ScissorRect = mEnvironmentProbe->ScissorRect();
+		view.PassCBIndex = gMaxViews + ShadowCascades::MaxCascades + f;
+		view.Capture = true;
+	}
+}
+
+void CameraApp::Pick(int x, int y)
+{
+	// Le viste sono disegnate alla risoluzione ridotta: il cursore va portato nella stessa scala.
+	float px = (float)x * mRenderWidth / mClientWidth;
+	float py = (float)y * mRenderHeight / mClientHeight;
+
+	// La vista sotto il cursore: il riquadro del picture-in-picture sta sopra l'altra.
+	const RenderView* view = nullptr;
+	for (auto it = mViews.rbegin(); it != mViews.rend() && view == nullptr; ++it)
+	{
+		const D3D12_RECT& rect = it->ScissorRect;
+		if (px >= rect.left && px < rect.right && py >= rect.top && py < rect.bottom)
+			view = &*it;
+	}
+	if (view == nullptr)
+		return;
+
+	RefitSceneBvh();
+
+	// Raggio nello spazio View attraverso il pixel, portato nello spazio World.
+	const Camera* camera = view->Cam;
+	XMFLOAT4X4 P = camera->GetProj4x4f();
+	float vx = (2.0f * (px - view->Viewport.TopLeftX) / view->Viewport.Width - 1.0f) / P(0, 0);
+	float vy = (-2.0f * (py - view->Viewport.TopLeftY) / view->Viewport.Height + 1.0f) / P(1, 1);
+
+	XMMATRIX invView = camera->GetInvView();
+	XMFLOAT3 origin;
+	XMFLOAT3 direction;
+	XMStoreFloat3(&origin, invView.r[3]);
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView)));
+
+	// Un solo raggio: le altre corsie del pacchetto restano inattive (distanza massima 0).
+	BoundsBvh::RayPacket packet = {};
+	packet.OriginX[0] = origin.x;
+	packet.OriginY[0] = origin.y;
+	packet.OriginZ[0] = origin.z;
+	packet.DirectionX[0] = direction.x;
+	packet.DirectionY[0] = direction.y;
+	packet.DirectionZ[0] = direction.z;
+	packet.MaxDistance[0] = camera->GetFarZ();
+
+	BoundsBvh::RayHit hits[4];
+	mSceneBvh.RayCast(packet, hits, &mPickMeshes);
+
+	if (hits[0].Item == BoundsBvh::NoItem)
+	{
+		::OutputDebugStringA("Pick: nothing\n");
+		return;
+	}
+
+	const RenderItem* ri = mSceneRitems[hits[0].Item];
+	std::string message = "Pick: object " + std::to_string(ri->ObjCBIndex) + " at " + std::to_string(hits[0].Distance);
+	if (hits[0].Triangle != BoundsBvh::NoItem)
+		message += ", triangle " + std::to_string(hits[0].Triangle);
+	::OutputDebugStringA((message + "\n").c_str());
+}
+
+void CameraApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const RenderView& view)
 {
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
@@ -1037,18 +3030,27 @@ void CameraApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::v
 	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
 	auto matCB = mCurrFrameResource->MaterialCB->Resource();
 
+	ID3D12PipelineState* currentPso = nullptr;
+
 	// For each render item...
-	for (size_t i = 0; i < ritems.size(); ++i)
+	for (size_t i = 0; i < view.Ritems.size(); ++i)
 	{
-		auto ri = ritems[i];
+		auto ri = view.Ritems[i];
+
+		// Variante dello shader richiesta da vista, materiale e distanza dell'oggetto.
+		ID3D12PipelineState* pso = OpaqueVariant(ShaderKeyFor(ri, view), !view.Capture);
+		if (pso != currentPso)
+		{
+			cmdList->SetPipelineState(pso);
+			currentPso = pso;
+		}
 
 		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
 		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
 		// Recupera l'handle al descriptor (SRV) della texture di tale RenderItem
-		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+		D3D12_GPU_DESCRIPTOR_HANDLE tex = mSrvHeap->GpuHandle(ri->Mat->DiffuseSrvHeapIndex);
 
 		// Collega SRV al root parameter con indice 0 della root signature, 
 		// che  quello con la root descriptor table che ha il range con un solo SRV.
@@ -1068,7 +3070,41 @@ void CameraApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::v
 	}
 }
 
-std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CameraApp::GetStaticSamplers()
+void CameraApp::DrawShadowCasters(ID3D12GraphicsCommandList* cmdList, const std::vector<uint32_t>& casters)
+{
+	// Il PSO delle ombre  gi impostato.
+	for (uint32_t id : casters)
+		DrawDepthOnly(cmdList, mShadowCasterRitems[id]);
+}
+
+void CameraApp::DrawDepthPrepass(ID3D12GraphicsCommandList* cmdList, const RenderView& view)
+{
+	// Il PSO del pre-pass  gi impostato; gli oggetti esclusi dal pre-pass scrivono
+	// la loro profondit nel pass principale.
+	for (const RenderItem* ri : view.Ritems)
+	{
+		if (UsesDepthPrepass(ShaderKeyFor(ri, view)))
+			DrawDepthOnly(cmdList, ri);
+	}
+}
+
+void CameraApp::DrawDepthOnly(ID3D12GraphicsCommandList* cmdList, const RenderItem* ri)
+{
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+
+	// VSShadow legge solo gWorld e gViewProj: basta l'object CB.
+	cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+	cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
+
+	cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+}
+
+std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> CameraApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
 	// and keep them available as part of the root signature.  
@@ -1119,8 +3155,21 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CameraApp::GetStaticSamplers()
 		0.0f,                              // mipLODBias
 		8);                                // maxAnisotropy
 
+	// Confronto per il PCF della shadow map: fuori dalla mappa il punto  illuminato.
+	const CD3DX12_STATIC_SAMPLER_DESC shadow(
+		6, // shaderRegister
+		D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT, // filter
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER,  // addressU
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER,  // addressV
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER,  // addressW
+		0.0f,                               // mipLODBias
+		16,                                 // maxAnisotropy
+		D3D12_COMPARISON_FUNC_LESS_EQUAL,
+		D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE);
+
 	return {
 		pointWrap, pointClamp,
 		linearWrap, linearClamp,
-		anisotropicWrap, anisotropicClamp };
+		anisotropicWrap, anisotropicClamp,
+		shadow };
 }
\ No newline at end of file
@@ -0,0 +1,889 @@
+//***************************************************************************************
+// BoundsBvh.cpp
+//***************************************************************************************
+
+#include "BoundsBvh.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOUNDS_BVH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	const uint32_t BinCount = 16;
+
+	// Past this depth nodes are split at the median, which bounds the traversal stack.
+	const uint32_t MaxSahDepth = 32;
+	const uint32_t MaxStackDepth = 64;
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	float HalfArea(const float mn[3], const float mx[3])
+	{
+		float dx = mx[0] - mn[0];
+		float dy = mx[1] - mn[1];
+		float dz = mx[2] - mn[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	void Grow(float mn[3], float mx[3], const float* itemMin, const float* itemMax)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			mn[i] = std::min<float>(mn[i], itemMin[i]);
+			mx[i] = std::max<float>(mx[i], itemMax[i]);
+		}
+	}
+
+	// Entry and exit distances of the ray through the box grown by radius.
+	void Slabs(const float* mn, const float* mx, float radius, const float origin[3], const float invDir[3],
+		float& tNear, float& tFar)
+	{
+		tNear = -FLT_MAX;
+		tFar = FLT_MAX;
+		for (int i = 0; i < 3; ++i)
+		{
+			float t1 = (mn[i] - radius - origin[i]) * invDir[i];
+			float t2 = (mx[i] + radius - origin[i]) * invDir[i];
+			tNear = std::max<float>(tNear, std::min<float>(t1, t2));
+			tFar = std::min<float>(tFar, std::max<float>(t1, t2));
+		}
+	}
+}
+
+	// Faces of a cube camera at center whose frustum the box touches, and those that contain
+	// it. Face +a sees the points whose coordinate along a (relative to the center) is in
+	// [nearZ, farZ] and at least their distance along the other two axes, so the box touches
+	// it if the part of its extent along a within those bounds reaches past the gap between
+	// the box and the center on the other axes; -a is the same, mirrored.
+	uint32_t CubeFaces(const float* mn, const float* mx, const float center[3], float nearZ, float farZ,
+		uint32_t& inside)
+	{
+		inside = 0;
+
+		float lo[3];
+		float hi[3];
+		float gap[3];
+		float reach[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			lo[i] = mn[i] - center[i];
+			hi[i] = mx[i] - center[i];
+			gap[i] = std::max<float>(0.0f, std::max<float>(lo[i], -hi[i]));
+			reach[i] = std::max<float>(-lo[i], hi[i]);
+
+			// Outside the union of the faces, the cube of side 2 farZ.
+			if (gap[i] > farZ)
+				return 0;
+		}
+
+		uint32_t faces = 0;
+		for (int a = 0; a < 3; ++a)
+		{
+			int b = (a + 1) % 3;
+			int c = (a + 2) % 3;
+			float side = std::max<float>(std::max<float>(gap[b], gap[c]), nearZ);
+			float spread = std::max<float>(reach[b], reach[c]);
+
+			if (std::max<float>(lo[a], side) <= std::min<float>(hi[a], farZ))
+				faces |= 1u << (2 * a);
+			if (std::max<float>(-hi[a], side) <= std::min<float>(-lo[a], farZ))
+				faces |= 2u << (2 * a);
+
+			if (lo[a] >= nearZ && hi[a] <= farZ && spread <= lo[a])
+				inside |= 1u << (2 * a);
+			if (-hi[a] >= nearZ && -lo[a] <= farZ && spread <= -hi[a])
+				inside |= 2u << (2 * a);
+		}
+
+		return faces;
+	}
+
+uint32_t BoundsBvh::Add(const float center[3], const float extents[3])
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		mMin.push_back(center[i] - extents[i]);
+		mMax.push_back(center[i] + extents[i]);
+	}
+	return Count() - 1;
+}
+
+void BoundsBvh::Clear()
+{
+	mMin.clear();
+	mMax.clear();
+	mNodes.clear();
+	mOrder.clear();
+	mSubtreeItems.clear();
+	mStats = Stats();
+}
+
+uint32_t BoundsBvh::Count()const
+{
+	return (uint32_t)(mMin.size() / 3);
+}
+
+void BoundsBvh::Build()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	uint32_t count = Count();
+	mOrder.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		mOrder[i] = i;
+
+	mNodes.clear();
+	mStats = Stats();
+	mStats.ItemCount = count;
+
+	if (count > 0)
+	{
+		// Children are referenced by index, but the array must not move while it is filled.
+		mNodes.reserve(2 * (size_t)count);
+		BuildNode(0, count, 1);
+	}
+
+	// The items below a node are contiguous in mOrder: after its first child, whose own
+	// items start where the node's do, come those of the second.
+	mSubtreeItems.resize(2 * mNodes.size());
+	for (size_t n = mNodes.size(); n-- > 0;)
+	{
+		const Node& node = mNodes[n];
+		if (node.Count > 0)
+		{
+			mSubtreeItems[2 * n] = node.First;
+			mSubtreeItems[2 * n + 1] = node.Count;
+		}
+		else
+		{
+			mSubtreeItems[2 * n] = mSubtreeItems[2 * (n + 1)];
+			mSubtreeItems[2 * n + 1] = mSubtreeItems[2 * (n + 1) + 1] + mSubtreeItems[2 * node.First + 1];
+		}
+	}
+
+	mStats.NodeCount = (uint32_t)mNodes.size();
+	mStats.BuildMs = MillisecondsSince(start);
+}
+
+uint32_t BoundsBvh::BuildNode(uint32_t first, uint32_t count, uint32_t depth)
+{
+	mStats.Depth = std::max<uint32_t>(mStats.Depth, depth);
+
+	uint32_t index = (uint32_t)mNodes.size();
+	mNodes.push_back(Node());
+	Node& node = mNodes.back();
+
+	float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < 3; ++i)
+	{
+		node.Min[i] = FLT_MAX;
+		node.Max[i] = -FLT_MAX;
+	}
+
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const float* itemMin = &mMin[3 * mOrder[i]];
+		const float* itemMax = &mMax[3 * mOrder[i]];
+		Grow(node.Min, node.Max, itemMin, itemMax);
+
+		// Centers doubled, which does not change the partition.
+		float center[3] = { itemMin[0] + itemMax[0], itemMin[1] + itemMax[1], itemMin[2] + itemMax[2] };
+		Grow(centerMin, centerMax, center, center);
+	}
+
+	if (count <= MaxLeafItems)
+	{
+		node.First = first;
+		node.Count = count;
+		return index;
+	}
+
+	int axis = 0;
+	for (int i = 1; i < 3; ++i)
+	{
+		if (centerMax[i] - centerMin[i] > centerMax[axis] - centerMin[axis])
+			axis = i;
+	}
+
+	uint32_t* begin = mOrder.data() + first;
+	uint32_t* end = begin + count;
+	uint32_t* middle = nullptr;
+
+	float span = centerMax[axis] - centerMin[axis];
+	if (span > 0.0f && depth < MaxSahDepth)
+	{
+		float binScale = BinCount / span;
+		auto binOf = [&](uint32_t item)
+		{
+			float center = mMin[3 * item + axis] + mMax[3 * item + axis];
+			return std::min<uint32_t>((uint32_t)((center - centerMin[axis]) * binScale), BinCount - 1);
+		};
+
+		struct Bin
+		{
+			float Min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			uint32_t Count = 0;
+		};
+
+		Bin bins[BinCount];
+		for (uint32_t* item = begin; item != end; ++item)
+		{
+			Bin& bin = bins[binOf(*item)];
+			Grow(bin.Min, bin.Max, &mMin[3 * *item], &mMax[3 * *item]);
+			bin.Count++;
+		}
+
+		// Cost of splitting after bin i: areas of both sides weighted by their counts,
+		// the right sides accumulated from the end first.
+		float rightCost[BinCount];
+		Bin right;
+		for (uint32_t i = BinCount - 1; i > 0; --i)
+		{
+			Grow(right.Min, right.Max, bins[i].Min, bins[i].Max);
+			right.Count += bins[i].Count;
+			rightCost[i - 1] = right.Count > 0 ? HalfArea(right.Min, right.Max) * right.Count : 0.0f;
+		}
+
+		uint32_t bestSplit = 0;
+		float bestCost = FLT_MAX;
+		Bin left;
+		for (uint32_t i = 0; i < BinCount - 1; ++i)
+		{
+			Grow(left.Min, left.Max, bins[i].Min, bins[i].Max);
+			left.Count += bins[i].Count;
+
+			float cost = (left.Count > 0 ? HalfArea(left.Min, left.Max) * left.Count : 0.0f) + rightCost[i];
+			if (left.Count > 0 && left.Count < count && cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		if (bestCost < FLT_MAX)
+			middle = std::partition(begin, end, [&](uint32_t item) { return binOf(item) <= bestSplit; });
+	}
+
+	// Coincident centers (or too deep): half of the boxes on each side.
+	if (middle == nullptr)
+	{
+		middle = begin + count / 2;
+		std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b)
+		{
+			return mMin[3 * a + axis] + mMax[3 * a + axis] < mMin[3 * b + axis] + mMax[3 * b + axis];
+		});
+	}
+
+	uint32_t leftCount = (uint32_t)(middle - begin);
+	BuildNode(first, leftCount, depth + 1);
+	uint32_t second = BuildNode(first + leftCount, count - leftCount, depth + 1);
+
+	mNodes[index].First = second;
+	mNodes[index].Count = 0;
+	return index;
+}
+
+bool BoundsBvh::SphereCast(const float origin[3], const float direction[3], float maxDistance, float radius, Hit& hit)
+{
+	if (mNodes.empty())
+		return false;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// A zero component would give 0 * inf in the slabs; a huge value gives the same planes.
+	float invDir[3];
+	for (int i = 0; i < 3; ++i)
+		invDir[i] = std::fabs(direction[i]) > 1e-20f ? 1.0f / direction[i] : std::copysign(1e20f, direction[i]);
+
+	float best = maxDistance;
+	bool found = false;
+
+	uint64_t nodesVisited = 0;
+	uint64_t itemsTested = 0;
+
+	uint32_t stack[MaxStackDepth];
+	uint32_t stackSize = 0;
+
+	float tNear, tFar;
+	Slabs(mNodes[0].Min, mNodes[0].Max, radius, origin, invDir, tNear, tFar);
+	if (tNear <= tFar && tFar >= 0.0f && tNear <= best)
+		stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = mNodes[stack[--stackSize]];
+		nodesVisited++;
+
+		if (node.Count > 0)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+			{
+				uint32_t item = mOrder[i];
+				itemsTested++;
+
+				Slabs(&mMin[3 * item], &mMax[3 * item], radius, origin, invDir, tNear, tFar);
+
+				// Overlapped at the origin (tNear < 0 < tFar) or missed.
+				if (tNear < 0.0f || tNear > tFar || tNear >= best)
+					continue;
+
+				best = tNear;
+				hit.Distance = tNear;
+				hit.Item = item;
+				found = true;
+			}
+			continue;
+		}
+
+		// The nearer child is visited first; a child entered beyond the best hit is skipped.
+		uint32_t children[2] = { (uint32_t)(&node - mNodes.data()) + 1, node.First };
+		float entry[2];
+		bool visit[2];
+		for (int c = 0; c < 2; ++c)
+		{
+			const Node& child = mNodes[children[c]];
+			Slabs(child.Min, child.Max, radius, origin, invDir, tNear, tFar);
+			entry[c] = std::max<float>(tNear, 0.0f);
+			visit[c] = tNear <= tFar && tFar >= 0.0f && entry[c] <= best;
+		}
+
+		int nearer = entry[1] < entry[0] ? 1 : 0;
+		int farther = 1 - nearer;
+		assert(stackSize + 2 <= MaxStackDepth);
+		if (visit[farther])
+			stack[stackSize++] = children[farther];
+		if (visit[nearer])
+			stack[stackSize++] = children[nearer];
+	}
+
+	mStats.Casts++;
+	mStats.NodesVisited += nodesVisited;
+	mStats.ItemsTested += itemsTested;
+	mStats.CastMs += MillisecondsSince(start);
+
+	return found;
+}
+
+#if BOUNDS_BVH_SSE
+
+uint32_t BoundsBvh::RaySlabs4(const float* mn, const float* mx, const RayPacket& packet, const float invDir[3][4],
+	const float best[4], float tNear[4])
+{
+	const float* origin[3] = { packet.OriginX, packet.OriginY, packet.OriginZ };
+
+	__m128 enter = _mm_setzero_ps();
+	__m128 exit = _mm_loadu_ps(best);
+	for (int i = 0; i < 3; ++i)
+	{
+		__m128 o = _mm_loadu_ps(origin[i]);
+		__m128 inv = _mm_loadu_ps(invDir[i]);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mn[i]), o), inv);
+		__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mx[i]), o), inv);
+		enter = _mm_max_ps(enter, _mm_min_ps(t1, t2));
+		exit = _mm_min_ps(exit, _mm_max_ps(t1, t2));
+	}
+
+	_mm_storeu_ps(tNear, enter);
+	return (uint32_t)_mm_movemask_ps(_mm_cmple_ps(enter, exit));
+}
+
+void BoundsBvh::Classify4(const float* mn, const float* mx, const float planes[6][4][4], uint32_t& outside,
+	uint32_t& straddling)
+{
+	__m128 center[3];
+	__m128 extents[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		center[i] = _mm_set1_ps(0.5f * (mn[i] + mx[i]));
+		extents[i] = _mm_set1_ps(0.5f * (mx[i] - mn[i]));
+	}
+
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	__m128 behind = _mm_setzero_ps();
+	__m128 crossing = _mm_setzero_ps();
+	for (int p = 0; p < 6; ++p)
+	{
+		__m128 distance = _mm_loadu_ps(planes[p][3]);
+		__m128 radius = _mm_setzero_ps();
+		for (int i = 0; i < 3; ++i)
+		{
+			__m128 n = _mm_loadu_ps(planes[p][i]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(n, center[i]));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(signBit, n), extents[i]));
+		}
+
+		behind = _mm_or_ps(behind, _mm_cmplt_ps(distance, _mm_xor_ps(radius, signBit)));
+		crossing = _mm_or_ps(crossing, _mm_cmplt_ps(distance, radius));
+
+		// Most boxes are outside all the frustums, often already behind the first planes.
+		if (_mm_movemask_ps(behind) == 0xf)
+			break;
+	}
+
+	outside = (uint32_t)_mm_movemask_ps(behind);
+	straddling = (uint32_t)_mm_movemask_ps(crossing) & ~outside;
+}
+
+#else
+
+uint32_t BoundsBvh::RaySlabs4(const float* mn, const float* mx, const RayPacket& packet, const float invDir[3][4],
+	const float best[4], float tNear[4])
+{
+	const float* origin[3] = { packet.OriginX, packet.OriginY, packet.OriginZ };
+
+	uint32_t mask = 0;
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		float enter = 0.0f;
+		float exit = best[lane];
+		for (int i = 0; i < 3; ++i)
+		{
+			float t1 = (mn[i] - origin[i][lane]) * invDir[i][lane];
+			float t2 = (mx[i] - origin[i][lane]) * invDir[i][lane];
+			enter = std::max<float>(enter, std::min<float>(t1, t2));
+			exit = std::min<float>(exit, std::max<float>(t1, t2));
+		}
+
+		tNear[lane] = enter;
+		if (enter <= exit)
+			mask |= 1u << lane;
+	}
+	return mask;
+}
+
+void BoundsBvh::Classify4(const float* mn, const float* mx, const float planes[6][4][4], uint32_t& outside,
+	uint32_t& straddling)
+{
+	float center[3];
+	float extents[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		center[i] = 0.5f * (mn[i] + mx[i]);
+		extents[i] = 0.5f * (mx[i] - mn[i]);
+	}
+
+	outside = 0;
+	straddling = 0;
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			float distance = planes[p][3][lane];
+			float radius = 0.0f;
+			for (int i = 0; i < 3; ++i)
+			{
+				distance += planes[p][i][lane] * center[i];
+				radius += std::fabs(planes[p][i][lane]) * extents[i];
+			}
+
+			if (distance < -radius)
+			{
+				outside |= 1u << lane;
+				break;
+			}
+			if (distance < radius)
+				straddling |= 1u << lane;
+		}
+	}
+	straddling &= ~outside;
+}
+
+#endif
+
+void BoundsBvh::RayCast(const RayPacket& packet, RayHit hits[4], ItemTest* test)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Inactive lanes get a negative best distance, which no box can be entered before.
+	float best[4];
+	float invDir[3][4];
+	const float* direction[3] = { packet.DirectionX, packet.DirectionY, packet.DirectionZ };
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		hits[lane] = RayHit();
+		best[lane] = packet.MaxDistance[lane] > 0.0f ? packet.MaxDistance[lane] : -1.0f;
+		for (int i = 0; i < 3; ++i)
+		{
+			float d = direction[i][lane];
+			invDir[i][lane] = std::fabs(d) > 1e-20f ? 1.0f / d : std::copysign(1e20f, d);
+		}
+	}
+
+	uint64_t nodesVisited = 0;
+	uint64_t exactTests = 0;
+
+	uint32_t stack[MaxStackDepth];
+	uint32_t stackSize = 0;
+
+	float tNear[4];
+	if (!mNodes.empty() && RaySlabs4(mNodes[0].Min, mNodes[0].Max, packet, invDir, best, tNear) != 0)
+		stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		uint32_t nodeIndex = stack[--stackSize];
+		const Node& node = mNodes[nodeIndex];
+
+		// The best hits may have improved since the node was pushed.
+		if (RaySlabs4(node.Min, node.Max, packet, invDir, best, tNear) == 0)
+			continue;
+		nodesVisited++;
+
+		if (node.Count > 0)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+			{
+				uint32_t item = mOrder[i];
+				uint32_t mask = RaySlabs4(&mMin[3 * item], &mMax[3 * item], packet, invDir, best, tNear);
+
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					if ((mask & (1u << lane)) == 0)
+						continue;
+
+					float distance = tNear[lane];
+					uint32_t triangle = NoItem;
+					if (test != nullptr)
+					{
+						const float origin[3] = { packet.OriginX[lane], packet.OriginY[lane], packet.OriginZ[lane] };
+						const float dir[3] = { packet.DirectionX[lane], packet.DirectionY[lane], packet.DirectionZ[lane] };
+
+						exactTests++;
+						if (!test->Intersect(item, origin, dir, tNear[lane], best[lane], distance, triangle))
+							continue;
+					}
+
+					best[lane] = distance;
+					hits[lane].Distance = distance;
+					hits[lane].Item = item;
+					hits[lane].Triangle = triangle;
+				}
+			}
+			continue;
+		}
+
+		// The child entered first by the packet is visited first.
+		uint32_t children[2] = { nodeIndex + 1, node.First };
+		float entry[2];
+		uint32_t masks[2];
+		for (int c = 0; c < 2; ++c)
+		{
+			masks[c] = RaySlabs4(mNodes[children[c]].Min, mNodes[children[c]].Max, packet, invDir, best, tNear);
+			entry[c] = FLT_MAX;
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				if ((masks[c] & (1u << lane)) != 0)
+					entry[c] = std::min<float>(entry[c], tNear[lane]);
+			}
+		}
+
+		int nearer = entry[1] < entry[0] ? 1 : 0;
+		int farther = 1 - nearer;
+		assert(stackSize + 2 <= MaxStackDepth);
+		if (masks[farther] != 0)
+			stack[stackSize++] = children[farther];
+		if (masks[nearer] != 0)
+			stack[stackSize++] = children[nearer];
+	}
+
+	mStats.Packets++;
+	mStats.PacketNodesVisited += nodesVisited;
+	mStats.ExactTests += exactTests;
+	mStats.RayMs += MillisecondsSince(start);
+}
+
+void BoundsBvh::CullFrustums(const Frustum* frustums, uint32_t count, std::vector<uint32_t>* visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	assert(count <= MaxFrustums);
+
+	for (uint32_t f = 0; f < count; ++f)
+		visible[f].clear();
+
+	// Frustums in groups of four, tested together: planes[group][plane][component][lane].
+	// The lanes past the last frustum have a plane nothing is in front of.
+	const uint32_t groupCount = (count + 3) / 4;
+	float planes[MaxFrustums / 4][6][4][4];
+	for (uint32_t f = 0; f < 4 * groupCount; ++f)
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				float unused = i == 3 ? -1.0f : 0.0f;
+				planes[f / 4][p][i][f % 4] = f < count ? frustums[f].Planes[p][i] : unused;
+			}
+		}
+	}
+
+	uint64_t nodesVisited = 0;
+	uint64_t boxTests = 0;
+
+	// Frustums a node straddles are tested again on its children; frustums that contain
+	// it see everything below it.
+	struct Entry
+	{
+		uint32_t Node;
+		uint32_t Straddling;
+		uint32_t Inside;
+	};
+
+	Entry stack[MaxStackDepth];
+	uint32_t stackSize = 0;
+	if (!mNodes.empty() && count > 0)
+		stack[stackSize++] = { 0, count == 32 ? 0xffffffff : (1u << count) - 1, 0 };
+
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		const Node& node = mNodes[entry.Node];
+		nodesVisited++;
+
+		uint32_t straddling = 0;
+		uint32_t inside = entry.Inside;
+		for (uint32_t g = 0; g < groupCount; ++g)
+		{
+			uint32_t tested = (entry.Straddling >> (4 * g)) & 0xf;
+			if (tested == 0)
+				continue;
+
+			boxTests++;
+			uint32_t outsideLanes;
+			uint32_t straddlingLanes;
+			Classify4(node.Min, node.Max, planes[g], outsideLanes, straddlingLanes);
+			straddling |= (tested & straddlingLanes) << (4 * g);
+			inside |= (tested & ~(outsideLanes | straddlingLanes)) << (4 * g);
+		}
+
+		if ((straddling | inside) == 0)
+			continue;
+
+		// Contained by all the frustums that see it: its items, without going down.
+		if (straddling == 0)
+		{
+			const uint32_t* items = &mOrder[mSubtreeItems[2 * entry.Node]];
+			uint32_t itemCount = mSubtreeItems[2 * entry.Node + 1];
+			for (uint32_t f = 0; f < count; ++f)
+			{
+				if ((inside & (1u << f)) != 0)
+					visible[f].insert(visible[f].end(), items, items + itemCount);
+			}
+			continue;
+		}
+
+		if (node.Count > 0)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+			{
+				uint32_t item = mOrder[i];
+
+				uint32_t seen = inside;
+				for (uint32_t g = 0; g < groupCount; ++g)
+				{
+					uint32_t tested = (straddling >> (4 * g)) & 0xf;
+					if (tested == 0)
+						continue;
+
+					boxTests++;
+					uint32_t outsideLanes;
+					uint32_t straddlingLanes;
+					Classify4(&mMin[3 * item], &mMax[3 * item], planes[g], outsideLanes, straddlingLanes);
+					seen |= (tested & ~outsideLanes) << (4 * g);
+				}
+
+				for (uint32_t f = 0; f < count; ++f)
+				{
+					if ((seen & (1u << f)) != 0)
+						visible[f].push_back(item);
+				}
+			}
+			continue;
+		}
+
+		// The first child is popped first, so the items come out in the order of the tree.
+		assert(stackSize + 2 <= MaxStackDepth);
+		stack[stackSize++] = { node.First, straddling, inside };
+		stack[stackSize++] = { entry.Node + 1, straddling, inside };
+	}
+
+	mStats.Culls++;
+	mStats.CullNodesVisited += nodesVisited;
+	mStats.CullBoxTests += boxTests;
+	mStats.CullMs += MillisecondsSince(start);
+}
+
+void BoundsBvh::CullCube(const float center[3], float nearZ, float farZ, std::vector<uint32_t>* visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t f = 0; f < CubeFaceCount; ++f)
+		visible[f].clear();
+
+	uint64_t nodesVisited = 0;
+	uint64_t boxTests = 0;
+
+	// As in CullFrustums: faces a node straddles are tested again on its children, faces
+	// that contain it see everything below it.
+	struct Entry
+	{
+		uint32_t Node;
+		uint32_t Straddling;
+		uint32_t Inside;
+	};
+
+	const uint32_t allFaces = (1u << CubeFaceCount) - 1;
+
+	Entry stack[MaxStackDepth];
+	uint32_t stackSize = 0;
+	if (!mNodes.empty())
+		stack[stackSize++] = { 0, allFaces, 0 };
+
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		const Node& node = mNodes[entry.Node];
+		nodesVisited++;
+
+		boxTests++;
+		uint32_t contained;
+		uint32_t touched = CubeFaces(node.Min, node.Max, center, nearZ, farZ, contained);
+		uint32_t inside = entry.Inside | (entry.Straddling & contained);
+		uint32_t straddling = entry.Straddling & touched & ~contained;
+
+		if ((straddling | inside) == 0)
+			continue;
+
+		if (straddling == 0)
+		{
+			const uint32_t* items = &mOrder[mSubtreeItems[2 * entry.Node]];
+			uint32_t itemCount = mSubtreeItems[2 * entry.Node + 1];
+			for (uint32_t f = 0; f < CubeFaceCount; ++f)
+			{
+				if ((inside & (1u << f)) != 0)
+					visible[f].insert(visible[f].end(), items, items + itemCount);
+			}
+			continue;
+		}
+
+		if (node.Count > 0)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+			{
+				uint32_t item = mOrder[i];
+
+				// Face mask of the item: one test, whatever the number of faces it is split to.
+				boxTests++;
+				uint32_t unused;
+				uint32_t seen = inside | (straddling & CubeFaces(&mMin[3 * item], &mMax[3 * item], center, nearZ, farZ, unused));
+				for (uint32_t f = 0; f < CubeFaceCount; ++f)
+				{
+					if ((seen & (1u << f)) != 0)
+						visible[f].push_back(item);
+				}
+			}
+			continue;
+		}
+
+		assert(stackSize + 2 <= MaxStackDepth);
+		stack[stackSize++] = { node.First, straddling, inside };
+		stack[stackSize++] = { entry.Node + 1, straddling, inside };
+	}
+
+	mStats.CubeCulls++;
+	mStats.CubeNodesVisited += nodesVisited;
+	mStats.CubeBoxTests += boxTests;
+	mStats.CubeCullMs += MillisecondsSince(start);
+}
+
+void BoundsBvh::SetBounds(uint32_t item, const float center[3], const float extents[3])
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		mMin[3 * item + i] = center[i] - extents[i];
+		mMax[3 * item + i] = center[i] + extents[i];
+	}
+}
+
+void BoundsBvh::Refit()
+{
+	// Children follow their parent in the array: going backwards, they are refitted first.
+	for (size_t n = mNodes.size(); n-- > 0;)
+	{
+		Node& node = mNodes[n];
+		for (int i = 0; i < 3; ++i)
+		{
+			node.Min[i] = FLT_MAX;
+			node.Max[i] = -FLT_MAX;
+		}
+
+		if (node.Count > 0)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+				Grow(node.Min, node.Max, &mMin[3 * mOrder[i]], &mMax[3 * mOrder[i]]);
+		}
+		else
+		{
+			Grow(node.Min, node.Max, mNodes[n + 1].Min, mNodes[n + 1].Max);
+			Grow(node.Min, node.Max, mNodes[node.First].Min, mNodes[node.First].Max);
+		}
+	}
+}
+
+const BoundsBvh::Stats& BoundsBvh::GetStats()const
+{
+	return mStats;
+}
+
+std::string BoundsBvh::Report()const
+{
+	double casts = (double)std::max<uint64_t>(mStats.Casts, 1);
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"BoundsBvh: %u boxes, %u nodes, depth %u, built in %.3f ms; %llu casts, %.1f nodes and %.1f boxes per cast, %.3f us per cast",
+		mStats.ItemCount, mStats.NodeCount, mStats.Depth, mStats.BuildMs, (unsigned long long)mStats.Casts,
+		mStats.NodesVisited / casts, mStats.ItemsTested / casts, 1000.0 * mStats.CastMs / casts);
+
+	std::string report = buffer;
+	if (mStats.Packets > 0)
+	{
+		double packets = (double)mStats.Packets;
+		snprintf(buffer, sizeof(buffer), "; %llu ray packets, %.1f nodes and %.1f exact tests per packet, %.3f us per packet",
+			(unsigned long long)mStats.Packets, mStats.PacketNodesVisited / packets, mStats.ExactTests / packets,
+			1000.0 * mStats.RayMs / packets);
+		report += buffer;
+	}
+
+	if (mStats.Culls > 0)
+	{
+		double culls = (double)mStats.Culls;
+		snprintf(buffer, sizeof(buffer), "; %llu frustum culls, %.1f nodes and %.1f box tests per cull, %.3f us per cull",
+			(unsigned long long)mStats.Culls, mStats.CullNodesVisited / culls, mStats.CullBoxTests / culls,
+			1000.0 * mStats.CullMs / culls);
+		report += buffer;
+	}
+
+	if (mStats.CubeCulls > 0)
+	{
+		double culls = (double)mStats.CubeCulls;
+		snprintf(buffer, sizeof(buffer), "; %llu cube culls, %.1f nodes and %.1f box tests per cull, %.3f us per cull",
+			(unsigned long long)mStats.CubeCulls, mStats.CubeNodesVisited / culls, mStats.CubeBoxTests / culls,
+			1000.0 * mStats.CubeCullMs / culls);
+		report += buffer;
+	}
+
+	return report;
+}
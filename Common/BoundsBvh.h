@@ -0,0 +1,190 @@
+//***************************************************************************************
+// BoundsBvh.h
+//
+// Bounding volume hierarchy over axis-aligned boxes (e.g. the world bounds of the
+// render items), for queries that must not touch every object.
+//   -Built top-down with a binned surface area heuristic on the box centers, at most
+//    four boxes per leaf. Nodes are stored depth-first in one array: the first child
+//    of an inner node follows it, the second is referenced by index.
+//   -SphereCast sweeps a sphere along a segment and returns the nearest box it touches.
+//    Boxes are grown by the radius and hit with a ray, which is exact on the faces and
+//    a little conservative near edges and corners (the rounded corners are treated as
+//    square). Boxes the sphere already overlaps at the origin are ignored, so a cast
+//    that starts against (or inside) an object is not stopped by it. Children are
+//    visited nearest first and subtrees beyond the best hit are skipped.
+//   -RayCast traces packets of four rays together: every node is tested against the
+//    four with SSE (scalar fallback elsewhere) and entered if any of them reaches it
+//    nearer than its best hit. Hits are on the boxes, or exact if an ItemTest is given
+//    (e.g. MeshRayTest, against the triangles of the item).
+//   -CullFrustums finds the boxes seen by several frustums (e.g. the cameras of a
+//    split screen) in one traversal: a node is tested only against the frustums it
+//    straddles, and a subtree a frustum contains is visible to it without further tests.
+//   -CullCube does the same for the six faces of a cube map camera (e.g. an environment
+//    probe): every box is tested once against their union, the cube of side 2 farZ around
+//    the camera, and the faces it touches come as a mask from comparing its extent along
+//    each axis with its distance from the camera on the other two, with no plane tests.
+//    The per-face lists are built in the same traversal.
+//   -SetBounds and Refit follow moving items without rebuilding the tree.
+//   -Boxes are given as center and extents, like DirectX::BoundingBox.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BoundsBvh
+{
+public:
+	struct Hit
+	{
+		// Distance along the direction at which the sphere touches the box.
+		float Distance = 0.0f;
+		uint32_t Item = 0;
+	};
+
+	// Four rays, as structure of arrays. Lanes with MaxDistance <= 0 are inactive.
+	struct RayPacket
+	{
+		float OriginX[4];
+		float OriginY[4];
+		float OriginZ[4];
+		float DirectionX[4];
+		float DirectionY[4];
+		float DirectionZ[4];
+		float MaxDistance[4];
+	};
+
+	struct RayHit
+	{
+		// Item is NoItem if the ray hit nothing; Triangle is NoItem for a hit on a box.
+		float Distance = 0.0f;
+		uint32_t Item = NoItem;
+		uint32_t Triangle = NoItem;
+	};
+
+	// Six planes (a, b, c, d), normals pointing inside: a point is inside if
+	// a*x + b*y + c*z + d >= 0 for all of them, as Camera::GetFrustumPlanes gives them.
+	struct Frustum
+	{
+		float Planes[6][4];
+	};
+
+	// Exact test of an item against a ray, made only where the ray enters the item's box
+	// (at boxDistance) nearer than the best hit so far (maxDistance).
+	class ItemTest
+	{
+	public:
+		virtual ~ItemTest() = default;
+		virtual bool Intersect(uint32_t item, const float origin[3], const float direction[3], float boxDistance,
+			float maxDistance, float& distance, uint32_t& triangle) = 0;
+	};
+
+	struct Stats
+	{
+		uint32_t ItemCount = 0;
+		uint32_t NodeCount = 0;
+		uint32_t Depth = 0;
+		double BuildMs = 0.0;
+
+		// Casts since the last build, with the nodes and boxes they tested.
+		uint64_t Casts = 0;
+		uint64_t NodesVisited = 0;
+		uint64_t ItemsTested = 0;
+		double CastMs = 0.0;
+
+		// Ray packets since the last build, with the nodes they entered and the exact
+		// item tests they made.
+		uint64_t Packets = 0;
+		uint64_t PacketNodesVisited = 0;
+		uint64_t ExactTests = 0;
+		double RayMs = 0.0;
+
+		// Frustum culls since the last build, with the nodes they entered and the box
+		// tests they made (each against up to four frustums at once).
+		uint64_t Culls = 0;
+		uint64_t CullNodesVisited = 0;
+		uint64_t CullBoxTests = 0;
+		double CullMs = 0.0;
+
+		// Cube camera culls since the last build, with the nodes they entered and the box
+		// tests they made (each against all six faces at once).
+		uint64_t CubeCulls = 0;
+		uint64_t CubeNodesVisited = 0;
+		uint64_t CubeBoxTests = 0;
+		double CubeCullMs = 0.0;
+	};
+
+	// Items are numbered in the order they are added; Build must follow.
+	uint32_t Add(const float center[3], const float extents[3]);
+	void Clear();
+	uint32_t Count()const;
+
+	void Build();
+
+	// Sweeps a sphere from origin along the unit direction for up to maxDistance.
+	// Returns false if it touches nothing.
+	bool SphereCast(const float origin[3], const float direction[3], float maxDistance, float radius, Hit& hit);
+
+	// Nearest hit of each ray of the packet (hits[i] for lane i). Rays starting inside a
+	// box hit it at distance 0 unless an exact test says otherwise.
+	void RayCast(const RayPacket& packet, RayHit hits[4], ItemTest* test = nullptr);
+
+	// Items whose box touches frustum i, in visible[i], for count frustums (at most
+	// MaxFrustums). The order of the items is the same for all of them.
+	void CullFrustums(const Frustum* frustums, uint32_t count, std::vector<uint32_t>* visible);
+
+	// Items whose box touches face i of a cube camera at center, in visible[i], for the
+	// CubeFaceCount faces in cube map order (+x, -x, +y, -y, +z, -z). Each face is a 90
+	// degree frustum from nearZ to farZ along its axis. The order of the items is the same
+	// for all of them.
+	void CullCube(const float center[3], float nearZ, float farZ, std::vector<uint32_t>* visible);
+
+	// Moves an item; the tree is correct again (if less tight) after Refit.
+	void SetBounds(uint32_t item, const float center[3], const float extents[3]);
+	void Refit();
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+	static const uint32_t MaxLeafItems = 4;
+	static const uint32_t NoItem = 0xffffffff;
+	static const uint32_t MaxFrustums = 32;
+	static const uint32_t CubeFaceCount = 6;
+
+private:
+	struct Node
+	{
+		float Min[3];
+		float Max[3];
+
+		// Leaf: items [First, First + Count) of mOrder. Inner node (Count == 0): index of
+		// the second child.
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	uint32_t BuildNode(uint32_t first, uint32_t count, uint32_t depth);
+
+	// Mask of the lanes that enter the box nearer than their best hit, and where.
+	static uint32_t RaySlabs4(const float* mn, const float* mx, const RayPacket& packet, const float invDir[3][4],
+		const float best[4], float tNear[4]);
+
+	// Masks of the four frustums (planes[plane][component][frustum]) the box is outside
+	// of, and of those it straddles.
+	static void Classify4(const float* mn, const float* mx, const float planes[6][4][4], uint32_t& outside,
+		uint32_t& straddling);
+
+private:
+	std::vector<float> mMin;
+	std::vector<float> mMax;
+
+	std::vector<Node> mNodes;
+	std::vector<uint32_t> mOrder;
+
+	// First item (in mOrder) and number of items below each node.
+	std::vector<uint32_t> mSubtreeItems;
+
+	Stats mStats;
+};
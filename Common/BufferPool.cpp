@@ -0,0 +1,66 @@
+//***************************************************************************************
+// BufferPool.cpp
+//***************************************************************************************
+
+#include "BufferPool.h"
+
+BufferPool::BufferPool(GpuHeapAllocator& allocator, UINT64 byteSize, D3D12_HEAP_TYPE heapType) :
+	mAllocator(allocator),
+	mRanges(byteSize)
+{
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+
+	mBuffer = allocator.CreateResource(bufferDesc, heapType,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, mAllocation);
+
+	if (heapType == D3D12_HEAP_TYPE_UPLOAD)
+		ThrowIfFailed(mBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+
+	mGpuAddress = mBuffer->GetGPUVirtualAddress();
+}
+
+BufferPool::~BufferPool()
+{
+	if (mMappedData != nullptr)
+		mBuffer->Unmap(0, nullptr);
+
+	mBuffer = nullptr;
+	mAllocator.Free(mAllocation);
+}
+
+BufferRange BufferPool::Allocate(UINT64 byteSize, UINT64 alignment)
+{
+	TlsfAllocator::Allocation range = mRanges.Allocate(byteSize, alignment);
+	if (!range.IsValid())
+		throw DxException(E_OUTOFMEMORY, L"BufferPool::Allocate", AnsiToWString(__FILE__), __LINE__);
+
+	BufferRange bufferRange;
+	bufferRange.Resource = mBuffer.Get();
+	bufferRange.Offset = range.Offset;
+	bufferRange.Size = byteSize;
+	bufferRange.GpuAddress = mGpuAddress + range.Offset;
+	bufferRange.CpuAddress = mMappedData != nullptr ? mMappedData + range.Offset : nullptr;
+	bufferRange.Range = range;
+
+	return bufferRange;
+}
+
+void BufferPool::Free(BufferRange& range)
+{
+	if (!range.IsValid())
+		return;
+
+	assert(range.Resource == mBuffer.Get());
+	mRanges.Free(range.Range);
+	range = BufferRange();
+}
+
+ID3D12Resource* BufferPool::Resource()const
+{
+	return mBuffer.Get();
+}
+
+TlsfAllocator::Stats BufferPool::GetStats()const
+{
+	return mRanges.GetStats();
+}
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// BufferPool.h
+//
+// One big buffer from which many small buffers (vertex/index buffers, structured
+// buffers, ...) are sub-allocated as ranges.
+//   -A range is just an offset in the shared resource, so there is no per-buffer
+//    resource, heap or 64 KB alignment to pay for.
+//   -Ranges come from a TlsfAllocator: freed ranges are merged with their neighbours
+//    and the pool never needs to be defragmented.
+//   -The buffer itself is placed through a GpuHeapAllocator and stays in the
+//    GENERIC_READ state; writes to a DEFAULT heap pool go through copy commands.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuHeapAllocator.h"
+
+struct BufferRange
+{
+	ID3D12Resource* Resource = nullptr;
+	UINT64 Offset = 0;
+	UINT64 Size = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+
+	// Only valid for pools on the upload heap.
+	BYTE* CpuAddress = nullptr;
+
+	TlsfAllocator::Allocation Range;
+
+	bool IsValid()const { return Resource != nullptr; }
+};
+
+class BufferPool
+{
+public:
+	BufferPool(GpuHeapAllocator& allocator, UINT64 byteSize,
+		D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT);
+	BufferPool(const BufferPool& rhs) = delete;
+	BufferPool& operator=(const BufferPool& rhs) = delete;
+	~BufferPool();
+
+	// Throws E_OUTOFMEMORY when no free range is large enough.
+	// 256 byte alignment makes every range usable as a constant buffer too.
+	BufferRange Allocate(UINT64 byteSize, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	// The GPU must be done with the range.
+	void Free(BufferRange& range);
+
+	ID3D12Resource* Resource()const;
+	TlsfAllocator::Stats GetStats()const;
+
+private:
+	GpuHeapAllocator& mAllocator;
+	GpuAllocation mAllocation;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer;
+	BYTE* mMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS mGpuAddress = 0;
+
+	TlsfAllocator mRanges;
+};
@@ -0,0 +1,473 @@
+//***************************************************************************************
+// CameraBatch.cpp
+//***************************************************************************************
+
+#include "CameraBatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAMERA_BATCH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// The few four-wide operations the batch needs, so that the SSE and the scalar
+	// builds share one implementation of every camera operation.
+#if CAMERA_BATCH_SSE
+	typedef __m128 Lanes;
+
+	inline Lanes Load(const float* p) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+	inline Lanes Splat(float s) { return _mm_set1_ps(s); }
+	inline Lanes Plus(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+	inline Lanes Minus(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+	inline Lanes Times(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+	inline Lanes Over(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+	inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+	inline Lanes NotZero(Lanes a) { return _mm_cmpneq_ps(a, _mm_setzero_ps()); }
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	inline bool Any(Lanes mask) { return _mm_movemask_ps(mask) != 0; }
+#else
+	struct Lanes
+	{
+		float v[4];
+	};
+
+	template<typename Op>
+	inline Lanes Map(Lanes a, Lanes b, Op op)
+	{
+		Lanes r;
+		for (int i = 0; i < 4; ++i)
+			r.v[i] = op(a.v[i], b.v[i]);
+		return r;
+	}
+
+	inline Lanes Load(const float* p) { Lanes r; std::copy(p, p + 4, r.v); return r; }
+	inline void Store(float* p, Lanes a) { std::copy(a.v, a.v + 4, p); }
+	inline Lanes Splat(float s) { Lanes r = { { s, s, s, s } }; return r; }
+	inline Lanes Plus(Lanes a, Lanes b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+	inline Lanes Minus(Lanes a, Lanes b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+	inline Lanes Times(Lanes a, Lanes b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+	inline Lanes Over(Lanes a, Lanes b) { return Map(a, b, [](float x, float y) { return x / y; }); }
+	inline Lanes Sqrt(Lanes a) { return Map(a, a, [](float x, float) { return std::sqrt(x); }); }
+	inline Lanes NotZero(Lanes a) { return Map(a, a, [](float x, float) { return x != 0.0f ? 1.0f : 0.0f; }); }
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b)
+	{
+		Lanes r;
+		for (int i = 0; i < 4; ++i)
+			r.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i];
+		return r;
+	}
+	inline bool Any(Lanes mask) { return mask.v[0] != 0.0f || mask.v[1] != 0.0f || mask.v[2] != 0.0f || mask.v[3] != 0.0f; }
+#endif
+
+	struct Vec3Lanes
+	{
+		Lanes X, Y, Z;
+	};
+
+	inline Vec3Lanes Load3(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, uint32_t i)
+	{
+		return { Load(&x[i]), Load(&y[i]), Load(&z[i]) };
+	}
+
+	inline void Store3(std::vector<float>& x, std::vector<float>& y, std::vector<float>& z, uint32_t i, const Vec3Lanes& v)
+	{
+		Store(&x[i], v.X);
+		Store(&y[i], v.Y);
+		Store(&z[i], v.Z);
+	}
+
+	inline Lanes Dot(const Vec3Lanes& a, const Vec3Lanes& b)
+	{
+		return Plus(Plus(Times(a.X, b.X), Times(a.Y, b.Y)), Times(a.Z, b.Z));
+	}
+
+	inline Vec3Lanes Cross(const Vec3Lanes& a, const Vec3Lanes& b)
+	{
+		return {
+			Minus(Times(a.Y, b.Z), Times(a.Z, b.Y)),
+			Minus(Times(a.Z, b.X), Times(a.X, b.Z)),
+			Minus(Times(a.X, b.Y), Times(a.Y, b.X)) };
+	}
+
+	// Length through sqrt and a division, like XMVector3Normalize.
+	inline Vec3Lanes Normalize(const Vec3Lanes& v)
+	{
+		Lanes length = Sqrt(Dot(v, v));
+		return { Over(v.X, length), Over(v.Y, length), Over(v.Z, length) };
+	}
+
+	// v * s + p, like XMVectorMultiplyAdd.
+	inline Vec3Lanes MultiplyAdd(const Vec3Lanes& v, Lanes s, const Vec3Lanes& p)
+	{
+		return { Plus(Times(v.X, s), p.X), Plus(Times(v.Y, s), p.Y), Plus(Times(v.Z, s), p.Z) };
+	}
+
+	inline Vec3Lanes Select3(Lanes mask, const Vec3Lanes& a, const Vec3Lanes& b)
+	{
+		return { Select(mask, a.X, b.X), Select(mask, a.Y, b.Y), Select(mask, a.Z, b.Z) };
+	}
+
+	// Rotation of v about the unit axis k (Rodrigues), given the sine and cosine of the angle.
+	inline Vec3Lanes Rotate(const Vec3Lanes& v, const Vec3Lanes& k, Lanes s, Lanes c)
+	{
+		Vec3Lanes kv = Cross(k, v);
+		Lanes kd = Times(Dot(k, v), Minus(Splat(1.0f), c));
+		return {
+			Plus(Plus(Times(v.X, c), Times(kv.X, s)), Times(k.X, kd)),
+			Plus(Plus(Times(v.Y, c), Times(kv.Y, s)), Times(k.Y, kd)),
+			Plus(Plus(Times(v.Z, c), Times(kv.Z, s)), Times(k.Z, kd)) };
+	}
+
+	// Per-camera amounts of the group starting at index, zero past the last camera.
+	inline Lanes LoadAmounts(const float* amounts, uint32_t index, uint32_t count)
+	{
+		if (index + 4 <= count)
+			return Load(amounts + index);
+
+		float padded[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		std::copy(amounts + index, amounts + count, padded);
+		return Load(padded);
+	}
+
+	void Normalize3(const float v[3], float out[3])
+	{
+		float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		out[0] = v[0] / length;
+		out[1] = v[1] / length;
+		out[2] = v[2] / length;
+	}
+
+	void Cross3(const float a[3], const float b[3], float out[3])
+	{
+		float x = a[1] * b[2] - a[2] * b[1];
+		float y = a[2] * b[0] - a[0] * b[2];
+		float z = a[0] * b[1] - a[1] * b[0];
+		out[0] = x;
+		out[1] = y;
+		out[2] = z;
+	}
+}
+
+uint32_t CameraBatch::Add()
+{
+	uint32_t index = mCount++;
+	uint32_t padded = (mCount + 3) & ~3u;
+
+	// New lanes (real or padding) start as Camera's default: origin, looking down +z.
+	auto grow = [padded](std::vector<float>& v, float value) { v.resize(padded, value); };
+	grow(mPosX, 0.0f);
+	grow(mPosY, 0.0f);
+	grow(mPosZ, 0.0f);
+	grow(mRightX, 1.0f);
+	grow(mRightY, 0.0f);
+	grow(mRightZ, 0.0f);
+	grow(mUpX, 0.0f);
+	grow(mUpY, 1.0f);
+	grow(mUpZ, 0.0f);
+	grow(mLookX, 0.0f);
+	grow(mLookY, 0.0f);
+	grow(mLookZ, 1.0f);
+	grow(mViewDirty, 0.0f);
+
+	mFovY.push_back(0.0f);
+	mAspect.push_back(0.0f);
+	mNearZ.push_back(0.0f);
+	mFarZ.push_back(0.0f);
+	mLensDirty.push_back(0);
+	mViews.resize(16 * (size_t)mCount, 0.0f);
+	mProjs.resize(16 * (size_t)mCount, 0.0f);
+	mVersions.push_back(0);
+
+	mViewDirty[index] = 1.0f;
+	SetLens(index, 0.25f * 3.1415926535f, 1.0f, 1.0f, 1000.0f);
+
+	return index;
+}
+
+void CameraBatch::Clear()
+{
+	*this = CameraBatch();
+}
+
+uint32_t CameraBatch::Count()const
+{
+	return mCount;
+}
+
+void CameraBatch::SetPosition(uint32_t index, const float position[3])
+{
+	mPosX[index] = position[0];
+	mPosY[index] = position[1];
+	mPosZ[index] = position[2];
+	mViewDirty[index] = 1.0f;
+}
+
+void CameraBatch::LookAt(uint32_t index, const float position[3], const float target[3], const float worldUp[3])
+{
+	// Same construction as Camera::LookAt.
+	float look[3] = { target[0] - position[0], target[1] - position[1], target[2] - position[2] };
+	Normalize3(look, look);
+
+	float right[3];
+	Cross3(worldUp, look, right);
+	Normalize3(right, right);
+
+	float up[3];
+	Cross3(look, right, up);
+
+	SetPosition(index, position);
+	mRightX[index] = right[0];
+	mRightY[index] = right[1];
+	mRightZ[index] = right[2];
+	mUpX[index] = up[0];
+	mUpY[index] = up[1];
+	mUpZ[index] = up[2];
+	mLookX[index] = look[0];
+	mLookY[index] = look[1];
+	mLookZ[index] = look[2];
+}
+
+void CameraBatch::SetLens(uint32_t index, float fovY, float aspect, float zn, float zf)
+{
+	mFovY[index] = fovY;
+	mAspect[index] = aspect;
+	mNearZ[index] = zn;
+	mFarZ[index] = zf;
+	mLensDirty[index] = 1;
+}
+
+void CameraBatch::MarkDirty(const float* amounts)
+{
+	for (uint32_t i = 0; i < mCount; ++i)
+	{
+		if (amounts[i] != 0.0f)
+			mViewDirty[i] = 1.0f;
+	}
+}
+
+void CameraBatch::Strafe(const float* distances)
+{
+	for (uint32_t i = 0; i < mCount; i += 4)
+	{
+		Lanes d = LoadAmounts(distances, i, mCount);
+		Vec3Lanes p = Load3(mPosX, mPosY, mPosZ, i);
+		Vec3Lanes r = Load3(mRightX, mRightY, mRightZ, i);
+		Store3(mPosX, mPosY, mPosZ, i, MultiplyAdd(r, d, p));
+	}
+
+	MarkDirty(distances);
+}
+
+void CameraBatch::Walk(const float* distances)
+{
+	for (uint32_t i = 0; i < mCount; i += 4)
+	{
+		Lanes d = LoadAmounts(distances, i, mCount);
+		Vec3Lanes p = Load3(mPosX, mPosY, mPosZ, i);
+		Vec3Lanes l = Load3(mLookX, mLookY, mLookZ, i);
+		Store3(mPosX, mPosY, mPosZ, i, MultiplyAdd(l, d, p));
+	}
+
+	MarkDirty(distances);
+}
+
+void CameraBatch::Pitch(const float* angles)
+{
+	// Up and look turn about right (normalized, as XMMatrixRotationAxis does).
+	for (uint32_t i = 0; i < mCount; i += 4)
+	{
+		float s[4], c[4];
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			float angle = i + k < mCount ? angles[i + k] : 0.0f;
+			s[k] = std::sin(angle);
+			c[k] = std::cos(angle);
+		}
+
+		Lanes sines = Load(s);
+		Lanes cosines = Load(c);
+		Vec3Lanes axis = Normalize(Load3(mRightX, mRightY, mRightZ, i));
+		Vec3Lanes u = Load3(mUpX, mUpY, mUpZ, i);
+		Vec3Lanes l = Load3(mLookX, mLookY, mLookZ, i);
+
+		Store3(mUpX, mUpY, mUpZ, i, Rotate(u, axis, sines, cosines));
+		Store3(mLookX, mLookY, mLookZ, i, Rotate(l, axis, sines, cosines));
+	}
+
+	MarkDirty(angles);
+}
+
+void CameraBatch::RotateY(const float* angles)
+{
+	// The whole basis turns about the world y axis (XMMatrixRotationY).
+	for (uint32_t i = 0; i < mCount; i += 4)
+	{
+		float s[4], c[4];
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			float angle = i + k < mCount ? angles[i + k] : 0.0f;
+			s[k] = std::sin(angle);
+			c[k] = std::cos(angle);
+		}
+
+		Lanes sines = Load(s);
+		Lanes cosines = Load(c);
+
+		std::vector<float>* axes[3][2] = {
+			{ &mRightX, &mRightZ },
+			{ &mUpX, &mUpZ },
+			{ &mLookX, &mLookZ } };
+
+		for (auto& axis : axes)
+		{
+			Lanes x = Load(&(*axis[0])[i]);
+			Lanes z = Load(&(*axis[1])[i]);
+			Store(&(*axis[0])[i], Plus(Times(x, cosines), Times(z, sines)));
+			Store(&(*axis[1])[i], Minus(Times(z, cosines), Times(x, sines)));
+		}
+	}
+
+	MarkDirty(angles);
+}
+
+void CameraBatch::Update()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mStats = Stats();
+	mStats.CameraCount = mCount;
+
+	for (uint32_t i = 0; i < mCount; i += 4)
+	{
+		Lanes dirty = NotZero(Load(&mViewDirty[i]));
+		if (!Any(dirty))
+			continue;
+
+		Vec3Lanes r = Load3(mRightX, mRightY, mRightZ, i);
+		Vec3Lanes u = Load3(mUpX, mUpY, mUpZ, i);
+		Vec3Lanes l = Load3(mLookX, mLookY, mLookZ, i);
+		Vec3Lanes p = Load3(mPosX, mPosY, mPosZ, i);
+
+		// Re-orthonormalization of Camera::UpdateViewMatrix. Cameras that did not change
+		// keep their basis untouched.
+		Vec3Lanes newL = Normalize(l);
+		Vec3Lanes newU = Normalize(Cross(newL, r));
+		Vec3Lanes newR = Cross(newU, newL);
+
+		r = Select3(dirty, newR, r);
+		u = Select3(dirty, newU, u);
+		l = Select3(dirty, newL, l);
+		Store3(mRightX, mRightY, mRightZ, i, r);
+		Store3(mUpX, mUpY, mUpZ, i, u);
+		Store3(mLookX, mLookY, mLookZ, i, l);
+
+		Lanes zero = Splat(0.0f);
+		float tx[4], ty[4], tz[4];
+		Store(tx, Minus(zero, Dot(p, r)));
+		Store(ty, Minus(zero, Dot(p, u)));
+		Store(tz, Minus(zero, Dot(p, l)));
+
+		for (uint32_t k = 0; k < 4 && i + k < mCount; ++k)
+		{
+			uint32_t index = i + k;
+			if (mViewDirty[index] == 0.0f)
+				continue;
+
+			float* v = &mViews[16 * (size_t)index];
+			v[0] = mRightX[index]; v[1] = mUpX[index]; v[2] = mLookX[index]; v[3] = 0.0f;
+			v[4] = mRightY[index]; v[5] = mUpY[index]; v[6] = mLookY[index]; v[7] = 0.0f;
+			v[8] = mRightZ[index]; v[9] = mUpZ[index]; v[10] = mLookZ[index]; v[11] = 0.0f;
+			v[12] = tx[k]; v[13] = ty[k]; v[14] = tz[k]; v[15] = 1.0f;
+
+			mViewDirty[index] = 0.0f;
+			++mVersions[index];
+			++mStats.ViewsUpdated;
+		}
+	}
+
+	// Lenses rarely change; the projection is per camera.
+	for (uint32_t i = 0; i < mCount; ++i)
+	{
+		if (!mLensDirty[i])
+			continue;
+
+		BuildProj(i);
+		mLensDirty[i] = 0;
+		++mVersions[i];
+		++mStats.ProjsUpdated;
+	}
+
+	mStats.UpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void CameraBatch::BuildProj(uint32_t index)
+{
+	// XMMatrixPerspectiveFovLH.
+	float height = std::cos(0.5f * mFovY[index]) / std::sin(0.5f * mFovY[index]);
+	float width = height / mAspect[index];
+	float range = mFarZ[index] / (mFarZ[index] - mNearZ[index]);
+
+	float* p = &mProjs[16 * (size_t)index];
+	std::fill(p, p + 16, 0.0f);
+	p[0] = width;
+	p[5] = height;
+	p[10] = range;
+	p[11] = 1.0f;
+	p[14] = -range * mNearZ[index];
+}
+
+const float* CameraBatch::View(uint32_t index)const
+{
+	return &mViews[16 * (size_t)index];
+}
+
+const float* CameraBatch::Proj(uint32_t index)const
+{
+	return &mProjs[16 * (size_t)index];
+}
+
+void CameraBatch::GetPosition(uint32_t index, float position[3])const
+{
+	position[0] = mPosX[index];
+	position[1] = mPosY[index];
+	position[2] = mPosZ[index];
+}
+
+void CameraBatch::GetBasis(uint32_t index, float right[3], float up[3], float look[3])const
+{
+	right[0] = mRightX[index];
+	right[1] = mRightY[index];
+	right[2] = mRightZ[index];
+	up[0] = mUpX[index];
+	up[1] = mUpY[index];
+	up[2] = mUpZ[index];
+	look[0] = mLookX[index];
+	look[1] = mLookY[index];
+	look[2] = mLookZ[index];
+}
+
+uint64_t CameraBatch::Version(uint32_t index)const
+{
+	return mVersions[index];
+}
+
+const CameraBatch::Stats& CameraBatch::GetStats()const
+{
+	return mStats;
+}
+
+std::string CameraBatch::Report()const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"CameraBatch: %u cameras, %u views and %u projections rebuilt, %.3f ms",
+		mStats.CameraCount, mStats.ViewsUpdated, mStats.ProjsUpdated, mStats.UpdateMs);
+
+	return buffer;
+}
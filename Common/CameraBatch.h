@@ -0,0 +1,87 @@
+//***************************************************************************************
+// CameraBatch.h
+//
+// State of many cameras (shadow cascades, probes, split-screen views) updated together.
+//   -Position and basis are stored as structure of arrays and every operation runs on
+//    four cameras at a time with SSE (scalar fallback elsewhere), with no XMFLOAT3
+//    round-trips per camera.
+//   -The operations and the view/projection matrices are the same as Camera's: Update
+//    re-orthonormalizes the basis and rebuilds the view of the cameras that changed,
+//    and the projection (XMMatrixPerspectiveFovLH layout) of those whose lens changed.
+//   -Matrices are row-major and transform row vectors, like DirectXMath's: View and
+//    Proj can be loaded with XMLoadFloat4x4 or copied into constant buffers.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CameraBatch
+{
+public:
+	struct Stats
+	{
+		uint32_t CameraCount = 0;
+		uint32_t ViewsUpdated = 0;
+		uint32_t ProjsUpdated = 0;
+		double UpdateMs = 0.0;
+	};
+
+	// Adds a camera at the origin looking down +z, with Camera's default lens.
+	uint32_t Add();
+	void Clear();
+	uint32_t Count()const;
+
+	void SetPosition(uint32_t index, const float position[3]);
+	void LookAt(uint32_t index, const float position[3], const float target[3], const float worldUp[3]);
+	void SetLens(uint32_t index, float fovY, float aspect, float zn, float zf);
+
+	// One amount per camera (Count() values); zero leaves a camera untouched.
+	void Strafe(const float* distances);
+	void Walk(const float* distances);
+	void Pitch(const float* angles);
+	void RotateY(const float* angles);
+
+	// Rebuilds the matrices of the cameras changed since the last update.
+	void Update();
+
+	// 16 floats, row-major.
+	const float* View(uint32_t index)const;
+	const float* Proj(uint32_t index)const;
+
+	void GetPosition(uint32_t index, float position[3])const;
+	void GetBasis(uint32_t index, float right[3], float up[3], float look[3])const;
+
+	// Incremented whenever the view or the projection of the camera is rebuilt.
+	uint64_t Version(uint32_t index)const;
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+private:
+	void MarkDirty(const float* amounts);
+	void BuildProj(uint32_t index);
+
+private:
+	uint32_t mCount = 0;
+
+	// Padded to a multiple of four; padding lanes hold a valid basis and are never read back.
+	std::vector<float> mPosX, mPosY, mPosZ;
+	std::vector<float> mRightX, mRightY, mRightZ;
+	std::vector<float> mUpX, mUpY, mUpZ;
+	std::vector<float> mLookX, mLookY, mLookZ;
+
+	// 1.0f where the view must be rebuilt (kept as float to be usable as a lane mask).
+	std::vector<float> mViewDirty;
+
+	std::vector<float> mFovY, mAspect, mNearZ, mFarZ;
+	std::vector<uint8_t> mLensDirty;
+
+	std::vector<float> mViews;
+	std::vector<float> mProjs;
+	std::vector<uint64_t> mVersions;
+
+	Stats mStats;
+};
@@ -0,0 +1,163 @@
+//***************************************************************************************
+// CameraPath.cpp
+//***************************************************************************************
+
+#include "CameraPath.h"
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Hermite segment from p1 (s = 0) to p2 (s = 1) with tangents m1 and m2.
+	float Hermite(float p1, float p2, float m1, float m2, float s)
+	{
+		float s2 = s * s;
+		float s3 = s2 * s;
+		return (2.0f * s3 - 3.0f * s2 + 1.0f) * p1 + (s3 - 2.0f * s2 + s) * m1 +
+			(-2.0f * s3 + 3.0f * s2) * p2 + (s3 - s2) * m2;
+	}
+
+	void Normalize(float v[3])
+	{
+		float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length > 0.0f)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	void Cross(const float a[3], const float b[3], float out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+}
+
+void CameraPath::AddKey(float time, const float position[3], const float target[3])
+{
+	assert(mKeys.empty() || time > mKeys.back().Time);
+
+	Key key;
+	key.Time = time;
+	for (int i = 0; i < 3; ++i)
+	{
+		key.Position[i] = position[i];
+		key.Target[i] = target[i];
+	}
+	mKeys.push_back(key);
+}
+
+void CameraPath::Clear()
+{
+	mKeys.clear();
+}
+
+uint32_t CameraPath::KeyCount()const
+{
+	return (uint32_t)mKeys.size();
+}
+
+float CameraPath::Duration()const
+{
+	return mKeys.empty() ? 0.0f : mKeys.back().Time - mKeys.front().Time;
+}
+
+void CameraPath::SetLens(float fovY, float aspect, float zn, float zf)
+{
+	mLens.FovY = fovY;
+	mLens.Aspect = aspect;
+	mLens.NearZ = zn;
+	mLens.FarZ = zf;
+}
+
+CameraState CameraPath::Sample(float time)const
+{
+	CameraState camera = mLens;
+	if (mKeys.empty())
+		return camera;
+
+	float position[3];
+	float target[3];
+
+	if (mKeys.size() == 1 || time <= mKeys.front().Time)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			position[i] = mKeys.front().Position[i];
+			target[i] = mKeys.front().Target[i];
+		}
+	}
+	else if (time >= mKeys.back().Time)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			position[i] = mKeys.back().Position[i];
+			target[i] = mKeys.back().Target[i];
+		}
+	}
+	else
+	{
+		// Segment [k1, k2] containing time; k0 and k3 are its neighbours (repeated at the ends).
+		size_t k2 = 1;
+		while (mKeys[k2].Time < time)
+			k2++;
+		size_t k1 = k2 - 1;
+		size_t k0 = k1 > 0 ? k1 - 1 : k1;
+		size_t k3 = k2 + 1 < mKeys.size() ? k2 + 1 : k2;
+
+		const Key& key0 = mKeys[k0];
+		const Key& key1 = mKeys[k1];
+		const Key& key2 = mKeys[k2];
+		const Key& key3 = mKeys[k3];
+
+		float duration = key2.Time - key1.Time;
+		float s = (time - key1.Time) / duration;
+
+		// Tangents in units per segment: (p2 - p0) / (t2 - t0) * (t2 - t1), and likewise at p2.
+		float scale1 = duration / (key2.Time - key0.Time);
+		float scale2 = duration / (key3.Time - key1.Time);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			position[i] = Hermite(key1.Position[i], key2.Position[i],
+				(key2.Position[i] - key0.Position[i]) * scale1, (key3.Position[i] - key1.Position[i]) * scale2, s);
+			target[i] = Hermite(key1.Target[i], key2.Target[i],
+				(key2.Target[i] - key0.Target[i]) * scale1, (key3.Target[i] - key1.Target[i]) * scale2, s);
+		}
+	}
+
+	float look[3] = { target[0] - position[0], target[1] - position[1], target[2] - position[2] };
+	Normalize(look);
+
+	// Same basis as Camera::LookAt: right = worldUp x look, up = look x right.
+	const float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+	float right[3];
+	Cross(worldUp, look, right);
+	Normalize(right);
+
+	float up[3];
+	Cross(look, right, up);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		camera.Position[i] = position[i];
+		camera.Look[i] = look[i];
+		camera.Up[i] = up[i];
+	}
+
+	return camera;
+}
+
+void CameraPath::Bake(float framesPerSecond, CameraRecording& recording)const
+{
+	if (mKeys.empty())
+		return;
+
+	float dt = 1.0f / framesPerSecond;
+	uint32_t frameCount = (uint32_t)std::floor(Duration() * framesPerSecond) + 1;
+	for (uint32_t i = 0; i < frameCount; ++i)
+		recording.AddCameraFrame(dt, Sample(mKeys.front().Time + i * dt));
+}
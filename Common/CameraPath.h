@@ -0,0 +1,48 @@
+//***************************************************************************************
+// CameraPath.h
+//
+// Flythrough defined by keyframes (time, position, point looked at).
+//   -Position and target follow Catmull-Rom splines through the keys. Tangents are the
+//    finite differences of the neighbouring keys scaled by the segment duration, so
+//    keys need not be evenly spaced in time and the speed stays continuous across them;
+//    the end keys are repeated to close the first and last segments.
+//   -The camera looks at the target with +y as world up and the basis is built like
+//    Camera::LookAt's.
+//   -Bake samples the path at a fixed rate into a CameraRecording, so a flythrough is
+//    the same sequence of views whatever the frame rate.
+//***************************************************************************************
+
+#pragma once
+
+#include "CameraRecording.h"
+#include <vector>
+
+class CameraPath
+{
+public:
+	// Keys must be added in increasing time order.
+	void AddKey(float time, const float position[3], const float target[3]);
+	void Clear();
+
+	uint32_t KeyCount()const;
+	float Duration()const;
+
+	void SetLens(float fovY, float aspect, float zn, float zf);
+
+	// Camera at the given time, clamped to the path.
+	CameraState Sample(float time)const;
+
+	// Appends one frame every 1 / framesPerSecond seconds, from the first key to the last.
+	void Bake(float framesPerSecond, CameraRecording& recording)const;
+
+private:
+	struct Key
+	{
+		float Time;
+		float Position[3];
+		float Target[3];
+	};
+
+	std::vector<Key> mKeys;
+	CameraState mLens;
+};
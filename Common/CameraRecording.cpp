@@ -0,0 +1,265 @@
+//***************************************************************************************
+// CameraRecording.cpp
+//***************************************************************************************
+
+#include "CameraRecording.h"
+#include "MappedFile.h"
+#include <cassert>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const char Magic[4] = { 'C', 'R', 'E', 'C' };
+	const size_t HeaderSize = 24;
+	const size_t FrameSize = 60;
+	const size_t SampleSize = 12;
+	const size_t EventSize = 17;
+
+	// Both targets are little-endian, so values are copied as they are in memory.
+	template<typename T>
+	void Put(std::vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	template<typename T>
+	T Get(const uint8_t*& in)
+	{
+		T value;
+		memcpy(&value, in, sizeof(T));
+		in += sizeof(T);
+		return value;
+	}
+
+	void PutCamera(std::vector<uint8_t>& out, const CameraState& camera)
+	{
+		for (int i = 0; i < 3; ++i)
+			Put(out, camera.Position[i]);
+		for (int i = 0; i < 3; ++i)
+			Put(out, camera.Look[i]);
+		for (int i = 0; i < 3; ++i)
+			Put(out, camera.Up[i]);
+		Put(out, camera.FovY);
+		Put(out, camera.Aspect);
+		Put(out, camera.NearZ);
+		Put(out, camera.FarZ);
+	}
+
+	CameraState GetCamera(const uint8_t*& in)
+	{
+		CameraState camera;
+		for (int i = 0; i < 3; ++i)
+			camera.Position[i] = Get<float>(in);
+		for (int i = 0; i < 3; ++i)
+			camera.Look[i] = Get<float>(in);
+		for (int i = 0; i < 3; ++i)
+			camera.Up[i] = Get<float>(in);
+		camera.FovY = Get<float>(in);
+		camera.Aspect = Get<float>(in);
+		camera.NearZ = Get<float>(in);
+		camera.FarZ = Get<float>(in);
+		return camera;
+	}
+}
+
+void CameraRecording::Clear()
+{
+	mFlags = 0;
+	mFrames.clear();
+	mSamples.clear();
+	mEvents.clear();
+}
+
+void CameraRecording::SetFlags(uint32_t flags)
+{
+	mFlags = flags;
+}
+
+uint32_t CameraRecording::Flags()const
+{
+	return mFlags;
+}
+
+void CameraRecording::BeginFrame(float deltaTime)
+{
+	Frame frame;
+	frame.DeltaTime = deltaTime;
+	frame.FirstSample = (uint32_t)mSamples.size();
+	mFrames.push_back(frame);
+}
+
+void CameraRecording::AddSample(double time, const std::vector<InputEvent>& events)
+{
+	assert(!mFrames.empty());
+
+	Sample sample;
+	sample.Time = time;
+	sample.FirstEvent = (uint32_t)mEvents.size();
+	sample.EventCount = (uint32_t)events.size();
+	mSamples.push_back(sample);
+	mEvents.insert(mEvents.end(), events.begin(), events.end());
+
+	mFrames.back().SampleCount++;
+}
+
+void CameraRecording::EndFrame(const CameraState& camera)
+{
+	assert(!mFrames.empty());
+	mFrames.back().Camera = camera;
+}
+
+void CameraRecording::AddCameraFrame(float deltaTime, const CameraState& camera)
+{
+	BeginFrame(deltaTime);
+	EndFrame(camera);
+}
+
+uint32_t CameraRecording::FrameCount()const
+{
+	return (uint32_t)mFrames.size();
+}
+
+const CameraRecording::Frame& CameraRecording::GetFrame(uint32_t index)const
+{
+	return mFrames[index];
+}
+
+const CameraRecording::Sample& CameraRecording::GetSample(uint32_t index)const
+{
+	return mSamples[index];
+}
+
+const InputEvent& CameraRecording::GetEvent(uint32_t index)const
+{
+	return mEvents[index];
+}
+
+void CameraRecording::PushSample(uint32_t index, InputSystem& input)const
+{
+	const Sample& sample = mSamples[index];
+	for (uint32_t i = 0; i < sample.EventCount; ++i)
+		input.Push(mEvents[sample.FirstEvent + i]);
+}
+
+bool CameraRecording::Save(const std::wstring& filename)const
+{
+	std::vector<uint8_t> data;
+	data.reserve(HeaderSize + mFrames.size() * FrameSize + mSamples.size() * SampleSize + mEvents.size() * EventSize);
+
+	data.insert(data.end(), Magic, Magic + 4);
+	Put(data, (uint32_t)Version);
+	Put(data, mFlags);
+	Put(data, (uint32_t)mFrames.size());
+	Put(data, (uint32_t)mSamples.size());
+	Put(data, (uint32_t)mEvents.size());
+
+	for (const Frame& frame : mFrames)
+	{
+		Put(data, frame.DeltaTime);
+		Put(data, frame.SampleCount);
+		PutCamera(data, frame.Camera);
+	}
+
+	for (const Sample& sample : mSamples)
+	{
+		Put(data, sample.Time);
+		Put(data, sample.EventCount);
+	}
+
+	// Event times are stored relative to their sample: a float keeps them to well under
+	// a microsecond.
+	for (const Sample& sample : mSamples)
+	{
+		for (uint32_t i = 0; i < sample.EventCount; ++i)
+		{
+			const InputEvent& e = mEvents[sample.FirstEvent + i];
+			Put(data, (uint8_t)e.Type);
+			Put(data, e.Code);
+			Put(data, e.X);
+			Put(data, e.Y);
+			Put(data, (float)(e.Time - sample.Time));
+		}
+	}
+
+#ifdef _WIN32
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+#else
+	std::ofstream fout(std::string(filename.begin(), filename.end()), std::ios::binary | std::ios::trunc);
+#endif
+	fout.write((const char*)data.data(), data.size());
+	return (bool)fout;
+}
+
+bool CameraRecording::Load(const std::wstring& filename)
+{
+	Clear();
+
+	MappedFile file;
+	if (!file.Open(filename) || file.Size() < HeaderSize || memcmp(file.Data(), Magic, 4) != 0)
+		return false;
+
+	const uint8_t* in = file.Data() + 4;
+	uint32_t version = Get<uint32_t>(in);
+	uint32_t flags = Get<uint32_t>(in);
+	uint32_t frameCount = Get<uint32_t>(in);
+	uint32_t sampleCount = Get<uint32_t>(in);
+	uint32_t eventCount = Get<uint32_t>(in);
+
+	uint64_t expected = HeaderSize + (uint64_t)frameCount * FrameSize + (uint64_t)sampleCount * SampleSize +
+		(uint64_t)eventCount * EventSize;
+	if (version != Version || file.Size() != expected)
+		return false;
+
+	mFrames.resize(frameCount);
+	uint64_t firstSample = 0;
+	for (Frame& frame : mFrames)
+	{
+		frame.DeltaTime = Get<float>(in);
+		frame.SampleCount = Get<uint32_t>(in);
+		frame.Camera = GetCamera(in);
+		frame.FirstSample = (uint32_t)firstSample;
+		firstSample += frame.SampleCount;
+	}
+
+	mSamples.resize(sampleCount);
+	uint64_t firstEvent = 0;
+	for (Sample& sample : mSamples)
+	{
+		sample.Time = Get<double>(in);
+		sample.EventCount = Get<uint32_t>(in);
+		sample.FirstEvent = (uint32_t)firstEvent;
+		firstEvent += sample.EventCount;
+	}
+
+	if (firstSample != sampleCount || firstEvent != eventCount)
+	{
+		Clear();
+		return false;
+	}
+
+	mEvents.resize(eventCount);
+	for (const Sample& sample : mSamples)
+	{
+		for (uint32_t i = 0; i < sample.EventCount; ++i)
+		{
+			uint8_t type = Get<uint8_t>(in);
+			if (type > (uint8_t)InputEventType::KeyHeld)
+			{
+				Clear();
+				return false;
+			}
+
+			InputEvent& e = mEvents[sample.FirstEvent + i];
+			e.Type = (InputEventType)type;
+			e.Code = Get<uint32_t>(in);
+			e.X = Get<int32_t>(in);
+			e.Y = Get<int32_t>(in);
+			e.Time = sample.Time + Get<float>(in);
+		}
+	}
+
+	mFlags = flags;
+	return true;
+}
@@ -0,0 +1,92 @@
+//***************************************************************************************
+// CameraRecording.h
+//
+// Per-frame camera state and input of a session, for replaying it exactly.
+//   -Every frame stores its delta time, the camera it was rendered with (position,
+//    basis and lens) and the input samples taken during it: the time of each
+//    InputSystem update and the events it consumed.
+//   -Replaying the samples through an InputSystem with the same bindings, with the
+//    recorded delta times driving the simulation, reproduces the session without
+//    live input. Replaying the camera states reproduces the exact view sequence; that
+//    needs nothing but this file (e.g. CameraBatch::LookAt and SetLens on any platform).
+//   -Binary file, little-endian, fields packed without padding:
+//      header  "CREC", uint32 version, uint32 flags, uint32 frames, samples, events
+//      frame   float deltaTime, uint32 sampleCount, 13 floats of CameraState
+//      sample  double time, uint32 eventCount
+//      event   uint8 type, uint32 code, int32 x, int32 y, float time - sample time
+//    Frames, then samples, then events, each in order; 60, 12 and 17 bytes.
+//***************************************************************************************
+
+#pragma once
+
+#include "InputSystem.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CameraState
+{
+	float Position[3] = { 0.0f, 0.0f, 0.0f };
+	float Look[3] = { 0.0f, 0.0f, 1.0f };
+	float Up[3] = { 0.0f, 1.0f, 0.0f };
+	float FovY = 0.25f * 3.1415926535f;
+	float Aspect = 1.0f;
+	float NearZ = 1.0f;
+	float FarZ = 1000.0f;
+};
+
+class CameraRecording
+{
+public:
+	struct Frame
+	{
+		float DeltaTime = 0.0f;
+		CameraState Camera;
+		uint32_t FirstSample = 0;
+		uint32_t SampleCount = 0;
+	};
+
+	struct Sample
+	{
+		double Time = 0.0;
+		uint32_t FirstEvent = 0;
+		uint32_t EventCount = 0;
+	};
+
+	void Clear();
+
+	// Application-defined bits saved with the recording (e.g. which camera was active).
+	void SetFlags(uint32_t flags);
+	uint32_t Flags()const;
+
+	// Recording: BeginFrame, any number of AddSample, EndFrame.
+	void BeginFrame(float deltaTime);
+	void AddSample(double time, const std::vector<InputEvent>& events);
+	void EndFrame(const CameraState& camera);
+
+	// Frames of a path, without input (see CameraPath::Bake).
+	void AddCameraFrame(float deltaTime, const CameraState& camera);
+
+	uint32_t FrameCount()const;
+	const Frame& GetFrame(uint32_t index)const;
+	const Sample& GetSample(uint32_t index)const;
+	const InputEvent& GetEvent(uint32_t index)const;
+
+	// Pushes the events of a sample into an input system; they keep their recorded times.
+	void PushSample(uint32_t index, InputSystem& input)const;
+
+	// Return false if the file cannot be written, or cannot be read or is not a
+	// recording of this version (the recording is left empty).
+	bool Save(const std::wstring& filename)const;
+	bool Load(const std::wstring& filename);
+
+	// 2: wheel events in InputSystem::WheelUnitsPerStep units instead of whole steps.
+	// 3: keys held when the recording starts are KeyHeld events instead of KeyDown.
+	static const uint32_t Version = 3;
+
+private:
+	uint32_t mFlags = 0;
+	std::vector<Frame> mFrames;
+	std::vector<Sample> mSamples;
+	std::vector<InputEvent> mEvents;
+};
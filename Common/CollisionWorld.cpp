@@ -0,0 +1,323 @@
+//***************************************************************************************
+// CollisionWorld.cpp
+//***************************************************************************************
+
+#include "CollisionWorld.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+CollisionWorld::CollisionWorld(float cellSize)
+	: mCellSize(cellSize), mInvCellSize(1.0f / cellSize)
+{
+}
+
+uint32_t CollisionWorld::AddStatic(const float center[3], const float extents[3])
+{
+	Body body;
+	for (int i = 0; i < 3; ++i)
+	{
+		body.Min[i] = center[i] - extents[i];
+		body.Max[i] = center[i] + extents[i];
+	}
+	body.Mover = false;
+	body.Stamp = 0;
+	CellRange(body.Min, body.Max, body.CellMin, body.CellMax);
+
+	mBodies.push_back(body);
+	Insert((uint32_t)mBodies.size() - 1);
+
+	mStats.StaticCount++;
+	return (uint32_t)mBodies.size() - 1;
+}
+
+uint32_t CollisionWorld::AddMover(const float center[3], const float extents[3])
+{
+	uint32_t id = AddStatic(center, extents);
+	mBodies[id].Mover = true;
+
+	mStats.StaticCount--;
+	mStats.MoverCount++;
+	return id;
+}
+
+void CollisionWorld::Clear()
+{
+	mBodies.clear();
+	mCells.clear();
+	mStamp = 0;
+	mStats = Stats();
+}
+
+void CollisionWorld::SetPosition(uint32_t mover, const float center[3])
+{
+	Body& body = mBodies[mover];
+	assert(body.Mover);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float extent = 0.5f * (body.Max[i] - body.Min[i]);
+		body.Min[i] = center[i] - extent;
+		body.Max[i] = center[i] + extent;
+	}
+	UpdateCells(mover);
+}
+
+void CollisionWorld::GetPosition(uint32_t body, float center[3])const
+{
+	for (int i = 0; i < 3; ++i)
+		center[i] = 0.5f * (mBodies[body].Min[i] + mBodies[body].Max[i]);
+}
+
+bool CollisionWorld::Move(uint32_t mover, const float displacement[3])
+{
+	Body& body = mBodies[mover];
+	assert(body.Mover);
+
+	float extents[3];
+	float center[3];
+	float remaining[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		extents[i] = 0.5f * (body.Max[i] - body.Min[i]);
+		center[i] = body.Min[i] + extents[i];
+		remaining[i] = displacement[i];
+	}
+
+	bool hitAnything = false;
+
+	for (uint32_t slide = 0; slide < MaxSlides; ++slide)
+	{
+		float length = std::sqrt(remaining[0] * remaining[0] + remaining[1] * remaining[1] + remaining[2] * remaining[2]);
+		if (length <= 0.0f)
+			break;
+
+		mStats.Sweeps++;
+
+		// Cells of the box swept along what is left of the displacement.
+		float sweptMin[3];
+		float sweptMax[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			sweptMin[i] = std::min<float>(body.Min[i], body.Min[i] + remaining[i]) - Skin;
+			sweptMax[i] = std::max<float>(body.Max[i], body.Max[i] + remaining[i]) + Skin;
+		}
+
+		int32_t cellMin[3];
+		int32_t cellMax[3];
+		CellRange(sweptMin, sweptMax, cellMin, cellMax);
+
+		if (++mStamp == 0)
+		{
+			for (Body& b : mBodies)
+				b.Stamp = 0;
+			mStamp = 1;
+		}
+		body.Stamp = mStamp;
+
+		float firstHit = 1.0f;
+		int hitAxis = -1;
+
+		for (int32_t z = cellMin[2]; z <= cellMax[2]; ++z)
+		for (int32_t y = cellMin[1]; y <= cellMax[1]; ++y)
+		for (int32_t x = cellMin[0]; x <= cellMax[0]; ++x)
+		{
+			auto cell = mCells.find(CellKey(x, y, z));
+			if (cell == mCells.end())
+				continue;
+
+			for (uint32_t other : cell->second)
+			{
+				Body& obstacle = mBodies[other];
+				if (obstacle.Stamp == mStamp)
+					continue;
+				obstacle.Stamp = mStamp;
+
+				mStats.CandidatesTested++;
+
+				// Ray from the center of the mover against the obstacle grown by its extents.
+				float tEnter = -FLT_MAX;
+				float tExit = FLT_MAX;
+				int enterAxis = -1;
+				bool miss = false;
+				for (int i = 0; i < 3 && !miss; ++i)
+				{
+					float lo = obstacle.Min[i] - extents[i];
+					float hi = obstacle.Max[i] + extents[i];
+					if (remaining[i] == 0.0f)
+					{
+						// Moving parallel to the slab: only a hit if already between its planes.
+						miss = center[i] <= lo || center[i] >= hi;
+						continue;
+					}
+
+					float t1 = (lo - center[i]) / remaining[i];
+					float t2 = (hi - center[i]) / remaining[i];
+					if (t1 > t2)
+						std::swap(t1, t2);
+
+					if (t1 > tEnter)
+					{
+						tEnter = t1;
+						enterAxis = i;
+					}
+					tExit = std::min<float>(tExit, t2);
+				}
+
+				if (miss || enterAxis < 0 || tEnter >= tExit)
+					continue;
+
+				// Overlapping at the start (entered before it, left after it): ignored so the
+				// mover can get out. Entered and left before the start: behind the mover.
+				if (tEnter < 0.0f)
+				{
+					if (tExit > 0.0f)
+						mStats.StartOverlaps++;
+					continue;
+				}
+
+				if (tEnter >= firstHit)
+					continue;
+
+				firstHit = tEnter;
+				hitAxis = enterAxis;
+			}
+		}
+
+		if (hitAxis < 0)
+		{
+			for (int i = 0; i < 3; ++i)
+				center[i] += remaining[i];
+			break;
+		}
+
+		hitAnything = true;
+		mStats.Hits++;
+
+		// Stops a skin short of the hit, then slides: the rest of the displacement loses
+		// its component along the normal (an axis, for boxes).
+		float moved = std::max<float>(firstHit - Skin / length, 0.0f);
+		for (int i = 0; i < 3; ++i)
+		{
+			center[i] += remaining[i] * moved;
+			remaining[i] *= 1.0f - firstHit;
+		}
+		remaining[hitAxis] = 0.0f;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			body.Min[i] = center[i] - extents[i];
+			body.Max[i] = center[i] + extents[i];
+		}
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		body.Min[i] = center[i] - extents[i];
+		body.Max[i] = center[i] + extents[i];
+	}
+	UpdateCells(mover);
+
+	mStats.Moves++;
+
+	return hitAnything;
+}
+
+void CollisionWorld::CellRange(const float mn[3], const float mx[3], int32_t cellMin[3], int32_t cellMax[3])const
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		cellMin[i] = (int32_t)std::floor(mn[i] * mInvCellSize);
+		cellMax[i] = (int32_t)std::floor(mx[i] * mInvCellSize);
+	}
+}
+
+uint64_t CollisionWorld::CellKey(int32_t x, int32_t y, int32_t z)
+{
+	// 21 bits per coordinate: +-1M cells on each axis.
+	const uint64_t mask = (1ull << 21) - 1;
+	return ((uint64_t)(uint32_t)x & mask) | (((uint64_t)(uint32_t)y & mask) << 21) | (((uint64_t)(uint32_t)z & mask) << 42);
+}
+
+void CollisionWorld::Insert(uint32_t id)
+{
+	const Body& body = mBodies[id];
+	for (int32_t z = body.CellMin[2]; z <= body.CellMax[2]; ++z)
+	for (int32_t y = body.CellMin[1]; y <= body.CellMax[1]; ++y)
+	for (int32_t x = body.CellMin[0]; x <= body.CellMax[0]; ++x)
+		mCells[CellKey(x, y, z)].push_back(id);
+
+	mStats.CellCount = (uint32_t)mCells.size();
+}
+
+void CollisionWorld::Remove(uint32_t id)
+{
+	const Body& body = mBodies[id];
+	for (int32_t z = body.CellMin[2]; z <= body.CellMax[2]; ++z)
+	for (int32_t y = body.CellMin[1]; y <= body.CellMax[1]; ++y)
+	for (int32_t x = body.CellMin[0]; x <= body.CellMax[0]; ++x)
+	{
+		// Cells left empty are kept: a mover going back and forth reuses their storage.
+		std::vector<uint32_t>& ids = mCells[CellKey(x, y, z)];
+		auto it = std::find(ids.begin(), ids.end(), id);
+		assert(it != ids.end());
+		*it = ids.back();
+		ids.pop_back();
+	}
+}
+
+void CollisionWorld::UpdateCells(uint32_t id)
+{
+	Body& body = mBodies[id];
+
+	int32_t cellMin[3];
+	int32_t cellMax[3];
+	CellRange(body.Min, body.Max, cellMin, cellMax);
+
+	bool same = true;
+	for (int i = 0; i < 3; ++i)
+		same = same && cellMin[i] == body.CellMin[i] && cellMax[i] == body.CellMax[i];
+	if (same)
+		return;
+
+	Remove(id);
+	for (int i = 0; i < 3; ++i)
+	{
+		body.CellMin[i] = cellMin[i];
+		body.CellMax[i] = cellMax[i];
+	}
+	Insert(id);
+
+	mStats.CellUpdates++;
+}
+
+const CollisionWorld::Stats& CollisionWorld::GetStats()const
+{
+	return mStats;
+}
+
+void CollisionWorld::ResetStats()
+{
+	mStats.Moves = 0;
+	mStats.Sweeps = 0;
+	mStats.CandidatesTested = 0;
+	mStats.Hits = 0;
+	mStats.CellUpdates = 0;
+	mStats.StartOverlaps = 0;
+}
+
+std::string CollisionWorld::Report()const
+{
+	double moves = (double)std::max<uint64_t>(mStats.Moves, 1);
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"CollisionWorld: %u static, %u movers, %u cells; %llu moves, %.2f sweeps, %.1f candidates, %.2f hits, %.2f cell updates, %llu start overlaps",
+		mStats.StaticCount, mStats.MoverCount, mStats.CellCount, (unsigned long long)mStats.Moves,
+		mStats.Sweeps / moves, mStats.CandidatesTested / moves, mStats.Hits / moves, mStats.CellUpdates / moves,
+		(unsigned long long)mStats.StartOverlaps);
+
+	return buffer;
+}
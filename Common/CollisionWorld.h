@@ -0,0 +1,100 @@
+//***************************************************************************************
+// CollisionWorld.h
+//
+// Moving boxes (the player, props) against static boxes (the level), and each other.
+//   -Every body is an axis-aligned box stored in a uniform spatial hash: a body is listed
+//    in every cell its box overlaps. Statics are inserted once; a mover is moved between
+//    cells only when the range of cells it overlaps changes, so the work per frame
+//    depends on the movers and on what lies around them, not on the size of the level.
+//   -Move sweeps a mover along a displacement against the bodies in the cells of the
+//    swept box. The sweep of a box against a box is a ray against their Minkowski sum,
+//    so the time of impact is exact. The mover stops a small skin short of the first
+//    hit, the displacement left loses its component along the hit normal and the sweep
+//    repeats, so the mover slides along walls and around corners.
+//   -Bodies the mover already overlaps are ignored, so a mover that starts inside
+//    something can always move out of it; there is no depenetration, it is not pushed
+//    out either. Such overlaps are counted in the stats. Other movers are obstacles
+//    where they are.
+//   -Boxes are given as center and extents, like DirectX::BoundingBox.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CollisionWorld
+{
+public:
+	struct Stats
+	{
+		uint32_t StaticCount = 0;
+		uint32_t MoverCount = 0;
+		uint32_t CellCount = 0;
+
+		// Since the last ResetStats.
+		uint64_t Moves = 0;
+		uint64_t Sweeps = 0;
+		uint64_t CandidatesTested = 0;
+		uint64_t Hits = 0;
+		uint64_t CellUpdates = 0;
+
+		// Bodies a sweep started inside of, and passed through.
+		uint64_t StartOverlaps = 0;
+	};
+
+	// Cells are cubes of this size; about the size of the movers works well.
+	explicit CollisionWorld(float cellSize = 4.0f);
+
+	uint32_t AddStatic(const float center[3], const float extents[3]);
+	uint32_t AddMover(const float center[3], const float extents[3]);
+	void Clear();
+
+	// Places a mover without sweeping it (e.g. on reset).
+	void SetPosition(uint32_t mover, const float center[3]);
+	void GetPosition(uint32_t body, float center[3])const;
+
+	// Moves a mover by the displacement, stopping at and sliding along what it meets.
+	// Returns true if it hit something. Bodies it overlaps at the start do not stop it.
+	// A move takes about a microsecond, so it is not timed here: callers time batches.
+	bool Move(uint32_t mover, const float displacement[3]);
+
+	const Stats& GetStats()const;
+	void ResetStats();
+	std::string Report()const;
+
+	// Gap left between a mover and what it stopped against.
+	static constexpr float Skin = 0.001f;
+	static const uint32_t MaxSlides = 4;
+
+private:
+	struct Body
+	{
+		float Min[3];
+		float Max[3];
+		int32_t CellMin[3];
+		int32_t CellMax[3];
+		bool Mover;
+		uint32_t Stamp;
+	};
+
+	void CellRange(const float mn[3], const float mx[3], int32_t cellMin[3], int32_t cellMax[3])const;
+	void Insert(uint32_t body);
+	void Remove(uint32_t body);
+	void UpdateCells(uint32_t body);
+	static uint64_t CellKey(int32_t x, int32_t y, int32_t z);
+
+private:
+	float mCellSize;
+	float mInvCellSize;
+
+	std::vector<Body> mBodies;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> mCells;
+
+	// Marks the bodies already tested by the current sweep (a body spans several cells).
+	uint32_t mStamp = 0;
+
+	Stats mStats;
+};
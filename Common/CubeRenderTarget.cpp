@@ -0,0 +1,129 @@
+//***************************************************************************************
+// CubeRenderTarget.cpp
+//***************************************************************************************
+
+#include "CubeRenderTarget.h"
+
+CubeRenderTarget::CubeRenderTarget(ID3D12Device* device, GpuHeapAllocator& allocator, ResourceStateTracker& stateTracker,
+	GpuDescriptorHeap& srvHeap, UINT resolution, DXGI_FORMAT colorFormat, DXGI_FORMAT depthFormat,
+	const float clearColor[4]) :
+	mAllocator(allocator),
+	mStateTracker(stateTracker),
+	mSrvHeap(srvHeap),
+	mResolution(resolution),
+	mRtvHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, FaceCount),
+	mDsvHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1)
+{
+	// Six slices, one per face; the SRV views them as a cube.
+	CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(colorFormat,
+		resolution, resolution, (UINT16)FaceCount, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+
+	D3D12_CLEAR_VALUE clear = {};
+	clear.Format = colorFormat;
+	std::copy(clearColor, clearColor + 4, clear.Color);
+
+	mResource = mAllocator.CreateResource(desc, D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &clear, mAllocation);
+	mStateTracker.Register(mResource.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	// The faces are rendered one after the other: a single depth buffer is enough.
+	CD3DX12_RESOURCE_DESC depthDesc = CD3DX12_RESOURCE_DESC::Tex2D(depthFormat,
+		resolution, resolution, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE);
+
+	D3D12_CLEAR_VALUE depthClear = {};
+	depthClear.Format = depthFormat;
+	depthClear.DepthStencil.Depth = 1.0f;
+	depthClear.DepthStencil.Stencil = 0;
+
+	mDepthResource = mAllocator.CreateResource(depthDesc, D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_DEPTH_WRITE, &depthClear, mDepthAllocation);
+	mStateTracker.Register(mDepthResource.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	mRtvs = mRtvHeap.Allocate(FaceCount);
+	for (UINT i = 0; i < FaceCount; ++i)
+	{
+		D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+		rtvDesc.Format = colorFormat;
+		rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2DARRAY;
+		rtvDesc.Texture2DArray.MipSlice = 0;
+		rtvDesc.Texture2DArray.PlaneSlice = 0;
+		rtvDesc.Texture2DArray.FirstArraySlice = i;
+		rtvDesc.Texture2DArray.ArraySize = 1;
+		device->CreateRenderTargetView(mResource.Get(), &rtvDesc, Rtv(i));
+	}
+
+	mDsv = mDsvHeap.Allocate();
+	device->CreateDepthStencilView(mDepthResource.Get(), nullptr, Dsv());
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = colorFormat;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+
+	// Created in a CPU-only heap and copied into the shader-visible one.
+	StagingDescriptorHeap staging(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1);
+	DescriptorHandle stagingSrv = staging.Allocate();
+	device->CreateShaderResourceView(mResource.Get(), &srvDesc, stagingSrv.Cpu);
+
+	mSrv = mSrvHeap.AllocatePersistent();
+	mSrvHeap.StageCopy(mSrv, 0, stagingSrv.Cpu, 1);
+	mSrvHeap.FlushCopies();
+}
+
+CubeRenderTarget::~CubeRenderTarget()
+{
+	mSrvHeap.FreePersistent(mSrv);
+	mRtvHeap.Free(mRtvs);
+	mDsvHeap.Free(mDsv);
+
+	mStateTracker.Unregister(mResource.Get());
+	mResource = nullptr;
+	mAllocator.Free(mAllocation);
+
+	mStateTracker.Unregister(mDepthResource.Get());
+	mDepthResource = nullptr;
+	mAllocator.Free(mDepthAllocation);
+}
+
+ID3D12Resource* CubeRenderTarget::Resource()const
+{
+	return mResource.Get();
+}
+
+ID3D12Resource* CubeRenderTarget::DepthResource()const
+{
+	return mDepthResource.Get();
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE CubeRenderTarget::Rtv(UINT face)const
+{
+	return mRtvHeap.CpuHandle(mRtvs.Index + face);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE CubeRenderTarget::Dsv()const
+{
+	return mDsvHeap.CpuHandle(mDsv.Index);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE CubeRenderTarget::Srv()const
+{
+	return mSrv.Gpu;
+}
+
+D3D12_VIEWPORT CubeRenderTarget::Viewport()const
+{
+	return { 0.0f, 0.0f, (float)mResolution, (float)mResolution, 0.0f, 1.0f };
+}
+
+D3D12_RECT CubeRenderTarget::ScissorRect()const
+{
+	return { 0, 0, (LONG)mResolution, (LONG)mResolution };
+}
+
+UINT CubeRenderTarget::Resolution()const
+{
+	return mResolution;
+}
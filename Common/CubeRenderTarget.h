@@ -0,0 +1,61 @@
+//***************************************************************************************
+// CubeRenderTarget.h
+//
+// Color cube map and the depth buffer its faces are rendered with, one face at a time
+// (e.g. an environment probe captured with a CubeCamera).
+//   -Placed in the allocator's heaps and registered with the ResourceStateTracker; it
+//    lives across frames, so faces that do not need rendering keep their contents.
+//   -One RTV per face and one DSV shared by all of them (in CPU-only heaps), and one
+//    cube SRV in the persistent region of the shader-visible heap.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuHeapAllocator.h"
+#include "ResourceStateTracker.h"
+#include "DescriptorAllocator.h"
+
+class CubeRenderTarget
+{
+public:
+	CubeRenderTarget(ID3D12Device* device, GpuHeapAllocator& allocator, ResourceStateTracker& stateTracker,
+		GpuDescriptorHeap& srvHeap, UINT resolution, DXGI_FORMAT colorFormat, DXGI_FORMAT depthFormat,
+		const float clearColor[4]);
+	CubeRenderTarget(const CubeRenderTarget& rhs) = delete;
+	CubeRenderTarget& operator=(const CubeRenderTarget& rhs) = delete;
+
+	// The GPU must be done with the cube map.
+	~CubeRenderTarget();
+
+	ID3D12Resource* Resource()const;
+	ID3D12Resource* DepthResource()const;
+	D3D12_CPU_DESCRIPTOR_HANDLE Rtv(UINT face)const;
+	D3D12_CPU_DESCRIPTOR_HANDLE Dsv()const;
+	D3D12_GPU_DESCRIPTOR_HANDLE Srv()const;
+
+	D3D12_VIEWPORT Viewport()const;
+	D3D12_RECT ScissorRect()const;
+
+	UINT Resolution()const;
+
+	static const UINT FaceCount = 6;
+
+private:
+	GpuHeapAllocator& mAllocator;
+	ResourceStateTracker& mStateTracker;
+	GpuDescriptorHeap& mSrvHeap;
+
+	UINT mResolution = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mResource;
+	GpuAllocation mAllocation;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mDepthResource;
+	GpuAllocation mDepthAllocation;
+
+	StagingDescriptorHeap mRtvHeap;
+	StagingDescriptorHeap mDsvHeap;
+	DescriptorHandle mRtvs;
+	DescriptorHandle mDsv;
+	DescriptorHandle mSrv;
+};
@@ -1259,7 +1259,8 @@ static HRESULT CreateD3DResources12(
 	_In_ bool isCubeMap,
 	_In_reads_opt_(mipCount*arraySize) D3D12_SUBRESOURCE_DATA* initData,
 	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	const CreateTexture12Func& createTexture
 	)
 {
 	if (device == nullptr)
@@ -1287,21 +1288,29 @@ static HRESULT CreateD3DResources12(
 		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 		texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-		hr = device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_COMMON,
-			nullptr,
-			IID_PPV_ARGS(&texture)
-			);
+		// Il chiamante pu decidere dove collocare la texture (ad es. in un heap condiviso).
+		if (createTexture)
+		{
+			hr = createTexture(texDesc, texture);
+		}
+		else
+		{
+			hr = device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+				D3D12_HEAP_FLAG_NONE,
+				&texDesc,
+				D3D12_RESOURCE_STATE_COMMON,
+				nullptr,
+				IID_PPV_ARGS(&texture)
+				);
+		}
 
 		if (FAILED(hr))
 		{
 			texture = nullptr;
 			return hr;
 		}
-		else
+		else if (cmdList != nullptr) // Senza command list il caricamento dei dati  a carico del chiamante.
 		{
 			const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
 			const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, num2DSubresources);
@@ -1696,7 +1705,9 @@ static HRESULT CreateTextureFromDDS12(
 	_In_ size_t maxsize,
 	_In_ bool forceSRGB,
 	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	_Out_opt_ std::vector<D3D12_SUBRESOURCE_DATA>* subresources = nullptr,
+	_In_opt_ const CreateTexture12Func& createTexture = nullptr)
 {
 	HRESULT hr = S_OK;
 
@@ -1880,6 +1891,14 @@ static HRESULT CreateTextureFromDDS12(
 		twidth, theight, tdepth, skipMip, initData.get()
 		);
 
+	// Se il chiamante vuole le sottorisorse si limita a creare la texture:
+	// il caricamento in GPU verr fatto altrove (ad es. tramite il ring di upload).
+	if (SUCCEEDED(hr) && subresources)
+	{
+		subresources->assign(initData.get(), initData.get() + (mipCount - skipMip) * arraySize);
+		cmdList = nullptr;
+	}
+
 	if (SUCCEEDED(hr))
 	{
 		hr = CreateD3DResources12(
@@ -1892,7 +1911,8 @@ static HRESULT CreateTextureFromDDS12(
 			isCubeMap,
 			initData.get(),
 			texture, 
-			textureUploadHeap);
+			textureUploadHeap,
+			createTexture);
 	}
 
 	return hr;
@@ -2146,9 +2166,56 @@ HRESULT DirectX::CreateDDSTextureFromMemoryEx( ID3D11Device* d3dDevice,
 }
 
 //--------------------------------------------------------------------------------------
+HRESULT DirectX::LoadDDSTextureFromFile12(_In_ ID3D12Device* device,
+	_In_z_ const wchar_t* szFileName,
+	_Out_ ComPtr<ID3D12Resource>& texture,
+	_Out_ std::unique_ptr<uint8_t[]>& ddsData,
+	_Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+	_In_ size_t maxsize,
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode,
+	_In_opt_ const CreateTexture12Func& createTexture)
+{
+	texture = nullptr;
+	subresources.clear();
+	if (alphaMode)
+	{
+		*alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+	}
+
+	if (!device || !szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Crea la texture su heap di default (stato COMMON) senza risorsa intermedia:
+	// le sottorisorse puntano dentro ddsData, che deve restare valido fino al caricamento.
+	ComPtr<ID3D12Resource> noUploadHeap;
+	hr = CreateTextureFromDDS12(device, nullptr, header,
+		bitData, bitSize, maxsize, false, texture, noUploadHeap, &subresources, createTexture);
+
+	if (SUCCEEDED(hr))
+	{
+		if (alphaMode)
+			*alphaMode = GetAlphaMode(header);
+	}
+
+	return hr;
+}
+
 _Use_decl_annotations_
 HRESULT DirectX::CreateDDSTextureFromFile( ID3D11Device* d3dDevice,
                                            const wchar_t* fileName,
+
                                            ID3D11Resource** texture,
                                            ID3D11ShaderResourceView** textureView,
                                            size_t maxsize,
@@ -32,6 +32,10 @@
 
 #pragma warning(pop)
 
+#include <memory>
+#include <vector>
+#include <functional>
+
 #if defined(_MSC_VER) && (_MSC_VER<1610) && !defined(_In_reads_)
 #define _In_reads_(exp)
 #define _Out_writes_(exp)
@@ -92,7 +96,25 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// Creates the texture in place of CreateCommittedResource on the default heap, e.g. as a
+	// placed resource in a larger heap. The texture must be created in the COMMON state.
+	typedef std::function<HRESULT(const D3D12_RESOURCE_DESC& desc,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& texture)> CreateTexture12Func;
+
+	// Creates only the texture (in the COMMON state) and returns its subresources, which
+	// point into ddsData: the upload to the GPU is left to the caller.
+	HRESULT LoadDDSTextureFromFile12(_In_ ID3D12Device* device,
+		                             _In_z_ const wchar_t* szFileName,
+		                             _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                             _Out_ std::unique_ptr<uint8_t[]>& ddsData,
+		                             _Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+		                             _In_ size_t maxsize = 0,
+		                             _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+		                             _In_opt_ const CreateTexture12Func& createTexture = nullptr
+		                             );
+
     // Standard version with optional auto-gen mipmap support
+
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
                                         _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
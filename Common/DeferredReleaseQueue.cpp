@@ -0,0 +1,33 @@
+//***************************************************************************************
+// DeferredReleaseQueue.cpp
+//***************************************************************************************
+
+#include "DeferredReleaseQueue.h"
+
+using Microsoft::WRL::ComPtr;
+
+void DeferredReleaseQueue::Enqueue(ComPtr<IUnknown> object)
+{
+	if (object != nullptr)
+		mCurrFrame.push_back(std::move(object));
+}
+
+void DeferredReleaseQueue::FinishFrame(UINT64 fenceValue)
+{
+	for (auto& object : mCurrFrame)
+		mPending.push_back({ fenceValue, std::move(object) });
+
+	mCurrFrame.clear();
+}
+
+void DeferredReleaseQueue::ReleaseCompleted(UINT64 completedFenceValue)
+{
+	// Fence values grow monotonically, so the oldest entries are at the front.
+	while (!mPending.empty() && mPending.front().Fence <= completedFenceValue)
+		mPending.pop_front();
+}
+
+size_t DeferredReleaseQueue::PendingCount()const
+{
+	return mCurrFrame.size() + mPending.size();
+}
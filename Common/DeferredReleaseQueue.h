@@ -0,0 +1,54 @@
+//***************************************************************************************
+// DeferredReleaseQueue.h
+//
+// Keeps GPU objects alive until the GPU is done with them and then drops the last
+// reference.
+//   -Objects enqueued while a frame is being recorded are tagged with the fence value
+//    passed to FinishFrame (the one signaled after that frame's command lists).
+//   -ReleaseCompleted releases everything whose fence has been reached, so staging
+//    resources die as soon as their copy has retired instead of living as long as
+//    the object that created them.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <deque>
+
+class DeferredReleaseQueue
+{
+public:
+	DeferredReleaseQueue() = default;
+	DeferredReleaseQueue(const DeferredReleaseQueue& rhs) = delete;
+	DeferredReleaseQueue& operator=(const DeferredReleaseQueue& rhs) = delete;
+
+	// Adds the object to the frame being recorded.
+	void Enqueue(Microsoft::WRL::ComPtr<IUnknown> object);
+
+	template<typename T>
+	void Enqueue(const Microsoft::WRL::ComPtr<T>& object)
+	{
+		if (object != nullptr)
+		{
+			Microsoft::WRL::ComPtr<IUnknown> unknown;
+			object.As(&unknown);
+			Enqueue(unknown);
+		}
+	}
+
+	// Tags every object enqueued since the previous call with fenceValue.
+	void FinishFrame(UINT64 fenceValue);
+	void ReleaseCompleted(UINT64 completedFenceValue);
+
+	size_t PendingCount()const;
+
+private:
+	struct PendingRelease
+	{
+		UINT64 Fence;
+		Microsoft::WRL::ComPtr<IUnknown> Object;
+	};
+
+	std::vector<Microsoft::WRL::ComPtr<IUnknown>> mCurrFrame;
+	std::deque<PendingRelease> mPending;
+};
@@ -0,0 +1,189 @@
+//***************************************************************************************
+// DescriptorAllocator.cpp
+//***************************************************************************************
+
+#include "DescriptorAllocator.h"
+
+StagingDescriptorHeap::StagingDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT capacity) :
+	mRanges(capacity)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = capacity;
+	heapDesc.Type = type;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+
+	mCpuStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+	mDescriptorSize = device->GetDescriptorHandleIncrementSize(type);
+}
+
+DescriptorHandle StagingDescriptorHeap::Allocate(UINT count)
+{
+	TlsfAllocator::Allocation range = mRanges.Allocate(count);
+	if (!range.IsValid())
+		throw DxException(E_OUTOFMEMORY, L"StagingDescriptorHeap::Allocate", AnsiToWString(__FILE__), __LINE__);
+
+	DescriptorHandle handle;
+	handle.Index = (UINT)range.Offset;
+	handle.Count = count;
+	handle.Cpu = CpuHandle(handle.Index);
+	handle.Range = range;
+
+	return handle;
+}
+
+void StagingDescriptorHeap::Free(DescriptorHandle& handle)
+{
+	if (!handle.IsValid())
+		return;
+
+	mRanges.Free(handle.Range);
+	handle = DescriptorHandle();
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE StagingDescriptorHeap::CpuHandle(UINT index)const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuStart, index, mDescriptorSize);
+}
+
+UINT StagingDescriptorHeap::DescriptorSize()const
+{
+	return mDescriptorSize;
+}
+
+GpuDescriptorHeap::GpuDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+	UINT persistentCount, UINT transientCount) :
+	mDevice(device),
+	mType(type),
+	mPersistent(persistentCount),
+	mTransientStart(persistentCount),
+	mTransient(transientCount)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = persistentCount + transientCount;
+	heapDesc.Type = type;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+
+	mCpuStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+	mGpuStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+	mDescriptorSize = device->GetDescriptorHandleIncrementSize(type);
+}
+
+DescriptorHandle GpuDescriptorHeap::MakeHandle(UINT index, UINT count)const
+{
+	DescriptorHandle handle;
+	handle.Index = index;
+	handle.Count = count;
+	handle.Cpu = CpuHandle(index);
+	handle.Gpu = GpuHandle(index);
+
+	return handle;
+}
+
+DescriptorHandle GpuDescriptorHeap::AllocatePersistent(UINT count)
+{
+	TlsfAllocator::Allocation range = mPersistent.Allocate(count);
+	if (!range.IsValid())
+		throw DxException(E_OUTOFMEMORY, L"GpuDescriptorHeap::AllocatePersistent", AnsiToWString(__FILE__), __LINE__);
+
+	DescriptorHandle handle = MakeHandle((UINT)range.Offset, count);
+	handle.Range = range;
+
+	return handle;
+}
+
+void GpuDescriptorHeap::FreePersistent(DescriptorHandle& handle)
+{
+	if (!handle.IsValid())
+		return;
+
+	// Command lists recorded in this frame may still reference the descriptors.
+	mCurrFrameFrees.push_back(handle.Range);
+	handle = DescriptorHandle();
+}
+
+DescriptorHandle GpuDescriptorHeap::AllocateTransient(UINT count)
+{
+	UINT64 offset = mTransient.Allocate(count);
+	if (offset == RingBufferAllocator::InvalidOffset)
+		throw DxException(E_OUTOFMEMORY, L"GpuDescriptorHeap::AllocateTransient", AnsiToWString(__FILE__), __LINE__);
+
+	return MakeHandle(mTransientStart + (UINT)offset, count);
+}
+
+void GpuDescriptorHeap::StageCopy(const DescriptorHandle& dest, UINT destOffset, D3D12_CPU_DESCRIPTOR_HANDLE src, UINT count)
+{
+	assert(destOffset + count <= dest.Count);
+
+	mCopyDestStarts.push_back(CpuHandle(dest.Index + destOffset));
+	mCopySrcStarts.push_back(src);
+	mCopySizes.push_back(count);
+}
+
+void GpuDescriptorHeap::FlushCopies()
+{
+	if (mCopySizes.empty())
+		return;
+
+	// Source and destination ranges have the same sizes, so one list describes both.
+	UINT rangeCount = (UINT)mCopySizes.size();
+	mDevice->CopyDescriptors(
+		rangeCount, mCopyDestStarts.data(), mCopySizes.data(),
+		rangeCount, mCopySrcStarts.data(), mCopySizes.data(),
+		mType);
+
+	mCopyDestStarts.clear();
+	mCopySrcStarts.clear();
+	mCopySizes.clear();
+}
+
+void GpuDescriptorHeap::FinishFrame(UINT64 fenceValue)
+{
+	for (auto& range : mCurrFrameFrees)
+		mPendingFrees.push_back({ fenceValue, range });
+	mCurrFrameFrees.clear();
+
+	mTransient.FinishFrame(fenceValue);
+}
+
+void GpuDescriptorHeap::ReleaseCompleted(UINT64 completedFenceValue)
+{
+	while (!mPendingFrees.empty() && mPendingFrees.front().Fence <= completedFenceValue)
+	{
+		mPersistent.Free(mPendingFrees.front().Range);
+		mPendingFrees.pop_front();
+	}
+
+	mTransient.ReleaseCompletedFrames(completedFenceValue);
+}
+
+ID3D12DescriptorHeap* GpuDescriptorHeap::Heap()const
+{
+	return mHeap.Get();
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE GpuDescriptorHeap::CpuHandle(UINT index)const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuStart, index, mDescriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE GpuDescriptorHeap::GpuHandle(UINT index)const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGpuStart, index, mDescriptorSize);
+}
+
+UINT GpuDescriptorHeap::DescriptorSize()const
+{
+	return mDescriptorSize;
+}
+
+UINT GpuDescriptorHeap::PersistentUsed()const
+{
+	return (UINT)mPersistent.UsedSize();
+}
+
+UINT GpuDescriptorHeap::TransientUsed()const
+{
+	return (UINT)mTransient.UsedSize();
+}
@@ -0,0 +1,127 @@
+//***************************************************************************************
+// DescriptorAllocator.h
+//
+// Descriptor management in place of fixed-size heaps filled by hand.
+//   -StagingDescriptorHeap: CPU-only heap in which descriptors are created. Reading
+//    shader-visible heaps from the CPU is slow, so views are written here first.
+//   -GpuDescriptorHeap: the shader-visible heap, split in two regions:
+//      -a persistent region for long-lived descriptors (e.g. texture SRVs), handed out
+//       by a TlsfAllocator; freed ranges are reused once the GPU is done with them;
+//      -a transient ring for descriptors that live one frame only, reclaimed by fence.
+//    Copies from staging heaps are queued and flushed with a single CopyDescriptors.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "TlsfAllocator.h"
+#include "RingBufferAllocator.h"
+#include <deque>
+
+struct DescriptorHandle
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE Cpu = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE Gpu = {};
+
+	// Position of the first descriptor in the heap and number of descriptors.
+	UINT Index = 0;
+	UINT Count = 0;
+
+	// Set for ranges that have to be given back to a TlsfAllocator.
+	TlsfAllocator::Allocation Range;
+
+	bool IsValid()const { return Count > 0; }
+};
+
+class StagingDescriptorHeap
+{
+public:
+	StagingDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT capacity);
+	StagingDescriptorHeap(const StagingDescriptorHeap& rhs) = delete;
+	StagingDescriptorHeap& operator=(const StagingDescriptorHeap& rhs) = delete;
+
+	// Throws E_OUTOFMEMORY when the heap is full.
+	DescriptorHandle Allocate(UINT count = 1);
+
+	// The GPU never reads these descriptors, so they can be freed right away
+	// (any pending copy from them must have been flushed, though).
+	void Free(DescriptorHandle& handle);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index)const;
+	UINT DescriptorSize()const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mHeap;
+	D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart = {};
+	UINT mDescriptorSize = 0;
+
+	TlsfAllocator mRanges;
+};
+
+class GpuDescriptorHeap
+{
+public:
+	GpuDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+		UINT persistentCount, UINT transientCount);
+	GpuDescriptorHeap(const GpuDescriptorHeap& rhs) = delete;
+	GpuDescriptorHeap& operator=(const GpuDescriptorHeap& rhs) = delete;
+
+	// Throws E_OUTOFMEMORY when the persistent region is full.
+	DescriptorHandle AllocatePersistent(UINT count = 1);
+
+	// The range becomes reusable once the frame being recorded has retired.
+	void FreePersistent(DescriptorHandle& handle);
+
+	// Contiguous descriptors valid until the current frame retires. Throws
+	// E_OUTOFMEMORY when the frames in flight already fill the ring.
+	DescriptorHandle AllocateTransient(UINT count);
+
+	// Queues a copy of count descriptors from a staging heap to dest (starting
+	// destOffset descriptors into it). Nothing is copied before FlushCopies.
+	void StageCopy(const DescriptorHandle& dest, UINT destOffset, D3D12_CPU_DESCRIPTOR_HANDLE src, UINT count);
+	void FlushCopies();
+
+	// Same contract as UploadRing: fenceValue is signaled after the frame's command lists.
+	void FinishFrame(UINT64 fenceValue);
+	void ReleaseCompleted(UINT64 completedFenceValue);
+
+	ID3D12DescriptorHeap* Heap()const;
+	D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index)const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index)const;
+	UINT DescriptorSize()const;
+
+	UINT PersistentUsed()const;
+	UINT TransientUsed()const;
+
+private:
+	DescriptorHandle MakeHandle(UINT index, UINT count)const;
+
+private:
+	struct PendingFree
+	{
+		UINT64 Fence;
+		TlsfAllocator::Allocation Range;
+	};
+
+	ID3D12Device* mDevice = nullptr;
+	D3D12_DESCRIPTOR_HEAP_TYPE mType;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mHeap;
+	D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE mGpuStart = {};
+	UINT mDescriptorSize = 0;
+
+	// Persistent region: [0, persistentCount).
+	TlsfAllocator mPersistent;
+	std::vector<TlsfAllocator::Allocation> mCurrFrameFrees;
+	std::deque<PendingFree> mPendingFrees;
+
+	// Transient region: [persistentCount, persistentCount + transientCount).
+	UINT mTransientStart = 0;
+	RingBufferAllocator mTransient;
+
+	// Copies waiting for FlushCopies.
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCopyDestStarts;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCopySrcStarts;
+	std::vector<UINT> mCopySizes;
+};
@@ -0,0 +1,95 @@
+//***************************************************************************************
+// FixedTimestep.cpp
+//***************************************************************************************
+
+#include "FixedTimestep.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+FixedTimestep::FixedTimestep(double stepSeconds, uint32_t maxStepsPerFrame)
+{
+	SetStep(stepSeconds);
+	SetMaxStepsPerFrame(maxStepsPerFrame);
+}
+
+void FixedTimestep::SetStep(double stepSeconds)
+{
+	assert(stepSeconds > 0.0);
+	mStep = stepSeconds;
+
+	// What was accumulated is kept, but no more than a step of the new size.
+	mAccumulator = std::fmod(mAccumulator, mStep);
+}
+
+double FixedTimestep::Step()const
+{
+	return mStep;
+}
+
+void FixedTimestep::SetMaxStepsPerFrame(uint32_t maxSteps)
+{
+	mMaxStepsPerFrame = maxSteps > 0 ? maxSteps : 1;
+}
+
+uint32_t FixedTimestep::MaxStepsPerFrame()const
+{
+	return mMaxStepsPerFrame;
+}
+
+uint32_t FixedTimestep::Advance(double frameSeconds)
+{
+	if (frameSeconds > 0.0)
+		mAccumulator += frameSeconds;
+
+	uint32_t steps = 0;
+	while (mAccumulator >= mStep && steps < mMaxStepsPerFrame)
+	{
+		mAccumulator -= mStep;
+		steps++;
+	}
+
+	// Whole steps that did not fit in this frame are dropped.
+	if (mAccumulator >= mStep)
+	{
+		double remainder = std::fmod(mAccumulator, mStep);
+		mStats.DroppedSeconds += mAccumulator - remainder;
+		mAccumulator = remainder;
+	}
+
+	mStats.StepsLastFrame = steps;
+	mStats.TotalSteps += steps;
+	mStats.Frames++;
+
+	return steps;
+}
+
+float FixedTimestep::Alpha(double extraSeconds)const
+{
+	double alpha = (mAccumulator + (extraSeconds > 0.0 ? extraSeconds : 0.0)) / mStep;
+	return (float)(alpha < 1.0 ? alpha : 1.0);
+}
+
+void FixedTimestep::Reset()
+{
+	mAccumulator = 0.0;
+}
+
+const FixedTimestep::Stats& FixedTimestep::GetStats()const
+{
+	return mStats;
+}
+
+std::string FixedTimestep::Report()const
+{
+	double stepsPerFrame = mStats.Frames > 0 ? (double)mStats.TotalSteps / (double)mStats.Frames : 0.0;
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"FixedTimestep: %.1f Hz, %llu steps in %llu frames (%.2f per frame), %.3f s dropped",
+		1.0 / mStep, (unsigned long long)mStats.TotalSteps, (unsigned long long)mStats.Frames, stepsPerFrame,
+		mStats.DroppedSeconds);
+
+	return buffer;
+}
@@ -0,0 +1,58 @@
+//***************************************************************************************
+// FixedTimestep.h
+//
+// Accumulator that runs a simulation at a fixed rate, independent of the frame rate.
+//   -Every frame adds its elapsed time and gets back the number of fixed steps to run:
+//    zero on most frames when rendering is faster than the simulation, several when
+//    it is slower.
+//   -A frame never runs more than MaxStepsPerFrame steps. The time beyond that is
+//    dropped, so after a hitch the simulation slows down instead of spending ever
+//    longer frames catching up.
+//   -Alpha() is where the frame falls between the last two simulated states, for
+//    rendering an interpolation of them.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class FixedTimestep
+{
+public:
+	struct Stats
+	{
+		uint32_t StepsLastFrame = 0;
+		uint64_t TotalSteps = 0;
+		uint64_t Frames = 0;
+		double DroppedSeconds = 0.0;
+	};
+
+	explicit FixedTimestep(double stepSeconds = 1.0 / 60.0, uint32_t maxStepsPerFrame = 8);
+
+	void SetStep(double stepSeconds);
+	double Step()const;
+
+	void SetMaxStepsPerFrame(uint32_t maxSteps);
+	uint32_t MaxStepsPerFrame()const;
+
+	// Adds the time elapsed since the previous frame; returns the steps to run now.
+	uint32_t Advance(double frameSeconds);
+
+	// In [0, 1]: 0 at the previous simulated state, 1 at the latest one. extraSeconds is
+	// time spent since Advance (e.g. for a later sample in the same frame).
+	float Alpha(double extraSeconds = 0.0)const;
+
+	// Empties the accumulator.
+	void Reset();
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+private:
+	double mStep = 1.0 / 60.0;
+	uint32_t mMaxStepsPerFrame = 8;
+	double mAccumulator = 0.0;
+
+	Stats mStats;
+};
@@ -0,0 +1,311 @@
+//***************************************************************************************
+// GpuHeapAllocator.cpp
+//***************************************************************************************
+
+#include "GpuHeapAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+static const D3D12_HEAP_TYPE gPoolHeapTypes[] = { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_TYPE_UPLOAD };
+
+static const wchar_t* CategoryName(GpuHeapCategory category)
+{
+	switch (category)
+	{
+	case GpuHeapCategory::Buffer: return L"Buffers";
+	case GpuHeapCategory::Texture: return L"Textures";
+	case GpuHeapCategory::RenderTarget: return L"RenderTargets";
+	default: return L"?";
+	}
+}
+
+GpuHeapAllocator::GpuHeapAllocator(ID3D12Device* device,
+	UINT64 defaultHeapBlockSize,
+	UINT64 uploadHeapBlockSize) :
+	mDevice(device)
+{
+	for (int i = 0; i < (int)GpuHeapCategory::Count; ++i)
+		mBudget[i] = UINT64_MAX;
+
+	for (D3D12_HEAP_TYPE heapType : gPoolHeapTypes)
+	{
+		for (int i = 0; i < (int)GpuHeapCategory::Count; ++i)
+		{
+			HeapPool pool;
+			pool.HeapType = heapType;
+			pool.Category = (GpuHeapCategory)i;
+			pool.BlockSize = heapType == D3D12_HEAP_TYPE_UPLOAD ? uploadHeapBlockSize : defaultHeapBlockSize;
+
+			// MSAA render targets need 4 MB alignment, and a placed resource cannot be more
+			// aligned than the heap that holds it.
+			pool.HeapAlignment = pool.Category == GpuHeapCategory::RenderTarget ?
+				D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+			mPools.push_back(std::move(pool));
+		}
+	}
+}
+
+GpuHeapAllocator::~GpuHeapAllocator()
+{
+}
+
+void GpuHeapAllocator::SetBudget(GpuHeapCategory category, UINT64 byteBudget)
+{
+	mBudget[(int)category] = byteBudget;
+}
+
+GpuHeapCategory GpuHeapAllocator::CategoryOf(const D3D12_RESOURCE_DESC& desc)
+{
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		return GpuHeapCategory::Buffer;
+
+	if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		return GpuHeapCategory::RenderTarget;
+
+	return GpuHeapCategory::Texture;
+}
+
+UINT GpuHeapAllocator::PoolIndex(D3D12_HEAP_TYPE heapType, GpuHeapCategory category)const
+{
+	UINT heapTypeIndex = heapType == D3D12_HEAP_TYPE_UPLOAD ? 1 : 0;
+	return heapTypeIndex * (UINT)GpuHeapCategory::Count + (UINT)category;
+}
+
+ComPtr<ID3D12Resource> GpuHeapAllocator::CreateResource(
+	const D3D12_RESOURCE_DESC& desc,
+	D3D12_HEAP_TYPE heapType,
+	D3D12_RESOURCE_STATES initialState,
+	const D3D12_CLEAR_VALUE* optimizedClearValue,
+	GpuAllocation& allocation)
+{
+	assert(heapType == D3D12_HEAP_TYPE_DEFAULT || heapType == D3D12_HEAP_TYPE_UPLOAD);
+
+	GpuHeapCategory category = CategoryOf(desc);
+	UINT poolIndex = PoolIndex(heapType, category);
+
+	D3D12_RESOURCE_DESC placedDesc = desc;
+	D3D12_RESOURCE_ALLOCATION_INFO info = {};
+
+	// Small textures can be placed at 4 KB boundaries. The device reports a larger
+	// alignment for the ones that do not qualify, which then fall back to the default.
+	if (category == GpuHeapCategory::Texture && placedDesc.Alignment == 0)
+	{
+		placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+		if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+			placedDesc.Alignment = 0;
+	}
+
+	if (placedDesc.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+		info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+
+	if (info.SizeInBytes == UINT64_MAX)
+		throw DxException(E_INVALIDARG, L"GpuHeapAllocator::CreateResource", AnsiToWString(__FILE__), __LINE__);
+
+	if (info.SizeInBytes > mPools[poolIndex].BlockSize)
+		AllocateDedicated(poolIndex, info.SizeInBytes, allocation);
+	else
+		AllocateInPool(poolIndex, info.SizeInBytes, info.Alignment, allocation);
+
+	ComPtr<ID3D12Resource> resource;
+	HRESULT hr = mDevice->CreatePlacedResource(
+		allocation.Heap,
+		allocation.Offset,
+		&placedDesc,
+		initialState,
+		optimizedClearValue,
+		IID_PPV_ARGS(&resource));
+
+	if (FAILED(hr))
+	{
+		Free(allocation);
+		ThrowIfFailed(hr);
+	}
+
+	return resource;
+}
+
+void GpuHeapAllocator::AllocateInPool(UINT poolIndex, UINT64 size, UINT64 alignment, GpuAllocation& allocation)
+{
+	HeapPool& pool = mPools[poolIndex];
+
+	UINT blockIndex = 0;
+	TlsfAllocator::Allocation range;
+	for (; blockIndex < pool.Blocks.size(); ++blockIndex)
+	{
+		if (pool.Blocks[blockIndex].Heap == nullptr)
+			continue;
+
+		range = pool.Blocks[blockIndex].Ranges->Allocate(size, alignment);
+		if (range.IsValid())
+			break;
+	}
+
+	// No block has room: open a new one, reusing the slot of a released block if any.
+	if (!range.IsValid())
+	{
+		ChargeBudget(pool.Category, pool.BlockSize);
+
+		blockIndex = 0;
+		while (blockIndex < pool.Blocks.size() && pool.Blocks[blockIndex].Heap != nullptr)
+			++blockIndex;
+		if (blockIndex == pool.Blocks.size())
+			pool.Blocks.emplace_back();
+
+		HeapBlock& block = pool.Blocks[blockIndex];
+		block.Heap = CreateHeap(pool, pool.BlockSize);
+		block.Ranges = std::make_unique<TlsfAllocator>(pool.BlockSize);
+
+		range = block.Ranges->Allocate(size, alignment);
+		assert(range.IsValid());
+	}
+
+	allocation.Heap = pool.Blocks[blockIndex].Heap.Get();
+	allocation.Offset = range.Offset;
+	allocation.Size = range.Size;
+	allocation.Pool = poolIndex;
+	allocation.Block = blockIndex;
+	allocation.Range = range;
+	allocation.DedicatedHeap = nullptr;
+}
+
+void GpuHeapAllocator::AllocateDedicated(UINT poolIndex, UINT64 size, GpuAllocation& allocation)
+{
+	HeapPool& pool = mPools[poolIndex];
+
+	UINT64 heapSize = (size + pool.HeapAlignment - 1) / pool.HeapAlignment * pool.HeapAlignment;
+	ChargeBudget(pool.Category, heapSize);
+
+	allocation.DedicatedHeap = CreateHeap(pool, heapSize);
+	allocation.Heap = allocation.DedicatedHeap.Get();
+	allocation.Offset = 0;
+	allocation.Size = heapSize;
+	allocation.Pool = poolIndex;
+	allocation.Range = TlsfAllocator::Allocation();
+
+	++mDedicatedHeapCount[(int)pool.Category];
+	mDedicatedBytes[(int)pool.Category] += heapSize;
+}
+
+ComPtr<ID3D12Heap> GpuHeapAllocator::CreateHeap(const HeapPool& pool, UINT64 byteSize)
+{
+	D3D12_HEAP_FLAGS flags = D3D12_HEAP_FLAG_NONE;
+	switch (pool.Category)
+	{
+	case GpuHeapCategory::Buffer: flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS; break;
+	case GpuHeapCategory::Texture: flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES; break;
+	case GpuHeapCategory::RenderTarget: flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES; break;
+	default: break;
+	}
+
+	CD3DX12_HEAP_DESC heapDesc(byteSize, pool.HeapType, pool.HeapAlignment, flags);
+
+	ComPtr<ID3D12Heap> heap;
+	HRESULT hr = mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap));
+	if (FAILED(hr))
+	{
+		// The bytes were charged to the budget before trying.
+		mHeapBytes[(int)pool.Category] -= byteSize;
+		ThrowIfFailed(hr);
+	}
+
+	return heap;
+}
+
+void GpuHeapAllocator::ChargeBudget(GpuHeapCategory category, UINT64 byteSize)
+{
+	int c = (int)category;
+	if (byteSize > mBudget[c] || mHeapBytes[c] > mBudget[c] - byteSize)
+		throw DxException(E_OUTOFMEMORY, L"GpuHeapAllocator::ChargeBudget", AnsiToWString(__FILE__), __LINE__);
+
+	mHeapBytes[c] += byteSize;
+}
+
+void GpuHeapAllocator::Free(GpuAllocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	HeapPool& pool = mPools[allocation.Pool];
+	int c = (int)pool.Category;
+
+	if (allocation.DedicatedHeap != nullptr)
+	{
+		mHeapBytes[c] -= allocation.Size;
+		mDedicatedBytes[c] -= allocation.Size;
+		--mDedicatedHeapCount[c];
+	}
+	else
+	{
+		HeapBlock& block = pool.Blocks[allocation.Block];
+		block.Ranges->Free(allocation.Range);
+
+		// Give empty blocks back to the system, but keep the first one around so that a
+		// resource recreated every resize (e.g. the depth buffer) does not create a heap
+		// each time.
+		if (block.Ranges->IsEmpty() && allocation.Block > 0)
+		{
+			block.Heap = nullptr;
+			block.Ranges = nullptr;
+			mHeapBytes[c] -= pool.BlockSize;
+		}
+	}
+
+	allocation = GpuAllocation();
+}
+
+GpuHeapStats GpuHeapAllocator::GetStats(GpuHeapCategory category)const
+{
+	GpuHeapStats stats;
+
+	for (const HeapPool& pool : mPools)
+	{
+		if (pool.Category != category)
+			continue;
+
+		for (const HeapBlock& block : pool.Blocks)
+		{
+			if (block.Heap == nullptr)
+				continue;
+
+			TlsfAllocator::Stats rangeStats = block.Ranges->GetStats();
+			++stats.HeapCount;
+			stats.HeapBytes += rangeStats.Capacity;
+			stats.UsedBytes += rangeStats.UsedSize;
+			stats.AllocationCount += rangeStats.AllocationCount;
+			stats.LargestFreeBlock = std::max<UINT64>(stats.LargestFreeBlock, rangeStats.LargestFreeBlock);
+		}
+	}
+
+	// A dedicated heap is always fully used by its resource.
+	int c = (int)category;
+	stats.DedicatedHeapCount = mDedicatedHeapCount[c];
+	stats.HeapCount += mDedicatedHeapCount[c];
+	stats.HeapBytes += mDedicatedBytes[c];
+	stats.UsedBytes += mDedicatedBytes[c];
+	stats.AllocationCount += mDedicatedHeapCount[c];
+
+	return stats;
+}
+
+void GpuHeapAllocator::LogStats()const
+{
+	const double toMB = 1.0 / (1024.0 * 1024.0);
+
+	for (int i = 0; i < (int)GpuHeapCategory::Count; ++i)
+	{
+		GpuHeapStats stats = GetStats((GpuHeapCategory)i);
+
+		std::wstring text =
+			L"***GPU heaps (" + std::wstring(CategoryName((GpuHeapCategory)i)) + L"): " +
+			L"Heaps = " + std::to_wstring(stats.HeapCount) +
+			L" (dedicated " + std::to_wstring(stats.DedicatedHeapCount) + L"), " +
+			L"Allocations = " + std::to_wstring(stats.AllocationCount) + L", " +
+			L"Used = " + std::to_wstring(stats.UsedBytes * toMB) + L"/" +
+			std::to_wstring(stats.HeapBytes * toMB) + L" MB, " +
+			L"Fragmentation = " + std::to_wstring(stats.Fragmentation()) + L"\n";
+
+		OutputDebugString(text.c_str());
+	}
+}
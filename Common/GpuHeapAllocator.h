@@ -0,0 +1,125 @@
+//***************************************************************************************
+// GpuHeapAllocator.h
+//
+// Places buffers and textures in large ID3D12Heap blocks instead of giving each of them
+// a committed resource (and therefore an implicit heap) of its own.
+//   -Heaps are grouped by heap type and by category (buffers, textures, render target/
+//    depth-stencil textures), which is what resource heap tier 1 requires.
+//   -Ranges inside a block are handed out by a TlsfAllocator; resources use the
+//    alignment reported by the device: 4 KB for small textures, 64 KB for everything
+//    else, 4 MB for MSAA targets.
+//   -Resources too large for a block get a dedicated heap.
+//   -Every category has a byte budget; going over it throws E_OUTOFMEMORY.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "TlsfAllocator.h"
+
+enum class GpuHeapCategory
+{
+	Buffer = 0,
+	Texture,
+	RenderTarget,
+	Count
+};
+
+struct GpuAllocation
+{
+	ID3D12Heap* Heap = nullptr;
+	UINT64 Offset = 0;
+	UINT64 Size = 0;
+
+	// Bookkeeping used by GpuHeapAllocator::Free.
+	UINT Pool = 0;
+	UINT Block = 0;
+	TlsfAllocator::Allocation Range;
+	Microsoft::WRL::ComPtr<ID3D12Heap> DedicatedHeap;
+
+	bool IsValid()const { return Heap != nullptr; }
+};
+
+struct GpuHeapStats
+{
+	UINT HeapCount = 0;
+	UINT64 HeapBytes = 0;
+	UINT64 UsedBytes = 0;
+	UINT64 LargestFreeBlock = 0;
+	UINT AllocationCount = 0;
+	UINT DedicatedHeapCount = 0;
+
+	// 0 when all the free space is contiguous, close to 1 when it is scattered in
+	// ranges too small to be useful.
+	float Fragmentation()const
+	{
+		UINT64 freeBytes = HeapBytes - UsedBytes;
+		return freeBytes > 0 ? 1.0f - (float)LargestFreeBlock / (float)freeBytes : 0.0f;
+	}
+};
+
+class GpuHeapAllocator
+{
+public:
+	GpuHeapAllocator(ID3D12Device* device,
+		UINT64 defaultHeapBlockSize = 64 * 1024 * 1024,
+		UINT64 uploadHeapBlockSize = 4 * 1024 * 1024);
+	GpuHeapAllocator(const GpuHeapAllocator& rhs) = delete;
+	GpuHeapAllocator& operator=(const GpuHeapAllocator& rhs) = delete;
+	~GpuHeapAllocator();
+
+	// Maximum number of heap bytes a category may use (across all heap types).
+	void SetBudget(GpuHeapCategory category, UINT64 byteBudget);
+
+	// Creates a placed resource and fills allocation, which must be handed back to Free
+	// once the resource has been released and the GPU no longer uses it.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateResource(
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_HEAP_TYPE heapType,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* optimizedClearValue,
+		GpuAllocation& allocation);
+
+	void Free(GpuAllocation& allocation);
+
+	GpuHeapStats GetStats(GpuHeapCategory category)const;
+
+	// Writes the statistics of every category to the debug output.
+	void LogStats()const;
+
+	static GpuHeapCategory CategoryOf(const D3D12_RESOURCE_DESC& desc);
+
+private:
+	struct HeapBlock
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		std::unique_ptr<TlsfAllocator> Ranges;
+	};
+
+	struct HeapPool
+	{
+		D3D12_HEAP_TYPE HeapType = D3D12_HEAP_TYPE_DEFAULT;
+		GpuHeapCategory Category = GpuHeapCategory::Buffer;
+		UINT64 BlockSize = 0;
+		UINT64 HeapAlignment = 0;
+		std::vector<HeapBlock> Blocks;
+	};
+
+	UINT PoolIndex(D3D12_HEAP_TYPE heapType, GpuHeapCategory category)const;
+	Microsoft::WRL::ComPtr<ID3D12Heap> CreateHeap(const HeapPool& pool, UINT64 byteSize);
+	void ChargeBudget(GpuHeapCategory category, UINT64 byteSize);
+
+	void AllocateInPool(UINT poolIndex, UINT64 size, UINT64 alignment, GpuAllocation& allocation);
+	void AllocateDedicated(UINT poolIndex, UINT64 size, GpuAllocation& allocation);
+
+private:
+	ID3D12Device* mDevice = nullptr;
+
+	// Two heap types (DEFAULT, UPLOAD) for each category.
+	std::vector<HeapPool> mPools;
+
+	UINT64 mBudget[(int)GpuHeapCategory::Count];
+	UINT64 mHeapBytes[(int)GpuHeapCategory::Count] = {};
+	UINT mDedicatedHeapCount[(int)GpuHeapCategory::Count] = {};
+	UINT64 mDedicatedBytes[(int)GpuHeapCategory::Count] = {};
+};
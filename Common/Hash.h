@@ -0,0 +1,70 @@
+//***************************************************************************************
+// Hash.h
+//
+// Incremental 64-bit FNV-1a hash for cache keys (pipeline states, shaders).
+// Not a cryptographic hash: it only has to tell different inputs apart.
+// The value depends only on the bytes added, so it is the same on every run, which the
+// on-disk caches rely on; scalars are added in memory order, so keys written on a
+// little-endian machine are not valid on a big-endian one.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+class Hasher
+{
+public:
+	static const uint64_t OffsetBasis = 14695981039346656037ull;
+	static const uint64_t Prime = 1099511628211ull;
+
+	explicit Hasher(uint64_t seed = OffsetBasis) : mHash(seed) {}
+
+	void Add(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			mHash ^= bytes[i];
+			mHash *= Prime;
+		}
+	}
+
+	// Scalars and enums only: structs may contain padding with undefined contents,
+	// so they have to be hashed field by field.
+	template<typename T>
+	void Add(const T& value)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+			"Hash structs field by field.");
+		Add(&value, sizeof(T));
+	}
+
+	// Includes the length, so that ("ab", "c") and ("a", "bc") differ.
+	void AddString(const std::string& s)
+	{
+		Add((uint64_t)s.size());
+		Add(s.data(), s.size());
+	}
+
+	void AddString(const char* s)
+	{
+		AddString(std::string(s != nullptr ? s : ""));
+	}
+
+	uint64_t Value()const { return mHash; }
+
+	static std::string ToHex(uint64_t hash)
+	{
+		char buffer[17];
+		snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+		return buffer;
+	}
+
+private:
+	uint64_t mHash;
+};
@@ -0,0 +1,345 @@
+//***************************************************************************************
+// InputSystem.cpp
+//***************************************************************************************
+
+#include "InputSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+double InputSystem::Now()
+{
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+void InputSystem::Push(const InputEvent& e)
+{
+	mQueue.push_back(e);
+}
+
+void InputSystem::PushKey(uint32_t key, bool down, double time)
+{
+	InputEvent e;
+	e.Type = down ? InputEventType::KeyDown : InputEventType::KeyUp;
+	e.Code = key;
+	e.Time = time;
+	mQueue.push_back(e);
+}
+
+void InputSystem::PushButton(uint32_t button, bool down, int32_t x, int32_t y, double time)
+{
+	InputEvent e;
+	e.Type = down ? InputEventType::ButtonDown : InputEventType::ButtonUp;
+	e.Code = button;
+	e.X = x;
+	e.Y = y;
+	e.Time = time;
+	mQueue.push_back(e);
+}
+
+void InputSystem::PushMouseMove(int32_t x, int32_t y, double time)
+{
+	InputEvent e;
+	e.Type = InputEventType::MouseMove;
+	e.X = x;
+	e.Y = y;
+	e.Time = time;
+	mQueue.push_back(e);
+}
+
+void InputSystem::PushWheel(float steps, double time)
+{
+	InputEvent e;
+	e.Type = InputEventType::MouseWheel;
+	e.X = (int32_t)std::lround(steps * WheelUnitsPerStep);
+	e.Time = time;
+	mQueue.push_back(e);
+}
+
+void InputSystem::PushReleaseAll(double time)
+{
+	InputEvent e;
+	e.Type = InputEventType::ReleaseAll;
+	e.Time = time;
+	mQueue.push_back(e);
+}
+
+void InputSystem::BindKey(uint32_t action, uint32_t key, float scale)
+{
+	AddAction(action);
+	mKeyBindings.push_back({ action, key, scale });
+	mKeys[key];
+}
+
+void InputSystem::BindMouseAxis(uint32_t action, MouseAxis axis, uint32_t requiredButtons, float scale)
+{
+	AddAction(action);
+	mMouseBindings.push_back({ action, axis, requiredButtons & 7u, scale });
+}
+
+void InputSystem::BindWheel(uint32_t action, float scale)
+{
+	AddAction(action);
+	mWheelBindings.push_back({ action, scale });
+}
+
+void InputSystem::ClearBindings()
+{
+	mKeyBindings.clear();
+	mMouseBindings.clear();
+	mWheelBindings.clear();
+	mKeys.clear();
+	mActions.clear();
+}
+
+void InputSystem::AddAction(uint32_t action)
+{
+	if (action >= mActions.size())
+		mActions.resize(action + 1);
+}
+
+void InputSystem::KeyDown(KeyState& key, double time, bool press)
+{
+	// Auto-repeat does not restart the hold.
+	if (key.Down)
+		return;
+
+	key.Down = true;
+	key.Pressed = key.Pressed || press;
+	key.Since = time;
+}
+
+void InputSystem::KeyUp(KeyState& key, double time)
+{
+	if (!key.Down)
+		return;
+
+	key.HeldSeconds += time - key.Since;
+	key.Down = false;
+}
+
+void InputSystem::Update(double time)
+{
+	auto updateBegin = std::chrono::high_resolution_clock::now();
+
+	// Events are placed within the interval: a hold that started before the previous
+	// update was already counted up to it.
+	double begin = mUpdated ? mLastUpdateTime : time;
+	if (!mUpdated)
+	{
+		for (const InputEvent& e : mQueue)
+			begin = e.Time < begin ? e.Time : begin;
+	}
+
+	double totalAge = 0.0;
+	double maxAge = 0.0;
+	uint32_t mouseMoves = 0;
+
+	for (const InputEvent& e : mQueue)
+	{
+		double t = e.Time < begin ? begin : (e.Time > time ? time : e.Time);
+
+		double age = time - e.Time;
+		totalAge += age;
+		maxAge = age > maxAge ? age : maxAge;
+
+		switch (e.Type)
+		{
+		case InputEventType::KeyDown:
+		case InputEventType::KeyHeld:
+		case InputEventType::KeyUp:
+		{
+			auto it = mKeys.find(e.Code);
+			if (it == mKeys.end())
+				break;
+
+			if (e.Type == InputEventType::KeyUp)
+				KeyUp(it->second, t);
+			else
+				KeyDown(it->second, t, e.Type == InputEventType::KeyDown);
+			break;
+		}
+
+		case InputEventType::ButtonDown:
+		case InputEventType::ButtonUp:
+			// The position of a click is where the next move is measured from.
+			mCursorX = e.X;
+			mCursorY = e.Y;
+			mHasCursor = true;
+
+			if (e.Type == InputEventType::ButtonDown)
+				mButtons |= e.Code & 7u;
+			else
+				mButtons &= ~(e.Code & 7u);
+			break;
+
+		case InputEventType::MouseMove:
+			if (mHasCursor)
+			{
+				mDeltaX[mButtons] += e.X - mCursorX;
+				mDeltaY[mButtons] += e.Y - mCursorY;
+			}
+			mCursorX = e.X;
+			mCursorY = e.Y;
+			mHasCursor = true;
+			mouseMoves++;
+			break;
+
+		case InputEventType::MouseWheel:
+			mWheel += e.X;
+			break;
+
+		case InputEventType::ReleaseAll:
+			for (auto& key : mKeys)
+				KeyUp(key.second, t);
+			mButtons = 0;
+			break;
+		}
+	}
+
+	// Keys still held count up to the end of the interval.
+	for (auto& key : mKeys)
+	{
+		if (key.second.Down)
+		{
+			key.second.HeldSeconds += time - key.second.Since;
+			key.second.Since = time;
+		}
+	}
+
+	for (ActionState& action : mActions)
+		action = ActionState();
+
+	for (const KeyBinding& binding : mKeyBindings)
+	{
+		const KeyState& key = mKeys[binding.Key];
+		ActionState& action = mActions[binding.Action];
+		action.Value += binding.Scale * (float)key.HeldSeconds;
+		action.Pressed = action.Pressed || key.Pressed;
+		action.Down = action.Down || key.Down;
+	}
+
+	for (const MouseBinding& binding : mMouseBindings)
+	{
+		const int64_t* deltas = binding.Axis == MouseAxis::X ? mDeltaX : mDeltaY;
+
+		int64_t delta = 0;
+		for (uint32_t buttons = 0; buttons < 8; ++buttons)
+		{
+			if ((buttons & binding.RequiredButtons) == binding.RequiredButtons)
+				delta += deltas[buttons];
+		}
+
+		mActions[binding.Action].Value += binding.Scale * (float)delta;
+	}
+
+	for (const WheelBinding& binding : mWheelBindings)
+		mActions[binding.Action].Value += binding.Scale * (float)mWheel / WheelUnitsPerStep;
+
+	// Ready for the next interval.
+	for (auto& key : mKeys)
+	{
+		key.second.Pressed = false;
+		key.second.HeldSeconds = 0.0;
+	}
+	for (uint32_t buttons = 0; buttons < 8; ++buttons)
+	{
+		mDeltaX[buttons] = 0;
+		mDeltaY[buttons] = 0;
+	}
+	mWheel = 0;
+
+	mStats.EventCount = (uint32_t)mQueue.size();
+	mStats.MouseMoves = mouseMoves;
+	mStats.AverageEventAgeMs = mQueue.empty() ? 0.0 : 1000.0 * totalAge / (double)mQueue.size();
+	mStats.MaxEventAgeMs = 1000.0 * maxAge;
+
+	// The queue becomes the list of processed events; its storage is reused next time.
+	mProcessed.swap(mQueue);
+	mQueue.clear();
+	mLastUpdateTime = time;
+	mUpdated = true;
+
+	mStats.UpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - updateBegin).count();
+}
+
+float InputSystem::Value(uint32_t action)const
+{
+	return action < mActions.size() ? mActions[action].Value : 0.0f;
+}
+
+bool InputSystem::Pressed(uint32_t action)const
+{
+	return action < mActions.size() && mActions[action].Pressed;
+}
+
+bool InputSystem::Down(uint32_t action)const
+{
+	return action < mActions.size() && mActions[action].Down;
+}
+
+const std::vector<InputEvent>& InputSystem::ProcessedEvents()const
+{
+	return mProcessed;
+}
+
+std::vector<InputEvent> InputSystem::HeldStateEvents()const
+{
+	std::vector<InputEvent> events;
+	double time = mLastUpdateTime;
+
+	if (mHasCursor)
+	{
+		InputEvent e;
+		e.Type = InputEventType::MouseMove;
+		e.X = mCursorX;
+		e.Y = mCursorY;
+		e.Time = time;
+		events.push_back(e);
+	}
+
+	for (uint32_t button = 1; button <= MouseMiddle; button <<= 1)
+	{
+		if ((mButtons & button) != 0)
+		{
+			InputEvent e;
+			e.Type = InputEventType::ButtonDown;
+			e.Code = button;
+			e.X = mCursorX;
+			e.Y = mCursorY;
+			e.Time = time;
+			events.push_back(e);
+		}
+	}
+
+	for (const auto& key : mKeys)
+	{
+		if (key.second.Down)
+		{
+			InputEvent e;
+			e.Type = InputEventType::KeyHeld;
+			e.Code = key.first;
+			e.Time = time;
+			events.push_back(e);
+		}
+	}
+
+	return events;
+}
+
+const InputSystem::Stats& InputSystem::GetStats()const
+{
+	return mStats;
+}
+
+std::string InputSystem::Report()const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"InputSystem: %u events (%u mouse moves) in the last update, %.3f ms average age, %.3f ms max age, %.4f ms update",
+		mStats.EventCount, mStats.MouseMoves, mStats.AverageEventAgeMs, mStats.MaxEventAgeMs, mStats.UpdateMs);
+
+	return buffer;
+}
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// InputSystem.h
+//
+// Queue of raw, timestamped input events turned into per-frame action values.
+//   -The window procedure only pushes events (key and button transitions, cursor
+//    positions, wheel steps); Update consumes them once per frame.
+//   -Cursor movement is coalesced: the deltas of all the moves of a frame are summed per
+//    combination of held mouse buttons, so a 1000 Hz mouse costs one camera update per
+//    frame instead of one per message.
+//   -Key bindings integrate the time a key was held within the frame from the event
+//    timestamps, not from a poll at the start of the frame: Value() is scale * seconds
+//    held, so a speed in units per second as scale gives a distance.
+//   -Mouse bindings give scale * pixels moved while the required buttons were held,
+//    wheel bindings scale * wheel steps, fractions of a step included (high-resolution
+//    wheels report less than a notch at a time).
+//   -Key codes and action ids are plain integers (virtual-key codes and an enum of the
+//    application on Windows). No platform dependency, so the queue and the action map
+//    can be driven and timed with synthetic event streams anywhere.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class InputEventType : uint8_t
+{
+	KeyDown,
+	KeyUp,
+	ButtonDown,		// Code: one of the InputSystem::Mouse* bits; X, Y: cursor position.
+	ButtonUp,
+	MouseMove,		// X, Y: cursor position.
+	MouseWheel,		// X: wheel movement in WheelUnitsPerStep-ths of a step (positive away from the user).
+	ReleaseAll,		// Focus lost: every key and button is released.
+	KeyHeld			// The key is already down where the stream starts: a hold, but not a press.
+};
+
+struct InputEvent
+{
+	InputEventType Type = InputEventType::KeyDown;
+	uint32_t Code = 0;
+	int32_t X = 0;
+	int32_t Y = 0;
+
+	// Seconds, on the clock of InputSystem::Now().
+	double Time = 0.0;
+};
+
+enum class MouseAxis : uint8_t
+{
+	X,
+	Y
+};
+
+class InputSystem
+{
+public:
+	static const uint32_t MouseLeft = 1;
+	static const uint32_t MouseRight = 2;
+	static const uint32_t MouseMiddle = 4;
+
+	// Resolution of wheel events, the same as WHEEL_DELTA on Windows.
+	static const int32_t WheelUnitsPerStep = 120;
+
+	struct Stats
+	{
+		uint32_t EventCount = 0;
+		uint32_t MouseMoves = 0;
+		double AverageEventAgeMs = 0.0;
+		double MaxEventAgeMs = 0.0;
+		double UpdateMs = 0.0;
+	};
+
+	// Seconds since an arbitrary origin, from a monotonic clock.
+	static double Now();
+
+	void Push(const InputEvent& e);
+	void PushKey(uint32_t key, bool down, double time);
+	void PushButton(uint32_t button, bool down, int32_t x, int32_t y, double time);
+	void PushMouseMove(int32_t x, int32_t y, double time);
+	void PushWheel(float steps, double time);
+	void PushReleaseAll(double time);
+
+	// Several bindings can feed the same action; their values are summed.
+	void BindKey(uint32_t action, uint32_t key, float scale = 1.0f);
+	void BindMouseAxis(uint32_t action, MouseAxis axis, uint32_t requiredButtons, float scale);
+	void BindWheel(uint32_t action, float scale);
+	void ClearBindings();
+
+	// Consumes the queued events and computes the action values of the interval since the
+	// previous update, up to time. Keys still held count up to time.
+	void Update(double time);
+
+	float Value(uint32_t action)const;
+
+	// A bound key went down during the interval.
+	bool Pressed(uint32_t action)const;
+
+	// A bound key is held at the end of the interval.
+	bool Down(uint32_t action)const;
+
+	// Events consumed by the last update, in order (e.g. to record them).
+	const std::vector<InputEvent>& ProcessedEvents()const;
+
+	// Events that bring an input system with the same bindings from nothing held to the
+	// state after the last update: the cursor position, then every held button and bound
+	// key (KeyHeld, so they are not pressed again), timed at that update so holds are
+	// counted from the same instant.
+	std::vector<InputEvent> HeldStateEvents()const;
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+private:
+	struct KeyState
+	{
+		bool Down = false;
+		bool Pressed = false;
+
+		// Start of the part of the current hold not yet counted.
+		double Since = 0.0;
+		double HeldSeconds = 0.0;
+	};
+
+	struct KeyBinding
+	{
+		uint32_t Action;
+		uint32_t Key;
+		float Scale;
+	};
+
+	struct MouseBinding
+	{
+		uint32_t Action;
+		MouseAxis Axis;
+		uint32_t RequiredButtons;
+		float Scale;
+	};
+
+	struct WheelBinding
+	{
+		uint32_t Action;
+		float Scale;
+	};
+
+	struct ActionState
+	{
+		float Value = 0.0f;
+		bool Pressed = false;
+		bool Down = false;
+	};
+
+	void AddAction(uint32_t action);
+	void KeyDown(KeyState& key, double time, bool press);
+	void KeyUp(KeyState& key, double time);
+
+private:
+	std::vector<InputEvent> mQueue;
+	std::vector<InputEvent> mProcessed;
+
+	std::vector<KeyBinding> mKeyBindings;
+	std::vector<MouseBinding> mMouseBindings;
+	std::vector<WheelBinding> mWheelBindings;
+
+	// Only keys that have a binding are tracked.
+	std::unordered_map<uint32_t, KeyState> mKeys;
+
+	uint32_t mButtons = 0;
+	bool mHasCursor = false;
+	int32_t mCursorX = 0;
+	int32_t mCursorY = 0;
+
+	// Cursor deltas of the interval, indexed by the mask of buttons held while moving.
+	int64_t mDeltaX[8] = {};
+	int64_t mDeltaY[8] = {};
+	int64_t mWheel = 0;
+
+	double mLastUpdateTime = 0.0;
+	bool mUpdated = false;
+
+	std::vector<ActionState> mActions;
+
+	Stats mStats;
+};
@@ -0,0 +1,52 @@
+//***************************************************************************************
+// LatencyStats.cpp
+//***************************************************************************************
+
+#include "LatencyStats.h"
+
+#include <cstdio>
+
+void LatencyStats::Add(double ms)
+{
+	if (mStats.Count == 0)
+	{
+		mStats.MinMs = ms;
+		mStats.MaxMs = ms;
+	}
+	else
+	{
+		mStats.MinMs = ms < mStats.MinMs ? ms : mStats.MinMs;
+		mStats.MaxMs = ms > mStats.MaxMs ? ms : mStats.MaxMs;
+	}
+
+	mTotalMs += ms;
+	mStats.Count++;
+	mStats.LastMs = ms;
+	mStats.AverageMs = mTotalMs / (double)mStats.Count;
+}
+
+void LatencyStats::Add(Clock::time_point begin, Clock::time_point end)
+{
+	Add(std::chrono::duration<double, std::milli>(end - begin).count());
+}
+
+void LatencyStats::Reset()
+{
+	mStats = Stats();
+	mTotalMs = 0.0;
+}
+
+const LatencyStats::Stats& LatencyStats::GetStats()const
+{
+	return mStats;
+}
+
+std::string LatencyStats::Report(const char* name)const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"%s: %llu frames, %.3f ms average, %.3f ms min, %.3f ms max",
+		name, (unsigned long long)mStats.Count, mStats.AverageMs, mStats.MinMs, mStats.MaxMs);
+
+	return buffer;
+}
@@ -0,0 +1,38 @@
+//***************************************************************************************
+// LatencyStats.h
+//
+// Running statistics of a latency measured once per frame (e.g. from the moment input
+// was sampled to the moment the frame was submitted): last, average, min and max.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class LatencyStats
+{
+public:
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Stats
+	{
+		uint64_t Count = 0;
+		double LastMs = 0.0;
+		double AverageMs = 0.0;
+		double MinMs = 0.0;
+		double MaxMs = 0.0;
+	};
+
+	void Add(double ms);
+	void Add(Clock::time_point begin, Clock::time_point end);
+	void Reset();
+
+	const Stats& GetStats()const;
+	std::string Report(const char* name)const;
+
+private:
+	Stats mStats;
+	double mTotalMs = 0.0;
+};
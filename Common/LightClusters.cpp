@@ -0,0 +1,340 @@
+//***************************************************************************************
+// LightClusters.cpp
+//***************************************************************************************
+
+#include "LightClusters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+static bool SameGrid(const ClusterGridDesc& a, const ClusterGridDesc& b)
+{
+	return a.CountX == b.CountX && a.CountY == b.CountY && a.CountZ == b.CountZ &&
+		a.NearZ == b.NearZ && a.FarZ == b.FarZ &&
+		a.ProjScaleX == b.ProjScaleX && a.ProjScaleY == b.ProjScaleY &&
+		a.MaxLightIndices == b.MaxLightIndices;
+}
+
+// Tile covering the NDC coordinate, clamped to the grid.
+static uint32_t TileOf(float t, uint32_t count)
+{
+	int tile = (int)std::floor(t * (float)count);
+	return (uint32_t)std::min<int>(std::max<int>(tile, 0), (int)count - 1);
+}
+
+void LightClusters::SetGrid(const ClusterGridDesc& desc)
+{
+	if (mHasGrid && SameGrid(desc, mGrid))
+		return;
+
+	mGrid = desc;
+	mHasGrid = true;
+
+	mDepthScale = (float)mGrid.CountZ / std::log2(mGrid.FarZ / mGrid.NearZ);
+	mDepthBias = -std::log2(mGrid.NearZ) * mDepthScale;
+
+	BuildBounds();
+}
+
+const ClusterGridDesc& LightClusters::Grid()const
+{
+	return mGrid;
+}
+
+uint32_t LightClusters::ClusterCount()const
+{
+	return mGrid.CountX * mGrid.CountY * mGrid.CountZ;
+}
+
+uint32_t LightClusters::ClusterIndex(uint32_t x, uint32_t y, uint32_t z)const
+{
+	return x + mGrid.CountX * (y + mGrid.CountY * z);
+}
+
+void LightClusters::BuildBounds()
+{
+	uint32_t count = ClusterCount();
+	for (std::vector<float>* v : { &mMinX, &mMinY, &mMinZ, &mMaxX, &mMaxY, &mMaxZ, &mCenterX, &mCenterY, &mCenterZ, &mRadius })
+		v->assign(count + 3, 0.0f);
+
+	for (uint32_t z = 0; z < mGrid.CountZ; ++z)
+	{
+		float zNear = mGrid.NearZ * std::pow(mGrid.FarZ / mGrid.NearZ, (float)z / mGrid.CountZ);
+		float zFar = mGrid.NearZ * std::pow(mGrid.FarZ / mGrid.NearZ, (float)(z + 1) / mGrid.CountZ);
+
+		for (uint32_t y = 0; y < mGrid.CountY; ++y)
+		{
+			// Rows go top to bottom, like pixel coordinates.
+			float ndcTop = 1.0f - 2.0f * y / mGrid.CountY;
+			float ndcBottom = 1.0f - 2.0f * (y + 1) / mGrid.CountY;
+
+			for (uint32_t x = 0; x < mGrid.CountX; ++x)
+			{
+				float ndcLeft = -1.0f + 2.0f * x / mGrid.CountX;
+				float ndcRight = -1.0f + 2.0f * (x + 1) / mGrid.CountX;
+
+				// The cluster is a frustum slab; its box spans both depth ends.
+				uint32_t c = ClusterIndex(x, y, z);
+				mMinX[c] = std::min<float>(ndcLeft * zNear, ndcLeft * zFar) / mGrid.ProjScaleX;
+				mMaxX[c] = std::max<float>(ndcRight * zNear, ndcRight * zFar) / mGrid.ProjScaleX;
+				mMinY[c] = std::min<float>(ndcBottom * zNear, ndcBottom * zFar) / mGrid.ProjScaleY;
+				mMaxY[c] = std::max<float>(ndcTop * zNear, ndcTop * zFar) / mGrid.ProjScaleY;
+				mMinZ[c] = zNear;
+				mMaxZ[c] = zFar;
+
+				float ex = 0.5f * (mMaxX[c] - mMinX[c]);
+				float ey = 0.5f * (mMaxY[c] - mMinY[c]);
+				float ez = 0.5f * (mMaxZ[c] - mMinZ[c]);
+				mCenterX[c] = mMinX[c] + ex;
+				mCenterY[c] = mMinY[c] + ey;
+				mCenterZ[c] = mMinZ[c] + ez;
+				mRadius[c] = std::sqrt(ex * ex + ey * ey + ez * ez);
+			}
+		}
+	}
+
+	mRanges.assign(count, ClusterRange());
+}
+
+float LightClusters::DepthScale()const
+{
+	return mDepthScale;
+}
+
+float LightClusters::DepthBias()const
+{
+	return mDepthBias;
+}
+
+uint32_t LightClusters::Slice(float viewZ)const
+{
+	float slice = std::log2(std::max<float>(viewZ, mGrid.NearZ)) * mDepthScale + mDepthBias;
+	return std::min<uint32_t>((uint32_t)std::max<float>(slice, 0.0f), mGrid.CountZ - 1);
+}
+
+bool LightClusters::Intersects(const ClusterLight& light, uint32_t c)const
+{
+	// Sphere vs box: squared distance from the center to the box.
+	float d2 = 0.0f;
+	const float* p = light.Position;
+	float mins[3] = { mMinX[c], mMinY[c], mMinZ[c] };
+	float maxs[3] = { mMaxX[c], mMaxY[c], mMaxZ[c] };
+	for (int i = 0; i < 3; ++i)
+	{
+		float d = std::max<float>(mins[i] - p[i], 0.0f) + std::max<float>(p[i] - maxs[i], 0.0f);
+		d2 += d * d;
+	}
+	if (d2 > light.Range * light.Range)
+		return false;
+
+	// Cones up to 90 degrees are also tested against the cluster's bounding sphere.
+	if (!light.IsSpot || light.CosAngle <= 0.0f)
+		return true;
+
+	float vx = mCenterX[c] - p[0];
+	float vy = mCenterY[c] - p[1];
+	float vz = mCenterZ[c] - p[2];
+	float lengthSq = vx * vx + vy * vy + vz * vz;
+	float along = vx * light.Direction[0] + vy * light.Direction[1] + vz * light.Direction[2];
+	float sinAngle = std::sqrt(1.0f - light.CosAngle * light.CosAngle);
+	float distance = light.CosAngle * std::sqrt(std::max<float>(lengthSq - along * along, 0.0f)) - along * sinAngle;
+
+	float r = mRadius[c];
+	return distance <= r && along <= r + light.Range && along >= -r;
+}
+
+#if LIGHT_CLUSTERS_SSE
+
+uint32_t LightClusters::Test4(const ClusterLight& light, uint32_t first)const
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 px = _mm_set1_ps(light.Position[0]);
+	const __m128 py = _mm_set1_ps(light.Position[1]);
+	const __m128 pz = _mm_set1_ps(light.Position[2]);
+
+	__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinX[first]), px), zero),
+		_mm_max_ps(_mm_sub_ps(px, _mm_loadu_ps(&mMaxX[first])), zero));
+	__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinY[first]), py), zero),
+		_mm_max_ps(_mm_sub_ps(py, _mm_loadu_ps(&mMaxY[first])), zero));
+	__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinZ[first]), pz), zero),
+		_mm_max_ps(_mm_sub_ps(pz, _mm_loadu_ps(&mMaxZ[first])), zero));
+
+	__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+	__m128 hit = _mm_cmple_ps(d2, _mm_set1_ps(light.Range * light.Range));
+
+	if (light.IsSpot && light.CosAngle > 0.0f && _mm_movemask_ps(hit) != 0)
+	{
+		__m128 vx = _mm_sub_ps(_mm_loadu_ps(&mCenterX[first]), px);
+		__m128 vy = _mm_sub_ps(_mm_loadu_ps(&mCenterY[first]), py);
+		__m128 vz = _mm_sub_ps(_mm_loadu_ps(&mCenterZ[first]), pz);
+		__m128 r = _mm_loadu_ps(&mRadius[first]);
+
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		__m128 along = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(vx, _mm_set1_ps(light.Direction[0])),
+			_mm_mul_ps(vy, _mm_set1_ps(light.Direction[1]))),
+			_mm_mul_ps(vz, _mm_set1_ps(light.Direction[2])));
+
+		float sinAngle = std::sqrt(1.0f - light.CosAngle * light.CosAngle);
+		__m128 side = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+		__m128 distance = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(light.CosAngle), side), _mm_mul_ps(along, _mm_set1_ps(sinAngle)));
+
+		__m128 cone = _mm_and_ps(_mm_cmple_ps(distance, r),
+			_mm_and_ps(_mm_cmple_ps(along, _mm_add_ps(r, _mm_set1_ps(light.Range))),
+				_mm_cmpge_ps(along, _mm_sub_ps(zero, r))));
+		hit = _mm_and_ps(hit, cone);
+	}
+
+	return (uint32_t)_mm_movemask_ps(hit);
+}
+
+#else
+
+uint32_t LightClusters::Test4(const ClusterLight& light, uint32_t first)const
+{
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (Intersects(light, first + i))
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+#endif
+
+void LightClusters::Assign(const ClusterLight* lights, uint32_t count)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mStats = Stats();
+	mStats.LightCount = count;
+	mPairs.clear();
+
+	for (uint32_t l = 0; l < count; ++l)
+	{
+		const ClusterLight& light = lights[l];
+		float px = light.Position[0];
+		float py = light.Position[1];
+		float r = light.Range;
+
+		float zMin = light.Position[2] - r;
+		float zMax = light.Position[2] + r;
+		if (zMax < mGrid.NearZ || zMin > mGrid.FarZ || r <= 0.0f)
+			continue;
+		zMin = std::max<float>(zMin, mGrid.NearZ);
+		zMax = std::min<float>(zMax, mGrid.FarZ);
+
+		// Conservative NDC extent: x/z is monotonic in z for a fixed x, so the sphere's
+		// x range divided by both depth ends bounds it.
+		float left = mGrid.ProjScaleX * std::min<float>((px - r) / zMin, (px - r) / zMax);
+		float right = mGrid.ProjScaleX * std::max<float>((px + r) / zMin, (px + r) / zMax);
+		float bottom = mGrid.ProjScaleY * std::min<float>((py - r) / zMin, (py - r) / zMax);
+		float top = mGrid.ProjScaleY * std::max<float>((py + r) / zMin, (py + r) / zMax);
+		if (right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f)
+			continue;
+
+		uint32_t x0 = TileOf(0.5f * (left + 1.0f), mGrid.CountX);
+		uint32_t x1 = TileOf(0.5f * (right + 1.0f), mGrid.CountX);
+		uint32_t y0 = TileOf(0.5f * (1.0f - top), mGrid.CountY);
+		uint32_t y1 = TileOf(0.5f * (1.0f - bottom), mGrid.CountY);
+		uint32_t z0 = Slice(zMin);
+		uint32_t z1 = Slice(zMax);
+
+		for (uint32_t z = z0; z <= z1; ++z)
+		{
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				uint32_t row = ClusterIndex(0, y, z);
+				for (uint32_t x = x0; x <= x1; x += 4)
+				{
+					uint32_t valid = x1 - x >= 3 ? 0xF : (1u << (x1 - x + 1)) - 1;
+					uint32_t mask = Test4(light, row + x) & valid;
+					mStats.ClustersTested += 4;
+
+					for (uint32_t i = 0; mask != 0; ++i, mask >>= 1)
+					{
+						if (mask & 1)
+							mPairs.emplace_back(row + x + i, l);
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort by cluster; lights stay in ascending order within a cluster.
+	if (mPairs.size() > mGrid.MaxLightIndices)
+	{
+		mStats.DroppedIndices = (uint32_t)(mPairs.size() - mGrid.MaxLightIndices);
+		mPairs.resize(mGrid.MaxLightIndices);
+	}
+
+	for (ClusterRange& range : mRanges)
+		range = ClusterRange();
+	for (const auto& pair : mPairs)
+		++mRanges[pair.first].Count;
+
+	uint32_t offset = 0;
+	for (ClusterRange& range : mRanges)
+	{
+		range.Offset = offset;
+		offset += range.Count;
+
+		if (range.Count > 0)
+			++mStats.OccupiedClusters;
+		mStats.MaxLightsPerCluster = std::max<uint32_t>(mStats.MaxLightsPerCluster, range.Count);
+	}
+
+	mIndices.resize(mPairs.size());
+	for (ClusterRange& range : mRanges)
+		range.Count = 0;
+	for (const auto& pair : mPairs)
+	{
+		ClusterRange& range = mRanges[pair.first];
+		mIndices[range.Offset + range.Count++] = pair.second;
+	}
+
+	mStats.IndexCount = (uint32_t)mIndices.size();
+	mStats.AssignMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const std::vector<ClusterRange>& LightClusters::Ranges()const
+{
+	return mRanges;
+}
+
+const std::vector<uint32_t>& LightClusters::LightIndices()const
+{
+	return mIndices;
+}
+
+const LightClusters::Stats& LightClusters::GetStats()const
+{
+	return mStats;
+}
+
+std::string LightClusters::Report()const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"LightClusters: %u lights, %u indices (%u dropped), %u/%u clusters occupied, max %u per cluster, %.3f ms",
+		mStats.LightCount, mStats.IndexCount, mStats.DroppedIndices, mStats.OccupiedClusters,
+		ClusterCount(), mStats.MaxLightsPerCluster, mStats.AssignMs);
+
+	return buffer;
+}
+
+float LightClusters::SpotCosAngle(float spotPower, float cutoff)
+{
+	// pow(x, 0) is 1 everywhere in front of the light.
+	if (spotPower <= 0.0f)
+		return 0.0f;
+
+	return std::pow(cutoff, 1.0f / spotPower);
+}
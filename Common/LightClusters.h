@@ -0,0 +1,125 @@
+//***************************************************************************************
+// LightClusters.h
+//
+// CPU light assignment for clustered forward shading.
+//   -The view frustum is divided into CountX x CountY screen tiles and CountZ depth
+//    slices. Slices are exponential in view depth, so near clusters are thin and far
+//    ones thick: slice = floor(log2(z) * DepthScale() + DepthBias()).
+//   -Assign bins point lights (spheres) and spot lights (cones) into the clusters they
+//    touch and produces, for every cluster, a range into one compact list of light
+//    indices. Both arrays are meant to be uploaded as structured buffers.
+//   -Each light only visits the clusters under its conservative screen/depth bounds;
+//    those are tested four at a time against the light with SSE (scalar fallback
+//    elsewhere). Cluster bounds are stored as structure of arrays for that purpose.
+//   -Lights come in view space; uploading the ranges and indices is up to the caller.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ClusterGridDesc
+{
+	uint32_t CountX = 16;
+	uint32_t CountY = 9;
+	uint32_t CountZ = 24;
+
+	// View depth covered by the slices.
+	float NearZ = 1.0f;
+	float FarZ = 1000.0f;
+
+	// Proj(0,0) and Proj(1,1) of the perspective projection (left-handed, +z forward).
+	float ProjScaleX = 1.0f;
+	float ProjScaleY = 1.0f;
+
+	// Capacity of the index list; references past it are dropped.
+	uint32_t MaxLightIndices = 1 << 19;
+};
+
+// A light in view space.
+struct ClusterLight
+{
+	float Position[3] = { 0.0f, 0.0f, 0.0f };
+	float Range = 0.0f;
+
+	// Spot lights only: unit axis and cosine of the cone half-angle.
+	float Direction[3] = { 0.0f, 0.0f, 1.0f };
+	float CosAngle = -1.0f;
+	bool IsSpot = false;
+};
+
+// Lights of one cluster: LightIndices()[Offset, Offset + Count).
+struct ClusterRange
+{
+	uint32_t Offset = 0;
+	uint32_t Count = 0;
+};
+
+class LightClusters
+{
+public:
+	struct Stats
+	{
+		uint32_t LightCount = 0;
+		uint32_t IndexCount = 0;
+		uint32_t DroppedIndices = 0;
+		uint32_t OccupiedClusters = 0;
+		uint32_t MaxLightsPerCluster = 0;
+		uint64_t ClustersTested = 0;
+		double AssignMs = 0.0;
+	};
+
+	// Recomputes the cluster bounds only if the grid actually changed.
+	void SetGrid(const ClusterGridDesc& desc);
+	const ClusterGridDesc& Grid()const;
+	uint32_t ClusterCount()const;
+	uint32_t ClusterIndex(uint32_t x, uint32_t y, uint32_t z)const;
+
+	void Assign(const ClusterLight* lights, uint32_t count);
+
+	const std::vector<ClusterRange>& Ranges()const;
+	const std::vector<uint32_t>& LightIndices()const;
+
+	float DepthScale()const;
+	float DepthBias()const;
+	uint32_t Slice(float viewZ)const;
+
+	// Exact (scalar) test of one light against one cluster, as done by Assign.
+	bool Intersects(const ClusterLight& light, uint32_t cluster)const;
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+	// Cone half-angle past which pow(cos, spotPower) falls below cutoff, as a cosine.
+	static float SpotCosAngle(float spotPower, float cutoff = 1.0f / 256.0f);
+
+private:
+	void BuildBounds();
+
+	// Bit i set if cluster first + i intersects the light.
+	uint32_t Test4(const ClusterLight& light, uint32_t first)const;
+
+private:
+	ClusterGridDesc mGrid;
+	bool mHasGrid = false;
+
+	float mDepthScale = 0.0f;
+	float mDepthBias = 0.0f;
+
+	// Cluster bounds in view space: a box, and the sphere around it for the cone test.
+	// Padded by 3 so that four clusters can always be loaded at once.
+	std::vector<float> mMinX, mMinY, mMinZ;
+	std::vector<float> mMaxX, mMaxY, mMaxZ;
+	std::vector<float> mCenterX, mCenterY, mCenterZ, mRadius;
+
+	// (cluster, light) pairs found by the tests, in light order.
+	std::vector<std::pair<uint32_t, uint32_t>> mPairs;
+
+	std::vector<ClusterRange> mRanges;
+	std::vector<uint32_t> mIndices;
+
+	Stats mStats;
+};
@@ -0,0 +1,42 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file: the contents are paged in on access
+// instead of being copied through a read buffer. Win32 and POSIX implementations.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// Returns false if the file does not exist or cannot be mapped. Empty files are
+	// opened successfully and have no data.
+	bool Open(const std::wstring& filename);
+	void Close();
+
+	bool IsOpen()const { return mOpen; }
+	const uint8_t* Data()const { return mData; }
+	size_t Size()const { return mSize; }
+
+private:
+	bool mOpen = false;
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+};
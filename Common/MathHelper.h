@@ -78,6 +78,50 @@ public:
         return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, A));
 	}
 
+	// Inverse of a rotation followed by a translation (e.g. a view matrix): the
+	// transpose of the rotation, and the translation brought back through it.
+	static DirectX::XMMATRIX InverseRigid(DirectX::FXMMATRIX M)
+	{
+		DirectX::XMMATRIX R = M;
+		R.r[3] = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		R = DirectX::XMMatrixTranspose(R);
+
+		DirectX::XMVECTOR t = DirectX::XMVector3TransformNormal(DirectX::XMVectorNegate(M.r[3]), R);
+		R.r[3] = DirectX::XMVectorSetW(t, 1.0f);
+		return R;
+	}
+
+	// Inverse of a left-handed perspective projection (XMMatrixPerspectiveFovLH and the
+	// like): only _11, _22, _33, _34 = 1 and _43 are non-zero, so it has a closed form.
+	static DirectX::XMMATRIX InversePerspective(DirectX::FXMMATRIX P)
+	{
+		DirectX::XMFLOAT4X4 p;
+		DirectX::XMStoreFloat4x4(&p, P);
+
+		return DirectX::XMMatrixSet(
+			1.0f / p._11, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f / p._22, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f / p._43,
+			0.0f, 0.0f, 1.0f, -p._33 / p._43);
+	}
+
+	// Blend of two affine transforms (scale, rotation, translation): scale and translation
+	// are lerped and rotation is slerped, so the result stays rigid, unlike a lerp of the
+	// matrices.
+	static DirectX::XMMATRIX InterpolateTransform(DirectX::FXMMATRIX A, DirectX::CXMMATRIX B, float t)
+	{
+		DirectX::XMVECTOR scaleA, rotationA, translationA;
+		DirectX::XMVECTOR scaleB, rotationB, translationB;
+		DirectX::XMMatrixDecompose(&scaleA, &rotationA, &translationA, A);
+		DirectX::XMMatrixDecompose(&scaleB, &rotationB, &translationB, B);
+
+		return DirectX::XMMatrixAffineTransformation(
+			DirectX::XMVectorLerp(scaleA, scaleB, t),
+			DirectX::XMVectorZero(),
+			DirectX::XMQuaternionSlerp(rotationA, rotationB, t),
+			DirectX::XMVectorLerp(translationA, translationB, t));
+	}
+
     static DirectX::XMFLOAT4X4 Identity4x4()
     {
         static DirectX::XMFLOAT4X4 I(
@@ -0,0 +1,156 @@
+//***************************************************************************************
+// MeshRayTest.cpp
+//***************************************************************************************
+
+#include "MeshRayTest.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+uint32_t MeshRayTest::AddMesh(const void* vertices, uint32_t vertexStride, const uint16_t* indices, uint32_t indexCount,
+	uint32_t startIndex, int32_t baseVertex)
+{
+	Mesh mesh;
+	mesh.FirstTriangle = (uint32_t)(mTriangles.size() / 9);
+	mesh.TriangleCount = indexCount / 3;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+	for (uint32_t i = 0; i < 3 * mesh.TriangleCount; ++i)
+	{
+		float position[3];
+		memcpy(position, bytes + (size_t)(baseVertex + indices[startIndex + i]) * vertexStride, sizeof(position));
+		mTriangles.insert(mTriangles.end(), position, position + 3);
+	}
+
+	mMeshes.push_back(mesh);
+	return (uint32_t)mMeshes.size() - 1;
+}
+
+void MeshRayTest::SetItem(uint32_t item, uint32_t mesh, const float world[16])
+{
+	SetWorld(item, world);
+	mItems[item].Mesh = mesh;
+}
+
+void MeshRayTest::SetWorld(uint32_t item, const float world[16])
+{
+	if (item >= mItems.size())
+		mItems.resize(item + 1);
+
+	Item& entry = mItems[item];
+
+	// Inverse of the 3x3 part from its cofactors; rows transform row vectors.
+	const float* m = world;
+	float c00 = m[5] * m[10] - m[6] * m[9];
+	float c01 = m[6] * m[8] - m[4] * m[10];
+	float c02 = m[4] * m[9] - m[5] * m[8];
+	float det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+	assert(det != 0.0f);
+	float invDet = 1.0f / det;
+
+	float* inv = entry.InvWorld;
+	inv[0] = c00 * invDet;
+	inv[1] = (m[2] * m[9] - m[1] * m[10]) * invDet;
+	inv[2] = (m[1] * m[6] - m[2] * m[5]) * invDet;
+	inv[3] = c01 * invDet;
+	inv[4] = (m[0] * m[10] - m[2] * m[8]) * invDet;
+	inv[5] = (m[2] * m[4] - m[0] * m[6]) * invDet;
+	inv[6] = c02 * invDet;
+	inv[7] = (m[1] * m[8] - m[0] * m[9]) * invDet;
+	inv[8] = (m[0] * m[5] - m[1] * m[4]) * invDet;
+
+	// Translation: -t * inverse(3x3).
+	for (int j = 0; j < 3; ++j)
+		inv[9 + j] = -(m[12] * inv[j] + m[13] * inv[3 + j] + m[14] * inv[6 + j]);
+}
+
+void MeshRayTest::Clear()
+{
+	mTriangles.clear();
+	mMeshes.clear();
+	mItems.clear();
+	mStats = Stats();
+}
+
+bool MeshRayTest::Intersect(uint32_t item, const float origin[3], const float direction[3], float boxDistance,
+	float maxDistance, float& distance, uint32_t& triangle)
+{
+	mStats.Tests++;
+
+	if (item >= mItems.size() || mItems[item].Mesh == NoMesh)
+	{
+		distance = boxDistance;
+		triangle = BoundsBvh::NoItem;
+		return true;
+	}
+
+	const Item& entry = mItems[item];
+	const float* inv = entry.InvWorld;
+
+	float o[3];
+	float d[3];
+	for (int j = 0; j < 3; ++j)
+	{
+		o[j] = origin[0] * inv[j] + origin[1] * inv[3 + j] + origin[2] * inv[6 + j] + inv[9 + j];
+		d[j] = direction[0] * inv[j] + direction[1] * inv[3 + j] + direction[2] * inv[6 + j];
+	}
+
+	const Mesh& mesh = mMeshes[entry.Mesh];
+	mStats.TrianglesTested += mesh.TriangleCount;
+
+	float best = maxDistance;
+	bool found = false;
+
+	const float* v = &mTriangles[9 * (size_t)mesh.FirstTriangle];
+	for (uint32_t t = 0; t < mesh.TriangleCount; ++t, v += 9)
+	{
+		float e1[3] = { v[3] - v[0], v[4] - v[1], v[5] - v[2] };
+		float e2[3] = { v[6] - v[0], v[7] - v[1], v[8] - v[2] };
+
+		float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (std::fabs(det) < 1e-12f)
+			continue;
+		float invDet = 1.0f / det;
+
+		float s[3] = { o[0] - v[0], o[1] - v[1], o[2] - v[2] };
+		float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			continue;
+
+		float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		float w = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+		if (w < 0.0f || u + w > 1.0f)
+			continue;
+
+		float hit = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+		if (hit > 0.0f && hit < best)
+		{
+			best = hit;
+			triangle = t;
+			found = true;
+		}
+	}
+
+	distance = best;
+	return found;
+}
+
+const MeshRayTest::Stats& MeshRayTest::GetStats()const
+{
+	return mStats;
+}
+
+std::string MeshRayTest::Report()const
+{
+	double tests = (double)std::max<uint64_t>(mStats.Tests, 1);
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "MeshRayTest: %u meshes, %u triangles; %llu item tests, %.1f triangles per test",
+		(uint32_t)mMeshes.size(), (uint32_t)(mTriangles.size() / 9), (unsigned long long)mStats.Tests,
+		mStats.TrianglesTested / tests);
+
+	return buffer;
+}
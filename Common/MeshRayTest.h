@@ -0,0 +1,68 @@
+//***************************************************************************************
+// MeshRayTest.h
+//
+// Exact ray test against the triangles of the items of a BoundsBvh.
+//   -Meshes are copied from indexed triangle lists (16-bit indices, positions as the
+//    first three floats of each vertex), the same data the vertex and index buffers
+//    are built from, with the base vertex and start index of the draw call.
+//   -Every item refers to a mesh and a world matrix. The ray is brought to object space
+//    instead of the triangles to world space; the direction is not renormalized, so
+//    distances stay those along the world ray. Triangles are two-sided
+//    (Moller-Trumbore) and numbered from the start index of the mesh.
+//   -Items without a mesh are hit on their box.
+//   -Matrices are row-major and transform row vectors, like DirectXMath's.
+//***************************************************************************************
+
+#pragma once
+
+#include "BoundsBvh.h"
+
+class MeshRayTest : public BoundsBvh::ItemTest
+{
+public:
+	struct Stats
+	{
+		uint64_t Tests = 0;
+		uint64_t TrianglesTested = 0;
+	};
+
+	uint32_t AddMesh(const void* vertices, uint32_t vertexStride, const uint16_t* indices, uint32_t indexCount,
+		uint32_t startIndex, int32_t baseVertex);
+
+	// The world matrix must be invertible. SetWorld moves an item (one without a mesh
+	// keeps being hit on its box).
+	void SetItem(uint32_t item, uint32_t mesh, const float world[16]);
+	void SetWorld(uint32_t item, const float world[16]);
+	void Clear();
+
+	bool Intersect(uint32_t item, const float origin[3], const float direction[3], float boxDistance,
+		float maxDistance, float& distance, uint32_t& triangle)override;
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+	static const uint32_t NoMesh = 0xffffffff;
+
+private:
+	struct Mesh
+	{
+		uint32_t FirstTriangle;
+		uint32_t TriangleCount;
+	};
+
+	struct Item
+	{
+		uint32_t Mesh = NoMesh;
+
+		// Inverse of the world matrix: rows 0-2 of the 3x3 part, then the translation.
+		float InvWorld[12];
+	};
+
+private:
+	// Nine floats (three positions) per triangle, in object space.
+	std::vector<float> mTriangles;
+	std::vector<Mesh> mMeshes;
+	std::vector<Item> mItems;
+
+	Stats mStats;
+};
@@ -0,0 +1,470 @@
+//***************************************************************************************
+// PipelineStateCache.cpp
+//***************************************************************************************
+
+#include "PipelineStateCache.h"
+#include "Hash.h"
+#include <chrono>
+
+using Microsoft::WRL::ComPtr;
+
+static bool ReadWholeFile(const std::wstring& filename, std::vector<char>& data)
+{
+	std::ifstream fin(filename, std::ios::binary);
+	if (!fin)
+		return false;
+
+	fin.seekg(0, std::ios_base::end);
+	data.resize((size_t)fin.tellg());
+	fin.seekg(0, std::ios_base::beg);
+	fin.read(data.data(), data.size());
+
+	return (bool)fin;
+}
+
+static void WriteWholeFile(const std::wstring& filename, const void* data, size_t size)
+{
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	fout.write((const char*)data, size);
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void HashBytecode(Hasher& h, const D3D12_SHADER_BYTECODE& bytecode)
+{
+	h.Add((UINT64)bytecode.BytecodeLength);
+	if (bytecode.BytecodeLength > 0)
+		h.Add(bytecode.pShaderBytecode, bytecode.BytecodeLength);
+}
+
+PipelineStateCache::PipelineStateCache(ID3D12Device* device, const std::wstring& cacheDirectory, UINT workerCount) :
+	mDevice(device),
+	mCacheDirectory(cacheDirectory)
+{
+	CreateDirectoryW(mCacheDirectory.c_str(), nullptr);
+
+	OpenLibrary();
+
+	if (workerCount == 0)
+		workerCount = std::min<UINT>(std::max<UINT>(std::thread::hardware_concurrency(), 2u) - 1, 4u);
+
+	for (UINT i = 0; i < workerCount; ++i)
+		mWorkers.emplace_back(&PipelineStateCache::WorkerMain, this);
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mJobAvailable.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+std::wstring PipelineStateCache::CachePath(const std::wstring& name)const
+{
+	return mCacheDirectory + L"\\" + name;
+}
+
+void PipelineStateCache::OpenLibrary()
+{
+	// Pipeline libraries need ID3D12Device1; without it every PSO is simply created.
+	ComPtr<ID3D12Device1> device1;
+	if (FAILED(mDevice->QueryInterface(IID_PPV_ARGS(&device1))))
+		return;
+
+	if (ReadWholeFile(CachePath(L"PipelineLibrary.bin"), mLibraryData) && !mLibraryData.empty())
+	{
+		// Fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH/ADAPTER_NOT_FOUND when the blob
+		// was written by another driver or GPU: start over with an empty library.
+		HRESULT hr = device1->CreatePipelineLibrary(mLibraryData.data(), mLibraryData.size(), IID_PPV_ARGS(&mLibrary));
+		if (SUCCEEDED(hr))
+			return;
+
+		::OutputDebugStringA("PipelineStateCache: stale pipeline library discarded.\n");
+		mLibraryData.clear();
+	}
+
+	if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&mLibrary))))
+		mLibrary = nullptr;
+}
+
+ComPtr<ID3D12RootSignature> PipelineStateCache::CreateRootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+	UINT64 hash = HashRootSignatureDesc(desc);
+	std::wstring path = CachePath(L"RootSignature_" + AnsiToWString(Hasher::ToHex(hash)) + L".bin");
+
+	std::vector<char> serialized;
+	if (ReadWholeFile(path, serialized) && !serialized.empty())
+	{
+		++mStats.RootSignatureHits;
+	}
+	else
+	{
+		ComPtr<ID3DBlob> serializedRootSig = nullptr;
+		ComPtr<ID3DBlob> errorBlob = nullptr;
+		HRESULT hr = D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1,
+			serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+		if (errorBlob != nullptr)
+		{
+			::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+		}
+		ThrowIfFailed(hr);
+
+		const char* bytes = (const char*)serializedRootSig->GetBufferPointer();
+		serialized.assign(bytes, bytes + serializedRootSig->GetBufferSize());
+		WriteWholeFile(path, serialized.data(), serialized.size());
+
+		++mStats.RootSignatureMisses;
+	}
+
+	ComPtr<ID3D12RootSignature> rootSignature;
+	ThrowIfFailed(mDevice->CreateRootSignature(0, serialized.data(), serialized.size(),
+		IID_PPV_ARGS(rootSignature.GetAddressOf())));
+
+	// PSO keys refer to the root signature by the hash of its desc.
+	mRootSignatureHashes[rootSignature.Get()] = hash;
+
+	return rootSignature;
+}
+
+PipelineStateCache::Handle PipelineStateCache::RequestGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	auto rs = mRootSignatureHashes.find(desc.pRootSignature);
+	assert(rs != mRootSignatureHashes.end() && "Root signature not created by the PipelineStateCache.");
+	assert(desc.StreamOutput.NumEntries == 0 && "Stream output is not supported by the cache.");
+
+	UINT64 hash = HashGraphicsPipelineDesc(desc, rs->second);
+
+	auto it = mHandles.find(hash);
+	if (it != mHandles.end())
+		return it->second;
+
+	Handle handle = (Handle)mEntries.size();
+	mEntries.push_back(std::make_unique<Entry>());
+	mEntries.back()->Hash = hash;
+	mHandles[hash] = handle;
+
+	// Deep copy of the desc: the job may run after the caller's blobs are gone.
+	auto job = std::make_unique<GraphicsJob>();
+	job->Desc = desc;
+	job->RootSignature = desc.pRootSignature;
+	job->Target = mEntries.back().get();
+
+	D3D12_SHADER_BYTECODE* stages[5] = { &job->Desc.VS, &job->Desc.PS, &job->Desc.DS, &job->Desc.HS, &job->Desc.GS };
+	for (int i = 0; i < 5; ++i)
+	{
+		const BYTE* bytes = (const BYTE*)stages[i]->pShaderBytecode;
+		job->Bytecode[i].assign(bytes, bytes + stages[i]->BytecodeLength);
+		stages[i]->pShaderBytecode = job->Bytecode[i].data();
+	}
+
+	job->InputElements.assign(desc.InputLayout.pInputElementDescs,
+		desc.InputLayout.pInputElementDescs + desc.InputLayout.NumElements);
+	for (const auto& e : job->InputElements)
+		job->SemanticNames.push_back(e.SemanticName);
+	for (size_t i = 0; i < job->InputElements.size(); ++i)
+		job->InputElements[i].SemanticName = job->SemanticNames[i].c_str();
+	job->Desc.InputLayout = { job->InputElements.data(), (UINT)job->InputElements.size() };
+
+	job->Desc.CachedPSO = {};
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(std::move(job));
+		++mStats.Pending;
+	}
+	mJobAvailable.notify_one();
+
+	return handle;
+}
+
+void PipelineStateCache::WorkerMain()
+{
+	for (;;)
+	{
+		std::unique_ptr<GraphicsJob> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAvailable.wait(lock, [this] { return mStop || !mJobs.empty(); });
+
+			// Queued jobs are finished even when stopping.
+			if (mJobs.empty())
+				return;
+
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		RunJob(*job);
+	}
+}
+
+void PipelineStateCache::RunJob(GraphicsJob& job)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Entry& entry = *job.Target;
+	std::wstring name = AnsiToWString(Hasher::ToHex(entry.Hash));
+
+	bool hit = false;
+	if (mLibrary != nullptr)
+	{
+		// E_INVALIDARG when the library has no pipeline with that name.
+		hit = SUCCEEDED(mLibrary->LoadGraphicsPipeline(name.c_str(), &job.Desc, IID_PPV_ARGS(&entry.Pso)));
+	}
+
+	if (!hit)
+	{
+		entry.Result = mDevice->CreateGraphicsPipelineState(&job.Desc, IID_PPV_ARGS(&entry.Pso));
+
+		if (SUCCEEDED(entry.Result) && mLibrary != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mLibraryMutex);
+			if (SUCCEEDED(mLibrary->StorePipeline(name.c_str(), entry.Pso.Get())))
+				mLibraryDirty = true;
+		}
+	}
+
+	double ms = MillisecondsSince(start);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (hit)
+			++mStats.Hits;
+		else
+			++mStats.Misses;
+		--mStats.Pending;
+		mStats.CreateMs += ms;
+
+		entry.Ready = true;
+	}
+	mJobDone.notify_all();
+}
+
+ID3D12PipelineState* PipelineStateCache::TryGet(Handle handle)const
+{
+	assert(handle < mEntries.size());
+
+	const Entry& entry = *mEntries[handle];
+	if (!entry.Ready || FAILED(entry.Result))
+		return nullptr;
+
+	return entry.Pso.Get();
+}
+
+ID3D12PipelineState* PipelineStateCache::Wait(Handle handle)
+{
+	assert(handle < mEntries.size());
+
+	Entry& entry = *mEntries[handle];
+	if (!entry.Ready)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mJobDone.wait(lock, [&entry] { return entry.Ready.load(); });
+
+		mStats.WaitMs += MillisecondsSince(start);
+	}
+
+	if (FAILED(entry.Result))
+		throw DxException(entry.Result, L"PipelineStateCache::Wait", AnsiToWString(__FILE__), __LINE__);
+
+	return entry.Pso.Get();
+}
+
+void PipelineStateCache::WaitAll()
+{
+	for (Handle h = 0; h < (Handle)mEntries.size(); ++h)
+		Wait(h);
+}
+
+void PipelineStateCache::Save()
+{
+	std::lock_guard<std::mutex> lock(mLibraryMutex);
+
+	if (mLibrary == nullptr || !mLibraryDirty)
+		return;
+
+	std::vector<char> data(mLibrary->GetSerializedSize());
+	ThrowIfFailed(mLibrary->Serialize(data.data(), data.size()));
+	WriteWholeFile(CachePath(L"PipelineLibrary.bin"), data.data(), data.size());
+
+	mLibraryDirty = false;
+}
+
+PipelineStateCache::Stats PipelineStateCache::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+void PipelineStateCache::LogStats()const
+{
+	Stats stats = GetStats();
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"PipelineStateCache: %u hits, %u misses (%.0f%% hit rate), %u pending, root signatures %u/%u cached, "
+		"%.1f ms creating, %.1f ms waited\n",
+		stats.Hits, stats.Misses, stats.HitRate() * 100.0f, stats.Pending,
+		stats.RootSignatureHits, stats.RootSignatureHits + stats.RootSignatureMisses,
+		stats.CreateMs, stats.WaitMs);
+
+	::OutputDebugStringA(buffer);
+}
+
+UINT64 PipelineStateCache::HashRootSignatureDesc(const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+	Hasher h;
+
+	h.Add(desc.NumParameters);
+	for (UINT i = 0; i < desc.NumParameters; ++i)
+	{
+		const D3D12_ROOT_PARAMETER& p = desc.pParameters[i];
+		h.Add(p.ParameterType);
+		h.Add(p.ShaderVisibility);
+
+		switch (p.ParameterType)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+			h.Add(p.DescriptorTable.NumDescriptorRanges);
+			for (UINT r = 0; r < p.DescriptorTable.NumDescriptorRanges; ++r)
+			{
+				const D3D12_DESCRIPTOR_RANGE& range = p.DescriptorTable.pDescriptorRanges[r];
+				h.Add(range.RangeType);
+				h.Add(range.NumDescriptors);
+				h.Add(range.BaseShaderRegister);
+				h.Add(range.RegisterSpace);
+				h.Add(range.OffsetInDescriptorsFromTableStart);
+			}
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			h.Add(p.Constants.ShaderRegister);
+			h.Add(p.Constants.RegisterSpace);
+			h.Add(p.Constants.Num32BitValues);
+			break;
+		default:
+			h.Add(p.Descriptor.ShaderRegister);
+			h.Add(p.Descriptor.RegisterSpace);
+			break;
+		}
+	}
+
+	h.Add(desc.NumStaticSamplers);
+	for (UINT i = 0; i < desc.NumStaticSamplers; ++i)
+	{
+		const D3D12_STATIC_SAMPLER_DESC& s = desc.pStaticSamplers[i];
+		h.Add(s.Filter);
+		h.Add(s.AddressU);
+		h.Add(s.AddressV);
+		h.Add(s.AddressW);
+		h.Add(s.MipLODBias);
+		h.Add(s.MaxAnisotropy);
+		h.Add(s.ComparisonFunc);
+		h.Add(s.BorderColor);
+		h.Add(s.MinLOD);
+		h.Add(s.MaxLOD);
+		h.Add(s.ShaderRegister);
+		h.Add(s.RegisterSpace);
+		h.Add(s.ShaderVisibility);
+	}
+
+	h.Add(desc.Flags);
+
+	return h.Value();
+}
+
+UINT64 PipelineStateCache::HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash)
+{
+	Hasher h;
+
+	h.Add(rootSignatureHash);
+
+	HashBytecode(h, desc.VS);
+	HashBytecode(h, desc.PS);
+	HashBytecode(h, desc.DS);
+	HashBytecode(h, desc.HS);
+	HashBytecode(h, desc.GS);
+
+	const D3D12_BLEND_DESC& blend = desc.BlendState;
+	h.Add(blend.AlphaToCoverageEnable);
+	h.Add(blend.IndependentBlendEnable);
+	for (const auto& rt : blend.RenderTarget)
+	{
+		h.Add(rt.BlendEnable);
+		h.Add(rt.LogicOpEnable);
+		h.Add(rt.SrcBlend);
+		h.Add(rt.DestBlend);
+		h.Add(rt.BlendOp);
+		h.Add(rt.SrcBlendAlpha);
+		h.Add(rt.DestBlendAlpha);
+		h.Add(rt.BlendOpAlpha);
+		h.Add(rt.LogicOp);
+		h.Add(rt.RenderTargetWriteMask);
+	}
+
+	h.Add(desc.SampleMask);
+
+	const D3D12_RASTERIZER_DESC& raster = desc.RasterizerState;
+	h.Add(raster.FillMode);
+	h.Add(raster.CullMode);
+	h.Add(raster.FrontCounterClockwise);
+	h.Add(raster.DepthBias);
+	h.Add(raster.DepthBiasClamp);
+	h.Add(raster.SlopeScaledDepthBias);
+	h.Add(raster.DepthClipEnable);
+	h.Add(raster.MultisampleEnable);
+	h.Add(raster.AntialiasedLineEnable);
+	h.Add(raster.ForcedSampleCount);
+	h.Add(raster.ConservativeRaster);
+
+	const D3D12_DEPTH_STENCIL_DESC& ds = desc.DepthStencilState;
+	h.Add(ds.DepthEnable);
+	h.Add(ds.DepthWriteMask);
+	h.Add(ds.DepthFunc);
+	h.Add(ds.StencilEnable);
+	h.Add(ds.StencilReadMask);
+	h.Add(ds.StencilWriteMask);
+	for (const D3D12_DEPTH_STENCILOP_DESC* face : { &ds.FrontFace, &ds.BackFace })
+	{
+		h.Add(face->StencilFailOp);
+		h.Add(face->StencilDepthFailOp);
+		h.Add(face->StencilPassOp);
+		h.Add(face->StencilFunc);
+	}
+
+	h.Add(desc.InputLayout.NumElements);
+	for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+		h.AddString(e.SemanticName);
+		h.Add(e.SemanticIndex);
+		h.Add(e.Format);
+		h.Add(e.InputSlot);
+		h.Add(e.AlignedByteOffset);
+		h.Add(e.InputSlotClass);
+		h.Add(e.InstanceDataStepRate);
+	}
+
+	h.Add(desc.IBStripCutValue);
+	h.Add(desc.PrimitiveTopologyType);
+	h.Add(desc.NumRenderTargets);
+	for (UINT i = 0; i < desc.NumRenderTargets; ++i)
+		h.Add(desc.RTVFormats[i]);
+	h.Add(desc.DSVFormat);
+	h.Add(desc.SampleDesc.Count);
+	h.Add(desc.SampleDesc.Quality);
+	h.Add(desc.NodeMask);
+	h.Add(desc.Flags);
+
+	return h.Value();
+}
@@ -0,0 +1,120 @@
+//***************************************************************************************
+// PipelineStateCache.h
+//
+// Pipeline states and root signatures that survive from one run to the next.
+//   -PSOs are keyed by a hash of the whole D3D12_GRAPHICS_PIPELINE_STATE_DESC, shader
+//    bytecode included, and stored in an ID3D12PipelineLibrary serialized to disk.
+//    A driver or adapter change invalidates the library, which is then rebuilt.
+//   -PSOs are created by worker threads: RequestGraphicsPipeline returns at once, TryGet
+//    lets a draw fall back to another PSO while the one it wants is not ready, Wait
+//    blocks explicitly.
+//   -Serialized root signatures are cached as files keyed by a hash of their desc.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class PipelineStateCache
+{
+public:
+	typedef UINT Handle;
+
+	struct Stats
+	{
+		UINT Hits = 0;
+		UINT Misses = 0;
+		UINT Pending = 0;
+		UINT RootSignatureHits = 0;
+		UINT RootSignatureMisses = 0;
+
+		// Time spent by the workers loading/creating PSOs, and by callers in Wait.
+		double CreateMs = 0.0;
+		double WaitMs = 0.0;
+
+		float HitRate()const { return Hits + Misses > 0 ? (float)Hits / (Hits + Misses) : 0.0f; }
+	};
+
+	// workerCount 0 picks one less than the number of hardware threads (at most 4).
+	PipelineStateCache(ID3D12Device* device, const std::wstring& cacheDirectory, UINT workerCount = 0);
+	PipelineStateCache(const PipelineStateCache& rhs) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache& rhs) = delete;
+	~PipelineStateCache();
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc);
+
+	// Queues the creation of a PSO. Descs with the same contents share a handle. The
+	// root signature must come from CreateRootSignature; bytecode and input layout are
+	// copied, so the caller's blobs may go away.
+	Handle RequestGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+	// nullptr while the PSO is being created.
+	ID3D12PipelineState* TryGet(Handle handle)const;
+
+	// Blocks until the PSO is ready; throws if its creation failed.
+	ID3D12PipelineState* Wait(Handle handle);
+	void WaitAll();
+
+	// Writes the pipeline library if pipelines were added since it was loaded.
+	void Save();
+
+	Stats GetStats()const;
+	void LogStats()const;
+
+	static UINT64 HashRootSignatureDesc(const D3D12_ROOT_SIGNATURE_DESC& desc);
+	static UINT64 HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash);
+
+private:
+	struct Entry
+	{
+		UINT64 Hash = 0;
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> Pso;
+		HRESULT Result = S_OK;
+		std::atomic<bool> Ready{ false };
+	};
+
+	// Owns everything the desc points to while the job waits in the queue.
+	struct GraphicsJob
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = {};
+		std::vector<BYTE> Bytecode[5];
+		std::vector<D3D12_INPUT_ELEMENT_DESC> InputElements;
+		std::vector<std::string> SemanticNames;
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> RootSignature;
+		Entry* Target = nullptr;
+	};
+
+	void OpenLibrary();
+	void WorkerMain();
+	void RunJob(GraphicsJob& job);
+
+	std::wstring CachePath(const std::wstring& name)const;
+
+private:
+	ID3D12Device* mDevice = nullptr;
+	std::wstring mCacheDirectory;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> mLibrary;
+	std::vector<char> mLibraryData;	// Must outlive mLibrary.
+	bool mLibraryDirty = false;
+	std::mutex mLibraryMutex;
+
+	std::unordered_map<ID3D12RootSignature*, UINT64> mRootSignatureHashes;
+
+	std::vector<std::unique_ptr<Entry>> mEntries;
+	std::unordered_map<UINT64, Handle> mHandles;
+
+	std::vector<std::thread> mWorkers;
+	std::deque<std::unique_ptr<GraphicsJob>> mJobs;
+	bool mStop = false;
+	mutable std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mJobDone;
+
+	Stats mStats;
+};
@@ -0,0 +1,463 @@
+//***************************************************************************************
+// RenderGraph.cpp
+//***************************************************************************************
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <functional>
+#include <queue>
+
+static const uint32_t gNoPass = ~0u;
+
+// States that can be combined and need no barrier between each other.
+static const RGState gReadStates = RGState::DepthRead | RGState::ShaderResource | RGState::CopySource;
+static const RGState gWriteStates = RGState::RenderTarget | RGState::DepthWrite | RGState::UnorderedAccess |
+	RGState::CopyDest | RGState::Present;
+
+static bool IsReadState(RGState state)
+{
+	return state != RGState::Undefined && (state & gWriteStates) == RGState::Undefined;
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+RGHandle RenderGraph::PassBuilder::Read(RGHandle texture, RGState state)
+{
+	assert(IsReadState(state));
+	mGraph.AddAccess(mPass, texture, state, false);
+	return texture;
+}
+
+RGHandle RenderGraph::PassBuilder::Write(RGHandle texture, RGState state)
+{
+	mGraph.AddAccess(mPass, texture, state, true);
+	return texture;
+}
+
+RGHandle RenderGraph::PassBuilder::Create(const std::string& name, const RGTextureDesc& desc, RGState state)
+{
+	return Write(mGraph.CreateTexture(name, desc), state);
+}
+
+void RenderGraph::PassBuilder::SideEffect()
+{
+	mGraph.mPasses[mPass].SideEffect = true;
+}
+
+void RenderGraph::SetSizeQuery(const SizeQueryFunc& sizeQuery)
+{
+	mSizeQuery = sizeQuery;
+}
+
+RGHandle RenderGraph::ImportTexture(const std::string& name, RGState initialState, RGState finalState)
+{
+	ResourceInfo info;
+	info.Name = name;
+	info.Imported = true;
+	info.InitialState = initialState;
+	info.FinalState = finalState;
+
+	mResources.push_back(info);
+	mLastWriter.push_back(gNoPass);
+	mCurrentReaders.emplace_back();
+
+	return (RGHandle)mResources.size() - 1;
+}
+
+RGHandle RenderGraph::CreateTexture(const std::string& name, const RGTextureDesc& desc)
+{
+	ResourceInfo info;
+	info.Name = name;
+	info.Desc = desc;
+
+	mResources.push_back(info);
+	mLastWriter.push_back(gNoPass);
+	mCurrentReaders.emplace_back();
+
+	return (RGHandle)mResources.size() - 1;
+}
+
+void RenderGraph::AddPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = execute;
+	mPasses.push_back(pass);
+
+	PassBuilder builder(*this, (uint32_t)mPasses.size() - 1);
+	setup(builder);
+}
+
+void RenderGraph::AddAccess(uint32_t pass, RGHandle resource, RGState state, bool write)
+{
+	assert(resource < mResources.size());
+
+	// A write keeps the previous contents (a pass may draw on top of them), so the
+	// previous writer is a producer just like for reads.
+	uint32_t producer = mLastWriter[resource];
+	if (producer != gNoPass && producer != pass)
+		mEdges.push_back({ producer, pass });
+
+	if (write)
+	{
+		// Write after read: readers of the current version go first.
+		for (uint32_t reader : mCurrentReaders[resource])
+		{
+			if (reader != pass)
+				mEdges.push_back({ reader, pass });
+		}
+
+		mLastWriter[resource] = pass;
+		mCurrentReaders[resource].clear();
+	}
+	else
+	{
+		mCurrentReaders[resource].push_back(pass);
+	}
+
+	mPasses[pass].Accesses.push_back({ resource, state, write, producer == pass ? gNoPass : producer });
+}
+
+void RenderGraph::Compile()
+{
+	mStats = RenderGraphStats();
+	mStats.PassCount = (uint32_t)mPasses.size();
+
+	CullPasses();
+	SortPasses();
+	ComputeLifetimes();
+	AssignHeapOffsets();
+	ComputeBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+	std::vector<uint32_t> stack;
+
+	for (uint32_t i = 0; i < (uint32_t)mPasses.size(); ++i)
+	{
+		Pass& pass = mPasses[i];
+		pass.Culled = true;
+
+		bool root = pass.SideEffect;
+		for (const Access& a : pass.Accesses)
+			root = root || (a.Write && mResources[a.Resource].Imported);
+
+		if (root)
+			stack.push_back(i);
+	}
+
+	// Everything a root depends on, directly or not, survives.
+	while (!stack.empty())
+	{
+		uint32_t i = stack.back();
+		stack.pop_back();
+
+		if (!mPasses[i].Culled)
+			continue;
+		mPasses[i].Culled = false;
+
+		for (const Access& a : mPasses[i].Accesses)
+		{
+			if (a.Producer != gNoPass && mPasses[a.Producer].Culled)
+				stack.push_back(a.Producer);
+		}
+	}
+
+	for (const Pass& pass : mPasses)
+		mStats.CulledPassCount += pass.Culled ? 1 : 0;
+}
+
+void RenderGraph::SortPasses()
+{
+	uint32_t passCount = (uint32_t)mPasses.size();
+
+	std::vector<std::vector<uint32_t>> successors(passCount);
+	std::vector<uint32_t> inDegree(passCount, 0);
+	for (const auto& e : mEdges)
+	{
+		if (mPasses[e.first].Culled || mPasses[e.second].Culled)
+			continue;
+
+		successors[e.first].push_back(e.second);
+		++inDegree[e.second];
+	}
+
+	// Kahn's algorithm; among the passes that are ready the one declared first runs first,
+	// so independent passes keep the order the application wrote them in.
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+	for (uint32_t i = 0; i < passCount; ++i)
+	{
+		if (!mPasses[i].Culled && inDegree[i] == 0)
+			ready.push(i);
+	}
+
+	mOrder.clear();
+	while (!ready.empty())
+	{
+		uint32_t i = ready.top();
+		ready.pop();
+		mOrder.push_back(i);
+
+		for (uint32_t s : successors[i])
+		{
+			if (--inDegree[s] == 0)
+				ready.push(s);
+		}
+	}
+
+	assert(mOrder.size() == passCount - mStats.CulledPassCount && "Render graph has a cycle.");
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (uint32_t order = 0; order < (uint32_t)mOrder.size(); ++order)
+	{
+		for (const Access& a : mPasses[mOrder[order]].Accesses)
+		{
+			ResourceInfo& r = mResources[a.Resource];
+			r.Used = true;
+			r.Usage = r.Usage | a.State;
+			r.FirstPass = std::min<uint32_t>(r.FirstPass, order);
+			r.LastPass = std::max<uint32_t>(r.LastPass, order);
+		}
+	}
+
+	for (ResourceInfo& r : mResources)
+	{
+		if (r.Imported || !r.Used)
+			continue;
+
+		if (mSizeQuery)
+		{
+			mSizeQuery(r.Desc, r.Usage, r.Size, r.Alignment);
+		}
+		else
+		{
+			// Rough estimate for graphs compiled without a device.
+			r.Size = AlignUp((uint64_t)r.Desc.Width * r.Desc.Height * r.Desc.SampleCount * 4, 65536);
+			r.Alignment = 65536;
+		}
+
+		++mStats.TransientCount;
+		mStats.TransientBytes += r.Size;
+	}
+}
+
+void RenderGraph::AssignHeapOffsets()
+{
+	std::vector<RGHandle> transients;
+	for (RGHandle h = 0; h < (RGHandle)mResources.size(); ++h)
+	{
+		if (!mResources[h].Imported && mResources[h].Used)
+			transients.push_back(h);
+	}
+
+	// Greedy placement, largest first: each texture goes to the lowest offset that does
+	// not collide with an already placed texture whose lifetime overlaps its own.
+	std::stable_sort(transients.begin(), transients.end(), [this](RGHandle a, RGHandle b)
+	{
+		return mResources[a].Size > mResources[b].Size;
+	});
+
+	std::vector<RGHandle> placed;
+	std::vector<std::pair<uint64_t, uint64_t>> busy;
+	mHeapSize = 0;
+
+	for (RGHandle h : transients)
+	{
+		ResourceInfo& r = mResources[h];
+
+		busy.clear();
+		for (RGHandle p : placed)
+		{
+			const ResourceInfo& q = mResources[p];
+			if (q.FirstPass <= r.LastPass && r.FirstPass <= q.LastPass)
+				busy.push_back({ q.HeapOffset, q.HeapOffset + q.Size });
+		}
+		std::sort(busy.begin(), busy.end());
+
+		uint64_t offset = 0;
+		for (const auto& range : busy)
+		{
+			if (offset + r.Size <= range.first)
+				break;
+			offset = std::max<uint64_t>(offset, AlignUp(range.second, r.Alignment));
+		}
+
+		r.HeapOffset = offset;
+		mHeapSize = std::max<uint64_t>(mHeapSize, offset + r.Size);
+		placed.push_back(h);
+	}
+
+	mStats.TransientHeapBytes = mHeapSize;
+}
+
+void RenderGraph::ComputeBarriers()
+{
+	std::vector<RGState> states(mResources.size());
+	for (size_t i = 0; i < mResources.size(); ++i)
+		states[i] = mResources[i].InitialState;
+
+	for (Pass& pass : mPasses)
+		pass.Barriers.clear();
+	mFinalBarriers.clear();
+
+	std::vector<std::pair<RGHandle, RGState>> required;
+	for (uint32_t order = 0; order < (uint32_t)mOrder.size(); ++order)
+	{
+		Pass& pass = mPasses[mOrder[order]];
+
+		// A pass may use a texture several ways at once (e.g. depth read + shader read).
+		required.clear();
+		for (const Access& a : pass.Accesses)
+		{
+			auto it = std::find_if(required.begin(), required.end(),
+				[&a](const std::pair<RGHandle, RGState>& p) { return p.first == a.Resource; });
+			if (it == required.end())
+				required.push_back({ a.Resource, a.State });
+			else
+				it->second = it->second | a.State;
+		}
+
+		for (const auto& req : required)
+		{
+			RGHandle h = req.first;
+			RGState state = req.second;
+			const ResourceInfo& r = mResources[h];
+
+			assert((IsReadState(state) || (state & gReadStates) == RGState::Undefined) &&
+				"A write state cannot be combined with other states.");
+
+			if (!r.Imported && order == r.FirstPass)
+			{
+				// The memory may have belonged to another transient (in this frame or at
+				// the end of the previous one): activate this one first.
+				std::vector<RGHandle> before;
+				std::vector<RGHandle> after;
+				for (RGHandle o = 0; o < (RGHandle)mResources.size(); ++o)
+				{
+					const ResourceInfo& q = mResources[o];
+					if (o == h || q.Imported || !q.Used)
+						continue;
+					if (q.HeapOffset >= r.HeapOffset + r.Size || r.HeapOffset >= q.HeapOffset + q.Size)
+						continue;
+
+					(q.LastPass < r.FirstPass ? before : after).push_back(o);
+				}
+
+				const std::vector<RGHandle>& candidates = before.empty() ? after : before;
+				if (!candidates.empty())
+				{
+					RGBarrier b;
+					b.Type = RGBarrier::Aliasing;
+					b.Resource = h;
+					b.AliasBefore = candidates.size() == 1 ? candidates[0] : RGInvalidHandle;
+					pass.Barriers.push_back(b);
+					++mStats.AliasingBarrierCount;
+				}
+			}
+
+			RGState current = states[h];
+			if (current == state || (IsReadState(current) && IsReadState(state) && (current & state) == state))
+				continue;
+
+			RGBarrier b;
+			b.Resource = h;
+			b.Before = current;
+			b.After = state;
+			pass.Barriers.push_back(b);
+			++mStats.TransitionCount;
+
+			states[h] = state;
+		}
+	}
+
+	for (RGHandle h = 0; h < (RGHandle)mResources.size(); ++h)
+	{
+		const ResourceInfo& r = mResources[h];
+		if (!r.Imported || r.FinalState == RGState::Undefined || states[h] == r.FinalState)
+			continue;
+
+		RGBarrier b;
+		b.Resource = h;
+		b.Before = states[h];
+		b.After = r.FinalState;
+		mFinalBarriers.push_back(b);
+		++mStats.TransitionCount;
+	}
+}
+
+void RenderGraph::Execute(const BarrierFunc& emitBarriers)
+{
+	for (uint32_t i : mOrder)
+	{
+		Pass& pass = mPasses[i];
+		if (!pass.Barriers.empty())
+			emitBarriers(pass.Barriers);
+
+		if (pass.Execute)
+			pass.Execute();
+	}
+
+	if (!mFinalBarriers.empty())
+		emitBarriers(mFinalBarriers);
+}
+
+void RenderGraph::Reset()
+{
+	mPasses.clear();
+	mResources.clear();
+	mLastWriter.clear();
+	mCurrentReaders.clear();
+	mEdges.clear();
+	mOrder.clear();
+	mFinalBarriers.clear();
+	mHeapSize = 0;
+	mStats = RenderGraphStats();
+}
+
+const std::vector<RenderGraph::ResourceInfo>& RenderGraph::Resources()const
+{
+	return mResources;
+}
+
+uint64_t RenderGraph::TransientHeapSize()const
+{
+	return mHeapSize;
+}
+
+const RenderGraphStats& RenderGraph::Stats()const
+{
+	return mStats;
+}
+
+std::vector<std::string> RenderGraph::ExecutionOrder()const
+{
+	std::vector<std::string> names;
+	for (uint32_t i : mOrder)
+		names.push_back(mPasses[i].Name);
+
+	return names;
+}
+
+std::string RenderGraph::Report()const
+{
+	const double MB = 1024.0 * 1024.0;
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"RenderGraph: %u passes (%u culled), %u transients, %.2f MB -> %.2f MB heap (%.2f MB saved by aliasing), "
+		"%u transitions, %u aliasing barriers",
+		mStats.PassCount, mStats.CulledPassCount, mStats.TransientCount,
+		mStats.TransientBytes / MB, mStats.TransientHeapBytes / MB, mStats.SavedBytes() / MB,
+		mStats.TransitionCount, mStats.AliasingBarrierCount);
+
+	return buffer;
+}
@@ -0,0 +1,218 @@
+//***************************************************************************************
+// RenderGraph.h
+//
+// Frame graph: passes declare the textures they read and write, the graph works out
+// everything else.
+//   -Passes whose results are never used (directly or indirectly) by a pass with side
+//    effects, or by an imported resource such as the back buffer, are culled.
+//   -Passes are ordered by their dependencies (stable with respect to declaration
+//    order) and the state transitions each pass needs are computed up front.
+//   -Transient textures are given offsets in a single heap; textures whose lifetimes
+//    do not overlap share memory, and an aliasing barrier is issued on first use.
+//   -Compile is CPU-only: texture sizes come from a callback, so it needs no device.
+//    RenderGraphExecutor turns the result into D3D12 resources and barriers.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class RGState : uint32_t
+{
+	Undefined = 0,
+	RenderTarget = 1 << 0,
+	DepthWrite = 1 << 1,
+	DepthRead = 1 << 2,
+	ShaderResource = 1 << 3,
+	UnorderedAccess = 1 << 4,
+	CopySource = 1 << 5,
+	CopyDest = 1 << 6,
+	Present = 1 << 7
+};
+
+inline RGState operator|(RGState a, RGState b) { return (RGState)((uint32_t)a | (uint32_t)b); }
+inline RGState operator&(RGState a, RGState b) { return (RGState)((uint32_t)a & (uint32_t)b); }
+inline bool HasState(RGState states, RGState s) { return ((uint32_t)states & (uint32_t)s) != 0; }
+
+typedef uint32_t RGHandle;
+static const RGHandle RGInvalidHandle = ~0u;
+
+struct RGTextureDesc
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t Format = 0;		// DXGI_FORMAT value.
+	uint32_t SampleCount = 1;
+
+	// Optimized clear values of render targets/depth buffers.
+	float ClearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float ClearDepth = 1.0f;
+	uint8_t ClearStencil = 0;
+};
+
+struct RGBarrier
+{
+	enum BarrierType { Transition, Aliasing };
+
+	BarrierType Type = Transition;
+	RGHandle Resource = RGInvalidHandle;
+
+	// Transition barriers.
+	RGState Before = RGState::Undefined;
+	RGState After = RGState::Undefined;
+
+	// Aliasing barriers: the transient that used the memory before (may be invalid when
+	// several did).
+	RGHandle AliasBefore = RGInvalidHandle;
+};
+
+struct RenderGraphStats
+{
+	uint32_t PassCount = 0;
+	uint32_t CulledPassCount = 0;
+	uint32_t TransientCount = 0;
+	uint32_t TransitionCount = 0;
+	uint32_t AliasingBarrierCount = 0;
+
+	// Memory needed by the transients without aliasing and with it.
+	uint64_t TransientBytes = 0;
+	uint64_t TransientHeapBytes = 0;
+
+	uint64_t SavedBytes()const { return TransientBytes - TransientHeapBytes; }
+};
+
+class RenderGraph
+{
+public:
+	class PassBuilder
+	{
+	public:
+		// Declares an access to a texture; returns the handle for convenience.
+		RGHandle Read(RGHandle texture, RGState state = RGState::ShaderResource);
+		RGHandle Write(RGHandle texture, RGState state = RGState::RenderTarget);
+
+		// Creates a transient texture owned by the graph (written by this pass).
+		RGHandle Create(const std::string& name, const RGTextureDesc& desc,
+			RGState state = RGState::RenderTarget);
+
+		// The pass is never culled (e.g. it reads back data or writes outside the graph).
+		void SideEffect();
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t pass) : mGraph(graph), mPass(pass) {}
+
+		RenderGraph& mGraph;
+		uint32_t mPass;
+	};
+
+	typedef std::function<void(PassBuilder& builder)> SetupFunc;
+	typedef std::function<void()> ExecuteFunc;
+
+	// Size and alignment of a transient texture given its description and the union of
+	// the states it is used in.
+	typedef std::function<void(const RGTextureDesc& desc, RGState usage,
+		uint64_t& size, uint64_t& alignment)> SizeQueryFunc;
+
+	// Receives the barriers to issue before a pass (or after the last one).
+	typedef std::function<void(const std::vector<RGBarrier>& barriers)> BarrierFunc;
+
+	struct ResourceInfo
+	{
+		std::string Name;
+		bool Imported = false;
+		RGTextureDesc Desc;
+
+		// Imported resources: state on entry and the state they must be left in.
+		RGState InitialState = RGState::Undefined;
+		RGState FinalState = RGState::Undefined;
+
+		// Filled by Compile.
+		RGState Usage = RGState::Undefined;
+		uint64_t Size = 0;
+		uint64_t Alignment = 1;
+		uint64_t HeapOffset = 0;
+		uint32_t FirstPass = ~0u;	// Execution order index.
+		uint32_t LastPass = 0;
+		bool Used = false;
+	};
+
+	RenderGraph() = default;
+	RenderGraph(const RenderGraph& rhs) = delete;
+	RenderGraph& operator=(const RenderGraph& rhs) = delete;
+
+	void SetSizeQuery(const SizeQueryFunc& sizeQuery);
+
+	RGHandle ImportTexture(const std::string& name, RGState initialState, RGState finalState);
+	RGHandle CreateTexture(const std::string& name, const RGTextureDesc& desc);
+
+	void AddPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+	// Culls, orders, computes barriers, lifetimes and heap offsets.
+	void Compile();
+
+	// Runs the surviving passes in order, handing the barriers each of them needs to
+	// emitBarriers first.
+	void Execute(const BarrierFunc& emitBarriers);
+
+	// Forgets passes and resources (the graph is rebuilt every frame).
+	void Reset();
+
+	const std::vector<ResourceInfo>& Resources()const;
+	uint64_t TransientHeapSize()const;
+	const RenderGraphStats& Stats()const;
+
+	// Names of the passes in execution order, culled ones excluded.
+	std::vector<std::string> ExecutionOrder()const;
+
+	// One-line summary of the stats, suitable for a log.
+	std::string Report()const;
+
+private:
+	struct Access
+	{
+		RGHandle Resource;
+		RGState State;
+		bool Write;
+		uint32_t Producer;	// Pass that wrote the version being accessed (~0u if none).
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		ExecuteFunc Execute;
+		std::vector<Access> Accesses;
+		bool SideEffect = false;
+		bool Culled = false;
+		std::vector<RGBarrier> Barriers;
+	};
+
+	void AddAccess(uint32_t pass, RGHandle resource, RGState state, bool write);
+
+	void CullPasses();
+	void SortPasses();
+	void ComputeLifetimes();
+	void ComputeBarriers();
+	void AssignHeapOffsets();
+
+private:
+	std::vector<Pass> mPasses;
+	std::vector<ResourceInfo> mResources;
+
+	// Per resource: last writer and readers of the current version while passes are added.
+	std::vector<uint32_t> mLastWriter;
+	std::vector<std::vector<uint32_t>> mCurrentReaders;
+
+	// Ordering constraints (from -> to) collected while passes are added.
+	std::vector<std::pair<uint32_t, uint32_t>> mEdges;
+
+	std::vector<uint32_t> mOrder;
+	std::vector<RGBarrier> mFinalBarriers;
+
+	SizeQueryFunc mSizeQuery;
+	uint64_t mHeapSize = 0;
+	RenderGraphStats mStats;
+};
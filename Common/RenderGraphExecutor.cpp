@@ -0,0 +1,375 @@
+//***************************************************************************************
+// RenderGraphExecutor.cpp
+//***************************************************************************************
+
+#include "RenderGraphExecutor.h"
+
+using Microsoft::WRL::ComPtr;
+
+static bool IsDepth(RGState usage)
+{
+	return HasState(usage, RGState::DepthWrite | RGState::DepthRead);
+}
+
+// Depth buffers that are also sampled need a typeless resource format.
+static DXGI_FORMAT ResourceFormat(DXGI_FORMAT format, bool sampled)
+{
+	if (!sampled)
+		return format;
+
+	switch (format)
+	{
+	case DXGI_FORMAT_D16_UNORM:				return DXGI_FORMAT_R16_TYPELESS;
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:		return DXGI_FORMAT_R24G8_TYPELESS;
+	case DXGI_FORMAT_D32_FLOAT:				return DXGI_FORMAT_R32_TYPELESS;
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:	return DXGI_FORMAT_R32G8X24_TYPELESS;
+	default:								return format;
+	}
+}
+
+static DXGI_FORMAT ShaderResourceFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_D16_UNORM:				return DXGI_FORMAT_R16_UNORM;
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:		return DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	case DXGI_FORMAT_D32_FLOAT:				return DXGI_FORMAT_R32_FLOAT;
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:	return DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS;
+	default:								return format;
+	}
+}
+
+static D3D12_RESOURCE_DESC MakeResourceDesc(const RGTextureDesc& d, RGState usage)
+{
+	bool sampled = HasState(usage, RGState::ShaderResource);
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Alignment = 0;
+	desc.Width = d.Width;
+	desc.Height = d.Height;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = ResourceFormat((DXGI_FORMAT)d.Format, sampled && IsDepth(usage));
+	desc.SampleDesc.Count = d.SampleCount;
+	desc.SampleDesc.Quality = 0;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	if (HasState(usage, RGState::RenderTarget))
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+	if (HasState(usage, RGState::UnorderedAccess))
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	if (IsDepth(usage))
+	{
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+		if (!sampled)
+			desc.Flags |= D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+	}
+
+	return desc;
+}
+
+bool RenderGraphExecutor::TransientKey::operator==(const TransientKey& rhs)const
+{
+	return Desc.Width == rhs.Desc.Width && Desc.Height == rhs.Desc.Height &&
+		Desc.Format == rhs.Desc.Format && Desc.SampleCount == rhs.Desc.SampleCount &&
+		memcmp(Desc.ClearColor, rhs.Desc.ClearColor, sizeof(Desc.ClearColor)) == 0 &&
+		Desc.ClearDepth == rhs.Desc.ClearDepth && Desc.ClearStencil == rhs.Desc.ClearStencil &&
+		Usage == rhs.Usage && HeapOffset == rhs.HeapOffset;
+}
+
+RenderGraphExecutor::RenderGraphExecutor(ID3D12Device* device, ResourceStateTracker& stateTracker,
+	DeferredReleaseQueue& deferredReleases, GpuDescriptorHeap& srvHeap) :
+	mDevice(device),
+	mStateTracker(stateTracker),
+	mDeferredReleases(deferredReleases),
+	mSrvHeap(srvHeap),
+	mRtvHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 64),
+	mDsvHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 64),
+	mSrvStagingHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 64)
+{
+}
+
+RenderGraphExecutor::~RenderGraphExecutor()
+{
+	ReleaseTransients();
+	mDeferredReleases.Enqueue(mHeap);
+}
+
+RenderGraph::SizeQueryFunc RenderGraphExecutor::SizeQuery()const
+{
+	ID3D12Device* device = mDevice;
+	return [device](const RGTextureDesc& d, RGState usage, uint64_t& size, uint64_t& alignment)
+	{
+		D3D12_RESOURCE_DESC desc = MakeResourceDesc(d, usage);
+		D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+
+		size = info.SizeInBytes;
+		alignment = info.Alignment;
+	};
+}
+
+void RenderGraphExecutor::BindImported(RGHandle handle, ID3D12Resource* resource,
+	D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+	if (handle >= mBindings.size())
+		mBindings.resize(handle + 1);
+
+	Binding& b = mBindings[handle];
+	assert(b.Owned == nullptr);
+
+	b.Resource = resource;
+	b.Rtv = rtv;
+	b.Dsv = dsv;
+}
+
+void RenderGraphExecutor::Prepare(const RenderGraph& graph)
+{
+	const auto& resources = graph.Resources();
+
+	std::vector<bool> slots(resources.size(), false);
+	std::vector<TransientKey> keys(resources.size());
+	bool multisampled = false;
+	for (RGHandle h = 0; h < (RGHandle)resources.size(); ++h)
+	{
+		const RenderGraph::ResourceInfo& r = resources[h];
+		if (r.Imported || !r.Used)
+			continue;
+
+		slots[h] = true;
+		keys[h] = { r.Desc, r.Usage, r.HeapOffset };
+		multisampled = multisampled || r.Desc.SampleCount > 1;
+	}
+
+	bool reuse = graph.TransientHeapSize() <= mHeapSize && slots == mTransientSlots;
+	for (RGHandle h = 0; reuse && h < (RGHandle)slots.size(); ++h)
+		reuse = !slots[h] || keys[h] == mKeys[h];
+
+	if (mBindings.size() < resources.size())
+		mBindings.resize(resources.size());
+
+	if (reuse)
+		return;
+
+	ReleaseTransients();
+
+	if (graph.TransientHeapSize() > mHeapSize)
+	{
+		mDeferredReleases.Enqueue(mHeap);
+		mHeap = nullptr;
+
+		// Tier 1 heaps hold render target/depth-stencil textures only, which is what
+		// transients are.
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = graph.TransientHeapSize();
+		heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		heapDesc.Alignment = multisampled ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT :
+			D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+
+		mHeapSize = heapDesc.SizeInBytes;
+	}
+
+	for (RGHandle h = 0; h < (RGHandle)resources.size(); ++h)
+	{
+		if (slots[h])
+			CreateTransient(h, resources[h]);
+	}
+
+	mTransientSlots = slots;
+	mKeys = keys;
+
+	std::string report = graph.Report() + "\n";
+	::OutputDebugStringA(report.c_str());
+}
+
+void RenderGraphExecutor::CreateTransient(RGHandle handle, const RenderGraph::ResourceInfo& info)
+{
+	assert((HasState(info.Usage, RGState::RenderTarget) || IsDepth(info.Usage)) &&
+		"Transients must be render targets or depth buffers.");
+
+	const RGTextureDesc& d = info.Desc;
+	bool depth = IsDepth(info.Usage);
+	D3D12_RESOURCE_DESC desc = MakeResourceDesc(d, info.Usage);
+
+	D3D12_CLEAR_VALUE optClear;
+	optClear.Format = (DXGI_FORMAT)d.Format;
+	if (depth)
+	{
+		optClear.DepthStencil.Depth = d.ClearDepth;
+		optClear.DepthStencil.Stencil = d.ClearStencil;
+	}
+	else
+	{
+		memcpy(optClear.Color, d.ClearColor, sizeof(optClear.Color));
+	}
+
+	D3D12_RESOURCE_STATES initialState = depth ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET;
+
+	Binding& b = mBindings[handle];
+	ThrowIfFailed(mDevice->CreatePlacedResource(mHeap.Get(), info.HeapOffset, &desc, initialState,
+		&optClear, IID_PPV_ARGS(&b.Owned)));
+	b.Resource = b.Owned.Get();
+
+	mStateTracker.Register(b.Resource, initialState);
+
+	bool msaa = d.SampleCount > 1;
+
+	if (HasState(info.Usage, RGState::RenderTarget))
+	{
+		b.RtvHandle = mRtvHeap.Allocate();
+		b.Rtv = b.RtvHandle.Cpu;
+		mDevice->CreateRenderTargetView(b.Resource, nullptr, b.Rtv);
+	}
+
+	if (depth)
+	{
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = (DXGI_FORMAT)d.Format;
+		dsvDesc.ViewDimension = msaa ? D3D12_DSV_DIMENSION_TEXTURE2DMS : D3D12_DSV_DIMENSION_TEXTURE2D;
+		dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+		dsvDesc.Texture2D.MipSlice = 0;
+
+		b.DsvHandle = mDsvHeap.Allocate();
+		b.Dsv = b.DsvHandle.Cpu;
+		mDevice->CreateDepthStencilView(b.Resource, &dsvDesc, b.Dsv);
+	}
+
+	if (HasState(info.Usage, RGState::ShaderResource))
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = ShaderResourceFormat((DXGI_FORMAT)d.Format);
+		srvDesc.ViewDimension = msaa ? D3D12_SRV_DIMENSION_TEXTURE2DMS : D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = 1;
+
+		DescriptorHandle staging = mSrvStagingHeap.Allocate();
+		mDevice->CreateShaderResourceView(b.Resource, &srvDesc, staging.Cpu);
+
+		b.SrvHandle = mSrvHeap.AllocatePersistent();
+		mSrvHeap.StageCopy(b.SrvHandle, 0, staging.Cpu, 1);
+		mSrvHeap.FlushCopies();
+
+		mSrvStagingHeap.Free(staging);
+	}
+}
+
+void RenderGraphExecutor::ReleaseTransients()
+{
+	for (Binding& b : mBindings)
+	{
+		if (b.Owned == nullptr)
+			continue;
+
+		mStateTracker.Unregister(b.Resource);
+		mDeferredReleases.Enqueue(b.Owned);
+
+		// Render target and depth views are consumed when the command is recorded.
+		mRtvHeap.Free(b.RtvHandle);
+		mDsvHeap.Free(b.DsvHandle);
+		mSrvHeap.FreePersistent(b.SrvHandle);
+
+		b = Binding();
+	}
+
+	mTransientSlots.clear();
+	mKeys.clear();
+}
+
+void RenderGraphExecutor::Execute(RenderGraph& graph, ID3D12GraphicsCommandList* cmdList)
+{
+	std::vector<D3D12_RESOURCE_BARRIER> aliasing;
+	std::vector<ID3D12Resource*> discards;
+
+	graph.Execute([&](const std::vector<RGBarrier>& barriers)
+	{
+		aliasing.clear();
+		discards.clear();
+
+		for (const RGBarrier& b : barriers)
+		{
+			ID3D12Resource* resource = Resource(b.Resource);
+
+			if (b.Type == RGBarrier::Aliasing)
+			{
+				ID3D12Resource* before = b.AliasBefore != RGInvalidHandle ? Resource(b.AliasBefore) : nullptr;
+				aliasing.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(before, resource));
+				discards.push_back(resource);
+			}
+			else
+			{
+				// The tracker knows the actual state (transients keep theirs from the
+				// previous frame), only the requested one is taken from the graph.
+				mStateTracker.Transition(resource, ToResourceStates(b.After));
+			}
+		}
+
+		if (!aliasing.empty())
+			cmdList->ResourceBarrier((UINT)aliasing.size(), aliasing.data());
+
+		mStateTracker.FlushBarriers(cmdList);
+
+		// Newly activated render targets/depth buffers have undefined contents.
+		for (ID3D12Resource* resource : discards)
+		{
+			D3D12_RESOURCE_STATES state = mStateTracker.GetState(resource);
+			if (state == D3D12_RESOURCE_STATE_RENDER_TARGET || state == D3D12_RESOURCE_STATE_DEPTH_WRITE)
+				cmdList->DiscardResource(resource, nullptr);
+		}
+	});
+}
+
+ID3D12Resource* RenderGraphExecutor::Resource(RGHandle handle)const
+{
+	assert(handle < mBindings.size() && mBindings[handle].Resource != nullptr);
+	return mBindings[handle].Resource;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE RenderGraphExecutor::Rtv(RGHandle handle)const
+{
+	assert(handle < mBindings.size() && mBindings[handle].Rtv.ptr != 0);
+	return mBindings[handle].Rtv;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE RenderGraphExecutor::Dsv(RGHandle handle)const
+{
+	assert(handle < mBindings.size() && mBindings[handle].Dsv.ptr != 0);
+	return mBindings[handle].Dsv;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE RenderGraphExecutor::Srv(RGHandle handle)const
+{
+	assert(handle < mBindings.size() && mBindings[handle].SrvHandle.IsValid());
+	return mBindings[handle].SrvHandle.Gpu;
+}
+
+UINT64 RenderGraphExecutor::TransientHeapSize()const
+{
+	return mHeapSize;
+}
+
+D3D12_RESOURCE_STATES RenderGraphExecutor::ToResourceStates(RGState state)
+{
+	D3D12_RESOURCE_STATES result = D3D12_RESOURCE_STATE_COMMON;
+
+	if (HasState(state, RGState::RenderTarget))
+		result |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+	if (HasState(state, RGState::DepthWrite))
+		result |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	if (HasState(state, RGState::DepthRead))
+		result |= D3D12_RESOURCE_STATE_DEPTH_READ;
+	if (HasState(state, RGState::ShaderResource))
+		result |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	if (HasState(state, RGState::UnorderedAccess))
+		result |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	if (HasState(state, RGState::CopySource))
+		result |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+	if (HasState(state, RGState::CopyDest))
+		result |= D3D12_RESOURCE_STATE_COPY_DEST;
+
+	// RGState::Present maps to D3D12_RESOURCE_STATE_PRESENT, which is COMMON.
+	return result;
+}
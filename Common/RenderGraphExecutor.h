@@ -0,0 +1,99 @@
+//***************************************************************************************
+// RenderGraphExecutor.h
+//
+// Runs a compiled RenderGraph on a D3D12 command list.
+//   -Transient textures are placed resources in one render target/depth-stencil heap,
+//    at the offsets chosen by the graph. They are kept from one frame to the next and
+//    recreated (the old ones released by fence) only when the graph's layout changes.
+//   -Transitions go through the ResourceStateTracker, aliasing barriers are issued
+//    directly. An aliased render target or depth buffer is discarded on activation, so
+//    its first pass must not expect any previous contents.
+//   -Imported textures (back buffer, depth buffer) are bound each frame, after Prepare,
+//    and must be registered with the tracker by their owner.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+#include "DeferredReleaseQueue.h"
+#include "DescriptorAllocator.h"
+
+class RenderGraphExecutor
+{
+public:
+	RenderGraphExecutor(ID3D12Device* device, ResourceStateTracker& stateTracker,
+		DeferredReleaseQueue& deferredReleases, GpuDescriptorHeap& srvHeap);
+	RenderGraphExecutor(const RenderGraphExecutor& rhs) = delete;
+	RenderGraphExecutor& operator=(const RenderGraphExecutor& rhs) = delete;
+	~RenderGraphExecutor();
+
+	// Size query to install with RenderGraph::SetSizeQuery.
+	RenderGraph::SizeQueryFunc SizeQuery()const;
+
+	void BindImported(RGHandle handle, ID3D12Resource* resource,
+		D3D12_CPU_DESCRIPTOR_HANDLE rtv = {}, D3D12_CPU_DESCRIPTOR_HANDLE dsv = {});
+
+	// Creates the transients of a compiled graph, or reuses those of the previous frame.
+	void Prepare(const RenderGraph& graph);
+
+	// Records the passes of a compiled (and prepared) graph.
+	void Execute(RenderGraph& graph, ID3D12GraphicsCommandList* cmdList);
+
+	// Transients are released by fence, like every other resource the GPU may be using.
+	void ReleaseTransients();
+
+	ID3D12Resource* Resource(RGHandle handle)const;
+	D3D12_CPU_DESCRIPTOR_HANDLE Rtv(RGHandle handle)const;
+	D3D12_CPU_DESCRIPTOR_HANDLE Dsv(RGHandle handle)const;
+	D3D12_GPU_DESCRIPTOR_HANDLE Srv(RGHandle handle)const;
+
+	UINT64 TransientHeapSize()const;
+
+	static D3D12_RESOURCE_STATES ToResourceStates(RGState state);
+
+private:
+	struct Binding
+	{
+		ID3D12Resource* Resource = nullptr;
+		D3D12_CPU_DESCRIPTOR_HANDLE Rtv = {};
+		D3D12_CPU_DESCRIPTOR_HANDLE Dsv = {};
+
+		// Transients only.
+		Microsoft::WRL::ComPtr<ID3D12Resource> Owned;
+		DescriptorHandle RtvHandle;
+		DescriptorHandle DsvHandle;
+		DescriptorHandle SrvHandle;
+	};
+
+	// What a transient was created from: the same key in the same slot means the
+	// resource of the previous frame can be used again.
+	struct TransientKey
+	{
+		RGTextureDesc Desc;
+		RGState Usage;
+		UINT64 HeapOffset;
+
+		bool operator==(const TransientKey& rhs)const;
+	};
+
+	void CreateTransient(RGHandle handle, const RenderGraph::ResourceInfo& info);
+
+private:
+	ID3D12Device* mDevice = nullptr;
+	ResourceStateTracker& mStateTracker;
+	DeferredReleaseQueue& mDeferredReleases;
+	GpuDescriptorHeap& mSrvHeap;
+
+	StagingDescriptorHeap mRtvHeap;
+	StagingDescriptorHeap mDsvHeap;
+	StagingDescriptorHeap mSrvStagingHeap;
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> mHeap;
+	UINT64 mHeapSize = 0;
+
+	std::vector<Binding> mBindings;
+	std::vector<bool> mTransientSlots;
+	std::vector<TransientKey> mKeys;
+};
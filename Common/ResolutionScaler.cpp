@@ -0,0 +1,157 @@
+//***************************************************************************************
+// ResolutionScaler.cpp
+//***************************************************************************************
+
+#include "ResolutionScaler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+ResolutionScaler::ResolutionScaler(const ResolutionScalerDesc& desc)
+{
+	SetDesc(desc);
+}
+
+void ResolutionScaler::SetDesc(const ResolutionScalerDesc& desc)
+{
+	mDesc = desc;
+	mDesc.MinScale = std::max<float>(mDesc.MinScale, mDesc.Step);
+	mDesc.MaxScale = std::max<float>(mDesc.MaxScale, mDesc.MinScale);
+	mDesc.Smoothing = std::min<double>(std::max<double>(mDesc.Smoothing, 0.001), 1.0);
+
+	Reset();
+}
+
+const ResolutionScalerDesc& ResolutionScaler::Desc()const
+{
+	return mDesc;
+}
+
+float ResolutionScaler::Quantize(float scale)const
+{
+	// Down to a whole step; the small bias keeps exact multiples from rounding one step lower.
+	float steps = std::floor(scale / mDesc.Step + 1e-4f);
+	return std::min<float>(std::max<float>(steps * mDesc.Step, mDesc.MinScale), mDesc.MaxScale);
+}
+
+float ResolutionScaler::Update(double frameMs)
+{
+	mStats.Frames++;
+	if (frameMs > mDesc.BudgetMs)
+		mStats.FramesOverBudget++;
+	mStats.ScaleSum += mScale;
+
+	// Frames queued before the last change are neither measured nor acted upon.
+	if (mSettleFrames > 0)
+	{
+		--mSettleFrames;
+		return mScale;
+	}
+
+	if (!mHasHistory)
+	{
+		mSmoothedMs = frameMs;
+		mHasHistory = true;
+	}
+	else if (frameMs > mDesc.SpikeFactor * mSmoothedMs && !mLastWasSpike)
+	{
+		mLastWasSpike = true;
+		mStats.SpikesIgnored++;
+		return mScale;
+	}
+	else
+	{
+		mSmoothedMs += mDesc.Smoothing * (frameMs - mSmoothedMs);
+	}
+	mLastWasSpike = false;
+
+	double high = mDesc.HighWatermark * mDesc.BudgetMs;
+	double low = mDesc.LowWatermark * mDesc.BudgetMs;
+
+	// Scale at which the time would be in the middle of the band, if it goes with the pixels.
+	float ideal = mScale * (float)std::sqrt(0.5 * (high + low) / std::max<double>(mSmoothedMs, 1e-3));
+
+	float scale = mScale;
+	if (mSmoothedMs > high)
+	{
+		mLowFrames = 0;
+		scale = std::min<float>(Quantize(ideal), Quantize(mScale - mDesc.Step));
+	}
+	else if (mSmoothedMs < low)
+	{
+		if (++mLowFrames >= mDesc.IncreaseDelayFrames)
+		{
+			float limit = std::min<float>(ideal, mScale + mDesc.MaxIncrease);
+			scale = std::max<float>(Quantize(limit), Quantize(mScale + mDesc.Step));
+		}
+	}
+	else
+	{
+		mLowFrames = 0;
+	}
+
+	if (scale != mScale)
+	{
+		if (scale < mScale)
+			mStats.Decreases++;
+		else
+			mStats.Increases++;
+
+		// The estimate follows the model until frames at the new size are measured.
+		mSmoothedMs *= (double)(scale * scale) / (mScale * mScale);
+		mScale = scale;
+		mLowFrames = 0;
+		mSettleFrames = mDesc.SettleFrames;
+		mStats.LowestScale = std::min<float>(mStats.LowestScale, mScale);
+	}
+
+	return mScale;
+}
+
+float ResolutionScaler::Scale()const
+{
+	return mScale;
+}
+
+double ResolutionScaler::SmoothedMs()const
+{
+	return mSmoothedMs;
+}
+
+void ResolutionScaler::ScaledSize(uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight)const
+{
+	scaledWidth = std::max<uint32_t>((uint32_t)(width * mScale + 0.5f), 1);
+	scaledHeight = std::max<uint32_t>((uint32_t)(height * mScale + 0.5f), 1);
+}
+
+void ResolutionScaler::Reset()
+{
+	mScale = Quantize(mDesc.MaxScale);
+	mSmoothedMs = 0.0;
+	mHasHistory = false;
+	mLastWasSpike = false;
+	mLowFrames = 0;
+	mSettleFrames = 0;
+
+	mStats = Stats();
+	mStats.LowestScale = mScale;
+}
+
+const ResolutionScaler::Stats& ResolutionScaler::GetStats()const
+{
+	return mStats;
+}
+
+std::string ResolutionScaler::Report()const
+{
+	double frames = (double)std::max<uint64_t>(mStats.Frames, 1);
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"ResolutionScaler: %llu frames, %.1f%% over the %.2f ms budget; scale %.3f (average %.3f, lowest %.3f), %u decreases, %u increases, %llu spikes ignored",
+		(unsigned long long)mStats.Frames, 100.0 * mStats.FramesOverBudget / frames, mDesc.BudgetMs, mScale,
+		mStats.ScaleSum / frames, mStats.LowestScale, mStats.Decreases, mStats.Increases,
+		(unsigned long long)mStats.SpikesIgnored);
+
+	return buffer;
+}
@@ -0,0 +1,102 @@
+//***************************************************************************************
+// ResolutionScaler.h
+//
+// Dynamic resolution: chooses every frame the fraction of the output size the scene is
+// rendered at, from the measured frame times against a budget.
+//   -Frame times are smoothed with an exponential moving average. A single frame longer
+//    than SpikeFactor times the average (a hitch, a page fault) is left out of it; two in
+//    a row are taken as a real change of the load.
+//   -Hysteresis: above HighWatermark * budget the scale goes down at once; below
+//    LowWatermark * budget it goes up only after IncreaseDelayFrames frames in a row;
+//    in between it stays where it is. The band between the two keeps the scale from
+//    oscillating around the budget.
+//   -The new scale assumes the frame time grows with the pixel count (the square of the
+//    scale) and aims at the middle of the band; going up it moves by at most
+//    MaxIncrease. A frame that is not GPU bound does not get faster at a lower scale,
+//    so the scale then settles at MinScale.
+//   -After a change the next SettleFrames frames are not acted upon: the frames already
+//    queued at the old size are still being measured.
+//   -Scales are multiples of Step, so the render size changes by whole steps only.
+//   -Update only takes frame times, so recorded traces (e.g. the delta times of a
+//    CameraRecording) can be replayed through it offline.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct ResolutionScalerDesc
+{
+	double BudgetMs = 1000.0 / 60.0;
+
+	float MinScale = 0.5f;
+	float MaxScale = 1.0f;
+	float Step = 1.0f / 32.0f;
+	float MaxIncrease = 0.125f;
+
+	// Fractions of the budget.
+	double HighWatermark = 0.95;
+	double LowWatermark = 0.8;
+
+	uint32_t IncreaseDelayFrames = 30;
+	uint32_t SettleFrames = 4;
+
+	// Weight of the newest frame in the moving average, in (0, 1].
+	double Smoothing = 0.1;
+	double SpikeFactor = 2.0;
+};
+
+class ResolutionScaler
+{
+public:
+	struct Stats
+	{
+		uint64_t Frames = 0;
+		uint64_t FramesOverBudget = 0;
+		uint64_t SpikesIgnored = 0;
+		uint32_t Decreases = 0;
+		uint32_t Increases = 0;
+		float LowestScale = 1.0f;
+
+		// Sum of the scales of all frames, for the average.
+		double ScaleSum = 0.0;
+	};
+
+	explicit ResolutionScaler(const ResolutionScalerDesc& desc = ResolutionScalerDesc());
+
+	// Also resets the controller.
+	void SetDesc(const ResolutionScalerDesc& desc);
+	const ResolutionScalerDesc& Desc()const;
+
+	// Adds the time of the frame just finished; returns the scale for the next one.
+	float Update(double frameMs);
+
+	float Scale()const;
+	double SmoothedMs()const;
+
+	// The output size times the scale, rounded, at least 1 x 1.
+	void ScaledSize(uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight)const;
+
+	// Back to MaxScale, with no history.
+	void Reset();
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+private:
+	float Quantize(float scale)const;
+
+private:
+	ResolutionScalerDesc mDesc;
+
+	float mScale = 1.0f;
+	double mSmoothedMs = 0.0;
+	bool mHasHistory = false;
+	bool mLastWasSpike = false;
+
+	uint32_t mLowFrames = 0;
+	uint32_t mSettleFrames = 0;
+
+	Stats mStats;
+};
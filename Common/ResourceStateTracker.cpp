@@ -0,0 +1,187 @@
+//***************************************************************************************
+// ResourceStateTracker.cpp
+//***************************************************************************************
+
+#include "ResourceStateTracker.h"
+
+static const D3D12_RESOURCE_STATES gReadStates = D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_DEPTH_READ;
+
+static bool IsReadState(D3D12_RESOURCE_STATES state)
+{
+	return state != D3D12_RESOURCE_STATE_COMMON && (state & ~gReadStates) == 0;
+}
+
+void ResourceStateTracker::Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+
+	UINT subresourceCount = 1;
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+		subresourceCount = desc.MipLevels;
+	else if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+		subresourceCount = desc.MipLevels * desc.DepthOrArraySize;
+
+	mStates[resource].assign(std::max<UINT>(subresourceCount, 1u), state);
+}
+
+void ResourceStateTracker::Unregister(ID3D12Resource* resource)
+{
+	mStates.erase(resource);
+
+	mPendingBarriers.erase(std::remove_if(mPendingBarriers.begin(), mPendingBarriers.end(),
+		[resource](const D3D12_RESOURCE_BARRIER& b) { return b.Transition.pResource == resource; }),
+		mPendingBarriers.end());
+}
+
+void ResourceStateTracker::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource)
+{
+	auto it = mStates.find(resource);
+	assert(it != mStates.end() && "Resource not registered with the state tracker.");
+
+	std::vector<D3D12_RESOURCE_STATES>& states = it->second;
+	UINT subresourceCount = (UINT)states.size();
+
+	// With one subresource there is no difference between the two kinds of barrier.
+	if (subresourceCount == 1)
+		subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		bool uniform = std::all_of(states.begin(), states.end(),
+			[&states](D3D12_RESOURCE_STATES s) { return s == states[0]; });
+
+		// A single whole-resource barrier is only possible when every subresource is in
+		// the same state and none of them has its own barrier waiting to be flushed.
+		bool pendingSubresource = false;
+		for (UINT i = 0; i < subresourceCount && subresourceCount > 1; ++i)
+			pendingSubresource = pendingSubresource || HasPendingBarrier(resource, i);
+
+		if (uniform && !pendingSubresource)
+		{
+			D3D12_RESOURCE_STATES newState = AddTransition(resource, subresource, states[0], state);
+			std::fill(states.begin(), states.end(), newState);
+			return;
+		}
+
+		SplitPendingBarrier(resource, subresourceCount);
+		for (UINT i = 0; i < subresourceCount; ++i)
+			states[i] = AddTransition(resource, i, states[i], state);
+	}
+	else
+	{
+		assert(subresource < subresourceCount);
+
+		SplitPendingBarrier(resource, subresourceCount);
+		states[subresource] = AddTransition(resource, subresource, states[subresource], state);
+	}
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::AddTransition(ID3D12Resource* resource, UINT subresource,
+	D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+	// Nothing to do if the subresource is already readable the way it is requested.
+	if (before == after || (IsReadState(before) && IsReadState(after) && (before & after) == after))
+	{
+		++mSkippedCount;
+		return before;
+	}
+
+	// A barrier recorded since the last flush is folded into the new one: no command
+	// between the two needed the intermediate state.
+	for (auto b = mPendingBarriers.begin(); b != mPendingBarriers.end(); ++b)
+	{
+		if (b->Transition.pResource == resource && b->Transition.Subresource == subresource)
+		{
+			if (b->Transition.StateBefore == after)
+			{
+				mPendingBarriers.erase(b);
+				++mSkippedCount;
+			}
+			else
+			{
+				b->Transition.StateAfter = after;
+			}
+
+			return after;
+		}
+	}
+
+	mPendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after, subresource));
+	return after;
+}
+
+bool ResourceStateTracker::HasPendingBarrier(ID3D12Resource* resource, UINT subresource)const
+{
+	for (const auto& b : mPendingBarriers)
+	{
+		if (b.Transition.pResource == resource && b.Transition.Subresource == subresource)
+			return true;
+	}
+
+	return false;
+}
+
+void ResourceStateTracker::SplitPendingBarrier(ID3D12Resource* resource, UINT subresourceCount)
+{
+	for (size_t i = 0; i < mPendingBarriers.size(); ++i)
+	{
+		D3D12_RESOURCE_BARRIER b = mPendingBarriers[i];
+		if (b.Transition.pResource != resource || b.Transition.Subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+			continue;
+
+		// Replace the whole-resource barrier with one barrier per subresource.
+		mPendingBarriers.erase(mPendingBarriers.begin() + i);
+		for (UINT s = 0; s < subresourceCount; ++s)
+		{
+			mPendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+				b.Transition.StateBefore, b.Transition.StateAfter, s));
+		}
+
+		return;
+	}
+}
+
+void ResourceStateTracker::FlushBarriers(ID3D12GraphicsCommandList* cmdList)
+{
+	if (mPendingBarriers.empty())
+		return;
+
+	cmdList->ResourceBarrier((UINT)mPendingBarriers.size(), mPendingBarriers.data());
+
+	mBarrierCount += (UINT)mPendingBarriers.size();
+	++mFlushCount;
+	mPendingBarriers.clear();
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::GetState(ID3D12Resource* resource, UINT subresource)const
+{
+	auto it = mStates.find(resource);
+	assert(it != mStates.end());
+
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+		subresource = 0;
+
+	return it->second[subresource];
+}
+
+UINT ResourceStateTracker::BarrierCount()const
+{
+	return mBarrierCount;
+}
+
+UINT ResourceStateTracker::SkippedCount()const
+{
+	return mSkippedCount;
+}
+
+UINT ResourceStateTracker::FlushCount()const
+{
+	return mFlushCount;
+}
+
+void ResourceStateTracker::ResetStats()
+{
+	mBarrierCount = 0;
+	mSkippedCount = 0;
+	mFlushCount = 0;
+}
@@ -0,0 +1,63 @@
+//***************************************************************************************
+// ResourceStateTracker.h
+//
+// Remembers the state of every registered resource (per subresource) so that callers
+// only say which state they need and never write the "before" state by hand.
+//   -Transition records the barrier lazily; FlushBarriers emits everything recorded
+//    so far with a single ResourceBarrier call, right before the draw or copy that
+//    needs it.
+//   -Requests that are already satisfied (same state, or a read state contained in
+//    the current combined read state) are dropped, and a transition that is undone
+//    before the next flush cancels out.
+//   -States are global to the tracker, which assumes that command lists execute in
+//    the order they are recorded (a single direct command list in these demos).
+//   -Planes of depth-stencil formats are not tracked separately.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class ResourceStateTracker
+{
+public:
+	ResourceStateTracker() = default;
+	ResourceStateTracker(const ResourceStateTracker& rhs) = delete;
+	ResourceStateTracker& operator=(const ResourceStateTracker& rhs) = delete;
+
+	// Starts tracking a resource whose subresources are all in the given state.
+	void Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+
+	// Must be called before the resource is released: its address could be reused.
+	void Unregister(ID3D12Resource* resource);
+
+	void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state,
+		UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+	void FlushBarriers(ID3D12GraphicsCommandList* cmdList);
+
+	D3D12_RESOURCE_STATES GetState(ID3D12Resource* resource, UINT subresource = 0)const;
+
+	// Counters since the last ResetStats.
+	UINT BarrierCount()const;
+	UINT SkippedCount()const;
+	UINT FlushCount()const;
+	void ResetStats();
+
+private:
+	// Records a barrier for one subresource (or all of them) and returns the state the
+	// subresource ends up in.
+	D3D12_RESOURCE_STATES AddTransition(ID3D12Resource* resource, UINT subresource,
+		D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+
+	bool HasPendingBarrier(ID3D12Resource* resource, UINT subresource)const;
+	void SplitPendingBarrier(ID3D12Resource* resource, UINT subresourceCount);
+
+private:
+	std::unordered_map<ID3D12Resource*, std::vector<D3D12_RESOURCE_STATES>> mStates;
+	std::vector<D3D12_RESOURCE_BARRIER> mPendingBarriers;
+
+	UINT mBarrierCount = 0;
+	UINT mSkippedCount = 0;
+	UINT mFlushCount = 0;
+};
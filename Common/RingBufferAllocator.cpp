@@ -0,0 +1,112 @@
+//***************************************************************************************
+// RingBufferAllocator.cpp
+//***************************************************************************************
+
+#include "RingBufferAllocator.h"
+#include <cassert>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+RingBufferAllocator::RingBufferAllocator(uint64_t capacity) :
+	mCapacity(capacity)
+{
+}
+
+uint64_t RingBufferAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment > 0);
+
+	if (size == 0 || size > mCapacity || mUsedSize + size > mCapacity)
+		return InvalidOffset;
+
+	// Empty ring: restart from the beginning so that we do not wrap needlessly.
+	if (mUsedSize == 0 && mPendingFrames.empty())
+	{
+		mHead = 0;
+		mTail = 0;
+	}
+
+	// Space is free in [mTail, mCapacity) and [0, mHead) when mTail >= mHead,
+	// and in [mTail, mHead) otherwise.
+	if (mTail >= mHead && mUsedSize < mCapacity)
+	{
+		uint64_t offset = AlignUp(mTail, alignment);
+		if (offset + size <= mCapacity)
+		{
+			uint64_t allocSize = offset + size - mTail;
+			mTail = (offset + size) % mCapacity;
+			mUsedSize += allocSize;
+			mCurrFrameSize += allocSize;
+			return offset;
+		}
+
+		// Wrap around: the end of the ring is wasted until this frame retires.
+		if (size <= mHead)
+		{
+			uint64_t allocSize = (mCapacity - mTail) + size;
+			if (mUsedSize + allocSize > mCapacity)
+				return InvalidOffset;
+
+			mTail = size;
+			mUsedSize += allocSize;
+			mCurrFrameSize += allocSize;
+			return 0;
+		}
+	}
+	else if (mTail < mHead)
+	{
+		uint64_t offset = AlignUp(mTail, alignment);
+		if (offset + size <= mHead)
+		{
+			uint64_t allocSize = offset + size - mTail;
+			mTail = offset + size;
+			mUsedSize += allocSize;
+			mCurrFrameSize += allocSize;
+			return offset;
+		}
+	}
+
+	return InvalidOffset;
+}
+
+void RingBufferAllocator::FinishFrame(uint64_t fenceValue)
+{
+	mPendingFrames.push_back({ fenceValue, mTail, mCurrFrameSize });
+	mCurrFrameSize = 0;
+}
+
+void RingBufferAllocator::ReleaseCompletedFrames(uint64_t completedFenceValue)
+{
+	while (!mPendingFrames.empty() && mPendingFrames.front().Fence <= completedFenceValue)
+	{
+		const FrameTail& oldest = mPendingFrames.front();
+		assert(oldest.Size <= mUsedSize);
+		mUsedSize -= oldest.Size;
+		mHead = oldest.Tail;
+		mPendingFrames.pop_front();
+	}
+}
+
+bool RingBufferAllocator::HasPendingFrames()const
+{
+	return !mPendingFrames.empty();
+}
+
+uint64_t RingBufferAllocator::OldestPendingFence()const
+{
+	assert(!mPendingFrames.empty());
+	return mPendingFrames.front().Fence;
+}
+
+uint64_t RingBufferAllocator::Capacity()const
+{
+	return mCapacity;
+}
+
+uint64_t RingBufferAllocator::UsedSize()const
+{
+	return mUsedSize;
+}
@@ -0,0 +1,58 @@
+//***************************************************************************************
+// RingBufferAllocator.h
+//
+// Offset-only ring allocator with fence-based reclamation.
+//   -It hands out [offset, offset+size) ranges from a fixed capacity in FIFO order.
+//   -Every allocation made between two calls to FinishFrame is tagged with the fence
+//    value passed to FinishFrame; the space is given back by ReleaseCompletedFrames
+//    once the GPU has reached that fence.
+//   -It knows nothing about Direct3D so it can be reused for upload memory as well as
+//    for descriptor ranges.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+class RingBufferAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+
+	explicit RingBufferAllocator(uint64_t capacity);
+
+	// Returns the offset of the allocated range or InvalidOffset if the ring is full.
+	// The padding needed to honor alignment (and the unused end of the ring, when the
+	// allocation wraps around) is accounted to the current frame.
+	uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+
+	// Closes the current frame: everything allocated since the previous call is
+	// released once completedFenceValue >= fenceValue.
+	void FinishFrame(uint64_t fenceValue);
+
+	// Reclaims the space of all the frames whose fence has been reached.
+	void ReleaseCompletedFrames(uint64_t completedFenceValue);
+
+	bool HasPendingFrames()const;
+	uint64_t OldestPendingFence()const;
+
+	uint64_t Capacity()const;
+	uint64_t UsedSize()const;
+
+private:
+	struct FrameTail
+	{
+		uint64_t Fence;
+		uint64_t Tail;
+		uint64_t Size;
+	};
+
+	std::deque<FrameTail> mPendingFrames;
+
+	uint64_t mCapacity = 0;
+	uint64_t mHead = 0;
+	uint64_t mTail = 0;
+	uint64_t mUsedSize = 0;
+	uint64_t mCurrFrameSize = 0;
+};
@@ -0,0 +1,282 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "Hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char Magic[4] = { 'S', 'C', 'S', 'O' };
+	const uint32_t FormatVersion = 1;
+	const size_t HeaderSize = 24;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static std::wstring DirectoryOf(const std::wstring& filename)
+{
+	size_t slash = filename.find_last_of(L"/\\");
+	return slash == std::wstring::npos ? std::wstring() : filename.substr(0, slash + 1);
+}
+
+static void CreateDirectoryIfMissing(const std::wstring& directory)
+{
+#ifdef _WIN32
+	CreateDirectoryW(directory.c_str(), nullptr);
+#else
+	mkdir(std::string(directory.begin(), directory.end()).c_str(), 0755);
+#endif
+}
+
+// Writes header and data to a temporary file next to filename, then renames it over
+// filename. The temporary name includes the process id, so two instances compiling the
+// same shader do not write to the same file.
+static bool WriteCacheFile(const std::wstring& filename, const std::vector<uint8_t>& header, const std::vector<uint8_t>& data)
+{
+#ifdef _WIN32
+	std::wstring temp = filename + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+	std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+#else
+	std::wstring temp = filename + L"." + std::to_wstring(getpid()) + L".tmp";
+	std::string tempName(temp.begin(), temp.end());
+	std::ofstream fout(tempName, std::ios::binary | std::ios::trunc);
+#endif
+	fout.write((const char*)header.data(), header.size());
+	fout.write((const char*)data.data(), data.size());
+	fout.close();
+
+#ifdef _WIN32
+	bool written = !fout.fail() && MoveFileExW(temp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+	if (!written)
+		DeleteFileW(temp.c_str());
+#else
+	bool written = !fout.fail() && rename(tempName.c_str(), std::string(filename.begin(), filename.end()).c_str()) == 0;
+	if (!written)
+		unlink(tempName.c_str());
+#endif
+	return written;
+}
+
+ShaderCache::ShaderCache(const std::wstring& cacheDirectory, const CompileFunc& compile,
+	uint32_t flags, const std::string& compilerVersion) :
+	mCacheDirectory(cacheDirectory),
+	mCompile(compile),
+	mFlags(flags),
+	mCompilerVersion(compilerVersion)
+{
+	CreateDirectoryIfMissing(mCacheDirectory);
+}
+
+std::shared_ptr<const ShaderBytecode> ShaderCache::Load(
+	const std::wstring& filename,
+	const std::vector<ShaderDefine>& defines,
+	const std::string& entrypoint,
+	const std::string& target)
+{
+	uint64_t key = ComputeKey(filename, defines, entrypoint, target);
+	std::wstring path = CachePath(key);
+
+	auto bytecode = std::make_shared<ShaderBytecode>();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (bytecode->mMapped.Open(path))
+	{
+		if (IsValidCacheFile(bytecode->mMapped, key))
+		{
+			bytecode->mMappedOffset = HeaderSize;
+			++mStats.Hits;
+			mStats.LoadMs += MillisecondsSince(start);
+			return bytecode;
+		}
+		++mStats.Rejected;
+	}
+	bytecode->mMapped.Close();
+
+	start = std::chrono::high_resolution_clock::now();
+	bytecode->mOwned = mCompile(filename, defines, entrypoint, target, mFlags);
+	mStats.CompileMs += MillisecondsSince(start);
+	++mStats.Misses;
+
+	std::vector<uint8_t> header(HeaderSize);
+	uint64_t payloadSize = bytecode->mOwned.size();
+	memcpy(header.data(), Magic, 4);
+	memcpy(header.data() + 4, &FormatVersion, 4);
+	memcpy(header.data() + 8, &key, 8);
+	memcpy(header.data() + 16, &payloadSize, 8);
+
+	// A failed write leaves the previous file (or none) in place: it only costs a
+	// compile at the next start.
+	WriteCacheFile(path, header, bytecode->mOwned);
+
+	return bytecode;
+}
+
+bool ShaderCache::IsValidCacheFile(const MappedFile& file, uint64_t key)
+{
+	if (file.Size() <= HeaderSize || memcmp(file.Data(), Magic, 4) != 0)
+		return false;
+
+	uint32_t version;
+	uint64_t fileKey, payloadSize;
+	memcpy(&version, file.Data() + 4, 4);
+	memcpy(&fileKey, file.Data() + 8, 8);
+	memcpy(&payloadSize, file.Data() + 16, 8);
+
+	return version == FormatVersion && fileKey == key && payloadSize == file.Size() - HeaderSize;
+}
+
+uint64_t ShaderCache::ComputeKey(
+	const std::wstring& filename,
+	const std::vector<ShaderDefine>& defines,
+	const std::string& entrypoint,
+	const std::string& target)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::wstring> visited;
+
+	Hasher h;
+	h.Add(HashSource(filename, visited));
+
+	h.Add((uint64_t)defines.size());
+	for (const ShaderDefine& d : defines)
+	{
+		h.AddString(d.Name);
+		h.AddString(d.Value);
+	}
+
+	h.AddString(entrypoint);
+	h.AddString(target);
+	h.Add(mFlags);
+	h.AddString(mCompilerVersion);
+
+	mStats.HashMs += MillisecondsSince(start);
+
+	return h.Value();
+}
+
+uint64_t ShaderCache::HashSource(const std::wstring& filename, std::vector<std::wstring>& visited)
+{
+	auto cached = mSourceHashes.find(filename);
+	if (cached != mSourceHashes.end())
+		return cached->second;
+
+	visited.push_back(filename);
+
+	Hasher h;
+
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		// Missing includes are the compiler's problem; the key just records the name.
+		h.AddString(std::string(filename.begin(), filename.end()));
+		return h.Value();
+	}
+
+	h.Add(file.Data(), file.Size());
+
+	// Includes are resolved relative to the including file, like the default handler
+	// of the HLSL compiler does.
+	std::wstring directory = DirectoryOf(filename);
+	for (const std::string& include : ParseIncludes((const char*)file.Data(), file.Size()))
+	{
+		std::wstring includePath = directory + std::wstring(include.begin(), include.end());
+
+		h.AddString(include);
+		if (std::find(visited.begin(), visited.end(), includePath) == visited.end())
+			h.Add(HashSource(includePath, visited));
+	}
+
+	mSourceHashes[filename] = h.Value();
+	return h.Value();
+}
+
+std::vector<std::string> ShaderCache::ParseIncludes(const char* source, size_t size)
+{
+	std::vector<std::string> includes;
+
+	size_t i = 0;
+	while (i < size)
+	{
+		size_t lineEnd = i;
+		while (lineEnd < size && source[lineEnd] != '\n')
+			++lineEnd;
+
+		size_t p = i;
+		while (p < lineEnd && (source[p] == ' ' || source[p] == '\t'))
+			++p;
+
+		if (p < lineEnd && source[p] == '#')
+		{
+			++p;
+			while (p < lineEnd && (source[p] == ' ' || source[p] == '\t'))
+				++p;
+
+			static const char directive[] = "include";
+			size_t length = sizeof(directive) - 1;
+			if (lineEnd - p > length && std::equal(directive, directive + length, source + p))
+			{
+				p += length;
+				while (p < lineEnd && (source[p] == ' ' || source[p] == '\t'))
+					++p;
+
+				if (p < lineEnd && (source[p] == '"' || source[p] == '<'))
+				{
+					char close = source[p] == '"' ? '"' : '>';
+					size_t nameStart = ++p;
+					while (p < lineEnd && source[p] != close)
+						++p;
+
+					if (p < lineEnd)
+						includes.emplace_back(source + nameStart, p - nameStart);
+				}
+			}
+		}
+
+		i = lineEnd + 1;
+	}
+
+	return includes;
+}
+
+void ShaderCache::ClearSourceHashes()
+{
+	mSourceHashes.clear();
+}
+
+std::wstring ShaderCache::CachePath(uint64_t key)const
+{
+	std::string hex = Hasher::ToHex(key);
+	return mCacheDirectory + L"/" + std::wstring(hex.begin(), hex.end()) + L".cso";
+}
+
+const ShaderCache::Stats& ShaderCache::GetStats()const
+{
+	return mStats;
+}
+
+std::string ShaderCache::Report()const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"ShaderCache: %u hits, %u misses (%u invalid files), %.2f ms hashing, %.2f ms loading, %.1f ms compiling",
+		mStats.Hits, mStats.Misses, mStats.Rejected, mStats.HashMs, mStats.LoadMs, mStats.CompileMs);
+
+	return buffer;
+}
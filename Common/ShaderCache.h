@@ -0,0 +1,117 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Compiled shader bytecode cached on disk, so that shaders are compiled once instead
+// of at every start.
+//   -The key hashes the source file, every file it includes (recursively), the defines,
+//    the entry point, the target, the compile flags and a compiler version string.
+//    Editing any of them produces a new key; nothing has to be invalidated by hand.
+//   -Cached blobs are read through a memory mapping; the compiler is only called on
+//    a miss, and its output is written back to the cache.
+//   -Each cache file starts with a header (magic, format version, key, payload size).
+//    A file whose header does not match, e.g. one cut short by a crash or a full disk,
+//    is treated as a miss and rewritten. Files are written to a temporary name and
+//    renamed into place, so a reader never sees a partial file under its final name.
+//   -Compiling is delegated to a callback (d3dUtil wraps D3DCompileFromFile), so the
+//    cache only deals with files, keys and blobs.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// Bytecode either mapped from the cache or just compiled.
+class ShaderBytecode
+{
+public:
+	const void* Data()const { return mMapped.IsOpen() ? (const void*)(mMapped.Data() + mMappedOffset) : (const void*)mOwned.data(); }
+	size_t Size()const { return mMapped.IsOpen() ? mMapped.Size() - mMappedOffset : mOwned.size(); }
+
+private:
+	friend class ShaderCache;
+
+	// The bytecode follows the header of the cache file.
+	MappedFile mMapped;
+	size_t mMappedOffset = 0;
+	std::vector<uint8_t> mOwned;
+};
+
+class ShaderCache
+{
+public:
+	// Compiles a shader; reports failures by throwing.
+	typedef std::function<std::vector<uint8_t>(
+		const std::wstring& filename,
+		const std::vector<ShaderDefine>& defines,
+		const std::string& entrypoint,
+		const std::string& target,
+		uint32_t flags)> CompileFunc;
+
+	struct Stats
+	{
+		uint32_t Hits = 0;
+		uint32_t Misses = 0;
+
+		// Cache files found but not valid (counted as misses too).
+		uint32_t Rejected = 0;
+		double HashMs = 0.0;
+		double LoadMs = 0.0;
+		double CompileMs = 0.0;
+	};
+
+	ShaderCache(const std::wstring& cacheDirectory, const CompileFunc& compile,
+		uint32_t flags = 0, const std::string& compilerVersion = "");
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+	std::shared_ptr<const ShaderBytecode> Load(
+		const std::wstring& filename,
+		const std::vector<ShaderDefine>& defines,
+		const std::string& entrypoint,
+		const std::string& target);
+
+	uint64_t ComputeKey(
+		const std::wstring& filename,
+		const std::vector<ShaderDefine>& defines,
+		const std::string& entrypoint,
+		const std::string& target);
+
+	// Forgets the source hashes computed so far (call after editing shaders at runtime).
+	void ClearSourceHashes();
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+	// Include directives of an HLSL source, in order ("..." and <...> forms).
+	static std::vector<std::string> ParseIncludes(const char* source, size_t size);
+
+private:
+	// Hash of a file and, recursively, of the files it includes.
+	uint64_t HashSource(const std::wstring& filename, std::vector<std::wstring>& visited);
+
+	std::wstring CachePath(uint64_t key)const;
+
+	// False if the file is not a complete cache file for the key.
+	static bool IsValidCacheFile(const MappedFile& file, uint64_t key);
+
+private:
+	std::wstring mCacheDirectory;
+	CompileFunc mCompile;
+	uint32_t mFlags = 0;
+	std::string mCompilerVersion;
+
+	std::unordered_map<std::wstring, uint64_t> mSourceHashes;
+
+	Stats mStats;
+};
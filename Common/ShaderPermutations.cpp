@@ -0,0 +1,147 @@
+//***************************************************************************************
+// ShaderPermutations.cpp
+//***************************************************************************************
+
+#include "ShaderPermutations.h"
+#include <cassert>
+
+uint32_t ShaderPermutationLayout::AddFlag(const std::string& define)
+{
+	return AddField(define, true, 1);
+}
+
+uint32_t ShaderPermutationLayout::AddCount(const std::string& define, uint32_t maxValue)
+{
+	return AddField(define, false, maxValue);
+}
+
+uint32_t ShaderPermutationLayout::AddField(const std::string& define, bool isFlag, uint32_t maxValue)
+{
+	Field field;
+	field.Define = define;
+	field.IsFlag = isFlag;
+	field.MaxValue = maxValue;
+	field.Shift = mBitCount;
+
+	field.Bits = 1;
+	while ((1u << field.Bits) <= maxValue)
+		++field.Bits;
+
+	mBitCount += field.Bits;
+	assert(mBitCount <= 32 && "Permutation key does not fit in 32 bits.");
+
+	mFields.push_back(field);
+	return (uint32_t)mFields.size() - 1;
+}
+
+uint32_t ShaderPermutationLayout::Mask(uint32_t field)const
+{
+	const Field& f = mFields[field];
+	uint32_t bits = f.Bits == 32 ? ~0u : (1u << f.Bits) - 1;
+	return bits << f.Shift;
+}
+
+uint32_t ShaderPermutationLayout::Set(uint32_t key, uint32_t field, uint32_t value)const
+{
+	const Field& f = mFields[field];
+	assert(value <= f.MaxValue);
+
+	return (key & ~Mask(field)) | (value << f.Shift);
+}
+
+uint32_t ShaderPermutationLayout::Get(uint32_t key, uint32_t field)const
+{
+	return (key & Mask(field)) >> mFields[field].Shift;
+}
+
+std::vector<ShaderDefine> ShaderPermutationLayout::Defines(uint32_t key)const
+{
+	std::vector<ShaderDefine> defines;
+
+	for (uint32_t i = 0; i < (uint32_t)mFields.size(); ++i)
+	{
+		const Field& f = mFields[i];
+		uint32_t value = Get(key, i);
+
+		if (f.IsFlag)
+		{
+			// Shaders test flags with #ifdef, so unset flags must not be defined at all.
+			if (value != 0)
+				defines.push_back({ f.Define, "1" });
+		}
+		else
+		{
+			defines.push_back({ f.Define, std::to_string(value) });
+		}
+	}
+
+	return defines;
+}
+
+std::string ShaderPermutationLayout::Describe(uint32_t key)const
+{
+	std::string text;
+
+	for (uint32_t i = 0; i < (uint32_t)mFields.size(); ++i)
+	{
+		const Field& f = mFields[i];
+		uint32_t value = Get(key, i);
+		if (f.IsFlag && value == 0)
+			continue;
+
+		if (!text.empty())
+			text += " ";
+		text += f.IsFlag ? f.Define : f.Define + "=" + std::to_string(value);
+	}
+
+	return text;
+}
+
+ShaderPermutations::ShaderPermutations(ShaderCache& cache, const std::wstring& filename, const ShaderPermutationLayout& layout) :
+	mCache(cache),
+	mFilename(filename),
+	mLayout(layout)
+{
+}
+
+void ShaderPermutations::SetKeyMask(const std::string& entrypoint, uint32_t mask)
+{
+	mKeyMasks[entrypoint] = mask;
+}
+
+uint32_t ShaderPermutations::EffectiveKey(const std::string& entrypoint, uint32_t key)const
+{
+	auto it = mKeyMasks.find(entrypoint);
+	return it == mKeyMasks.end() ? key : key & it->second;
+}
+
+std::shared_ptr<const ShaderBytecode> ShaderPermutations::Get(const std::string& entrypoint, const std::string& target, uint32_t key)
+{
+	key = EffectiveKey(entrypoint, key);
+
+	auto id = std::make_pair(entrypoint + ":" + target, key);
+	auto it = mVariants.find(id);
+	if (it != mVariants.end())
+		return it->second;
+
+	auto bytecode = mCache.Load(mFilename, mLayout.Defines(key), entrypoint, target);
+	mVariants[id] = bytecode;
+
+	return bytecode;
+}
+
+void ShaderPermutations::Prebuild(const std::string& entrypoint, const std::string& target, const std::vector<uint32_t>& keys)
+{
+	for (uint32_t key : keys)
+		Get(entrypoint, target, key);
+}
+
+const ShaderPermutationLayout& ShaderPermutations::Layout()const
+{
+	return mLayout;
+}
+
+size_t ShaderPermutations::VariantCount()const
+{
+	return mVariants.size();
+}
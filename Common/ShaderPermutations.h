@@ -0,0 +1,83 @@
+//***************************************************************************************
+// ShaderPermutations.h
+//
+// Variants of one shader file selected by a permutation key.
+//   -ShaderPermutationLayout packs the shader's knobs into a 32-bit key: flags (a define
+//    that is either set to 1 or absent) and counts (a define with a numeric value).
+//    Materials and passes each set their own fields and the keys are OR'ed together.
+//   -ShaderPermutations builds each (entry point, key) pair once, through ShaderCache,
+//    either on demand or ahead of time with Prebuild. Every entry point can be given
+//    the mask of the fields it actually depends on, so keys that only differ in fields
+//    it ignores share one variant.
+//***************************************************************************************
+
+#pragma once
+
+#include "ShaderCache.h"
+#include <map>
+
+class ShaderPermutationLayout
+{
+public:
+	// Returns the field index to pass to Set/Get.
+	uint32_t AddFlag(const std::string& define);
+	uint32_t AddCount(const std::string& define, uint32_t maxValue);
+
+	uint32_t Set(uint32_t key, uint32_t field, uint32_t value)const;
+	uint32_t Get(uint32_t key, uint32_t field)const;
+
+	// Bits a field occupies in the key.
+	uint32_t Mask(uint32_t field)const;
+
+	std::vector<ShaderDefine> Defines(uint32_t key)const;
+
+	// Readable form of a key, e.g. "NUM_DIR_LIGHTS=3 FOG".
+	std::string Describe(uint32_t key)const;
+
+private:
+	struct Field
+	{
+		std::string Define;
+		bool IsFlag = false;
+		uint32_t MaxValue = 1;
+		uint32_t Shift = 0;
+		uint32_t Bits = 1;
+	};
+
+	uint32_t AddField(const std::string& define, bool isFlag, uint32_t maxValue);
+
+private:
+	std::vector<Field> mFields;
+	uint32_t mBitCount = 0;
+};
+
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(ShaderCache& cache, const std::wstring& filename, const ShaderPermutationLayout& layout);
+	ShaderPermutations(const ShaderPermutations& rhs) = delete;
+	ShaderPermutations& operator=(const ShaderPermutations& rhs) = delete;
+
+	// Fields the entry point depends on (all of them by default).
+	void SetKeyMask(const std::string& entrypoint, uint32_t mask);
+
+	// The key with the fields the entry point ignores cleared.
+	uint32_t EffectiveKey(const std::string& entrypoint, uint32_t key)const;
+
+	// Built on first use, shared afterwards.
+	std::shared_ptr<const ShaderBytecode> Get(const std::string& entrypoint, const std::string& target, uint32_t key);
+
+	// Builds the variants before they are needed (e.g. at load time).
+	void Prebuild(const std::string& entrypoint, const std::string& target, const std::vector<uint32_t>& keys);
+
+	const ShaderPermutationLayout& Layout()const;
+	size_t VariantCount()const;
+
+private:
+	ShaderCache& mCache;
+	std::wstring mFilename;
+	ShaderPermutationLayout mLayout;
+
+	std::map<std::string, uint32_t> mKeyMasks;
+	std::map<std::pair<std::string, uint32_t>, std::shared_ptr<const ShaderBytecode>> mVariants;
+};
@@ -0,0 +1,393 @@
+//***************************************************************************************
+// ShadowCascades.cpp
+//***************************************************************************************
+
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHADOW_CASCADES_SSE 1
+#include <xmmintrin.h>
+#endif
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static float Dot3(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Normalize3(float v[3])
+{
+	float length = std::sqrt(Dot3(v, v));
+	for (int i = 0; i < 3; ++i)
+		v[i] /= length;
+}
+
+static void Multiply(const float a[4][4], const float b[4][4], float result[4][4])
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			result[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j] + a[i][3] * b[3][j];
+		}
+	}
+}
+
+void ShadowCascades::SetDesc(const ShadowCascadeDesc& desc)
+{
+	assert(desc.CascadeCount >= 1 && desc.CascadeCount <= MaxCascades);
+
+	mDesc = desc;
+	InvalidateCache();
+}
+
+const ShadowCascadeDesc& ShadowCascades::Desc()const
+{
+	return mDesc;
+}
+
+uint32_t ShadowCascades::AddCaster(const float center[3], const float extents[3], bool isStatic)
+{
+	uint32_t id = mCasterCount++;
+
+	for (std::vector<float>* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ,
+		&mLightCenterX, &mLightCenterY, &mLightCenterZ, &mLightExtentX, &mLightExtentY, &mLightExtentZ })
+	{
+		v->resize(mCasterCount + 3, 0.0f);
+	}
+	mIsStatic.resize(mCasterCount + 3, 1);
+	mIsStatic[id] = isStatic ? 1 : 0;
+
+	SetCasterBounds(id, center, extents);
+	return id;
+}
+
+void ShadowCascades::SetCasterBounds(uint32_t id, const float center[3], const float extents[3])
+{
+	assert(id < mCasterCount);
+
+	if (mIsStatic[id])
+		++mStaticVersion;
+
+	mCenterX[id] = center[0];
+	mCenterY[id] = center[1];
+	mCenterZ[id] = center[2];
+	mExtentX[id] = extents[0];
+	mExtentY[id] = extents[1];
+	mExtentZ[id] = extents[2];
+}
+
+void ShadowCascades::InvalidateCache()
+{
+	for (RenderedState& rendered : mRendered)
+		rendered.Valid = false;
+}
+
+void ShadowCascades::ComputeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits)
+{
+	for (uint32_t i = 1; i <= count; ++i)
+	{
+		float t = (float)i / count;
+		float uniform = nearZ + (farZ - nearZ) * t;
+		float logarithmic = nearZ * std::pow(farZ / nearZ, t);
+		splits[i - 1] = lambda * logarithmic + (1.0f - lambda) * uniform;
+	}
+}
+
+void ShadowCascades::SetLightBasis(const float lightDirection[3])
+{
+	std::memcpy(mLightZ, lightDirection, sizeof(mLightZ));
+	Normalize3(mLightZ);
+
+	// Any up vector will do as long as it is not parallel to the light.
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	if (std::fabs(mLightZ[1]) > 0.99f)
+	{
+		up[1] = 0.0f;
+		up[2] = 1.0f;
+	}
+
+	// Left-handed, as in XMMatrixLookToLH: x = up x z, y = z x x.
+	mLightX[0] = up[1] * mLightZ[2] - up[2] * mLightZ[1];
+	mLightX[1] = up[2] * mLightZ[0] - up[0] * mLightZ[2];
+	mLightX[2] = up[0] * mLightZ[1] - up[1] * mLightZ[0];
+	Normalize3(mLightX);
+
+	mLightY[0] = mLightZ[1] * mLightX[2] - mLightZ[2] * mLightX[1];
+	mLightY[1] = mLightZ[2] * mLightX[0] - mLightZ[0] * mLightX[2];
+	mLightY[2] = mLightZ[0] * mLightX[1] - mLightZ[1] * mLightX[0];
+}
+
+void ShadowCascades::Fit(const ShadowCamera& camera, ShadowCascade& cascade)const
+{
+	float n = cascade.SplitNear;
+	float f = cascade.SplitFar;
+
+	// Squared distance of a slice corner from the view axis, per unit of depth.
+	float tanHalfFovY = std::tan(0.5f * camera.FovY);
+	float k = tanHalfFovY * tanHalfFovY * (1.0f + camera.Aspect * camera.Aspect);
+
+	// Sphere centered on the view axis, as close as possible to being equidistant from
+	// the near and the far corners. Rounding the radius keeps float noise from changing it.
+	float z = std::min<float>(0.5f * (n + f) * (1.0f + k), f);
+	float radius = std::max<float>(
+		std::sqrt((f - z) * (f - z) + f * f * k),
+		std::sqrt((z - n) * (z - n) + n * n * k));
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	float world[3];
+	for (int i = 0; i < 3; ++i)
+		world[i] = camera.Position[i] + camera.Look[i] * z;
+
+	// Snap the center to whole texels: the projection then only ever moves by texels,
+	// and sampled depths do not swim.
+	float texel = 2.0f * radius / mDesc.Resolution;
+	float center[3] = { Dot3(world, mLightX), Dot3(world, mLightY), Dot3(world, mLightZ) };
+	for (int i = 0; i < 3; ++i)
+		cascade.Center[i] = std::floor(center[i] / texel) * texel;
+
+	cascade.Radius = radius;
+	cascade.TexelSize = texel;
+
+	float view[4][4] =
+	{
+		{ mLightX[0], mLightY[0], mLightZ[0], 0.0f },
+		{ mLightX[1], mLightY[1], mLightZ[1], 0.0f },
+		{ mLightX[2], mLightY[2], mLightZ[2], 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	};
+
+	// XMMatrixOrthographicOffCenterLH over center -/+ radius on every axis.
+	float zNear = cascade.Center[2] - radius;
+	float ortho[4][4] =
+	{
+		{ 1.0f / radius, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f / radius, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.5f / radius, 0.0f },
+		{ -cascade.Center[0] / radius, -cascade.Center[1] / radius, -zNear * 0.5f / radius, 1.0f }
+	};
+
+	// NDC [-1,+1]^2 to texture space [0,1]^2.
+	const float toTexture[4][4] =
+	{
+		{ 0.5f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, -0.5f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.5f, 0.5f, 0.0f, 1.0f }
+	};
+
+	Multiply(view, ortho, cascade.ViewProj);
+	Multiply(cascade.ViewProj, toTexture, cascade.ShadowTransform);
+}
+
+#if SHADOW_CASCADES_SSE
+
+void ShadowCascades::TransformCasters()
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (int row = 0; row < 3; ++row)
+	{
+		const float* axis = row == 0 ? mLightX : row == 1 ? mLightY : mLightZ;
+		float* outCenter = row == 0 ? mLightCenterX.data() : row == 1 ? mLightCenterY.data() : mLightCenterZ.data();
+		float* outExtent = row == 0 ? mLightExtentX.data() : row == 1 ? mLightExtentY.data() : mLightExtentZ.data();
+
+		__m128 ax = _mm_set1_ps(axis[0]);
+		__m128 ay = _mm_set1_ps(axis[1]);
+		__m128 az = _mm_set1_ps(axis[2]);
+		__m128 absX = _mm_andnot_ps(signMask, ax);
+		__m128 absY = _mm_andnot_ps(signMask, ay);
+		__m128 absZ = _mm_andnot_ps(signMask, az);
+
+		for (uint32_t i = 0; i < mCasterCount; i += 4)
+		{
+			__m128 c = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_loadu_ps(&mCenterX[i]), ax),
+				_mm_mul_ps(_mm_loadu_ps(&mCenterY[i]), ay)),
+				_mm_mul_ps(_mm_loadu_ps(&mCenterZ[i]), az));
+
+			// Extent of a rotated box along the axis: |axis| . extents.
+			__m128 e = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_loadu_ps(&mExtentX[i]), absX),
+				_mm_mul_ps(_mm_loadu_ps(&mExtentY[i]), absY)),
+				_mm_mul_ps(_mm_loadu_ps(&mExtentZ[i]), absZ));
+
+			_mm_storeu_ps(&outCenter[i], c);
+			_mm_storeu_ps(&outExtent[i], e);
+		}
+	}
+}
+
+void ShadowCascades::Cull(ShadowCascade& cascade)
+{
+	cascade.Casters.clear();
+	cascade.HasDynamicCasters = false;
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 cx = _mm_set1_ps(cascade.Center[0]);
+	const __m128 cy = _mm_set1_ps(cascade.Center[1]);
+	const __m128 r = _mm_set1_ps(cascade.Radius);
+	const __m128 zFar = _mm_set1_ps(cascade.Center[2] + cascade.Radius);
+
+	for (uint32_t i = 0; i < mCasterCount; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(&mLightCenterX[i]), cx)), _mm_loadu_ps(&mLightExtentX[i]));
+		__m128 dy = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(&mLightCenterY[i]), cy)), _mm_loadu_ps(&mLightExtentY[i]));
+		__m128 front = _mm_sub_ps(_mm_loadu_ps(&mLightCenterZ[i]), _mm_loadu_ps(&mLightExtentZ[i]));
+
+		// Overlaps the cascade's square, and starts before its far plane (anything
+		// nearer to the light still casts into it).
+		__m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(dx, r), _mm_cmple_ps(dy, r)), _mm_cmple_ps(front, zFar));
+
+		uint32_t count = std::min<uint32_t>(mCasterCount - i, 4);
+		uint32_t mask = (uint32_t)_mm_movemask_ps(hit) & ((1u << count) - 1);
+		for (uint32_t j = 0; mask != 0; ++j, mask >>= 1)
+		{
+			if (mask & 1)
+			{
+				cascade.Casters.push_back(i + j);
+				if (!mIsStatic[i + j])
+					cascade.HasDynamicCasters = true;
+			}
+		}
+	}
+}
+
+#else
+
+void ShadowCascades::TransformCasters()
+{
+	for (uint32_t i = 0; i < mCasterCount; ++i)
+	{
+		float c[3] = { mCenterX[i], mCenterY[i], mCenterZ[i] };
+		float e[3] = { mExtentX[i], mExtentY[i], mExtentZ[i] };
+		float absX[3] = { std::fabs(mLightX[0]), std::fabs(mLightX[1]), std::fabs(mLightX[2]) };
+		float absY[3] = { std::fabs(mLightY[0]), std::fabs(mLightY[1]), std::fabs(mLightY[2]) };
+		float absZ[3] = { std::fabs(mLightZ[0]), std::fabs(mLightZ[1]), std::fabs(mLightZ[2]) };
+
+		mLightCenterX[i] = Dot3(c, mLightX);
+		mLightCenterY[i] = Dot3(c, mLightY);
+		mLightCenterZ[i] = Dot3(c, mLightZ);
+		mLightExtentX[i] = Dot3(e, absX);
+		mLightExtentY[i] = Dot3(e, absY);
+		mLightExtentZ[i] = Dot3(e, absZ);
+	}
+}
+
+void ShadowCascades::Cull(ShadowCascade& cascade)
+{
+	cascade.Casters.clear();
+	cascade.HasDynamicCasters = false;
+
+	for (uint32_t i = 0; i < mCasterCount; ++i)
+	{
+		if (std::fabs(mLightCenterX[i] - cascade.Center[0]) - mLightExtentX[i] <= cascade.Radius &&
+			std::fabs(mLightCenterY[i] - cascade.Center[1]) - mLightExtentY[i] <= cascade.Radius &&
+			mLightCenterZ[i] - mLightExtentZ[i] <= cascade.Center[2] + cascade.Radius)
+		{
+			cascade.Casters.push_back(i);
+			if (!mIsStatic[i])
+				cascade.HasDynamicCasters = true;
+		}
+	}
+}
+
+#endif
+
+void ShadowCascades::Update(const ShadowCamera& camera, const float lightDirection[3])
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mStats = Stats();
+	mStats.CasterCount = mCasterCount;
+
+	SetLightBasis(lightDirection);
+
+	float nearZ = camera.NearZ;
+	float farZ = std::min<float>(camera.FarZ, mDesc.ShadowDistance);
+
+	float splits[MaxCascades];
+	ComputeSplits(nearZ, farZ, mDesc.CascadeCount, mDesc.Lambda, splits);
+
+	for (uint32_t i = 0; i < mDesc.CascadeCount; ++i)
+	{
+		ShadowCascade& cascade = mCascades[i];
+		cascade.SplitNear = i == 0 ? nearZ : splits[i - 1];
+		cascade.SplitFar = splits[i];
+		Fit(camera, cascade);
+	}
+
+	mStats.FitMs = MillisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+
+	TransformCasters();
+	for (uint32_t i = 0; i < mDesc.CascadeCount; ++i)
+	{
+		Cull(mCascades[i]);
+		mStats.VisibleCasters += (uint32_t)mCascades[i].Casters.size();
+	}
+
+	mStats.CullMs = MillisecondsSince(start);
+
+	for (uint32_t i = 0; i < mDesc.CascadeCount; ++i)
+	{
+		ShadowCascade& cascade = mCascades[i];
+		RenderedState& rendered = mRendered[i];
+
+		bool unchanged = rendered.Valid &&
+			std::equal(cascade.Center, cascade.Center + 3, rendered.Center) &&
+			cascade.Radius == rendered.Radius &&
+			std::equal(mLightZ, mLightZ + 3, rendered.LightZ) &&
+			rendered.StaticVersion == mStaticVersion;
+
+		// A dynamic caster that just left the cascade still has to be erased from it.
+		cascade.NeedsRender = !unchanged || cascade.HasDynamicCasters || rendered.HadDynamicCasters;
+		if (!cascade.NeedsRender)
+			continue;
+
+		rendered.Valid = true;
+		std::copy(cascade.Center, cascade.Center + 3, rendered.Center);
+		rendered.Radius = cascade.Radius;
+		std::copy(mLightZ, mLightZ + 3, rendered.LightZ);
+		rendered.StaticVersion = mStaticVersion;
+		rendered.HadDynamicCasters = cascade.HasDynamicCasters;
+
+		++mStats.RenderedCascades;
+	}
+}
+
+uint32_t ShadowCascades::CascadeCount()const
+{
+	return mDesc.CascadeCount;
+}
+
+const ShadowCascade& ShadowCascades::Cascade(uint32_t index)const
+{
+	assert(index < mDesc.CascadeCount);
+	return mCascades[index];
+}
+
+const ShadowCascades::Stats& ShadowCascades::GetStats()const
+{
+	return mStats;
+}
+
+std::string ShadowCascades::Report()const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"ShadowCascades: %u cascades, %u rendered, %u/%u casters visible (summed over cascades), %.3f ms fitting, %.3f ms culling",
+		mDesc.CascadeCount, mStats.RenderedCascades, mStats.VisibleCasters, mStats.CasterCount, mStats.FitMs, mStats.CullMs);
+
+	return buffer;
+}
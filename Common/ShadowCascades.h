@@ -0,0 +1,151 @@
+//***************************************************************************************
+// ShadowCascades.h
+//
+// CPU side of cascaded shadow maps for one directional light.
+//   -Splits blend a uniform and a logarithmic partition of [near, min(far, distance)]
+//    of the camera (practical split scheme, Lambda = 0 uniform, 1 logarithmic).
+//   -Every cascade is fitted with a bounding sphere of its slice of the camera frustum.
+//    The radius only depends on the lens, and the center is snapped to whole shadow map
+//    texels in light space, so the projection does not shimmer while the camera moves
+//    or turns and stays exactly the same while it is still.
+//   -Shadow casters are boxes. They are brought to light space once per update and
+//    culled against every cascade, four at a time with SSE (scalar fallback elsewhere).
+//    Casters between the light and a cascade are kept: the shadow pass is expected to
+//    clamp their depth instead of clipping it.
+//   -A cascade needs rendering only if its projection changed, a static caster was
+//    moved, or it contains (or contained last time) a dynamic caster; otherwise the
+//    shadow map keeps the depth rendered earlier.
+//   -Matrices are row-major and transform row vectors, like DirectXMath's, so they can
+//    be copied into constant buffers as they are.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShadowCascadeDesc
+{
+	uint32_t CascadeCount = 4;
+	uint32_t Resolution = 2048;
+	float Lambda = 0.8f;
+
+	// Shadows end here, or at the camera's far plane if that is nearer.
+	float ShadowDistance = 80.0f;
+};
+
+// Lens and world-space basis of the viewing camera.
+struct ShadowCamera
+{
+	float Position[3] = { 0.0f, 0.0f, 0.0f };
+	float Right[3] = { 1.0f, 0.0f, 0.0f };
+	float Up[3] = { 0.0f, 1.0f, 0.0f };
+	float Look[3] = { 0.0f, 0.0f, 1.0f };
+
+	float NearZ = 1.0f;
+	float FarZ = 1000.0f;
+	float FovY = 0.785398f;
+	float Aspect = 1.0f;
+};
+
+struct ShadowCascade
+{
+	// View depth range covered by the cascade.
+	float SplitNear = 0.0f;
+	float SplitFar = 0.0f;
+
+	// Snapped center (light space) and radius of the cascade's bounding sphere.
+	float Center[3] = { 0.0f, 0.0f, 0.0f };
+	float Radius = 0.0f;
+
+	// World units per shadow map texel.
+	float TexelSize = 0.0f;
+
+	// World to light clip space, and world to shadow map texture space (u, v, depth).
+	float ViewProj[4][4] = {};
+	float ShadowTransform[4][4] = {};
+
+	// Ids of the casters that may cast into the cascade.
+	std::vector<uint32_t> Casters;
+	bool HasDynamicCasters = false;
+
+	bool NeedsRender = true;
+};
+
+class ShadowCascades
+{
+public:
+	static const uint32_t MaxCascades = 4;
+
+	struct Stats
+	{
+		uint32_t CasterCount = 0;
+		uint32_t VisibleCasters = 0;
+		uint32_t RenderedCascades = 0;
+		double FitMs = 0.0;
+		double CullMs = 0.0;
+	};
+
+	void SetDesc(const ShadowCascadeDesc& desc);
+	const ShadowCascadeDesc& Desc()const;
+
+	// Static casters are expected to stay put; moving one invalidates the cached depth.
+	uint32_t AddCaster(const float center[3], const float extents[3], bool isStatic);
+	void SetCasterBounds(uint32_t id, const float center[3], const float extents[3]);
+
+	// Forces every cascade to be rendered again (e.g. after the shadow map was recreated).
+	void InvalidateCache();
+
+	// lightDirection is the direction the light travels in (need not be normalized).
+	void Update(const ShadowCamera& camera, const float lightDirection[3]);
+
+	uint32_t CascadeCount()const;
+	const ShadowCascade& Cascade(uint32_t index)const;
+
+	const Stats& GetStats()const;
+	std::string Report()const;
+
+	// Far depth of each of count cascades over [nearZ, farZ].
+	static void ComputeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits);
+
+private:
+	void SetLightBasis(const float lightDirection[3]);
+	void Fit(const ShadowCamera& camera, ShadowCascade& cascade)const;
+	void TransformCasters();
+	void Cull(ShadowCascade& cascade);
+
+private:
+	ShadowCascadeDesc mDesc;
+	ShadowCascade mCascades[MaxCascades];
+
+	// Light space axes (rows of the light's view rotation).
+	float mLightX[3] = { 1.0f, 0.0f, 0.0f };
+	float mLightY[3] = { 0.0f, 1.0f, 0.0f };
+	float mLightZ[3] = { 0.0f, 0.0f, 1.0f };
+
+	// Casters as structure of arrays, padded by 3 for four-wide loads.
+	std::vector<float> mCenterX, mCenterY, mCenterZ;
+	std::vector<float> mExtentX, mExtentY, mExtentZ;
+	std::vector<uint8_t> mIsStatic;
+	uint32_t mCasterCount = 0;
+
+	// The same boxes in light space.
+	std::vector<float> mLightCenterX, mLightCenterY, mLightCenterZ;
+	std::vector<float> mLightExtentX, mLightExtentY, mLightExtentZ;
+
+	// What each cascade was last rendered with.
+	struct RenderedState
+	{
+		bool Valid = false;
+		float Center[3] = {};
+		float Radius = 0.0f;
+		float LightZ[3] = {};
+		uint32_t StaticVersion = 0;
+		bool HadDynamicCasters = false;
+	};
+	RenderedState mRendered[MaxCascades];
+	uint32_t mStaticVersion = 0;
+
+	Stats mStats;
+};
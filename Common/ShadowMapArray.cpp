@@ -0,0 +1,105 @@
+//***************************************************************************************
+// ShadowMapArray.cpp
+//***************************************************************************************
+
+#include "ShadowMapArray.h"
+
+ShadowMapArray::ShadowMapArray(ID3D12Device* device, GpuHeapAllocator& allocator, ResourceStateTracker& stateTracker,
+	GpuDescriptorHeap& srvHeap, UINT resolution, UINT sliceCount) :
+	mAllocator(allocator),
+	mStateTracker(stateTracker),
+	mSrvHeap(srvHeap),
+	mResolution(resolution),
+	mSliceCount(sliceCount),
+	mDsvHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, sliceCount)
+{
+	// Typeless, so that the same memory can be viewed as depth (DSV) and as R32 (SRV).
+	CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_TYPELESS,
+		resolution, resolution, (UINT16)sliceCount, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+	D3D12_CLEAR_VALUE clear = {};
+	clear.Format = DepthFormat;
+	clear.DepthStencil.Depth = 1.0f;
+	clear.DepthStencil.Stencil = 0;
+
+	mResource = mAllocator.CreateResource(desc, D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_DEPTH_WRITE, &clear, mAllocation);
+	mStateTracker.Register(mResource.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	mDsvs = mDsvHeap.Allocate(sliceCount);
+	for (UINT i = 0; i < sliceCount; ++i)
+	{
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DepthFormat;
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+		dsvDesc.Texture2DArray.MipSlice = 0;
+		dsvDesc.Texture2DArray.FirstArraySlice = i;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(mResource.Get(), &dsvDesc, Dsv(i));
+	}
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = sliceCount;
+	srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+
+	// Created in a CPU-only heap and copied into the shader-visible one.
+	StagingDescriptorHeap staging(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1);
+	DescriptorHandle stagingSrv = staging.Allocate();
+	device->CreateShaderResourceView(mResource.Get(), &srvDesc, stagingSrv.Cpu);
+
+	mSrv = mSrvHeap.AllocatePersistent();
+	mSrvHeap.StageCopy(mSrv, 0, stagingSrv.Cpu, 1);
+	mSrvHeap.FlushCopies();
+}
+
+ShadowMapArray::~ShadowMapArray()
+{
+	mSrvHeap.FreePersistent(mSrv);
+	mDsvHeap.Free(mDsvs);
+
+	mStateTracker.Unregister(mResource.Get());
+	mResource = nullptr;
+	mAllocator.Free(mAllocation);
+}
+
+ID3D12Resource* ShadowMapArray::Resource()const
+{
+	return mResource.Get();
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE ShadowMapArray::Dsv(UINT slice)const
+{
+	return mDsvHeap.CpuHandle(mDsvs.Index + slice);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE ShadowMapArray::Srv()const
+{
+	return mSrv.Gpu;
+}
+
+D3D12_VIEWPORT ShadowMapArray::Viewport()const
+{
+	return { 0.0f, 0.0f, (float)mResolution, (float)mResolution, 0.0f, 1.0f };
+}
+
+D3D12_RECT ShadowMapArray::ScissorRect()const
+{
+	return { 0, 0, (LONG)mResolution, (LONG)mResolution };
+}
+
+UINT ShadowMapArray::Resolution()const
+{
+	return mResolution;
+}
+
+UINT ShadowMapArray::SliceCount()const
+{
+	return mSliceCount;
+}
@@ -0,0 +1,55 @@
+//***************************************************************************************
+// ShadowMapArray.h
+//
+// Depth texture array holding one shadow map per cascade.
+//   -Placed in the allocator's heaps and registered with the ResourceStateTracker; it
+//    lives across frames, so cascades that do not need rendering keep their depth.
+//   -One DSV per slice (in a CPU-only heap) and one SRV over the whole array, in the
+//    persistent region of the shader-visible heap.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuHeapAllocator.h"
+#include "ResourceStateTracker.h"
+#include "DescriptorAllocator.h"
+
+class ShadowMapArray
+{
+public:
+	ShadowMapArray(ID3D12Device* device, GpuHeapAllocator& allocator, ResourceStateTracker& stateTracker,
+		GpuDescriptorHeap& srvHeap, UINT resolution, UINT sliceCount);
+	ShadowMapArray(const ShadowMapArray& rhs) = delete;
+	ShadowMapArray& operator=(const ShadowMapArray& rhs) = delete;
+
+	// The GPU must be done with the shadow map.
+	~ShadowMapArray();
+
+	ID3D12Resource* Resource()const;
+	D3D12_CPU_DESCRIPTOR_HANDLE Dsv(UINT slice)const;
+	D3D12_GPU_DESCRIPTOR_HANDLE Srv()const;
+
+	D3D12_VIEWPORT Viewport()const;
+	D3D12_RECT ScissorRect()const;
+
+	UINT Resolution()const;
+	UINT SliceCount()const;
+
+	static const DXGI_FORMAT DepthFormat = DXGI_FORMAT_D32_FLOAT;
+
+private:
+	GpuHeapAllocator& mAllocator;
+	ResourceStateTracker& mStateTracker;
+	GpuDescriptorHeap& mSrvHeap;
+
+	UINT mResolution = 0;
+	UINT mSliceCount = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mResource;
+	GpuAllocation mAllocation;
+
+	StagingDescriptorHeap mDsvHeap;
+	DescriptorHandle mDsvs;
+	DescriptorHandle mSrv;
+};
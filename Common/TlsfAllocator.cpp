@@ -0,0 +1,338 @@
+//***************************************************************************************
+// TlsfAllocator.cpp
+//***************************************************************************************
+
+#include "TlsfAllocator.h"
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static uint32_t FloorLog2(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return (uint32_t)index;
+#else
+	return 63u - (uint32_t)__builtin_clzll(value);
+#endif
+}
+
+static uint32_t LowestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(value);
+#endif
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity) :
+	mCapacity(capacity)
+{
+	assert(capacity > 0);
+
+	for (uint32_t fl = 0; fl < FLCount; ++fl)
+		for (uint32_t sl = 0; sl < SLCount; ++sl)
+			mFreeHeads[fl][sl] = InvalidBlock;
+
+	// Initially a single free block spans the whole range.
+	uint32_t index = NewBlock();
+	mBlocks[index].Offset = 0;
+	mBlocks[index].Size = capacity;
+	InsertFreeBlock(index);
+}
+
+void TlsfAllocator::MappingInsert(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < SLCount)
+	{
+		// Small sizes are binned linearly in the first row.
+		fl = 0;
+		sl = (uint32_t)size;
+	}
+	else
+	{
+		uint32_t log2 = FloorLog2(size);
+		sl = (uint32_t)(size >> (log2 - SLLog2)) ^ SLCount;
+		fl = log2 - SLLog2 + 1;
+	}
+}
+
+void TlsfAllocator::MappingSearch(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+	// Round up to the next bin boundary so that any block found in the bin fits.
+	if (size >= SLCount)
+		size += (1ull << (FloorLog2(size) - SLLog2)) - 1;
+
+	MappingInsert(size, fl, sl);
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint32_t fl, uint32_t sl)const
+{
+	if (fl >= FLCount)
+		return InvalidBlock;
+
+	uint32_t slMap = mSLBitmap[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		uint64_t flMap = (fl + 1 < 64) ? (mFLBitmap & (~0ull << (fl + 1))) : 0;
+		if (flMap == 0)
+			return InvalidBlock;
+
+		fl = LowestBit(flMap);
+		slMap = mSLBitmap[fl];
+	}
+
+	sl = LowestBit(slMap);
+	return mFreeHeads[fl][sl];
+}
+
+void TlsfAllocator::InsertFreeBlock(uint32_t index)
+{
+	Block& block = mBlocks[index];
+
+	uint32_t fl, sl;
+	MappingInsert(block.Size, fl, sl);
+
+	block.Free = true;
+	block.PrevFree = InvalidBlock;
+	block.NextFree = mFreeHeads[fl][sl];
+	if (block.NextFree != InvalidBlock)
+		mBlocks[block.NextFree].PrevFree = index;
+
+	mFreeHeads[fl][sl] = index;
+	mFLBitmap |= 1ull << fl;
+	mSLBitmap[fl] |= 1u << sl;
+	++mFreeBlockCount;
+}
+
+void TlsfAllocator::RemoveFreeBlock(uint32_t index)
+{
+	Block& block = mBlocks[index];
+	assert(block.Free);
+
+	uint32_t fl, sl;
+	MappingInsert(block.Size, fl, sl);
+
+	if (block.PrevFree != InvalidBlock)
+		mBlocks[block.PrevFree].NextFree = block.NextFree;
+	if (block.NextFree != InvalidBlock)
+		mBlocks[block.NextFree].PrevFree = block.PrevFree;
+
+	if (mFreeHeads[fl][sl] == index)
+	{
+		mFreeHeads[fl][sl] = block.NextFree;
+		if (block.NextFree == InvalidBlock)
+		{
+			mSLBitmap[fl] &= ~(1u << sl);
+			if (mSLBitmap[fl] == 0)
+				mFLBitmap &= ~(1ull << fl);
+		}
+	}
+
+	block.Free = false;
+	block.PrevFree = InvalidBlock;
+	block.NextFree = InvalidBlock;
+	--mFreeBlockCount;
+}
+
+uint32_t TlsfAllocator::SplitFront(uint32_t index, uint64_t size)
+{
+	uint32_t front = NewBlock();
+
+	Block& block = mBlocks[index];
+	Block& frontBlock = mBlocks[front];
+
+	frontBlock.Offset = block.Offset;
+	frontBlock.Size = size;
+	frontBlock.PrevPhys = block.PrevPhys;
+	frontBlock.NextPhys = index;
+	if (block.PrevPhys != InvalidBlock)
+		mBlocks[block.PrevPhys].NextPhys = front;
+
+	block.Offset += size;
+	block.Size -= size;
+	block.PrevPhys = front;
+
+	return front;
+}
+
+uint32_t TlsfAllocator::SplitBack(uint32_t index, uint64_t size)
+{
+	uint32_t back = NewBlock();
+
+	Block& block = mBlocks[index];
+	Block& backBlock = mBlocks[back];
+
+	block.Size -= size;
+
+	backBlock.Offset = block.Offset + block.Size;
+	backBlock.Size = size;
+	backBlock.PrevPhys = index;
+	backBlock.NextPhys = block.NextPhys;
+	if (block.NextPhys != InvalidBlock)
+		mBlocks[block.NextPhys].PrevPhys = back;
+
+	block.NextPhys = back;
+
+	return back;
+}
+
+void TlsfAllocator::MergeWithNext(uint32_t index)
+{
+	Block& block = mBlocks[index];
+	uint32_t next = block.NextPhys;
+	Block& nextBlock = mBlocks[next];
+
+	block.Size += nextBlock.Size;
+	block.NextPhys = nextBlock.NextPhys;
+	if (nextBlock.NextPhys != InvalidBlock)
+		mBlocks[nextBlock.NextPhys].PrevPhys = index;
+
+	RecycleBlock(next);
+}
+
+uint32_t TlsfAllocator::NewBlock()
+{
+	if (!mUnusedBlocks.empty())
+	{
+		uint32_t index = mUnusedBlocks.back();
+		mUnusedBlocks.pop_back();
+		mBlocks[index] = Block();
+		return index;
+	}
+
+	mBlocks.emplace_back();
+	return (uint32_t)mBlocks.size() - 1;
+}
+
+void TlsfAllocator::RecycleBlock(uint32_t index)
+{
+	mUnusedBlocks.push_back(index);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment > 0);
+
+	Allocation allocation;
+	if (size == 0 || size > mCapacity)
+		return allocation;
+
+	// Look for a block that fits the request even with worst-case alignment padding.
+	uint64_t searchSize = size + alignment - 1;
+	if (searchSize > mCapacity)
+		return allocation;
+
+	uint32_t fl, sl;
+	MappingSearch(searchSize, fl, sl);
+
+	uint32_t index = FindFreeBlock(fl, sl);
+	if (index == InvalidBlock)
+		return allocation;
+
+	RemoveFreeBlock(index);
+
+	// Leading padding goes back to the free lists as a block of its own. Its physical
+	// predecessor cannot be free (free neighbours are always merged).
+	uint64_t padding = AlignUp(mBlocks[index].Offset, alignment) - mBlocks[index].Offset;
+	if (padding > 0)
+	{
+		uint32_t front = SplitFront(index, padding);
+		InsertFreeBlock(front);
+	}
+
+	// Same for the unused tail.
+	if (mBlocks[index].Size > size)
+	{
+		uint32_t back = SplitBack(index, mBlocks[index].Size - size);
+		InsertFreeBlock(back);
+	}
+
+	mUsedSize += mBlocks[index].Size;
+	++mAllocationCount;
+
+	allocation.Offset = mBlocks[index].Offset;
+	allocation.Size = mBlocks[index].Size;
+	allocation.Block = index;
+	return allocation;
+}
+
+void TlsfAllocator::Free(const Allocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	uint32_t index = allocation.Block;
+	assert(index < mBlocks.size() && !mBlocks[index].Free);
+	assert(mBlocks[index].Offset == allocation.Offset);
+
+	mUsedSize -= mBlocks[index].Size;
+	--mAllocationCount;
+
+	// Coalesce with the free physical neighbours.
+	uint32_t prev = mBlocks[index].PrevPhys;
+	if (prev != InvalidBlock && mBlocks[prev].Free)
+	{
+		RemoveFreeBlock(prev);
+		MergeWithNext(prev);
+		index = prev;
+	}
+
+	uint32_t next = mBlocks[index].NextPhys;
+	if (next != InvalidBlock && mBlocks[next].Free)
+	{
+		RemoveFreeBlock(next);
+		MergeWithNext(index);
+	}
+
+	InsertFreeBlock(index);
+}
+
+TlsfAllocator::Stats TlsfAllocator::GetStats()const
+{
+	Stats stats;
+	stats.Capacity = mCapacity;
+	stats.UsedSize = mUsedSize;
+	stats.AllocationCount = mAllocationCount;
+	stats.FreeBlockCount = mFreeBlockCount;
+
+	// The largest free block lives in the highest non-empty bin.
+	if (mFLBitmap != 0)
+	{
+		uint32_t fl = FloorLog2(mFLBitmap);
+		uint32_t sl = FloorLog2(mSLBitmap[fl]);
+		for (uint32_t i = mFreeHeads[fl][sl]; i != InvalidBlock; i = mBlocks[i].NextFree)
+		{
+			if (mBlocks[i].Size > stats.LargestFreeBlock)
+				stats.LargestFreeBlock = mBlocks[i].Size;
+		}
+	}
+
+	return stats;
+}
+
+uint64_t TlsfAllocator::Capacity()const
+{
+	return mCapacity;
+}
+
+uint64_t TlsfAllocator::UsedSize()const
+{
+	return mUsedSize;
+}
+
+bool TlsfAllocator::IsEmpty()const
+{
+	return mAllocationCount == 0;
+}
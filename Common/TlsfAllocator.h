@@ -0,0 +1,98 @@
+//***************************************************************************************
+// TlsfAllocator.h
+//
+// Two-Level Segregated Fit allocator over an abstract range [0, capacity).
+//   -Free blocks are binned by size in a two-level table (power of two, then 32 linear
+//    subdivisions); two bitmaps make finding a fitting bin O(1).
+//   -Adjacent free blocks are merged on Free, so the allocator never needs an explicit
+//    defragmentation pass.
+//   -It only deals with offsets: the same core places resources in ID3D12Heap blocks,
+//    sub-ranges in a big buffer or descriptor ranges in a heap, and it builds on any
+//    platform so that it can be measured with synthetic allocation traces.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class TlsfAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+	static const uint32_t InvalidBlock = ~0u;
+
+	struct Allocation
+	{
+		uint64_t Offset = InvalidOffset;
+		uint64_t Size = 0;
+		uint32_t Block = InvalidBlock;
+
+		bool IsValid()const { return Block != InvalidBlock; }
+	};
+
+	struct Stats
+	{
+		uint64_t Capacity = 0;
+		uint64_t UsedSize = 0;
+		uint64_t LargestFreeBlock = 0;
+		uint32_t AllocationCount = 0;
+		uint32_t FreeBlockCount = 0;
+	};
+
+	explicit TlsfAllocator(uint64_t capacity);
+
+	// Returns an invalid allocation when no free block is large enough.
+	Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+	void Free(const Allocation& allocation);
+
+	Stats GetStats()const;
+
+	uint64_t Capacity()const;
+	uint64_t UsedSize()const;
+	bool IsEmpty()const;
+
+private:
+	static const uint32_t SLLog2 = 5;
+	static const uint32_t SLCount = 1u << SLLog2;
+	static const uint32_t FLCount = 64 - SLLog2 + 1;
+
+	struct Block
+	{
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+		uint32_t PrevPhys = InvalidBlock;
+		uint32_t NextPhys = InvalidBlock;
+		uint32_t PrevFree = InvalidBlock;
+		uint32_t NextFree = InvalidBlock;
+		bool Free = false;
+	};
+
+	static void MappingInsert(uint64_t size, uint32_t& fl, uint32_t& sl);
+	static void MappingSearch(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+	uint32_t FindFreeBlock(uint32_t fl, uint32_t sl)const;
+	void InsertFreeBlock(uint32_t index);
+	void RemoveFreeBlock(uint32_t index);
+
+	// Carves a new block of the given size out of the front/back of an existing one.
+	uint32_t SplitFront(uint32_t index, uint64_t size);
+	uint32_t SplitBack(uint32_t index, uint64_t size);
+	void MergeWithNext(uint32_t index);
+
+	uint32_t NewBlock();
+	void RecycleBlock(uint32_t index);
+
+private:
+	std::vector<Block> mBlocks;
+	std::vector<uint32_t> mUnusedBlocks;
+
+	uint64_t mFLBitmap = 0;
+	uint32_t mSLBitmap[FLCount] = {};
+	uint32_t mFreeHeads[FLCount][SLCount];
+
+	uint64_t mCapacity = 0;
+	uint64_t mUsedSize = 0;
+	uint32_t mAllocationCount = 0;
+	uint32_t mFreeBlockCount = 0;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "GpuHeapAllocator.h"
 
 template<typename T>
 class UploadBuffer
@@ -49,6 +50,23 @@ public:
         ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
     }
 
+    // Come sopra ma il buffer viene collocato (placed resource) in un heap di upload
+    // condiviso gestito dall'allocatore, invece di avere un heap implicito tutto suo.
+    UploadBuffer(GpuHeapAllocator& allocator, UINT elementCount, bool isConstantBuffer) :
+        mIsConstantBuffer(isConstantBuffer),
+        mAllocator(&allocator)
+    {
+        mElementByteSize = sizeof(T);
+        if(isConstantBuffer)
+            mElementByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
+
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)mElementByteSize*elementCount);
+        mUploadBuffer = allocator.CreateResource(bufferDesc, D3D12_HEAP_TYPE_UPLOAD,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, mAllocation);
+
+        ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+    }
+
     UploadBuffer(const UploadBuffer& rhs) = delete;
     UploadBuffer& operator=(const UploadBuffer& rhs) = delete;
     ~UploadBuffer()
@@ -57,6 +75,11 @@ public:
             mUploadBuffer->Unmap(0, nullptr);
 
         mMappedData = nullptr;
+
+        // Lo spazio nell'heap condiviso si pu restituire solo dopo aver rilasciato la risorsa.
+        mUploadBuffer = nullptr;
+        if(mAllocator != nullptr)
+            mAllocator->Free(mAllocation);
     }
 
     ID3D12Resource* Resource()const
@@ -69,10 +92,28 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Sovrascrive solo byteSize byte di un elemento, a partire da byteOffset: serve a
+    // correggere una parte dei dati gi scritti (es. la camera nel late latch).
+    void CopyData(int elementIndex, UINT byteOffset, const void* data, UINT byteSize)
+    {
+        assert(byteOffset + byteSize <= sizeof(T));
+        memcpy(&mMappedData[elementIndex*mElementByteSize + byteOffset], data, byteSize);
+    }
+
+    // Copia pi elementi con un'unica memcpy (solo buffer non costanti, senza padding).
+    void CopyData(int firstElement, const T* data, UINT elementCount)
+    {
+        assert(!mIsConstantBuffer);
+        memcpy(&mMappedData[firstElement*mElementByteSize], data, sizeof(T)*elementCount);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
     bool mIsConstantBuffer = false;
+
+    GpuHeapAllocator* mAllocator = nullptr;
+    GpuAllocation mAllocation;
 };
\ No newline at end of file
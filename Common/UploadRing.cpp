@@ -0,0 +1,135 @@
+//***************************************************************************************
+// UploadRing.cpp
+//***************************************************************************************
+
+#include "UploadRing.h"
+
+using Microsoft::WRL::ComPtr;
+
+UploadRing::UploadRing(ID3D12Device* device, ID3D12Fence* fence, UINT64 byteSize,
+	DeferredReleaseQueue* deferredReleases) :
+	mDevice(device),
+	mFence(fence),
+	mDeferredReleases(deferredReleases),
+	mRing(byteSize)
+{
+	CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mUploadBuffer)));
+
+	// Keep the buffer mapped for the whole lifetime of the ring; D3D12 does not require
+	// Unmap before the GPU reads from an upload heap.
+	ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+	mGpuAddress = mUploadBuffer->GetGPUVirtualAddress();
+}
+
+UploadRing::~UploadRing()
+{
+	if (mUploadBuffer != nullptr)
+		mUploadBuffer->Unmap(0, nullptr);
+
+	mMappedData = nullptr;
+}
+
+UploadAllocation UploadRing::Allocate(UINT64 byteSize, UINT64 alignment)
+{
+	// Would never fit, no matter how many frames retire.
+	if (byteSize > mRing.Capacity() && mDeferredReleases != nullptr)
+		return AllocateDedicated(byteSize);
+
+	UINT64 offset = mRing.Allocate(byteSize, alignment);
+
+	// Ring full: wait for the oldest submitted frame and try again.
+	while (offset == RingBufferAllocator::InvalidOffset && mRing.HasPendingFrames())
+	{
+		UINT64 oldestFence = mRing.OldestPendingFence();
+		if (mFence->GetCompletedValue() < oldestFence)
+		{
+			HANDLE eventHandle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+			ThrowIfFailed(mFence->SetEventOnCompletion(oldestFence, eventHandle));
+			WaitForSingleObject(eventHandle, INFINITE);
+			CloseHandle(eventHandle);
+		}
+
+		mRing.ReleaseCompletedFrames(mFence->GetCompletedValue());
+		offset = mRing.Allocate(byteSize, alignment);
+	}
+
+	if (offset == RingBufferAllocator::InvalidOffset)
+		throw DxException(E_OUTOFMEMORY, L"UploadRing::Allocate", AnsiToWString(__FILE__), __LINE__);
+
+	UploadAllocation alloc;
+	alloc.Resource = mUploadBuffer.Get();
+	alloc.Offset = offset;
+	alloc.CpuAddress = mMappedData + offset;
+	alloc.GpuAddress = mGpuAddress + offset;
+
+	return alloc;
+}
+
+UploadAllocation UploadRing::AllocateDedicated(UINT64 byteSize)
+{
+	ComPtr<ID3D12Resource> uploadBuffer;
+
+	CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&uploadBuffer)));
+
+	UploadAllocation alloc;
+	alloc.Resource = uploadBuffer.Get();
+	alloc.Offset = 0;
+	ThrowIfFailed(uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&alloc.CpuAddress)));
+	alloc.GpuAddress = uploadBuffer->GetGPUVirtualAddress();
+
+	// The queue holds the only reference: the buffer is released (and implicitly
+	// unmapped) once the frame that records the copy has retired.
+	mDeferredReleases->Enqueue(uploadBuffer);
+	++mDedicatedAllocationCount;
+
+	return alloc;
+}
+
+void UploadRing::FinishFrame(UINT64 fenceValue)
+{
+	mRing.FinishFrame(fenceValue);
+}
+
+void UploadRing::ReleaseCompleted(UINT64 completedFenceValue)
+{
+	mRing.ReleaseCompletedFrames(completedFenceValue);
+}
+
+ID3D12Resource* UploadRing::Resource()const
+{
+	return mUploadBuffer.Get();
+}
+
+UINT64 UploadRing::Capacity()const
+{
+	return mRing.Capacity();
+}
+
+UINT64 UploadRing::UsedSize()const
+{
+	return mRing.UsedSize();
+}
+
+UINT UploadRing::DedicatedAllocationCount()const
+{
+	return mDedicatedAllocationCount;
+}
+
@@ -0,0 +1,71 @@
+//***************************************************************************************
+// UploadRing.h
+//
+// One large, persistently mapped buffer on the upload heap from which all the staging
+// memory for buffer and texture initialization is sub-allocated.
+//   -Allocations are placed in a RingBufferAllocator and retired by fence, so the
+//    total amount of staging memory stays bounded by the ring capacity.
+//   -No resource is created per upload: thousands of small uploads cost a memcpy and
+//    a copy command each, not a driver allocation.
+//   -A request larger than the whole ring gets a dedicated upload buffer which is
+//    handed to a DeferredReleaseQueue and dropped once its copy has retired.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "RingBufferAllocator.h"
+#include "DeferredReleaseQueue.h"
+
+struct UploadAllocation
+{
+	ID3D12Resource* Resource = nullptr;
+	UINT64 Offset = 0;
+	BYTE* CpuAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+};
+
+class UploadRing
+{
+public:
+	// The fence is the one the command queue signals at the end of every frame; it is
+	// used to wait for old frames to retire when the ring is full.
+	UploadRing(ID3D12Device* device, ID3D12Fence* fence, UINT64 byteSize,
+		DeferredReleaseQueue* deferredReleases = nullptr);
+	UploadRing(const UploadRing& rhs) = delete;
+	UploadRing& operator=(const UploadRing& rhs) = delete;
+	~UploadRing();
+
+	// Throws if the request cannot fit even after every submitted frame has retired
+	// (i.e. the allocations of the frame being recorded already fill the ring).
+	// Requests larger than the ring are served by a dedicated buffer when a
+	// DeferredReleaseQueue was provided.
+	UploadAllocation Allocate(UINT64 byteSize, UINT64 alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	// Call once the commands referencing the current allocations have been submitted
+	// and fenceValue has been signaled on the queue.
+	void FinishFrame(UINT64 fenceValue);
+	void ReleaseCompleted(UINT64 completedFenceValue);
+
+	ID3D12Resource* Resource()const;
+	UINT64 Capacity()const;
+	UINT64 UsedSize()const;
+
+	// Number of uploads that did not fit the ring and got their own buffer.
+	UINT DedicatedAllocationCount()const;
+
+private:
+	UploadAllocation AllocateDedicated(UINT64 byteSize);
+
+private:
+	ID3D12Device* mDevice = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+	BYTE* mMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS mGpuAddress = 0;
+
+	ID3D12Fence* mFence = nullptr;
+	DeferredReleaseQueue* mDeferredReleases = nullptr;
+	UINT mDedicatedAllocationCount = 0;
+
+	RingBufferAllocator mRing;
+};
@@ -4,6 +4,7 @@
 
 #include "d3dApp.h"
 #include <WindowsX.h>
+#include <psapi.h>
 
 using Microsoft::WRL::ComPtr;
 using namespace std;
@@ -17,6 +18,22 @@ MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return D3DApp::GetApp()->MsgProc(hwnd, msg, wParam, lParam);
 }
 
+// Bit di InputSystem del pulsante a cui si riferisce un messaggio WM_*BUTTONDOWN/UP.
+static uint32_t MouseButton(UINT msg)
+{
+	switch(msg)
+	{
+	case WM_LBUTTONDOWN:
+	case WM_LBUTTONUP:
+		return InputSystem::MouseLeft;
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONUP:
+		return InputSystem::MouseRight;
+	default:
+		return InputSystem::MouseMiddle;
+	}
+}
+
 D3DApp* D3DApp::mApp = nullptr;
 D3DApp* D3DApp::GetApp()
 {
@@ -171,8 +188,13 @@ void D3DApp::OnResize()
 	// mSwapChainBuffer  un array che contiene i back buffer dello swapchain.
 	// mDepthStencilBuffer conserva il depth-stencil buffer.
 	for (int i = 0; i < SwapChainBufferCount; ++i)
+	{
+		mStateTracker.Unregister(mSwapChainBuffer[i].Get());
 		mSwapChainBuffer[i].Reset();
+	}
+	mStateTracker.Unregister(mDepthStencilBuffer.Get());
     mDepthStencilBuffer.Reset();
+	mGpuHeapAllocator->Free(mDepthStencilAllocation);
 	
 	// Per lo swapchain  sufficiente ridimensionare tutti i buffer in un colpo solo con ResizeBuffers.
     ThrowIfFailed(mSwapChain->ResizeBuffers(
@@ -198,6 +220,7 @@ void D3DApp::OnResize()
 	for (UINT i = 0; i < SwapChainBufferCount; i++)
 	{
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
+		mStateTracker.Register(mSwapChainBuffer[i].Get(), D3D12_RESOURCE_STATE_PRESENT);
 		md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
 		rtvHeapHandle.Offset(1, mRtvDescriptorSize);
 	}
@@ -236,14 +259,10 @@ void D3DApp::OnResize()
 	// Lo fa su heap di default in quanto CPU non ha necessit di accedere a tale risorsa.
 	// Lo stato iniziale indicato  COMMON, che  quello comunemente specificato quando si 
 	// crea una texture, prima che venga utilizzata.
-	// Usa wrapper CD3DX12 per evitare di dover creare D3D12_HEAP_PROPERTIES esplicitamente.
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-        &depthStencilDesc,
-		D3D12_RESOURCE_STATE_COMMON,
-        &optClear,
-        IID_PPV_ARGS(mDepthStencilBuffer.GetAddressOf())));
+	// La risorsa viene collocata in un heap per render target/depth-stencil condiviso:
+	// ad ogni resize lo spazio del buffer precedente viene riusato senza creare un nuovo heap.
+	mDepthStencilBuffer = mGpuHeapAllocator->CreateResource(depthStencilDesc, D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COMMON, &optClear, mDepthStencilAllocation);
 
 	// Crea una DSV/descriptor per il livello mipmap 0 (l'unico presente) della texture che 
 	// rappresenta il depth-stencil buffer.
@@ -259,10 +278,11 @@ void D3DApp::OnResize()
 
 	// Cambia stato da COMMON a DEPTH_WRITE, che indica lo stato di una risorsa che verra usata
 	// come depth-stencil buffer.
-	// Usa wrapper CD3DX12 per poter usare la funzione di supporto Transition, che evita di creare
-	// esplicitamente un oggetto D3D12_RESOURCE_BARRIER al solo fine di impostarne i campi.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthStencilBuffer.Get(),
-		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+	// Il tracker conosce lo stato corrente della risorsa, quindi basta indicare quello
+	// richiesto; la barriera viene emessa da FlushBarriers.
+	mStateTracker.Register(mDepthStencilBuffer.Get(), D3D12_RESOURCE_STATE_COMMON);
+	mStateTracker.Transition(mDepthStencilBuffer.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+	mStateTracker.FlushBarriers(mCommandList.Get());
 	
 	// La transizione di stato nelle risorse avviene su timeline della GPU quindi  necessario
 	// inviare il comando alla coda (inviando cio la command list che lo contiene).
@@ -311,6 +331,9 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		{
 			mAppPaused = true;
 			mTimer.Stop();
+
+			// I rilasci dei tasti arriverebbero ad un'altra finestra.
+			mInput.PushReleaseAll(InputSystem::Now());
 		}
 		else
 		{
@@ -412,17 +435,31 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	case WM_LBUTTONDOWN:
 	case WM_MBUTTONDOWN:
 	case WM_RBUTTONDOWN:
+		mInput.PushButton(MouseButton(msg), true, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), InputSystem::Now());
 		OnMouseDown(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 	case WM_LBUTTONUP:
 	case WM_MBUTTONUP:
 	case WM_RBUTTONUP:
+		mInput.PushButton(MouseButton(msg), false, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), InputSystem::Now());
 		OnMouseUp(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 	case WM_MOUSEMOVE:
+		mInput.PushMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), InputSystem::Now());
 		OnMouseMove(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
+	case WM_MOUSEWHEEL:
+		// Le rotelle ad alta risoluzione inviano frazioni di WHEEL_DELTA.
+		mInput.PushWheel((float)GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA, InputSystem::Now());
+		return 0;
+	case WM_KEYDOWN:
+		// Le ripetizioni automatiche (bit 30 di lParam) non sono nuove pressioni.
+		if((lParam & (1 << 30)) == 0)
+			mInput.PushKey((uint32_t)wParam, true, InputSystem::Now());
+		return 0;
     case WM_KEYUP:
+        mInput.PushKey((uint32_t)wParam, false, InputSystem::Now());
+
         if(wParam == VK_ESCAPE)
         {
             PostQuitMessage(0);
@@ -546,6 +583,8 @@ bool D3DApp::InitDirect3D()
     LogAdapters();
 #endif
 
+	mGpuHeapAllocator = std::make_unique<GpuHeapAllocator>(md3dDevice.Get());
+
 	CreateCommandObjects();
     CreateSwapChain();
     CreateRtvAndDsvDescriptorHeaps();
@@ -687,15 +726,22 @@ void D3DApp::CalculateFrameStats()
         wstring fpsStr = to_wstring(fps);
         wstring mspfStr = to_wstring(mspf);
 
+        // Barriere emesse per frame (e transizioni inutili scartate dal tracker).
+        wstring barriersStr = to_wstring(mStateTracker.BarrierCount() / frameCnt);
+        wstring skippedStr = to_wstring(mStateTracker.SkippedCount() / frameCnt);
+
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            L"   barriers/frame: " + barriersStr +
+            L" (skipped " + skippedStr + L")";
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
 		// Reset for next average.
 		frameCnt = 0;
 		timeElapsed += 1.0f;
+		mStateTracker.ResetStats();
 	}
 }
 
@@ -749,6 +795,34 @@ void D3DApp::LogAdapterOutputs(IDXGIAdapter* adapter)
     }
 }
 
+void D3DApp::LogMemoryUsage(const std::wstring& label)
+{
+    PROCESS_MEMORY_COUNTERS processMem = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &processMem, sizeof(processMem));
+
+    DXGI_QUERY_VIDEO_MEMORY_INFO localMem = {};
+    DXGI_QUERY_VIDEO_MEMORY_INFO nonLocalMem = {};
+
+    ComPtr<IDXGIAdapter3> adapter;
+    if(SUCCEEDED(mdxgiFactory->EnumAdapterByLuid(md3dDevice->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+    {
+        adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &localMem);
+        adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &nonLocalMem);
+    }
+
+    const double toMB = 1.0 / (1024.0 * 1024.0);
+    std::wstring text =
+        L"***Memory (" + label + L"): " +
+        L"WorkingSet = " + std::to_wstring(processMem.WorkingSetSize * toMB) + L" MB, " +
+        L"VideoLocal = " + std::to_wstring(localMem.CurrentUsage * toMB) + L" MB, " +
+        L"VideoNonLocal = " + std::to_wstring(nonLocalMem.CurrentUsage * toMB) + L" MB\n";
+
+    OutputDebugString(text.c_str());
+
+    if(mGpuHeapAllocator != nullptr)
+        mGpuHeapAllocator->LogStats();
+}
+
 void D3DApp::LogOutputDisplayModes(IDXGIOutput* output, DXGI_FORMAT format)
 {
     UINT count = 0;
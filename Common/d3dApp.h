@@ -11,6 +11,9 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "InputSystem.h"
+#include "GpuHeapAllocator.h"
+#include "ResourceStateTracker.h"
 
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
@@ -72,6 +75,10 @@ protected:
     void LogAdapterOutputs(IDXGIAdapter* adapter);
     void LogOutputDisplayModes(IDXGIOutput* output, DXGI_FORMAT format);
 
+    // Writes the process working set and the video memory used by the application
+    // (local = VRAM, non-local = system memory visible to the GPU, e.g. upload heaps).
+    void LogMemoryUsage(const std::wstring& label);
+
 protected:
 
     static D3DApp* mApp;
@@ -90,11 +97,21 @@ protected:
 
 	// Used to keep track of the delta-time and game time (4.4).
 	GameTimer mTimer;
+
+	// Keyboard and mouse messages are queued here with a timestamp; the derived
+	// class consumes them once per frame with mInput.Update.
+	InputSystem mInput;
 	
     Microsoft::WRL::ComPtr<IDXGIFactory4> mdxgiFactory;
     Microsoft::WRL::ComPtr<IDXGISwapChain> mSwapChain;
     Microsoft::WRL::ComPtr<ID3D12Device> md3dDevice;
 
+    // Heaps in which buffers and textures are placed (instead of committed resources).
+    std::unique_ptr<GpuHeapAllocator> mGpuHeapAllocator;
+
+    // Current state of the tracked resources; barriers are batched through it.
+    ResourceStateTracker mStateTracker;
+
     Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
     UINT64 mCurrentFence = 0;
 	
@@ -106,6 +123,7 @@ protected:
 	int mCurrBackBuffer = 0;
     Microsoft::WRL::ComPtr<ID3D12Resource> mSwapChainBuffer[SwapChainBufferCount];
     Microsoft::WRL::ComPtr<ID3D12Resource> mDepthStencilBuffer;
+    GpuAllocation mDepthStencilAllocation;
 
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mDsvHeap;
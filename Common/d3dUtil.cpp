@@ -1,5 +1,9 @@
 
 #include "d3dUtil.h"
+#include "UploadRing.h"
+#include "BufferPool.h"
+#include "ResourceStateTracker.h"
+#include "ShaderCache.h"
 #include <comdef.h>
 #include <fstream>
 
@@ -102,6 +106,59 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     return defaultBuffer;
 }
 
+void d3dUtil::UploadTexture(
+    ID3D12GraphicsCommandList* cmdList,
+    ID3D12Resource* texture,
+    const std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+    UploadRing& uploadRing,
+    ResourceStateTracker& stateTracker)
+{
+    const UINT numSubresources = (UINT)subresources.size();
+    const UINT64 uploadSize = GetRequiredIntermediateSize(texture, 0, numSubresources);
+
+    // Le footprint delle sottorisorse devono partire da un offset multiplo di 512 byte.
+    UploadAllocation staging = uploadRing.Allocate(uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+    // La barriera verso COPY_DEST parte insieme a quelle lasciate in sospeso dagli
+    // upload precedenti (una sola ResourceBarrier per tutte).
+    stateTracker.Register(texture, D3D12_RESOURCE_STATE_COMMON);
+    stateTracker.Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST);
+    stateTracker.FlushBarriers(cmdList);
+
+    UpdateSubresources(cmdList, texture, staging.Resource, staging.Offset, 0, numSubresources,
+        const_cast<D3D12_SUBRESOURCE_DATA*>(subresources.data()));
+
+    stateTracker.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
+BufferRange d3dUtil::CreateDefaultBuffer(
+    ID3D12GraphicsCommandList* cmdList,
+    const void* initData,
+    UINT64 byteSize,
+    BufferPool& bufferPool,
+    UploadRing& uploadRing,
+    ResourceStateTracker& stateTracker)
+{
+    BufferRange range = bufferPool.Allocate(byteSize);
+
+    UploadAllocation staging = uploadRing.Allocate(byteSize, 16);
+    memcpy(staging.CpuAddress, initData, (size_t)byteSize);
+
+    // Le transizioni riguardano l'intera risorsa del pool: gli altri intervalli non
+    // possono essere letti dalla GPU tra le due barriere. Se la copia precedente nello
+    // stesso pool ha lasciato in sospeso il ritorno a GENERIC_READ, le due transizioni
+    // si annullano e non viene emessa alcuna barriera.
+    stateTracker.Transition(range.Resource, D3D12_RESOURCE_STATE_COPY_DEST);
+    stateTracker.FlushBarriers(cmdList);
+
+    cmdList->CopyBufferRegion(range.Resource, range.Offset, staging.Resource, staging.Offset, byteSize);
+
+    stateTracker.Transition(range.Resource, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    return range;
+}
+
+
 ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
@@ -128,6 +185,42 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	return byteCode;
 }
 
+UINT d3dUtil::ShaderCompileFlags()
+{
+#if defined(DEBUG) || defined(_DEBUG)  
+	return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	return D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+}
+
+std::vector<uint8_t> d3dUtil::CompileShaderBytecode(
+	const std::wstring& filename,
+	const std::vector<ShaderDefine>& defines,
+	const std::string& entrypoint,
+	const std::string& target,
+	uint32_t flags)
+{
+	// Lista di macro terminata da una coppia di nullptr, come richiesto dal compilatore.
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine& d : defines)
+		macros.push_back({ d.Name.c_str(), d.Value.c_str() });
+	macros.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> byteCode = nullptr;
+	ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompileFromFile(filename.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		entrypoint.c_str(), target.c_str(), flags, 0, &byteCode, &errors);
+
+	if(errors != nullptr)
+		OutputDebugStringA((char*)errors->GetBufferPointer());
+
+	ThrowIfFailed(hr);
+
+	const uint8_t* bytes = (const uint8_t*)byteCode->GetBufferPointer();
+	return std::vector<uint8_t>(bytes, bytes + byteCode->GetBufferSize());
+}
+
 std::wstring DxException::ToString()const
 {
     // Get the string description of the error code.
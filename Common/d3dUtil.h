@@ -31,6 +31,12 @@
 
 extern const int gNumFrameResources;
 
+class UploadRing;
+class BufferPool;
+struct BufferRange;
+class ResourceStateTracker;
+struct ShaderDefine;
+
 inline void d3dSetDebugName(IDXGIObject* obj, const char* name)
 {
     if(obj)
@@ -122,11 +128,44 @@ public:
         UINT64 byteSize,
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+    // Copia le sottorisorse di una texture (creata nello stato COMMON) passando per il ring
+    // di upload e la lascia nello stato PIXEL_SHADER_RESOURCE (alla prossima FlushBarriers).
+    static void UploadTexture(
+        ID3D12GraphicsCommandList* cmdList,
+        ID3D12Resource* texture,
+        const std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+        UploadRing& uploadRing,
+        ResourceStateTracker& stateTracker);
+
+    // Il buffer non  una risorsa a s ma un intervallo sub-allocato da un BufferPool
+    // (una sola risorsa condivisa da molti buffer piccoli); i dati arrivano tramite il
+    // ring di upload. La risorsa del pool (registrata nel tracker) torna nello stato
+    // GENERIC_READ: copie consecutive nello stesso pool non generano barriere intermedie.
+    static BufferRange CreateDefaultBuffer(
+        ID3D12GraphicsCommandList* cmdList,
+        const void* initData,
+        UINT64 byteSize,
+        BufferPool& bufferPool,
+        UploadRing& uploadRing,
+        ResourceStateTracker& stateTracker);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+
+	// Flag di compilazione predefiniti: debug senza ottimizzazioni, release al livello 3.
+	static UINT ShaderCompileFlags();
+
+	// Come CompileShader, ma con flag espliciti e bytecode restituito come array di byte:
+	//  il compilatore che ShaderCache usa quando un blob non  in cache.
+	static std::vector<uint8_t> CompileShaderBytecode(
+		const std::wstring& filename,
+		const std::vector<ShaderDefine>& defines,
+		const std::string& entrypoint,
+		const std::string& target,
+		uint32_t flags);
 };
 
 class DxException
@@ -169,6 +208,8 @@ struct MeshGeometry
     // conservare codice oggetto durante compilazione di shader ma anche come buffer di 
     // dati tipizzati: ad esempio vertex o index buffer costruiti dall'applicazione. 
     // Poi sta al programmatore effettuare i cast opportuni.
+    // Vengono riempite solo se una funzionalit lato CPU (ad es. il picking) le richiede,
+    // altrimenti restano nullptr per non duplicare in memoria di sistema tutta la geometria.
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU  = nullptr;
 
@@ -176,9 +217,10 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
 
-    // Riferimenti a risorse GPU (vertex ed index buffer intermedi, cio su heap di upload)
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
+    // Posizione dei dati all'interno delle risorse: diversa da 0 quando vertex ed index
+    // buffer sono sub-allocati da un BufferPool condiviso.
+	UINT64 VertexBufferOffset = 0;
+	UINT64 IndexBufferOffset = 0;
 
     // Info utili riguardo vertex ed index buffer che contengono e descrivono la geometria.
 	UINT VertexByteStride = 0;
@@ -195,7 +237,7 @@ struct MeshGeometry
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
+		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress() + VertexBufferOffset;
 		vbv.StrideInBytes = VertexByteStride;
 		vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -206,19 +248,12 @@ struct MeshGeometry
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
+		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress() + IndexBufferOffset;
 		ibv.Format = IndexFormat;
 		ibv.SizeInBytes = IndexBufferByteSize;
 
 		return ibv;
 	}
-
-    // Elimina riferimenti alle risorse intermedie.
-	void DisposeUploaders()
-	{
-		VertexBufferUploader = nullptr;
-		IndexBufferUploader = nullptr;
-	}
 };
 
 struct Light
@@ -281,6 +316,10 @@ struct Material
 	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
 	float Roughness = .25f;
 	DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Parte della chiave di permutazione dello shader richiesta dal materiale
+	// (es. ALPHA_TEST); viene combinata con quella del pass.
+	UINT ShaderFeatures = 0;
 };
 
 struct Texture
@@ -291,11 +330,11 @@ struct Texture
     // Percorso del file DDS
 	std::wstring Filename;
 
-    // Risorsa intermedia (in upload heap) in cui caricare i dati dal file DDS.
-    Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap = nullptr;
-
     // Risorsa (in default heap) in cui copiare i dati da risorsa intermedia.
 	Microsoft::WRL::ComPtr<ID3D12Resource> Resource = nullptr;
+
+    // Indice dell'SRV della texture nella regione persistente dell'heap shader-visible.
+	UINT SrvHeapIndex = 0;
 };
 
 #ifndef ThrowIfFailed
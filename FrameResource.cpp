@@ -1,15 +1,22 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, GpuHeapAllocator& allocator, UINT passCount, UINT objectCount, UINT materialCount,
+    UINT clusterCount, UINT clusteredLightCount, UINT clusterLightIndexCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
   //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    // The constant buffers of all the frame resources share the allocator's upload heaps.
+    PassCB = std::make_unique<UploadBuffer<PassConstants>>(allocator, passCount, true);
+    LightingCB = std::make_unique<UploadBuffer<LightingConstants>>(allocator, 1, true);
+    MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(allocator, materialCount, true);
+    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(allocator, objectCount, true);
+
+    ClusteredLights = std::make_unique<UploadBuffer<Light>>(allocator, std::max<UINT>(clusteredLightCount, 1), false);
+    ClusterRanges = std::make_unique<UploadBuffer<ClusterRange>>(allocator, std::max<UINT>(clusterCount, 1), false);
+    ClusterLightIndices = std::make_unique<UploadBuffer<UINT>>(allocator, std::max<UINT>(clusterLightIndexCount, 1), false);
 
     //WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
 }
@@ -3,6 +3,7 @@
 #include "Common/d3dUtil.h"
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
+#include "Common/LightClusters.h"
 
 struct ObjectConstants
 {
@@ -27,8 +28,38 @@ struct PassConstants
     float TotalTime = 0.0f;
     float DeltaTime = 0.0f;
 
+    // Light clusters, only read by CLUSTERED_LIGHTS variants: a pixel belongs to tile
+    // PosH.xy * ClusterTileScale and slice log2(viewZ) * ClusterDepthScale + ClusterDepthBias.
+    DirectX::XMUINT3 ClusterCount = { 1, 1, 1 };
+    float ClusterDepthScale = 0.0f;
+    DirectX::XMFLOAT2 ClusterTileScale = { 0.0f, 0.0f };
+    float ClusterDepthBias = 0.0f;
+    float cbPerObjectPad2 = 0.0f;
+
+    // Cascaded shadow map of Lights[0], only read by SHADOWS variants: cascade i covers view
+    // depths up to CascadeSplits[i] and ShadowTransform[i] maps world space to its slice.
+    DirectX::XMFLOAT4X4 ShadowTransform[4];
+    DirectX::XMFLOAT4 CascadeSplits = { 0.0f, 0.0f, 0.0f, 0.0f };
+    UINT CascadeCount = 0;
+    float ShadowTexelSize = 0.0f;
+    DirectX::XMFLOAT2 cbPerObjectPad3 = { 0.0f, 0.0f };
+};
+
+// Lights and environment. They rarely change, so the CPU keeps a version number and
+// each frame resource uploads them again only when its copy is older.
+struct LightingConstants
+{
     DirectX::XMFLOAT4 AmbientLight = { 0.0f, 0.0f, 0.0f, 1.0f };
 
+    // Only read by shader variants built with FOG.
+    DirectX::XMFLOAT4 FogColor = { 0.7f, 0.7f, 0.7f, 1.0f };
+    float FogStart = 5.0f;
+    float FogRange = 150.0f;
+
+    // Clustered lights from ClusterSpotLightStart on are spot lights.
+    UINT ClusterSpotLightStart = 0;
+    float cbLightingPad0 = 0.0f;
+
     // Indices [0, NUM_DIR_LIGHTS) are directional lights;
     // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
     // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
@@ -49,7 +80,8 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, GpuHeapAllocator& allocator, UINT passCount, UINT objectCount, UINT materialCount,
+        UINT clusterCount, UINT clusteredLightCount, UINT clusterLightIndexCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -62,13 +94,22 @@ public:
     // that reference it.  So each frame needs their own cbuffers.
    // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
+    std::unique_ptr<UploadBuffer<LightingConstants>> LightingCB = nullptr;
     std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
+    // Structured buffers written by the CPU light assignment every frame.
+    std::unique_ptr<UploadBuffer<Light>> ClusteredLights = nullptr;
+    std::unique_ptr<UploadBuffer<ClusterRange>> ClusterRanges = nullptr;
+    std::unique_ptr<UploadBuffer<UINT>> ClusterLightIndices = nullptr;
+
     // We cannot update a dynamic vertex buffer until the GPU is done processing
     // the commands that reference it.  So each frame needs their own.
     //std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
 
+    // Version of the lighting data in LightingCB (0: never written).
+    UINT64 LightingVersion = 0;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
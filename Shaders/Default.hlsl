@@ -22,6 +22,24 @@
 
 Texture2D    gDiffuseMap : register(t0);
 
+#ifdef CLUSTERED_LIGHTS
+// Luci assegnate ai cluster dalla CPU (LightClusters). Per ogni cluster gClusters contiene
+// offset e numero dei suoi indici in gClusterLightIndices.
+StructuredBuffer<Light> gClusteredLights     : register(t1);
+StructuredBuffer<uint2> gClusters            : register(t2);
+StructuredBuffer<uint>  gClusterLightIndices : register(t3);
+#endif
+
+#ifdef SHADOWS
+// Una slice per cascata della luce principale.
+Texture2DArray gShadowMap : register(t4);
+#endif
+
+#ifdef REFLECTIONS
+// Ambiente catturato dalla sonda al centro dell'oggetto.
+TextureCube gEnvironmentMap : register(t5);
+#endif
+
 
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
@@ -29,6 +47,7 @@ SamplerState gsamLinearWrap       : register(s2);
 SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
+SamplerComparisonState gsamShadow : register(s6);
 
 // Constant data that varies per frame.
 cbuffer cbPerObject : register(b0)
@@ -54,15 +73,44 @@ cbuffer cbPass : register(b1)
     float gFarZ;
     float gTotalTime;
     float gDeltaTime;
-    
+
+    // Griglia dei cluster (usata solo dalle varianti con CLUSTERED_LIGHTS).
+    uint3 gClusterCount;
+    float gClusterDepthScale;
+    float2 gClusterTileScale;
+    float gClusterDepthBias;
+    float cbPerObjectPad2;
+
+    // Cascate della shadow map (usate solo dalle varianti con SHADOWS).
+    float4x4 gShadowTransform[4];
+    float4 gCascadeSplits;
+    uint gCascadeCount;
+    float gShadowTexelSize;
+    float2 cbPerObjectPad3;
+};
+
+cbuffer cbMaterial : register(b2)
+{
+	float4   gDiffuseAlbedo;
+    float3   gFresnelR0;
+    float    gRoughness;
+	float4x4 gMatTransform;
+};
+
+// Luci e ambiente: cambiano di rado e vengono ricaricati solo quando cambiano.
+cbuffer cbLighting : register(b3)
+{
     // Intensit di luce indiretta incidente proveniente da tutte le sorgenti presenti nella scena.
     float4 gAmbientLight;
 
-    // Colore, partenza e range di per nebbia.
-	/*float4 gFogColor;
+    // Colore, partenza e range di per nebbia (usati solo dalle varianti con FOG).
+	float4 gFogColor;
 	float gFogStart;
 	float gFogRange;
-	float2 cbPerObjectPad2;*/
+
+    // Le luci assegnate ai cluster da gClusterSpotLightStart in poi sono spot.
+    uint gClusterSpotLightStart;
+    float cbLightingPad0;
 
     // Indici [0, NUM_DIR_LIGHTS) sono per luci direzionali;
     // indici [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) sono per punti luce;
@@ -72,14 +120,6 @@ cbuffer cbPass : register(b1)
     Light gLights[MaxLights];
 };
 
-cbuffer cbMaterial : register(b2)
-{
-	float4   gDiffuseAlbedo;
-    float3   gFresnelR0;
-    float    gRoughness;
-	float4x4 gMatTransform;
-};
-
 struct VertexIn
 {
 	float3 PosL    : POSITION;
@@ -100,14 +140,17 @@ VertexOut VS(VertexIn vin)
 	VertexOut vout = (VertexOut)0.0f;
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    // precise: la profondit deve coincidere bit per bit con quella di VSShadow,
+    // che scrive il depth pre-pass confrontato poi con EQUAL.
+    precise float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
     vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
 
     // Transform to homogeneous clip space.
-    vout.PosH = mul(posW, gViewProj);
+    precise float4 posH = mul(posW, gViewProj);
+    vout.PosH = posH;
 	
 	// Output vertex attributes for interpolation across triangle.
 	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
@@ -116,6 +159,55 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+// Solo profondit: usato dai pass delle ombre e dal depth pre-pass, senza pixel shader.
+// Stesse operazioni (e precise) di VS, cos le profondit coincidono.
+float4 VSShadow(VertexIn vin) : SV_POSITION
+{
+    precise float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    precise float4 posH = mul(posW, gViewProj);
+    return posH;
+}
+
+#ifdef SHADOWS
+// Frazione di luce (in [0,1]) che raggiunge il punto posW, a profondit viewDepth in
+// view space, filtrando 3x3 campioni della cascata che lo contiene.
+float CalcShadowFactor(float3 posW, float viewDepth)
+{
+    uint cascade = gCascadeCount;
+    for (uint i = gCascadeCount; i > 0; --i)
+    {
+        if (viewDepth <= gCascadeSplits[i - 1])
+            cascade = i - 1;
+    }
+
+    // Oltre l'ultima cascata non ci sono ombre.
+    if (cascade == gCascadeCount)
+        return 1.0f;
+
+    // Proiezione ortografica: non serve dividere per w.
+    float4 shadowPosH = mul(float4(posW, 1.0f), gShadowTransform[cascade]);
+    float depth = shadowPosH.z;
+
+    const float dx = gShadowTexelSize;
+    const float2 offsets[9] =
+    {
+        float2(-dx,  -dx), float2(0.0f,  -dx), float2(dx,  -dx),
+        float2(-dx, 0.0f), float2(0.0f, 0.0f), float2(dx, 0.0f),
+        float2(-dx,  +dx), float2(0.0f,  +dx), float2(dx,  +dx)
+    };
+
+    float percentLit = 0.0f;
+    [unroll]
+    for (int k = 0; k < 9; ++k)
+    {
+        percentLit += gShadowMap.SampleCmpLevelZero(gsamShadow,
+            float3(shadowPosH.xy + offsets[k], cascade), depth).r;
+    }
+
+    return percentLit / 9.0f;
+}
+#endif
+
 float4 PS(VertexOut pin) : SV_Target
 {
     float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
@@ -139,11 +231,43 @@ float4 PS(VertexOut pin) : SV_Target
     const float shininess = 1.0f - gRoughness;
     Material mat = { diffuseAlbedo, gFresnelR0, shininess };
     float3 shadowFactor = 1.0f;
+#ifdef SHADOWS
+    // Solo la luce principale proietta ombre; SV_Position.w  la profondit in view space.
+    shadowFactor[0] = CalcShadowFactor(pin.PosW, pin.PosH.w);
+#endif
     float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
         pin.NormalW, toEyeW, shadowFactor);
 
+#ifdef CLUSTERED_LIGHTS
+    // Cluster del pixel: tile in screen space e slice esponenziale sulla profondit in
+    // view space (SV_Position.w). Si valutano solo le luci che lo toccano.
+    uint3 cluster;
+    cluster.xy = min(uint2(pin.PosH.xy * gClusterTileScale), gClusterCount.xy - 1);
+    cluster.z = (uint)clamp(log2(pin.PosH.w) * gClusterDepthScale + gClusterDepthBias, 0.0f, (float)(gClusterCount.z - 1));
+
+    uint2 range = gClusters[cluster.x + gClusterCount.x * (cluster.y + gClusterCount.y * cluster.z)];
+    for (uint k = 0; k < range.y; ++k)
+    {
+        uint index = gClusterLightIndices[range.x + k];
+        if (index < gClusterSpotLightStart)
+            directLight.rgb += ComputePointLight(gClusteredLights[index], mat, pin.PosW, pin.NormalW, toEyeW);
+        else
+            directLight.rgb += ComputeSpotLight(gClusteredLights[index], mat, pin.PosW, pin.NormalW, toEyeW);
+    }
+#endif
+
     float4 litColor = ambient + directLight;
 
+#ifdef REFLECTIONS
+    // Riflesso dell'ambiente nella direzione speculare, pesato da Fresnel e lucentezza.
+    // La sonda sta al centro dell'oggetto: su un oggetto convesso e piccolo rispetto
+    // alla distanza di ci che riflette l'errore di parallasse resta contenuto.
+    float3 r = reflect(-toEyeW, pin.NormalW);
+    float4 reflectionColor = gEnvironmentMap.Sample(gsamLinearWrap, r);
+    float3 fresnelFactor = SchlickFresnel(gFresnelR0, pin.NormalW, r);
+    litColor.rgb += shininess * fresnelFactor * reflectionColor.rgb;
+#endif
+
     //Nebbia
 #ifdef FOG
     // Restituisce peso (in [0,1]) che ha la nebbia in base alla
@@ -0,0 +1,46 @@
+//***************************************************************************************
+// Upscale.hlsl
+//
+// Porta sul back buffer la scena disegnata a risoluzione ridotta (risoluzione dinamica).
+//***************************************************************************************
+
+// La scena occupa l'angolo in alto a sinistra della texture, grande quanto il back buffer.
+Texture2D gSceneColor : register(t0);
+
+SamplerState gsamLinearClamp : register(s3);
+
+// L'inizio di cbPass di Default.hlsl: gRenderTargetSize  la regione disegnata.
+cbuffer cbPass : register(b1)
+{
+    float4x4 gView;
+    float4x4 gInvView;
+    float4x4 gProj;
+    float4x4 gInvProj;
+    float4x4 gViewProj;
+    float4x4 gInvViewProj;
+    float3 gEyePosW;
+    float cbPerObjectPad1;
+    float2 gRenderTargetSize;
+    float2 gInvRenderTargetSize;
+};
+
+// Un triangolo che copre tutto lo schermo, senza vertex buffer.
+float4 VS(uint vertexId : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    return float4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, 0.0f, 1.0f);
+}
+
+float4 PS(float4 posH : SV_POSITION) : SV_Target
+{
+    float2 texSize;
+    gSceneColor.GetDimensions(texSize.x, texSize.y);
+
+    // Dal pixel del back buffer (grande quanto la texture) al punto corrispondente della
+    // regione disegnata. Il filtro bilineare si ferma a mezzo texel dal bordo della
+    // regione: oltre restano i pixel di frame disegnati ad un'altra scala.
+    float2 scenePos = posH.xy * gRenderTargetSize / texSize;
+    scenePos = clamp(scenePos, 0.5f, gRenderTargetSize - 0.5f);
+
+    return gSceneColor.Sample(gsamLinearClamp, scenePos / texSize);
+}